@@ -0,0 +1,131 @@
+/**
+ * @file bench/alloc_bench.cpp
+ * @brief SET/DEL churn on the slab allocator against plain glibc malloc
+ *
+ * Usage: alloc_bench [keys] [rounds]   (default: 1000000 10)
+ *
+ * Each allocator runs in its own forked process, so neither inherits the
+ * other's heap. A run fills an unlocked single-shard manager with `keys`
+ * short strings (8..128 bytes, stored inside the entry), then churns it:
+ * every round deletes a random half of the keys and writes as many new
+ * ones with values of 64..1024 bytes, a mix of embedded and separately
+ * allocated strings. Growing values over a heap full of holes left by
+ * small ones is what fragments a general-purpose malloc.
+ *
+ * Reports the churn rate in commands per second, the keyspace's own
+ * estimate of its size (used_memory), the growth of the process RSS, and
+ * their ratio, which is INFO's mem_fragmentation_ratio without the
+ * process's fixed overhead. Slab runs add the allocator's page-level
+ * ratio (active pages over live blocks).
+ */
+
+#include <sys/wait.h>
+#include <unistd.h>
+
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <random>
+#include <string>
+#include <vector>
+
+#include "storage/manager.hpp"
+#include "storage/slab_allocator.hpp"
+
+namespace
+{
+    using Clock = std::chrono::steady_clock;
+    using opus::storage::CacheManager;
+    using opus::storage::SlabAllocator;
+
+    size_t residentBytes()
+    {
+        long pages = 0, resident = 0;
+        if (FILE *statm = std::fopen("/proc/self/statm", "r"))
+        {
+            if (std::fscanf(statm, "%ld %ld", &pages, &resident) != 2)
+                resident = 0;
+            std::fclose(statm);
+        }
+        return static_cast<size_t>(resident) * static_cast<size_t>(sysconf(_SC_PAGESIZE));
+    }
+
+    std::string keyName(uint64_t id)
+    {
+        return "churn:" + std::to_string(id);
+    }
+
+    void run(const char *name, bool slab, size_t keys, size_t rounds)
+    {
+        SlabAllocator::configure(slab, false);
+        size_t baseline = residentBytes();
+
+        std::mt19937_64 rng(7);
+        std::string pattern(1024, 'v');
+        std::uniform_int_distribution<size_t> small(8, 128), large(64, 1024);
+
+        CacheManager cache(1, false);
+        std::vector<uint64_t> live(keys);
+        for (size_t i = 0; i < keys; ++i)
+        {
+            live[i] = i;
+            cache.set(keyName(i), pattern.substr(0, small(rng)));
+        }
+
+        uint64_t next = keys;
+        size_t commands = 0;
+        auto start = Clock::now();
+        for (size_t round = 0; round < rounds; ++round)
+        {
+            for (size_t i = 0; i < keys; ++i)
+            {
+                if (rng() & 1)
+                    continue;
+                cache.del(keyName(live[i]));
+                live[i] = next++;
+                cache.set(keyName(live[i]), pattern.substr(0, large(rng)));
+                commands += 2;
+            }
+        }
+        double seconds = std::chrono::duration<double>(Clock::now() - start).count();
+        while (cache.rehashStep())
+        {
+        }
+
+        size_t used = cache.usedMemory();
+        size_t rss = residentBytes() - baseline;
+        std::printf("%-6s %12.0f %12.1f %12.1f %8.2f", name, commands / seconds, used / 1048576.0, rss / 1048576.0,
+                    double(rss) / used);
+        if (slab)
+        {
+            auto stats = SlabAllocator::stats();
+            std::printf(" %8.2f", double(stats.active) / stats.allocated);
+        }
+        std::printf("\n");
+    }
+}
+
+int main(int argc, char *argv[])
+{
+    size_t keys = argc > 1 ? std::strtoull(argv[1], nullptr, 10) : 1000000;
+    size_t rounds = argc > 2 ? std::strtoull(argv[2], nullptr, 10) : 10;
+
+    std::printf("%zu keys, %zu churn rounds\n", keys, rounds);
+    std::printf("%-6s %12s %12s %12s %8s %8s\n", "alloc", "commands/s", "used MB", "RSS MB", "RSS/used", "pages");
+    std::fflush(stdout);
+
+    const std::pair<const char *, bool> allocators[] = {{"libc", false}, {"slab", true}};
+    for (const auto &[name, slab] : allocators)
+    {
+        pid_t child = fork();
+        if (child == 0)
+        {
+            run(name, slab, keys, rounds);
+            std::fflush(stdout);
+            _exit(0);
+        }
+        if (child > 0)
+            waitpid(child, nullptr, 0);
+    }
+    return 0;
+}
@@ -0,0 +1,128 @@
+/**
+ * @file bench/bulk_load_bench.cpp
+ * @brief Bulk-load throughput of single-key writes against their batch forms
+ *
+ * Usage: bulk_load_bench [keys] [batch]   (default: 10000000 100)
+ *
+ * Loads `keys` string keys into an unlocked manager, as the default mode
+ * runs it, once with one set() per key and once with mset() batches of
+ * `batch` pairs, which hash the batch up front and prefetch each key's
+ * bucket a few keys ahead. Then fills lists and sets of `batch` elements,
+ * one push or add per element against a single variadic call per key.
+ * Keys and values are built before the clock starts, so what is timed is
+ * the manager alone.
+ */
+
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <string>
+#include <string_view>
+#include <utility>
+#include <vector>
+
+#include "storage/manager.hpp"
+
+namespace
+{
+    using Clock = std::chrono::steady_clock;
+    using opus::storage::CacheManager;
+
+    double seconds_since(Clock::time_point start)
+    {
+        return std::chrono::duration<double>(Clock::now() - start).count();
+    }
+
+    void report(const char *label, size_t operations, double seconds)
+    {
+        std::printf("%-28s %12.0f /sec %9.2f s\n", label, operations / seconds, seconds);
+    }
+}
+
+int main(int argc, char *argv[])
+{
+    size_t keys = argc > 1 ? std::strtoull(argv[1], nullptr, 10) : 10000000;
+    size_t batch = argc > 2 ? std::strtoull(argv[2], nullptr, 10) : 100;
+
+    std::vector<std::string> names(keys);
+    for (size_t i = 0; i < keys; ++i)
+    {
+        names[i] = "key:" + std::to_string(i);
+    }
+    const std::string value(32, 'v');
+
+    std::printf("%zu keys, batches of %zu\n", keys, batch);
+    {
+        CacheManager cache(1, false);
+        auto start = Clock::now();
+        for (const auto &name : names)
+        {
+            cache.set(name, value);
+        }
+        report("SET", keys, seconds_since(start));
+    }
+    {
+        CacheManager cache(1, false);
+        std::vector<CacheManager::KeyValue> pairs;
+        pairs.reserve(batch);
+        auto start = Clock::now();
+        for (size_t i = 0; i < keys; i += batch)
+        {
+            pairs.clear();
+            for (size_t j = i; j < i + batch && j < keys; ++j)
+            {
+                pairs.emplace_back(names[j], value);
+            }
+            cache.mset(pairs);
+        }
+        report("MSET", keys, seconds_since(start));
+    }
+
+    // Collections get `batch` elements each, over keys / batch keys, so
+    // every run writes the same number of elements.
+    size_t collections = keys / batch;
+    std::vector<std::string_view> elements(names.begin(), names.begin() + batch);
+    {
+        CacheManager cache(1, false);
+        auto start = Clock::now();
+        for (size_t i = 0; i < collections; ++i)
+        {
+            for (std::string_view element : elements)
+            {
+                cache.rpush(names[i], element);
+            }
+        }
+        report("RPUSH, one value per call", collections * batch, seconds_since(start));
+    }
+    {
+        CacheManager cache(1, false);
+        auto start = Clock::now();
+        for (size_t i = 0; i < collections; ++i)
+        {
+            cache.rpush(names[i], elements);
+        }
+        report("RPUSH, variadic", collections * batch, seconds_since(start));
+    }
+    {
+        CacheManager cache(1, false);
+        auto start = Clock::now();
+        for (size_t i = 0; i < collections; ++i)
+        {
+            for (std::string_view element : elements)
+            {
+                cache.sadd(names[i], element);
+            }
+        }
+        report("SADD, one member per call", collections * batch, seconds_since(start));
+    }
+    {
+        CacheManager cache(1, false);
+        auto start = Clock::now();
+        for (size_t i = 0; i < collections; ++i)
+        {
+            cache.sadd(names[i], elements);
+        }
+        report("SADD, variadic", collections * batch, seconds_since(start));
+    }
+    return 0;
+}
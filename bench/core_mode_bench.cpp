@@ -0,0 +1,190 @@
+/**
+ * @file bench/core_mode_bench.cpp
+ * @brief Single-threaded executor vs shared-nothing thread-per-core mode
+ *
+ * Usage: core_mode_bench [cores] [clients] [millis_per_run] [port]
+ *
+ * Starts each server flavour in-process and drives it with `clients`
+ * connections, each pipelining 32 commands (90% GET, 10% SET) on random
+ * keys from its own thread.
+ */
+
+#include <arpa/inet.h>
+#include <atomic>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <random>
+#include <stdexcept>
+#include <string>
+#include <sys/socket.h>
+#include <thread>
+#include <unistd.h>
+#include <vector>
+
+#include "server/core_group.hpp"
+#include "server/server.hpp"
+#include "storage/manager.hpp"
+
+namespace
+{
+    constexpr int KEYS = 100000;
+    constexpr int DEPTH = 32;
+
+    int connect_to(int port)
+    {
+        int fd = socket(AF_INET, SOCK_STREAM, 0);
+        sockaddr_in addr{};
+        addr.sin_family = AF_INET;
+        addr.sin_port = htons(static_cast<uint16_t>(port));
+        addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+        if (connect(fd, reinterpret_cast<sockaddr *>(&addr), sizeof(addr)) < 0)
+        {
+            throw std::runtime_error("connect failed");
+        }
+        int yes = 1;
+        setsockopt(fd, IPPROTO_TCP, TCP_NODELAY, &yes, sizeof(yes));
+        return fd;
+    }
+
+    void send_all(int fd, const std::string &data)
+    {
+        size_t sent = 0;
+        while (sent < data.size())
+        {
+            ssize_t n = send(fd, data.data() + sent, data.size() - sent, 0);
+            if (n <= 0)
+                throw std::runtime_error("send failed");
+            sent += static_cast<size_t>(n);
+        }
+    }
+
+    void recv_exactly(int fd, std::string &sink, size_t bytes)
+    {
+        sink.resize(bytes);
+        size_t got = 0;
+        while (got < bytes)
+        {
+            ssize_t n = recv(fd, &sink[got], bytes - got, 0);
+            if (n <= 0)
+                throw std::runtime_error("recv failed");
+            got += static_cast<size_t>(n);
+        }
+    }
+
+    std::string command(const char *name, const std::string &key, bool with_value)
+    {
+        std::string out = with_value ? "*3\r\n" : "*2\r\n";
+        out += "$" + std::to_string(std::char_traits<char>::length(name)) + "\r\n" + name + "\r\n";
+        out += "$" + std::to_string(key.size()) + "\r\n" + key + "\r\n";
+        if (with_value)
+            out += "$5\r\nvalue\r\n";
+        return out;
+    }
+
+    void preload(int port)
+    {
+        int fd = connect_to(port);
+        std::string sink;
+        for (int base = 0; base < KEYS; base += 1000)
+        {
+            std::string batch;
+            for (int i = base; i < base + 1000; ++i)
+            {
+                batch += command("SET", "key:" + std::to_string(i), true);
+            }
+            send_all(fd, batch);
+            recv_exactly(fd, sink, 5 * 1000);
+        }
+        close(fd);
+    }
+
+    double drive(int port, int clients, int millis)
+    {
+        std::atomic<bool> stop{false};
+        std::vector<unsigned long long> counts(clients, 0);
+        std::vector<std::thread> threads;
+
+        for (int c = 0; c < clients; ++c)
+        {
+            threads.emplace_back([&, c]
+                                 {
+                int fd = connect_to(port);
+                std::mt19937 rng(c + 7);
+                std::uniform_int_distribution<int> pick(0, KEYS - 1);
+                std::string batch, sink;
+                unsigned long long ops = 0;
+                while (!stop.load(std::memory_order_relaxed))
+                {
+                    batch.clear();
+                    size_t reply_bytes = 0;
+                    for (int i = 0; i < DEPTH; ++i)
+                    {
+                        std::string key = "key:" + std::to_string(pick(rng));
+                        bool is_set = (rng() % 10) == 0;
+                        batch += command(is_set ? "SET" : "GET", key, is_set);
+                        reply_bytes += is_set ? 5 : 11; // "+OK\r\n" / "$5\r\nvalue\r\n"
+                    }
+                    send_all(fd, batch);
+                    recv_exactly(fd, sink, reply_bytes);
+                    ops += DEPTH;
+                }
+                counts[c] = ops;
+                close(fd); });
+        }
+
+        std::this_thread::sleep_for(std::chrono::milliseconds(millis));
+        stop.store(true);
+        for (auto &thread : threads)
+        {
+            thread.join();
+        }
+
+        unsigned long long total = 0;
+        for (auto count : counts)
+        {
+            total += count;
+        }
+        return total * 1000.0 / millis;
+    }
+}
+
+int main(int argc, char *argv[])
+{
+    unsigned hw = std::thread::hardware_concurrency();
+    int cores = argc > 1 ? std::atoi(argv[1]) : static_cast<int>(hw ? hw : 1);
+    int clients = argc > 2 ? std::atoi(argv[2]) : 2 * cores;
+    int millis = argc > 3 ? std::atoi(argv[3]) : 2000;
+    int port = argc > 4 ? std::atoi(argv[4]) : 7400;
+
+    double single_rate;
+    {
+        opus::storage::CacheManager cache(1, false);
+        opus::server::Server server("127.0.0.1", port, cache);
+        std::thread loop([&server]
+                         { server.run(); });
+        preload(port);
+        single_rate = drive(port, clients, millis);
+        server.stop();
+        loop.join();
+    }
+
+    double group_rate;
+    {
+        opus::server::CoreGroup group("127.0.0.1", port + 1, static_cast<size_t>(cores));
+        std::thread loop([&group]
+                         { group.run(); });
+        preload(port + 1);
+        group_rate = drive(port + 1, clients, millis);
+        group.stop();
+        loop.join();
+    }
+
+    std::printf("hardware threads: %u, clients: %d, pipeline depth: %d\n", hw, clients, DEPTH);
+    std::printf("%-28s %14s\n", "mode", "ops/sec");
+    std::printf("%-28s %14.0f\n", "single", single_rate);
+    std::printf("%-28s %14.0f\n", ("shared-nothing (" + std::to_string(cores) + " cores)").c_str(), group_rate);
+    return 0;
+}
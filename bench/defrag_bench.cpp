@@ -0,0 +1,175 @@
+/**
+ * @file bench/defrag_bench.cpp
+ * @brief Memory given back by active defragmentation after mass deletes
+ *
+ * Usage: defrag_bench [keys] [delete_percent] [cpu_percent]   (default: 1000000 80 25)
+ *
+ * Fills an unlocked single-shard manager on the slab allocator with a mix
+ * of strings (16..512 bytes), small lists, sets and hashes, then deletes a
+ * random `delete_percent` of the keys. What is left is scattered over
+ * pages that are mostly empty, so neither RSS nor the allocator's page
+ * count goes down much. The bench then calls activeDefragCycle() every
+ * simulated 100 ms interval, with `cpu_percent` of it to spend, until the
+ * fragmentation is back under the 10% threshold, and reports the allocator
+ * fragmentation ratio (active pages over live blocks), RSS and the
+ * keyspace's used_memory before and after, the number of cycles, the
+ * longest one, and that every surviving key still reads back intact.
+ */
+
+#include <unistd.h>
+
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <random>
+#include <string>
+#include <vector>
+
+#include "storage/manager.hpp"
+#include "storage/slab_allocator.hpp"
+
+namespace
+{
+    using Clock = std::chrono::steady_clock;
+    using opus::storage::CacheManager;
+    using opus::storage::SlabAllocator;
+
+    constexpr std::chrono::milliseconds CYCLE_INTERVAL(100);
+
+    // A simulated minute, in case the ratio never gets under the threshold.
+    constexpr size_t MAX_CYCLES = 600;
+
+    size_t residentBytes()
+    {
+        long pages = 0, resident = 0;
+        if (FILE *statm = std::fopen("/proc/self/statm", "r"))
+        {
+            if (std::fscanf(statm, "%ld %ld", &pages, &resident) != 2)
+                resident = 0;
+            std::fclose(statm);
+        }
+        return static_cast<size_t>(resident) * static_cast<size_t>(sysconf(_SC_PAGESIZE));
+    }
+
+    std::string keyName(uint64_t id)
+    {
+        return "defrag:" + std::to_string(id);
+    }
+
+    // Value of key `id`: its type and contents follow from the id alone,
+    // so survivors can be checked after the moves.
+    void store(CacheManager &cache, uint64_t id)
+    {
+        std::string key = keyName(id);
+        std::string field = "f" + std::to_string(id);
+        switch (id % 8)
+        {
+        case 5:
+            for (const char *suffix : {"", ":a", ":b"})
+                cache.rpush(key, field + suffix);
+            break;
+        case 6:
+            cache.sadd(key, std::vector<std::string>{field, field + ":a", field + ":b"});
+            break;
+        case 7:
+            cache.hset(key, {{field, std::string(32, 'h')}});
+            break;
+        default:
+            cache.set(key, std::string(16 + id % 497, 'v'));
+            break;
+        }
+    }
+
+    bool intact(CacheManager &cache, uint64_t id)
+    {
+        std::string key = keyName(id);
+        std::string field = "f" + std::to_string(id);
+        switch (id % 8)
+        {
+        case 5:
+            return cache.llen(key) == 3;
+        case 6:
+            return cache.sismember(key, field + ":b");
+        case 7:
+            return cache.hget(key, field) == std::string(32, 'h');
+        default:
+        {
+            auto value = cache.get(key);
+            return value && *value == std::string(16 + id % 497, 'v');
+        }
+        }
+    }
+
+    void report(const char *label, CacheManager &cache, size_t baseline)
+    {
+        auto heap = SlabAllocator::threadStats();
+        std::printf("%-8s %10.2f %10.1f %10.1f %10.1f\n", label, double(heap.active) / heap.allocated,
+                    heap.active / 1048576.0, (residentBytes() - baseline) / 1048576.0, cache.usedMemory() / 1048576.0);
+    }
+}
+
+int main(int argc, char *argv[])
+{
+    size_t keys = argc > 1 ? std::strtoull(argv[1], nullptr, 10) : 1000000;
+    unsigned percent = argc > 2 ? static_cast<unsigned>(std::strtoul(argv[2], nullptr, 10)) : 80;
+    unsigned cpu = argc > 3 ? static_cast<unsigned>(std::strtoul(argv[3], nullptr, 10)) : 25;
+
+    SlabAllocator::configure(true, false);
+    size_t baseline = residentBytes();
+
+    CacheManager cache(1, false);
+    for (uint64_t id = 0; id < keys; ++id)
+        store(cache, id);
+
+    std::mt19937_64 rng(11);
+    std::vector<uint64_t> kept;
+    for (uint64_t id = 0; id < keys; ++id)
+    {
+        if (rng() % 100 < percent)
+            cache.del(keyName(id));
+        else
+            kept.push_back(id);
+    }
+    while (cache.rehashStep())
+    {
+    }
+
+    std::printf("%zu keys, %u%% deleted, %u%% CPU per %lld ms cycle\n", keys, percent, cpu,
+                static_cast<long long>(CYCLE_INTERVAL.count()));
+    std::printf("%-8s %10s %10s %10s %10s\n", "", "frag", "pages MB", "RSS MB", "used MB");
+    report("before", cache, baseline);
+
+    opus::storage::DefragConfig config;
+    config.enabled = true;
+    config.threshold_percent = 10;
+    config.ignore_bytes = 0;
+    config.cpu_percent = cpu;
+    cache.setActiveDefrag(config);
+
+    // Passes follow one another until the ratio is under the threshold,
+    // i.e. until a cycle neither continues a pass nor finishes one.
+    size_t cycles = 0;
+    double longest = 0;
+    uint64_t passes;
+    auto start = Clock::now();
+    do
+    {
+        passes = cache.defragStats().passes;
+        auto cycle = Clock::now();
+        cache.activeDefragCycle(CYCLE_INTERVAL);
+        longest = std::max(longest, std::chrono::duration<double, std::milli>(Clock::now() - cycle).count());
+        ++cycles;
+    } while ((cache.defragStats().running || cache.defragStats().passes != passes) && cycles < MAX_CYCLES);
+    double seconds = std::chrono::duration<double>(Clock::now() - start).count();
+
+    report("after", cache, baseline);
+    auto stats = cache.defragStats();
+    size_t bad = static_cast<size_t>(
+        std::count_if(kept.begin(), kept.end(), [&](uint64_t id) { return !intact(cache, id); }));
+    std::printf("%llu passes in %zu cycles (%.1f ms busy, longest %.2f ms), %llu blocks moved in %llu keys\n",
+                static_cast<unsigned long long>(stats.passes), cycles, seconds * 1000, longest,
+                static_cast<unsigned long long>(stats.hits), static_cast<unsigned long long>(stats.key_hits));
+    std::printf("%zu of %zu surviving keys damaged\n", bad, kept.size());
+    return bad == 0 ? 0 : 1;
+}
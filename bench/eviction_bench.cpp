@@ -0,0 +1,165 @@
+/**
+ * @file bench/eviction_bench.cpp
+ * @brief Hit ratio and speed of the eviction policies on replayed traces
+ *
+ * Usage: eviction_bench [keys] [requests] [cache_percent]   (default: 1000000 10000000 10)
+ *
+ * Replays two traces against a CacheManager whose maxmemory holds about
+ * `cache_percent` of the `keys` keys, the way a look-aside cache is used:
+ * GET, and SET on a miss. "zipf" draws keys from a Zipfian distribution
+ * (s = 0.99); "zipf+scan" interleaves the same traffic with sequential
+ * scans of one-off keys, each as large as the cache, which is the pattern
+ * that flushes hot keys out of an LRU. Reports the hit ratio and requests
+ * per second of each policy. Traces are generated up front and replayed on
+ * a simulated clock of 10000 requests per second, so LRU idle times and
+ * LFU decay advance as they would under load.
+ */
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <random>
+#include <string>
+#include <vector>
+
+#include "storage/manager.hpp"
+
+namespace
+{
+    using Clock = std::chrono::steady_clock;
+    using opus::storage::CacheManager;
+    using opus::storage::EvictionPolicy;
+
+    constexpr size_t VALUE_SIZE = 64;
+    constexpr size_t REQUESTS_PER_SECOND = 10000;
+
+    // Zipf traffic between two scans.
+    constexpr size_t SCAN_PERIOD = 500000;
+
+    std::string keyName(uint64_t id)
+    {
+        return "key:" + std::to_string(id);
+    }
+
+    std::vector<uint64_t> zipfTrace(size_t keys, size_t requests, double skew, std::mt19937_64 &rng)
+    {
+        std::vector<double> cdf(keys);
+        double sum = 0;
+        for (size_t i = 0; i < keys; ++i)
+        {
+            sum += 1.0 / std::pow(double(i + 1), skew);
+            cdf[i] = sum;
+        }
+
+        // Ranks are scattered over the ids so popularity does not follow
+        // insertion order.
+        std::vector<uint64_t> ids(keys);
+        for (size_t i = 0; i < keys; ++i)
+            ids[i] = i;
+        std::shuffle(ids.begin(), ids.end(), rng);
+
+        std::uniform_real_distribution<double> uniform(0, sum);
+        std::vector<uint64_t> trace(requests);
+        for (auto &request : trace)
+        {
+            size_t rank = std::lower_bound(cdf.begin(), cdf.end(), uniform(rng)) - cdf.begin();
+            request = ids[std::min(rank, keys - 1)];
+        }
+        return trace;
+    }
+
+    // Replaces stretches of the trace with scans of ids past `keys`, each
+    // seen once.
+    std::vector<uint64_t> withScans(std::vector<uint64_t> trace, size_t keys, size_t scan_length)
+    {
+        uint64_t next = keys;
+        for (size_t start = SCAN_PERIOD; start < trace.size(); start += SCAN_PERIOD + scan_length)
+        {
+            for (size_t i = start; i < std::min(trace.size(), start + scan_length); ++i)
+                trace[i] = next++;
+        }
+        return trace;
+    }
+
+    double seconds(Clock::time_point start)
+    {
+        return std::chrono::duration<double>(Clock::now() - start).count();
+    }
+
+    // usedMemory() per key of the kind the traces store.
+    double bytesPerKey()
+    {
+        constexpr size_t SAMPLE = 100000;
+        CacheManager cache(1, false);
+        std::string value(VALUE_SIZE, 'v');
+        for (size_t i = 0; i < SAMPLE; ++i)
+            cache.set(keyName(i), value);
+        return double(cache.usedMemory()) / SAMPLE;
+    }
+
+    void replay(const char *policy_name, EvictionPolicy policy, size_t max_memory, const std::vector<uint64_t> &trace)
+    {
+        CacheManager cache(1, false);
+        cache.setMaxMemory(max_memory, policy);
+        long long now_ms = CacheManager::currentTimeMs();
+        cache.updateLruClock(now_ms);
+
+        std::string value(VALUE_SIZE, 'v');
+        size_t hits = 0;
+        auto start = Clock::now();
+        for (size_t i = 0; i < trace.size(); ++i)
+        {
+            if (i % REQUESTS_PER_SECOND == 0)
+                cache.updateLruClock(now_ms + static_cast<long long>(i / REQUESTS_PER_SECOND) * 1000);
+
+            // Every command makes room first, as the server does.
+            cache.evictIfNeeded();
+            std::string key = keyName(trace[i]);
+            if (cache.get(key))
+                ++hits;
+            else
+                cache.set(key, value);
+        }
+        double rate = trace.size() / seconds(start);
+
+        std::printf("  %-16s %9.2f%% %12.0f %10zu\n", policy_name, 100.0 * hits / trace.size(), rate,
+                    cache.memoryStats().evicted_keys);
+    }
+}
+
+int main(int argc, char *argv[])
+{
+    size_t keys = argc > 1 ? std::strtoull(argv[1], nullptr, 10) : 1000000;
+    size_t requests = argc > 2 ? std::strtoull(argv[2], nullptr, 10) : 10000000;
+    double percent = argc > 3 ? std::strtod(argv[3], nullptr) : 10;
+
+    size_t cache_keys = static_cast<size_t>(keys * percent / 100);
+    size_t max_memory = static_cast<size_t>(cache_keys * bytesPerKey());
+
+    std::mt19937_64 rng(42);
+    std::vector<uint64_t> zipf = zipfTrace(keys, requests, 0.99, rng);
+    const std::pair<const char *, std::vector<uint64_t>> traces[] = {
+        {"zipf", zipf},
+        {"zipf+scan", withScans(zipf, keys, cache_keys)},
+    };
+    const std::pair<const char *, EvictionPolicy> policies[] = {
+        {"allkeys-random", EvictionPolicy::ALLKEYS_RANDOM},
+        {"allkeys-lru", EvictionPolicy::ALLKEYS_LRU},
+        {"allkeys-lfu", EvictionPolicy::ALLKEYS_LFU},
+        {"allkeys-tinylfu", EvictionPolicy::ALLKEYS_TINYLFU},
+    };
+
+    std::printf("%zu keys, %zu requests, cache of %zu keys (%zu bytes)\n", keys, requests, cache_keys, max_memory);
+    for (const auto &[trace_name, trace] : traces)
+    {
+        std::printf("%s\n  %-16s %10s %12s %10s\n", trace_name, "policy", "hit ratio", "requests/s", "evicted");
+        for (const auto &[policy_name, policy] : policies)
+        {
+            replay(policy_name, policy, max_memory, trace);
+        }
+    }
+    return 0;
+}
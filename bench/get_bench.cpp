@@ -0,0 +1,126 @@
+/**
+ * @file bench/get_bench.cpp
+ * @brief GET throughput by value size against an in-process server
+ *
+ * Usage: get_bench [port] [depth]   (default: 7398 16)
+ *
+ * Starts a single-threaded Server on 127.0.0.1:<port>, as the default
+ * mode runs it, stores `depth` keys of 16 B, 1 KB and 64 KB in turn and
+ * reads them back over one connection in pipelines of `depth` GETs.
+ * Reports GETs per second and the value bytes delivered per second; the
+ * 64 KB case is dominated by how often the server copies the value on
+ * its way to the socket.
+ */
+
+#include <arpa/inet.h>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <stdexcept>
+#include <string>
+#include <sys/socket.h>
+#include <thread>
+#include <unistd.h>
+
+#include "server/server.hpp"
+#include "storage/manager.hpp"
+
+namespace
+{
+    int connect_to(int port)
+    {
+        int fd = socket(AF_INET, SOCK_STREAM, 0);
+        sockaddr_in addr{};
+        addr.sin_family = AF_INET;
+        addr.sin_port = htons(static_cast<uint16_t>(port));
+        addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+        if (connect(fd, reinterpret_cast<sockaddr *>(&addr), sizeof(addr)) < 0)
+        {
+            throw std::runtime_error("connect failed");
+        }
+        int yes = 1;
+        setsockopt(fd, IPPROTO_TCP, TCP_NODELAY, &yes, sizeof(yes));
+        return fd;
+    }
+
+    std::string bulk(const std::string &arg)
+    {
+        return "$" + std::to_string(arg.size()) + "\r\n" + arg + "\r\n";
+    }
+
+    void send_all(int fd, const std::string &data)
+    {
+        size_t sent = 0;
+        while (sent < data.size())
+        {
+            ssize_t n = send(fd, data.data() + sent, data.size() - sent, 0);
+            if (n <= 0)
+                throw std::runtime_error("send failed");
+            sent += static_cast<size_t>(n);
+        }
+    }
+
+    void recv_exactly(int fd, std::string &sink, size_t bytes)
+    {
+        sink.resize(bytes);
+        size_t got = 0;
+        while (got < bytes)
+        {
+            ssize_t n = recv(fd, &sink[got], bytes - got, 0);
+            if (n <= 0)
+                throw std::runtime_error("recv failed");
+            got += static_cast<size_t>(n);
+        }
+    }
+}
+
+int main(int argc, char *argv[])
+{
+    int port = argc > 1 ? std::atoi(argv[1]) : 7398;
+    int depth = argc > 2 ? std::atoi(argv[2]) : 16;
+
+    // Only the loop thread touches the keyspace, as in the default mode.
+    opus::storage::CacheManager cache(1, false);
+    opus::server::Server server("127.0.0.1", port, cache);
+    std::thread server_thread([&server]
+                              { server.run(); });
+
+    int fd = connect_to(port);
+    std::string sink;
+
+    // About a gigabyte of values per size, capped for the small ones.
+    const std::pair<size_t, long> sizes[] = {{16, 2000000}, {1024, 1000000}, {65536, 16384}};
+    std::printf("%-8s %14s %14s\n", "value", "GET ops/sec", "MB/sec");
+    for (const auto &[size, gets] : sizes)
+    {
+        std::string value(size, 'v');
+        std::string sets, pipeline;
+        for (int i = 0; i < depth; ++i)
+        {
+            std::string key = "get:" + std::to_string(i);
+            sets += "*3\r\n" + bulk("SET") + bulk(key) + bulk(value);
+            pipeline += "*2\r\n" + bulk("GET") + bulk(key);
+        }
+        send_all(fd, sets);
+        recv_exactly(fd, sink, 5 * static_cast<size_t>(depth)); // "+OK\r\n"
+
+        size_t reply_bytes = bulk(value).size() * static_cast<size_t>(depth);
+        long batches = gets / depth;
+        auto start = std::chrono::steady_clock::now();
+        for (long b = 0; b < batches; ++b)
+        {
+            send_all(fd, pipeline);
+            recv_exactly(fd, sink, reply_bytes);
+        }
+        std::chrono::duration<double> elapsed = std::chrono::steady_clock::now() - start;
+        double rate = static_cast<double>(batches) * depth / elapsed.count();
+        std::printf("%-8zu %14.0f %14.1f\n", size, rate, rate * size / 1048576.0);
+    }
+
+    close(fd);
+    server.stop();
+    server_thread.join();
+    return 0;
+}
@@ -0,0 +1,123 @@
+/**
+ * @file bench/hash_bench.cpp
+ * @brief Memory and speed of HashType against a plain std::unordered_map
+ *
+ * Usage: hash_bench [hashes] [value_len]   (default: 100000 12)
+ *
+ * For hashes of 10, 30 and 50 fields (user-profile sized; field names like
+ * "field_17"), builds `hashes` of them and reports heap bytes per field,
+ * the HSET rate and the HGET rate. HashType stays in its packed encoding at
+ * these sizes; the unordered_map row is what every hash cost before.
+ */
+
+#include <malloc.h>
+
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <optional>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+#include "storage/hash_type.hpp"
+
+namespace
+{
+    using Clock = std::chrono::steady_clock;
+
+    class MapHash
+    {
+    private:
+        std::unordered_map<std::string, std::string> fields;
+
+    public:
+        int hset(const std::string &field, const std::string &value)
+        {
+            auto [it, inserted] = fields.try_emplace(field, value);
+            if (!inserted)
+                it->second = value;
+            return inserted ? 1 : 0;
+        }
+
+        std::optional<std::string> hget(const std::string &field) const
+        {
+            auto it = fields.find(field);
+            if (it == fields.end())
+                return std::nullopt;
+            return it->second;
+        }
+    };
+
+    size_t heapInUse()
+    {
+        struct mallinfo2 info = mallinfo2();
+        return info.uordblks + info.hblkhd;
+    }
+
+    double seconds(Clock::time_point start)
+    {
+        return std::chrono::duration<double>(Clock::now() - start).count();
+    }
+
+    template <typename Hash>
+    void run(const char *name, size_t hashes, size_t field_count, const std::string &value)
+    {
+        std::vector<std::string> names;
+        for (size_t i = 0; i < field_count; ++i)
+        {
+            names.push_back("field_" + std::to_string(i));
+        }
+
+        size_t before = heapInUse();
+        std::vector<Hash *> all(hashes);
+
+        auto start = Clock::now();
+        for (auto &hash : all)
+        {
+            hash = new Hash();
+            for (const auto &field : names)
+            {
+                hash->hset(field, value);
+            }
+        }
+        double total = double(hashes) * field_count;
+        double set_rate = total / seconds(start);
+        double bytes = double(heapInUse() - before - hashes * sizeof(Hash *)) / total;
+
+        start = Clock::now();
+        size_t sink = 0;
+        for (const auto *hash : all)
+        {
+            for (const auto &field : names)
+            {
+                sink += hash->hget(field)->size();
+            }
+        }
+        double get_rate = total / seconds(start);
+
+        for (auto *hash : all)
+        {
+            delete hash;
+        }
+        std::printf("%-14s %7zu %14.1f %14.0f %14.0f%s\n", name, field_count, bytes, set_rate, get_rate,
+                    sink == 0 ? " " : "");
+        malloc_trim(0);
+    }
+}
+
+int main(int argc, char *argv[])
+{
+    size_t hashes = argc > 1 ? std::strtoull(argv[1], nullptr, 10) : 100000;
+    size_t value_len = argc > 2 ? std::strtoull(argv[2], nullptr, 10) : 12;
+    std::string value(value_len, 'v');
+
+    std::printf("%zu hashes, %zu byte values\n", hashes, value_len);
+    std::printf("%-14s %7s %14s %14s %14s\n", "hash", "fields", "bytes/field", "hset/s", "hget/s");
+    for (size_t fields : {10, 30, 50})
+    {
+        run<MapHash>("unordered_map", hashes, fields, value);
+        run<opus::storage::HashType>("HashType", hashes, fields, value);
+    }
+    return 0;
+}
@@ -0,0 +1,194 @@
+/**
+ * @file bench/keyspace_bench.cpp
+ * @brief Keyspace table: storage::Dict against std::unordered_map
+ *
+ * Usage: keyspace_bench [keys...]   (default: 1000000 10000000 50000000)
+ *
+ * For each key count, loads the table one key at a time and reports the
+ * heap bytes per key, the slowest single insert (the worst pause growth
+ * causes) and the average latency of random hit and miss lookups. The two
+ * tables are built one after the other so peak memory is one table.
+ */
+
+#include <malloc.h>
+
+#include <algorithm>
+#include <chrono>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <random>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+#include <vector>
+
+#include "storage/dict.hpp"
+
+namespace
+{
+    using Clock = std::chrono::steady_clock;
+
+    struct Entry
+    {
+        std::string key;
+        uint64_t value;
+    };
+
+    struct EntryTraits
+    {
+        static std::string_view key(const Entry &entry) { return entry.key; }
+    };
+
+    using Dict = opus::storage::Dict<Entry, EntryTraits>;
+    using Map = std::unordered_map<std::string, uint64_t>;
+
+    struct Result
+    {
+        double bytes_per_key;
+        double max_insert_us;
+        double hit_ns;
+        double miss_ns;
+    };
+
+    size_t heapInUse()
+    {
+        struct mallinfo2 info = mallinfo2();
+        return info.uordblks + info.hblkhd;
+    }
+
+    // Fixed-width keys, short enough to stay in std::string's inline buffer.
+    std::string makeKey(uint64_t i)
+    {
+        char buf[16];
+        std::snprintf(buf, sizeof(buf), "key:%011llu", static_cast<unsigned long long>(i));
+        return buf;
+    }
+
+    std::vector<uint64_t> probeOrder(uint64_t keys, size_t count, uint64_t offset)
+    {
+        std::mt19937_64 rng(42);
+        std::uniform_int_distribution<uint64_t> pick(0, keys - 1);
+        std::vector<uint64_t> order(count);
+        for (auto &i : order)
+            i = pick(rng) + offset;
+        return order;
+    }
+
+    double nsPerOp(Clock::time_point start, size_t ops)
+    {
+        return std::chrono::duration<double, std::nano>(Clock::now() - start).count() / ops;
+    }
+
+    // Lookup keys are built up front so the timing covers only the table.
+    std::vector<std::string> probeKeys(const std::vector<uint64_t> &order)
+    {
+        std::vector<std::string> out;
+        out.reserve(order.size());
+        for (uint64_t i : order)
+            out.push_back(makeKey(i));
+        return out;
+    }
+
+    template <typename InsertFn>
+    double load(uint64_t keys, InsertFn insert)
+    {
+        double worst = 0;
+        for (uint64_t i = 0; i < keys; ++i)
+        {
+            std::string key = makeKey(i);
+            auto start = Clock::now();
+            insert(std::move(key), i);
+            worst = std::max(worst, std::chrono::duration<double, std::micro>(Clock::now() - start).count());
+        }
+        return worst;
+    }
+
+    Result benchDict(uint64_t keys, const std::vector<std::string> &hits, const std::vector<std::string> &misses)
+    {
+        Result result{};
+        size_t before = heapInUse();
+        {
+            Dict dict;
+            result.max_insert_us = load(keys, [&](std::string &&key, uint64_t i)
+                                        {
+                size_t hash = Dict::hashKey(key);
+                dict.insertUnique(Entry{std::move(key), i}, hash); });
+            while (dict.rehashStep(1024))
+            {
+            }
+            result.bytes_per_key = double(heapInUse() - before) / keys;
+
+            uint64_t sink = 0;
+            auto start = Clock::now();
+            for (const auto &key : hits)
+                sink += dict.find(key)->value;
+            result.hit_ns = nsPerOp(start, hits.size());
+
+            start = Clock::now();
+            for (const auto &key : misses)
+                sink += dict.find(key) != nullptr;
+            result.miss_ns = nsPerOp(start, misses.size());
+            if (sink == 1)
+                std::printf(" ");
+        }
+        return result;
+    }
+
+    Result benchMap(uint64_t keys, const std::vector<std::string> &hits, const std::vector<std::string> &misses)
+    {
+        Result result{};
+        size_t before = heapInUse();
+        {
+            Map map;
+            result.max_insert_us = load(keys, [&](std::string &&key, uint64_t i)
+                                        { map.emplace(std::move(key), i); });
+            result.bytes_per_key = double(heapInUse() - before) / keys;
+
+            uint64_t sink = 0;
+            auto start = Clock::now();
+            for (const auto &key : hits)
+                sink += map.find(key)->second;
+            result.hit_ns = nsPerOp(start, hits.size());
+
+            start = Clock::now();
+            for (const auto &key : misses)
+                sink += map.find(key) != map.end();
+            result.miss_ns = nsPerOp(start, misses.size());
+            if (sink == 1)
+                std::printf(" ");
+        }
+        return result;
+    }
+
+    void print(const char *name, uint64_t keys, const Result &r)
+    {
+        std::printf("%-14s %12llu %12.1f %14.1f %10.1f %10.1f\n", name,
+                    static_cast<unsigned long long>(keys), r.bytes_per_key,
+                    r.max_insert_us, r.hit_ns, r.miss_ns);
+    }
+}
+
+int main(int argc, char *argv[])
+{
+    std::vector<uint64_t> sizes;
+    for (int i = 1; i < argc; ++i)
+        sizes.push_back(std::strtoull(argv[i], nullptr, 10));
+    if (sizes.empty())
+        sizes = {1000000, 10000000, 50000000};
+
+    std::printf("%-14s %12s %12s %14s %10s %10s\n", "table", "keys", "bytes/key",
+                "max insert us", "hit ns", "miss ns");
+    for (uint64_t keys : sizes)
+    {
+        const size_t probes = 1000000;
+        auto hits = probeKeys(probeOrder(keys, probes, 0));
+        auto misses = probeKeys(probeOrder(keys, probes, keys));
+
+        print("unordered_map", keys, benchMap(keys, hits, misses));
+        malloc_trim(0);
+        print("Dict", keys, benchDict(keys, hits, misses));
+        malloc_trim(0);
+    }
+    return 0;
+}
@@ -0,0 +1,129 @@
+/**
+ * @file bench/lazy_free_bench.cpp
+ * @brief Time a delete or flush holds the caller, freeing inline against
+ *        freeing in the background
+ *
+ * Usage: lazy_free_bench [elements] [keys]   (default: 5000000 2000000)
+ *
+ * Builds, in an unlocked manager as the default mode runs it, one list,
+ * set, hash and sorted set of `elements` elements each and times DEL of
+ * each against UNLINK of a fresh copy, then fills `keys` string keys and
+ * times FLUSHALL against FLUSHALL ASYNC. Only the call itself is timed:
+ * that is how long the event loop would stop serving everyone else. The
+ * background thread's own time is reported apart, as the wait for its
+ * queue to drain.
+ */
+
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <string>
+#include <string_view>
+#include <thread>
+#include <utility>
+#include <vector>
+
+#include "storage/manager.hpp"
+
+namespace
+{
+    using Clock = std::chrono::steady_clock;
+    using opus::storage::CacheManager;
+
+    double ms_since(Clock::time_point start)
+    {
+        return std::chrono::duration<double, std::milli>(Clock::now() - start).count();
+    }
+
+    double drain(CacheManager &cache)
+    {
+        auto start = Clock::now();
+        while (cache.memoryStats().lazyfree_pending > 0)
+        {
+            std::this_thread::sleep_for(std::chrono::microseconds(100));
+        }
+        return ms_since(start);
+    }
+
+    void fill(CacheManager &cache, std::string_view type, std::string_view key, const std::vector<std::string> &names)
+    {
+        const size_t batch = 1000;
+        for (size_t i = 0; i < names.size(); i += batch)
+        {
+            auto first = names.begin() + i;
+            auto last = names.begin() + std::min(i + batch, names.size());
+            if (type == "list")
+            {
+                cache.rpush(key, std::vector<std::string_view>(first, last));
+            }
+            else if (type == "set")
+            {
+                cache.sadd(key, std::vector<std::string_view>(first, last));
+            }
+            else if (type == "hash")
+            {
+                std::vector<opus::storage::HashType::FieldValue> pairs;
+                for (auto it = first; it != last; ++it)
+                    pairs.emplace_back(*it, "v");
+                cache.hset(key, pairs);
+            }
+            else
+            {
+                std::vector<std::pair<double, std::string>> pairs;
+                for (auto it = first; it != last; ++it)
+                    pairs.emplace_back(static_cast<double>(it - names.begin()), *it);
+                int added = 0, updated = 0;
+                cache.zadd(key, pairs, 0, added, updated);
+            }
+        }
+    }
+}
+
+int main(int argc, char *argv[])
+{
+    size_t elements = argc > 1 ? std::strtoull(argv[1], nullptr, 10) : 5000000;
+    size_t keys = argc > 2 ? std::strtoull(argv[2], nullptr, 10) : 2000000;
+
+    std::vector<std::string> names(std::max(elements, keys));
+    for (size_t i = 0; i < names.size(); ++i)
+    {
+        names[i] = "element:" + std::to_string(i);
+    }
+    std::vector<std::string> members(names.begin(), names.begin() + elements);
+
+    CacheManager cache(1, false);
+    std::printf("%zu elements per collection, %zu keys to flush\n", elements, keys);
+    std::printf("%-10s %14s %14s %14s\n", "", "DEL ms", "UNLINK ms", "drain ms");
+    for (const char *type : {"list", "set", "hash", "zset"})
+    {
+        fill(cache, type, "inline", members);
+        fill(cache, type, "lazy", members);
+
+        auto start = Clock::now();
+        cache.del("inline");
+        double inline_ms = ms_since(start);
+        start = Clock::now();
+        cache.unlink("lazy");
+        double lazy_ms = ms_since(start);
+        std::printf("%-10s %14.3f %14.3f %14.1f\n", type, inline_ms, lazy_ms, drain(cache));
+    }
+
+    std::printf("%-10s %14s %14s %14s\n", "", "FLUSHALL ms", "ASYNC ms", "drain ms");
+    double flush_ms[2];
+    for (int async = 0; async < 2; ++async)
+    {
+        for (size_t i = 0; i < keys; ++i)
+        {
+            cache.set(names[i], "value");
+        }
+        auto start = Clock::now();
+        if (async)
+            cache.clearAsync();
+        else
+            cache.clear();
+        flush_ms[async] = ms_since(start);
+    }
+    std::printf("%-10s %14.3f %14.3f %14.1f\n", "keys", flush_ms[0], flush_ms[1], drain(cache));
+    return 0;
+}
@@ -0,0 +1,143 @@
+/**
+ * @file bench/list_bench.cpp
+ * @brief Quicklist ListType against the previous std::list<std::string> layout
+ *
+ * Usage: list_bench [elements] [element_len]   (default: 1000000 16)
+ *
+ * Builds one list of `elements` values with RPUSH and reports the push
+ * rate, heap bytes per element, the latency of LINDEX and a 10-element
+ * LRANGE deep into the list (90% of the way in), and the LPOP rate while
+ * draining it.
+ */
+
+#include <malloc.h>
+
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <iterator>
+#include <list>
+#include <optional>
+#include <string>
+#include <vector>
+
+#include "storage/list_type.hpp"
+
+namespace
+{
+    using Clock = std::chrono::steady_clock;
+
+    // The list representation ListType used before the quicklist.
+    class LinkedList
+    {
+    private:
+        std::list<std::string> values;
+
+    public:
+        int rpush(const std::string &val)
+        {
+            values.push_back(val);
+            return values.size();
+        }
+
+        std::optional<std::string> lpop()
+        {
+            if (values.empty())
+                return std::nullopt;
+            std::string val = values.front();
+            values.pop_front();
+            return val;
+        }
+
+        std::optional<std::string> lindex(long long index) const
+        {
+            if (index < 0 || index >= static_cast<long long>(values.size()))
+                return std::nullopt;
+            auto it = values.begin();
+            std::advance(it, index);
+            return *it;
+        }
+
+        std::vector<std::string> lrange(long long start, long long stop) const
+        {
+            std::vector<std::string> result;
+            auto it = values.begin();
+            std::advance(it, start);
+            for (long long i = start; i <= stop && it != values.end(); ++i, ++it)
+            {
+                result.push_back(*it);
+            }
+            return result;
+        }
+    };
+
+    size_t heapInUse()
+    {
+        struct mallinfo2 info = mallinfo2();
+        return info.uordblks + info.hblkhd;
+    }
+
+    double seconds(Clock::time_point start)
+    {
+        return std::chrono::duration<double>(Clock::now() - start).count();
+    }
+
+    template <typename List>
+    void run(const char *name, size_t elements, size_t element_len)
+    {
+        std::string value(element_len, 'x');
+        size_t before = heapInUse();
+        auto *list = new List();
+
+        auto start = Clock::now();
+        for (size_t i = 0; i < elements; ++i)
+        {
+            list->rpush(value);
+        }
+        double push_rate = elements / seconds(start);
+        double bytes = double(heapInUse() - before) / elements;
+
+        // A few repetitions so the fast case is measurable at all.
+        const int reps = 20;
+        long long deep = static_cast<long long>(elements * 9 / 10);
+
+        start = Clock::now();
+        size_t sink = 0;
+        for (int r = 0; r < reps; ++r)
+        {
+            sink += list->lindex(deep + r)->size();
+        }
+        double lindex_us = seconds(start) * 1e6 / reps;
+
+        start = Clock::now();
+        for (int r = 0; r < reps; ++r)
+        {
+            sink += list->lrange(deep + r, deep + r + 9).size();
+        }
+        double lrange_us = seconds(start) * 1e6 / reps;
+
+        start = Clock::now();
+        while (list->lpop())
+        {
+        }
+        double pop_rate = elements / seconds(start);
+        delete list;
+
+        std::printf("%-10s %14.0f %12.1f %12.1f %12.1f %14.0f%s\n", name, push_rate, bytes,
+                    lindex_us, lrange_us, pop_rate, sink == 0 ? " " : "");
+        malloc_trim(0);
+    }
+}
+
+int main(int argc, char *argv[])
+{
+    size_t elements = argc > 1 ? std::strtoull(argv[1], nullptr, 10) : 1000000;
+    size_t element_len = argc > 2 ? std::strtoull(argv[2], nullptr, 10) : 16;
+
+    std::printf("%zu elements of %zu bytes\n", elements, element_len);
+    std::printf("%-10s %14s %12s %12s %12s %14s\n", "list", "rpush/s", "bytes/elem",
+                "lindex us", "lrange us", "lpop/s");
+    run<LinkedList>("std::list", elements, element_len);
+    run<opus::storage::ListType>("quicklist", elements, element_len);
+    return 0;
+}
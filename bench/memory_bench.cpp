@@ -0,0 +1,77 @@
+/**
+ * @file bench/memory_bench.cpp
+ * @brief Heap bytes per key held by the CacheManager
+ *
+ * Usage: memory_bench [keys] [key_len] [value_len]   (default: 1000000 40 60)
+ *
+ * Fills an unlocked single-shard manager with string keys and reports the
+ * heap growth per key: malloc's bytes in use (glibc mallinfo2, so its own
+ * chunk overhead is included) plus the slab allocator's blocks, rounded up
+ * to their size classes. The defaults mirror a session cache: ~40 byte keys and
+ * ~60 byte values. A few other value sizes are reported alongside to show
+ * where values stop being stored inline.
+ */
+
+#include <malloc.h>
+
+#include <cstdio>
+#include <cstdlib>
+#include <string>
+#include <vector>
+
+#include "storage/manager.hpp"
+#include "storage/slab_allocator.hpp"
+
+namespace
+{
+    size_t heapInUse()
+    {
+        // Large slab requests are malloc's, and already in mallinfo2.
+        struct mallinfo2 info = mallinfo2();
+        auto slab = opus::storage::SlabAllocator::stats();
+        return info.uordblks + info.hblkhd + slab.allocated - slab.large;
+    }
+
+    std::string makeKey(size_t i, size_t len)
+    {
+        std::string key = "session:" + std::to_string(i) + ":";
+        key.resize(len < key.size() ? key.size() : len, 'k');
+        return key;
+    }
+
+    double bytesPerKey(size_t keys, size_t key_len, size_t value_len)
+    {
+        std::string value(value_len, 'v');
+        size_t before = heapInUse();
+        double result;
+        {
+            opus::storage::CacheManager cache(1, false);
+            for (size_t i = 0; i < keys; ++i)
+            {
+                cache.set(makeKey(i, key_len), value);
+            }
+            while (cache.rehashStep())
+            {
+            }
+            result = double(heapInUse() - before) / keys;
+        }
+        malloc_trim(0);
+        return result;
+    }
+}
+
+int main(int argc, char *argv[])
+{
+    size_t keys = argc > 1 ? std::strtoull(argv[1], nullptr, 10) : 1000000;
+    size_t key_len = argc > 2 ? std::strtoull(argv[2], nullptr, 10) : 40;
+    size_t value_len = argc > 3 ? std::strtoull(argv[3], nullptr, 10) : 60;
+
+    std::vector<size_t> value_sizes = {value_len, 8, 200, 1000};
+
+    std::printf("%-10s %8s %10s %12s\n", "keys", "key len", "value len", "bytes/key");
+    for (size_t len : value_sizes)
+    {
+        std::printf("%-10zu %8zu %10zu %12.1f\n", keys, key_len, len, bytesPerKey(keys, key_len, len));
+    }
+    return 0;
+}
@@ -0,0 +1,119 @@
+/**
+ * @file bench/pipeline_bench.cpp
+ * @brief Pipelined SET/GET throughput against an in-process server
+ *
+ * Usage: pipeline_bench [port] [ops_per_depth]
+ *
+ * Starts a Server on 127.0.0.1:<port> in a background thread and drives it
+ * from one blocking client that sends `depth` commands per round trip.
+ */
+
+#include <arpa/inet.h>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <stdexcept>
+#include <string>
+#include <sys/socket.h>
+#include <thread>
+#include <unistd.h>
+
+#include "server/server.hpp"
+#include "storage/manager.hpp"
+
+namespace
+{
+    int connect_to(int port)
+    {
+        int fd = socket(AF_INET, SOCK_STREAM, 0);
+        sockaddr_in addr{};
+        addr.sin_family = AF_INET;
+        addr.sin_port = htons(static_cast<uint16_t>(port));
+        addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+        if (connect(fd, reinterpret_cast<sockaddr *>(&addr), sizeof(addr)) < 0)
+        {
+            throw std::runtime_error("connect failed");
+        }
+        int yes = 1;
+        setsockopt(fd, IPPROTO_TCP, TCP_NODELAY, &yes, sizeof(yes));
+        return fd;
+    }
+
+    std::string encode(const std::string &a, const std::string &b, const std::string *c = nullptr)
+    {
+        std::string out = "*" + std::to_string(c ? 3 : 2) + "\r\n";
+        out += "$" + std::to_string(a.size()) + "\r\n" + a + "\r\n";
+        out += "$" + std::to_string(b.size()) + "\r\n" + b + "\r\n";
+        if (c)
+            out += "$" + std::to_string(c->size()) + "\r\n" + *c + "\r\n";
+        return out;
+    }
+
+    // Sends `batches` pipelines of the given request and waits for
+    // `reply_bytes` bytes of answers per pipeline. Returns ops/sec.
+    double run_series(int fd, const std::string &pipeline, size_t reply_bytes, int depth, long batches)
+    {
+        std::string sink(reply_bytes, '\0');
+        auto start = std::chrono::steady_clock::now();
+        for (long b = 0; b < batches; ++b)
+        {
+            size_t sent = 0;
+            while (sent < pipeline.size())
+            {
+                ssize_t n = send(fd, pipeline.data() + sent, pipeline.size() - sent, 0);
+                if (n <= 0)
+                    throw std::runtime_error("send failed");
+                sent += static_cast<size_t>(n);
+            }
+
+            size_t got = 0;
+            while (got < reply_bytes)
+            {
+                ssize_t n = recv(fd, &sink[got], reply_bytes - got, 0);
+                if (n <= 0)
+                    throw std::runtime_error("recv failed");
+                got += static_cast<size_t>(n);
+            }
+        }
+        std::chrono::duration<double> elapsed = std::chrono::steady_clock::now() - start;
+        return static_cast<double>(batches) * depth / elapsed.count();
+    }
+}
+
+int main(int argc, char *argv[])
+{
+    int port = argc > 1 ? std::atoi(argv[1]) : 7399;
+    long ops = argc > 2 ? std::atol(argv[2]) : 200000;
+
+    opus::storage::CacheManager cache;
+    opus::server::Server server("127.0.0.1", port, cache);
+    std::thread server_thread([&server]
+                              { server.run(); });
+
+    int fd = connect_to(port);
+    const std::string value = "value";
+
+    std::printf("%-8s %14s %14s\n", "depth", "SET ops/sec", "GET ops/sec");
+    for (int depth = 1; depth <= 256; depth *= 2)
+    {
+        std::string sets, gets;
+        for (int i = 0; i < depth; ++i)
+        {
+            std::string key = "key:" + std::to_string(i);
+            sets += encode("SET", key, &value);
+            gets += encode("GET", key);
+        }
+
+        long batches = ops / depth;
+        double set_rate = run_series(fd, sets, 5 * depth, depth, batches);  // "+OK\r\n"
+        double get_rate = run_series(fd, gets, 11 * depth, depth, batches); // "$5\r\nvalue\r\n"
+        std::printf("%-8d %14.0f %14.0f\n", depth, set_rate, get_rate);
+    }
+
+    close(fd);
+    server.stop();
+    server_thread.join();
+    return 0;
+}
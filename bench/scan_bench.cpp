@@ -0,0 +1,66 @@
+/**
+ * @file bench/scan_bench.cpp
+ * @brief Cost of one SCAN page against keyspace size and COUNT
+ *
+ * Usage: scan_bench [max_keys]   (default: 1000000)
+ *
+ * Fills an unlocked manager, as the default mode runs it, with 10 000
+ * keys and then ten times as many per round up to `max_keys`, and at each
+ * size walks the whole keyspace with CacheManager::scan() at COUNT 10,
+ * 100 and 1000. Reports the time per page and per key returned; a page
+ * should cost the same whatever the keyspace size, and a full walk must
+ * return every key.
+ */
+
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <optional>
+#include <string>
+#include <unordered_set>
+#include <vector>
+
+#include "storage/manager.hpp"
+
+int main(int argc, char *argv[])
+{
+    size_t max_keys = argc > 1 ? std::strtoull(argv[1], nullptr, 10) : 1000000;
+
+    opus::storage::CacheManager cache(1, false);
+    size_t loaded = 0;
+    std::printf("%10s %6s %10s %12s %12s\n", "keys", "count", "pages", "ns/page", "ns/key");
+    for (size_t keys = 10000; keys <= max_keys; keys *= 10)
+    {
+        for (; loaded < keys; ++loaded)
+        {
+            cache.set("key:" + std::to_string(loaded), "v");
+        }
+
+        for (size_t count : {10, 100, 1000})
+        {
+            std::vector<std::string> page;
+            std::unordered_set<std::string> seen;
+            size_t pages = 0;
+            std::chrono::duration<double, std::nano> elapsed{0};
+            unsigned long long cursor = 0;
+            do
+            {
+                page.clear();
+                auto start = std::chrono::steady_clock::now();
+                cursor = cache.scan(cursor, count, std::nullopt, page);
+                elapsed += std::chrono::steady_clock::now() - start;
+                ++pages;
+                seen.insert(page.begin(), page.end());
+            } while (cursor != 0);
+
+            if (seen.size() != keys)
+            {
+                std::printf("scan returned %zu of %zu keys\n", seen.size(), keys);
+                return 1;
+            }
+            std::printf("%10zu %6zu %10zu %12.0f %12.1f\n", keys, count, pages, elapsed.count() / pages,
+                        elapsed.count() / keys);
+        }
+    }
+    return 0;
+}
@@ -0,0 +1,79 @@
+/**
+ * @file bench/set_algebra_bench.cpp
+ * @brief SINTER/SINTERCARD evaluation: smallest-first, LIMIT and thread split
+ *
+ * Usage: set_algebra_bench [small] [large]   (default: 1000000 4000000)
+ *
+ * Intersects a set of `small` string members with one of `large` members
+ * that contains all of them, and times: SINTER with the sets given in
+ * either order (smallest-first makes the order irrelevant), SINTERCARD
+ * with and without LIMIT 100, and both again split across threads.
+ */
+
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <string>
+#include <vector>
+
+#include "storage/set_type.hpp"
+
+namespace
+{
+    using Clock = std::chrono::steady_clock;
+    using opus::storage::SetType;
+
+    double millis(Clock::time_point start)
+    {
+        return std::chrono::duration<double, std::milli>(Clock::now() - start).count();
+    }
+
+    void report(const char *name, size_t result, Clock::time_point start)
+    {
+        std::printf("%-28s %12.1f ms %12zu\n", name, millis(start), result);
+    }
+}
+
+int main(int argc, char *argv[])
+{
+    size_t small_size = argc > 1 ? std::strtoull(argv[1], nullptr, 10) : 1000000;
+    size_t large_size = argc > 2 ? std::strtoull(argv[2], nullptr, 10) : 4000000;
+
+    SetType small, large;
+    for (size_t i = 0; i < small_size; ++i)
+    {
+        small.sadd("member:" + std::to_string(i * 2));
+    }
+    for (size_t i = 0; i < large_size; ++i)
+    {
+        large.sadd("member:" + std::to_string(i));
+    }
+
+    std::printf("%zu x %zu members\n", small_size, large_size);
+    std::printf("%-28s %15s %12s\n", "operation", "time", "result");
+
+    SetType::Limits limits;
+    SetType::setLimits(limits);
+
+    auto start = Clock::now();
+    report("SINTER small large", SetType::intersect({&small, &large}).size(), start);
+
+    start = Clock::now();
+    report("SINTER large small", SetType::intersect({&large, &small}).size(), start);
+
+    start = Clock::now();
+    report("SINTERCARD", SetType::intersectCount({&small, &large}), start);
+
+    start = Clock::now();
+    report("SINTERCARD LIMIT 100", SetType::intersectCount({&small, &large}, 100), start);
+
+    limits.parallel_intersect_min = 1;
+    SetType::setLimits(limits);
+
+    start = Clock::now();
+    report("SINTER split across threads", SetType::intersect({&small, &large}).size(), start);
+
+    start = Clock::now();
+    report("SINTERCARD split", SetType::intersectCount({&small, &large}), start);
+    return 0;
+}
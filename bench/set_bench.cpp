@@ -0,0 +1,113 @@
+/**
+ * @file bench/set_bench.cpp
+ * @brief Compact SetType encodings against the previous std::unordered_set layout
+ *
+ * Usage: set_bench [sets] [members]   (default: 100000 16)
+ *
+ * Builds `sets` sets of `members` members each, once with integer members
+ * (intset encoding) and once with short strings (listpack encoding), and
+ * reports the SADD rate, heap bytes per member and the SISMEMBER rate over
+ * a mix of hits and misses.
+ */
+
+#include <malloc.h>
+
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <string>
+#include <unordered_set>
+#include <vector>
+
+#include "storage/set_type.hpp"
+
+namespace
+{
+    using Clock = std::chrono::steady_clock;
+
+    // The set representation SetType used before the compact encodings.
+    class HashSet
+    {
+    private:
+        std::unordered_set<std::string> values;
+
+    public:
+        int sadd(const std::string &value) { return values.insert(value).second ? 1 : 0; }
+        bool sismember(const std::string &value) const { return values.find(value) != values.end(); }
+    };
+
+    size_t heapInUse()
+    {
+        struct mallinfo2 info = mallinfo2();
+        return info.uordblks + info.hblkhd;
+    }
+
+    double seconds(Clock::time_point start)
+    {
+        return std::chrono::duration<double>(Clock::now() - start).count();
+    }
+
+    template <typename Set>
+    void run(const char *name, const std::vector<std::string> &members, size_t sets)
+    {
+        size_t before = heapInUse();
+        std::vector<Set> all(sets);
+
+        auto start = Clock::now();
+        for (auto &set : all)
+        {
+            for (const auto &member : members)
+            {
+                set.sadd(member);
+            }
+        }
+        double total = double(sets) * members.size();
+        double add_rate = total / seconds(start);
+        double bytes = double(heapInUse() - before) / total;
+
+        // Every member once, plus as many misses (a shifted member list).
+        std::vector<std::string> probes = members;
+        for (const auto &member : members)
+        {
+            probes.push_back(member + "0");
+        }
+
+        start = Clock::now();
+        size_t hits = 0;
+        for (const auto &set : all)
+        {
+            for (const auto &probe : probes)
+            {
+                hits += set.sismember(probe) ? 1 : 0;
+            }
+        }
+        double lookup_rate = double(sets) * probes.size() / seconds(start);
+
+        std::printf("%-24s %14.0f %12.1f %16.0f%s\n", name, add_rate, bytes, lookup_rate,
+                    hits == 0 ? " " : "");
+        all.clear();
+        all.shrink_to_fit();
+        malloc_trim(0);
+    }
+}
+
+int main(int argc, char *argv[])
+{
+    size_t sets = argc > 1 ? std::strtoull(argv[1], nullptr, 10) : 100000;
+    size_t count = argc > 2 ? std::strtoull(argv[2], nullptr, 10) : 16;
+
+    std::vector<std::string> integers, strings;
+    for (size_t i = 0; i < count; ++i)
+    {
+        integers.push_back(std::to_string(1000 + i * 7919));
+        strings.push_back("member:" + std::to_string(i));
+    }
+
+    std::printf("%zu sets of %zu members\n", sets, count);
+    std::printf("%-24s %14s %12s %16s\n", "set", "sadd/s", "bytes/member", "sismember/s");
+    run<HashSet>("unordered_set integers", integers, sets);
+    run<opus::storage::SetType>("SetType integers", integers, sets);
+    run<HashSet>("unordered_set strings", strings, sets);
+    run<opus::storage::SetType>("SetType strings", strings, sets);
+    return 0;
+}
@@ -0,0 +1,105 @@
+/**
+ * @file bench/shard_scaling_bench.cpp
+ * @brief Multithreaded read scaling of the sharded CacheManager
+ *
+ * Usage: shard_scaling_bench [keys] [millis_per_run]
+ *
+ * Preloads strings, sets and lists, then runs a GET/SISMEMBER/LRANGE mix
+ * from 1, 2, 4, 8 and 16 threads, once with a single shard (one global
+ * lock) and once with the default shard count.
+ */
+
+#include <atomic>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <random>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "storage/manager.hpp"
+
+namespace
+{
+    void preload(opus::storage::CacheManager &cache, int keys)
+    {
+        for (int i = 0; i < keys; ++i)
+        {
+            std::string id = std::to_string(i);
+            cache.set("str:" + id, "value-" + id);
+            cache.sadd("set:" + id, std::vector<std::string>{"a", "b", id});
+            cache.rpush("list:" + id, "x");
+            cache.rpush("list:" + id, id);
+        }
+    }
+
+    double run(opus::storage::CacheManager &cache, int keys, int threads, int millis)
+    {
+        std::atomic<bool> stop{false};
+        std::vector<unsigned long long> counts(threads, 0);
+        std::vector<std::thread> workers;
+
+        for (int t = 0; t < threads; ++t)
+        {
+            workers.emplace_back([&, t]
+                                 {
+                std::mt19937 rng(t + 1);
+                std::uniform_int_distribution<int> pick(0, keys - 1);
+                unsigned long long ops = 0;
+                while (!stop.load(std::memory_order_relaxed))
+                {
+                    std::string id = std::to_string(pick(rng));
+                    switch (ops % 3)
+                    {
+                    case 0:
+                        cache.get("str:" + id);
+                        break;
+                    case 1:
+                        cache.sismember("set:" + id, id);
+                        break;
+                    default:
+                        cache.lrange("list:" + id, 0, -1);
+                        break;
+                    }
+                    ++ops;
+                }
+                counts[t] = ops; });
+        }
+
+        std::this_thread::sleep_for(std::chrono::milliseconds(millis));
+        stop.store(true);
+        for (auto &worker : workers)
+        {
+            worker.join();
+        }
+
+        unsigned long long total = 0;
+        for (auto c : counts)
+        {
+            total += c;
+        }
+        return total * 1000.0 / millis;
+    }
+}
+
+int main(int argc, char *argv[])
+{
+    int keys = argc > 1 ? std::atoi(argv[1]) : 100000;
+    int millis = argc > 2 ? std::atoi(argv[2]) : 1000;
+
+    opus::storage::CacheManager single(1);
+    opus::storage::CacheManager sharded;
+    preload(single, keys);
+    preload(sharded, keys);
+
+    std::printf("hardware threads: %u\n", std::thread::hardware_concurrency());
+    std::printf("%-8s %16s %16s\n", "threads", "1 shard ops/s", "sharded ops/s");
+    for (int threads = 1; threads <= 16; threads *= 2)
+    {
+        double a = run(single, keys, threads, millis);
+        double b = run(sharded, keys, threads, millis);
+        std::printf("%-8d %16.0f %16.0f\n", threads, a, b);
+    }
+    return 0;
+}
@@ -0,0 +1,185 @@
+/**
+ * @file bench/stream_bench.cpp
+ * @brief Memory and other clients' latency during one large SMEMBERS
+ *
+ * Usage: stream_bench [port] [members] [rounds]   (default: 7399 5000000 3)
+ *
+ * Starts a single-threaded Server on 127.0.0.1:<port>, as the default
+ * mode runs it, with one set of `members` members. One connection then
+ * reads SMEMBERS of the whole set `rounds` times while a second one sends
+ * PINGs back to back. Reports how much the resident set grew over the
+ * loaded keyspace at its highest, sampled every millisecond, and the PING
+ * round trips seen while the big reply was being served.
+ */
+
+#include <algorithm>
+#include <arpa/inet.h>
+#include <atomic>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <fstream>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <stdexcept>
+#include <string>
+#include <sys/socket.h>
+#include <thread>
+#include <unistd.h>
+#include <vector>
+
+#include "server/server.hpp"
+#include "storage/manager.hpp"
+
+namespace
+{
+    using Clock = std::chrono::steady_clock;
+
+    int connect_to(int port)
+    {
+        int fd = socket(AF_INET, SOCK_STREAM, 0);
+        sockaddr_in addr{};
+        addr.sin_family = AF_INET;
+        addr.sin_port = htons(static_cast<uint16_t>(port));
+        addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+        if (connect(fd, reinterpret_cast<sockaddr *>(&addr), sizeof(addr)) < 0)
+        {
+            throw std::runtime_error("connect failed");
+        }
+        int yes = 1;
+        setsockopt(fd, IPPROTO_TCP, TCP_NODELAY, &yes, sizeof(yes));
+        return fd;
+    }
+
+    void send_all(int fd, const std::string &data)
+    {
+        size_t sent = 0;
+        while (sent < data.size())
+        {
+            ssize_t n = send(fd, data.data() + sent, data.size() - sent, 0);
+            if (n <= 0)
+                throw std::runtime_error("send failed");
+            sent += static_cast<size_t>(n);
+        }
+    }
+
+    void recv_exactly(int fd, size_t bytes)
+    {
+        static char sink[64 * 1024];
+        while (bytes > 0)
+        {
+            ssize_t n = recv(fd, sink, std::min(bytes, sizeof(sink)), 0);
+            if (n <= 0)
+                throw std::runtime_error("recv failed");
+            bytes -= static_cast<size_t>(n);
+        }
+    }
+
+    size_t resident_kb()
+    {
+        std::ifstream status("/proc/self/status");
+        std::string line;
+        while (std::getline(status, line))
+        {
+            if (line.compare(0, 6, "VmRSS:") == 0)
+                return std::strtoull(line.c_str() + 6, nullptr, 10);
+        }
+        return 0;
+    }
+
+    std::string member(size_t i)
+    {
+        return "member:" + std::to_string(i);
+    }
+
+    double percentile(std::vector<double> &sorted, double p)
+    {
+        if (sorted.empty())
+            return 0;
+        return sorted[static_cast<size_t>(p * static_cast<double>(sorted.size() - 1))];
+    }
+}
+
+int main(int argc, char *argv[])
+{
+    int port = argc > 1 ? std::atoi(argv[1]) : 7399;
+    size_t members = argc > 2 ? std::strtoull(argv[2], nullptr, 10) : 5000000;
+    int rounds = argc > 3 ? std::atoi(argv[3]) : 3;
+
+    // Only the loop thread touches the keyspace, as in the default mode;
+    // it is filled before that thread starts.
+    opus::storage::CacheManager cache(1, false);
+    size_t reply_bytes = 3 + std::to_string(members).size();
+    std::vector<std::string> batch;
+    for (size_t i = 0; i < members; ++i)
+    {
+        batch.push_back(member(i));
+        size_t len = batch.back().size();
+        reply_bytes += 1 + std::to_string(len).size() + 2 + len + 2;
+        if (batch.size() == 1000 || i + 1 == members)
+        {
+            cache.sadd("big", std::move(batch));
+            batch.clear();
+        }
+    }
+
+    opus::server::Server server("127.0.0.1", port, cache);
+    std::thread server_thread([&server]
+                              { server.run(); });
+
+    int bulk = connect_to(port);
+    int probe = connect_to(port);
+    const std::string smembers = "*2\r\n$8\r\nSMEMBERS\r\n$3\r\nbig\r\n";
+    const std::string ping = "*1\r\n$4\r\nPING\r\n";
+    send_all(probe, ping);
+    recv_exactly(probe, 7); // "+PONG\r\n"
+
+    size_t baseline = resident_kb();
+    std::atomic<bool> done{false};
+    std::atomic<size_t> peak{baseline};
+    std::thread sampler([&]
+                        {
+        while (!done.load())
+        {
+            size_t now = resident_kb();
+            if (now > peak.load())
+                peak.store(now);
+            std::this_thread::sleep_for(std::chrono::milliseconds(1));
+        } });
+
+    std::vector<double> latencies;
+    std::thread pinger([&]
+                       {
+        while (!done.load())
+        {
+            auto start = Clock::now();
+            send_all(probe, ping);
+            recv_exactly(probe, 7);
+            latencies.push_back(std::chrono::duration<double, std::micro>(Clock::now() - start).count());
+        } });
+
+    auto start = Clock::now();
+    for (int r = 0; r < rounds; ++r)
+    {
+        send_all(bulk, smembers);
+        recv_exactly(bulk, reply_bytes);
+    }
+    double elapsed = std::chrono::duration<double>(Clock::now() - start).count();
+    done.store(true);
+    pinger.join();
+    sampler.join();
+
+    std::sort(latencies.begin(), latencies.end());
+    std::printf("%zu members, %.1f MB reply, %d rounds\n", members, reply_bytes / 1048576.0, rounds);
+    std::printf("SMEMBERS        %10.3f s each\n", elapsed / rounds);
+    std::printf("peak RSS growth %10.1f MB\n", (peak.load() - baseline) / 1024.0);
+    std::printf("PING round trip %10zu samples, p50 %.0f us, p99 %.0f us, max %.0f us\n",
+                latencies.size(), percentile(latencies, 0.5), percentile(latencies, 0.99),
+                latencies.empty() ? 0.0 : latencies.back());
+
+    close(bulk);
+    close(probe);
+    server.stop();
+    server_thread.join();
+    return 0;
+}
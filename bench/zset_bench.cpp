@@ -0,0 +1,179 @@
+/**
+ * @file bench/zset_bench.cpp
+ * @brief ZADD and range query speed of SortedSetType at 1M members
+ *
+ * Usage: zset_bench [members] [queries]   (default: 1000000 100000)
+ *
+ * Builds one sorted set of `members` random scores and reports heap bytes
+ * per member, the ZADD rate, and the rate of ZSCORE, ZRANK, a 10-member
+ * ZRANGE at a random rank and a 10-member ZRANGEBYSCORE at a random score.
+ * The std::set row is an ordered tree plus a score map without rank
+ * information, so its rank queries walk the tree (O(n)); it runs a
+ * ten-thousandth of the queries for those.
+ */
+
+#include <malloc.h>
+
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <iterator>
+#include <optional>
+#include <random>
+#include <set>
+#include <string>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+#include "storage/sorted_set_type.hpp"
+
+namespace
+{
+    using Clock = std::chrono::steady_clock;
+    using opus::storage::ScoreRange;
+    using opus::storage::SortedSetType;
+
+    class TreeZset
+    {
+    private:
+        std::set<std::pair<double, std::string>> ordered;
+        std::unordered_map<std::string, double> scores;
+
+    public:
+        void zadd(const std::string &member, double &score, unsigned)
+        {
+            auto [it, inserted] = scores.try_emplace(member, score);
+            if (!inserted)
+            {
+                ordered.erase({it->second, member});
+                it->second = score;
+            }
+            ordered.emplace(score, member);
+        }
+
+        std::optional<double> zscore(const std::string &member) const
+        {
+            auto it = scores.find(member);
+            if (it == scores.end())
+                return std::nullopt;
+            return it->second;
+        }
+
+        std::optional<size_t> zrank(const std::string &member) const
+        {
+            auto it = scores.find(member);
+            if (it == scores.end())
+                return std::nullopt;
+            return std::distance(ordered.begin(), ordered.find({it->second, member}));
+        }
+
+        std::vector<SortedSetType::MemberScore> zrange(long long start, long long stop) const
+        {
+            std::vector<SortedSetType::MemberScore> result;
+            auto it = std::next(ordered.begin(), start);
+            for (long long i = start; i <= stop && it != ordered.end(); ++i, ++it)
+            {
+                result.emplace_back(it->second, it->first);
+            }
+            return result;
+        }
+
+        std::vector<SortedSetType::MemberScore> zrangebyscore(const ScoreRange &range, bool, size_t,
+                                                              long long count) const
+        {
+            std::vector<SortedSetType::MemberScore> result;
+            auto it = ordered.lower_bound({range.min, std::string()});
+            for (; it != ordered.end() && range.belowMax(it->first) && static_cast<long long>(result.size()) < count;
+                 ++it)
+            {
+                result.emplace_back(it->second, it->first);
+            }
+            return result;
+        }
+    };
+
+    size_t heapInUse()
+    {
+        struct mallinfo2 info = mallinfo2();
+        return info.uordblks + info.hblkhd;
+    }
+
+    double seconds(Clock::time_point start)
+    {
+        return std::chrono::duration<double>(Clock::now() - start).count();
+    }
+
+    template <typename Zset>
+    void run(const char *name, size_t members, size_t queries, size_t rank_queries)
+    {
+        std::mt19937_64 rng(7);
+        std::uniform_real_distribution<double> scores(0, 1e6);
+        std::vector<std::string> names;
+        names.reserve(members);
+        for (size_t i = 0; i < members; ++i)
+        {
+            names.push_back("member:" + std::to_string(i));
+        }
+
+        size_t before = heapInUse();
+        auto *zset = new Zset();
+        auto start = Clock::now();
+        for (const auto &member : names)
+        {
+            double score = scores(rng);
+            zset->zadd(member, score, 0);
+        }
+        double add_rate = members / seconds(start);
+        double bytes = double(heapInUse() - before) / members;
+
+        size_t sink = 0;
+        start = Clock::now();
+        for (size_t i = 0; i < queries; ++i)
+        {
+            sink += zset->zscore(names[rng() % members]) > 0.0;
+        }
+        double score_rate = queries / seconds(start);
+
+        start = Clock::now();
+        for (size_t i = 0; i < rank_queries; ++i)
+        {
+            sink += *zset->zrank(names[rng() % members]);
+        }
+        double rank_rate = rank_queries / seconds(start);
+
+        start = Clock::now();
+        for (size_t i = 0; i < rank_queries; ++i)
+        {
+            long long first = rng() % members;
+            sink += zset->zrange(first, first + 9).size();
+        }
+        double range_rate = rank_queries / seconds(start);
+
+        start = Clock::now();
+        for (size_t i = 0; i < queries; ++i)
+        {
+            ScoreRange range{scores(rng), 1e6};
+            sink += zset->zrangebyscore(range, false, 0, 10).size();
+        }
+        double by_score_rate = queries / seconds(start);
+
+        delete zset;
+        std::printf("%-14s %12.1f %12.0f %12.0f %12.0f %12.0f %12.0f%s\n", name, bytes, add_rate, score_rate, rank_rate,
+                    range_rate, by_score_rate, sink == 0 ? " " : "");
+        malloc_trim(0);
+    }
+}
+
+int main(int argc, char *argv[])
+{
+    size_t members = argc > 1 ? std::strtoull(argv[1], nullptr, 10) : 1000000;
+    size_t queries = argc > 2 ? std::strtoull(argv[2], nullptr, 10) : 100000;
+
+    std::printf("%zu members, %zu queries\n", members, queries);
+    std::printf("%-14s %12s %12s %12s %12s %12s %12s\n", "zset", "bytes/member", "zadd/s", "zscore/s", "zrank/s",
+                "zrange/s", "byscore/s");
+    run<TreeZset>("std::set", members, queries, queries / 10000 + 1);
+    run<SortedSetType>("SortedSetType", members, queries, queries);
+    return 0;
+}
@@ -0,0 +1,1731 @@
+/**
+ * @file command/executor.cpp
+ * @brief Implementation of the command table and dispatch
+ */
+
+#include "executor.hpp"
+#include "glob.hpp"
+
+#include "storage/slab_allocator.hpp"
+#include "storage/string_type.hpp"
+
+#include <algorithm>
+#include <cctype>
+#include <charconv>
+#include <cmath>
+#include <cstdint>
+#include <cstdio>
+#include <limits>
+#include <memory>
+#include <stdexcept>
+#include <string>
+#include <unordered_map>
+#include <unistd.h>
+
+namespace opus
+{
+    namespace command
+    {
+
+        namespace
+        {
+            using Args = std::vector<std::string_view>;
+            using Handler = void (*)(storage::CacheManager &, const Args &, ReplyWriter &);
+
+            struct CommandSpec
+            {
+                CommandInfo info;
+                Handler handler;
+                bool deny_oom = false; // may grow the keyspace: refused above maxmemory
+            };
+
+            bool parse_int(std::string_view str, long long &out)
+            {
+                auto [ptr, ec] = std::from_chars(str.data(), str.data() + str.size(), out);
+                return ec == std::errc() && ptr == str.data() + str.size();
+            }
+
+            bool equals_ignore_case(std::string_view a, std::string_view b)
+            {
+                if (a.size() != b.size())
+                    return false;
+                for (size_t i = 0; i < a.size(); ++i)
+                {
+                    if (std::toupper(static_cast<unsigned char>(a[i])) != std::toupper(static_cast<unsigned char>(b[i])))
+                        return false;
+                }
+                return true;
+            }
+
+            // Elements a streamed reply writes per turn of the event loop:
+            // about the cost of an ordinary command, so other clients never
+            // wait much longer than that behind a large LRANGE or SMEMBERS.
+            constexpr size_t STREAM_SLICE = 1024;
+
+            // A reply walking a whole collection (LRANGE, SMEMBERS, HGETALL),
+            // encoded straight from the value a slice at a time rather than
+            // copied out first. Should the value be about to change while the
+            // reply is still being written, the rest is encoded on the spot,
+            // so the client sees the value as it was when the command ran.
+            template <typename T>
+            class CollectionStream : public ReplyStream, public storage::ValueReader
+            {
+            private:
+                storage::CacheManager &cache;
+                ReplyBuffer rest;
+                int protocol = 2;
+                bool detached = false;
+
+            protected:
+                const T *value = nullptr; // null for a missing key
+
+                // Writes the reply's header; false if there is nothing to walk.
+                virtual bool begin(ReplyWriter &reply) = 0;
+
+                // Writes up to `count` more elements; false once all are written.
+                virtual bool write(ReplyWriter &reply, size_t count) = 0;
+
+            public:
+                explicit CollectionStream(storage::CacheManager &cache) : cache(cache) {}
+                ~CollectionStream() override { cache.detachReader(*this); }
+
+                bool resume(ReplyWriter &reply) override
+                {
+                    if (!detached)
+                        return write(reply, STREAM_SLICE);
+                    reply.add_raw(rest.take());
+                    return false;
+                }
+
+                void valueChanging() override
+                {
+                    ReplyWriter writer(rest);
+                    writer.set_protocol(protocol);
+                    while (write(writer, SIZE_MAX))
+                    {
+                    }
+                    detached = true;
+                }
+
+                // Replies with the T at `key`. A single-threaded manager keeps
+                // the value where it is between turns, so all but the first
+                // slice can be left to the writer's stream; otherwise the
+                // value is only safe to read under its shard lock and is
+                // written out in one go.
+                static void send(std::unique_ptr<CollectionStream> stream, storage::CacheManager &cache,
+                                 std::string_view key, ReplyWriter &reply)
+                {
+                    if (cache.threadSafe())
+                    {
+                        bool found = cache.template readValue<T>(key, [&](const T &value)
+                                                                 {
+                            stream->value = &value;
+                            if (stream->begin(reply))
+                            {
+                                while (stream->write(reply, SIZE_MAX))
+                                {
+                                }
+                            } });
+                        if (!found)
+                            stream->begin(reply);
+                        return;
+                    }
+
+                    stream->protocol = reply.protocol();
+                    stream->value = cache.template attachReader<T>(key, *stream);
+                    if (stream->begin(reply) && stream->write(reply, STREAM_SLICE))
+                        reply.add_stream(std::move(stream));
+                }
+            };
+
+            class ListStream final : public CollectionStream<storage::ListType>
+            {
+            private:
+                long long start, stop;
+                storage::ListType::RangeCursor cursor;
+
+                bool begin(ReplyWriter &reply) override
+                {
+                    if (value)
+                        cursor = value->range(start, stop);
+                    reply.add_array(cursor.left);
+                    return cursor.left > 0;
+                }
+
+                bool write(ReplyWriter &reply, size_t count) override
+                {
+                    return value->forEachInRange(cursor, count, [&](std::string_view element)
+                                                 { reply.add_bulk_string(element); });
+                }
+
+            public:
+                ListStream(storage::CacheManager &cache, long long start, long long stop)
+                    : CollectionStream(cache), start(start), stop(stop) {}
+            };
+
+            class SetStream final : public CollectionStream<storage::SetType>
+            {
+            private:
+                size_t cursor = 0;
+
+                bool begin(ReplyWriter &reply) override
+                {
+                    size_t size = value ? static_cast<size_t>(value->scard()) : 0;
+                    reply.add_array(size);
+                    return size > 0;
+                }
+
+                bool write(ReplyWriter &reply, size_t count) override
+                {
+                    cursor = value->visitMembers(cursor, count, [&](std::string_view member)
+                                                 { reply.add_bulk_string(member); });
+                    return cursor != 0;
+                }
+
+            public:
+                using CollectionStream::CollectionStream;
+            };
+
+            class HashStream final : public CollectionStream<storage::HashType>
+            {
+            private:
+                size_t cursor = 0;
+
+                bool begin(ReplyWriter &reply) override
+                {
+                    size_t size = value ? static_cast<size_t>(value->hlen()) : 0;
+                    reply.add_map(size);
+                    return size > 0;
+                }
+
+                bool write(ReplyWriter &reply, size_t count) override
+                {
+                    cursor = value->visitPairs(cursor, count, [&](std::string_view field, std::string_view element)
+                                               {
+                        reply.add_bulk_string(field);
+                        reply.add_bulk_string(element); });
+                    return cursor != 0;
+                }
+
+            public:
+                using CollectionStream::CollectionStream;
+            };
+
+            void cmd_ping(storage::CacheManager &, const Args &args, ReplyWriter &reply)
+            {
+                if (args.size() > 1)
+                    reply.add_bulk_string(args[1]);
+                else
+                    reply.add_simple_string("PONG");
+            }
+
+            void cmd_echo(storage::CacheManager &, const Args &args, ReplyWriter &reply)
+            {
+                reply.add_bulk_string(args[1]);
+            }
+
+            void cmd_quit(storage::CacheManager &, const Args &, ReplyWriter &reply)
+            {
+                reply.add_simple_string("OK");
+            }
+
+            // Clients such as redis-cli probe COMMAND on connect; an empty
+            // array is enough for them to carry on.
+            void cmd_command(storage::CacheManager &, const Args &, ReplyWriter &reply)
+            {
+                reply.add_array(0);
+            }
+
+            // HELLO [protover [AUTH username password] [SETNAME clientname]]
+            // Only the protocol version is acted upon; credentials were
+            // already checked when the server was started.
+            void cmd_hello(storage::CacheManager &, const Args &args, ReplyWriter &reply)
+            {
+                if (args.size() > 1)
+                {
+                    long long version = 0;
+                    if (!parse_int(args[1], version))
+                    {
+                        reply.add_error("ERR Protocol version is not an integer or out of range");
+                        return;
+                    }
+                    if (version != 2 && version != 3)
+                    {
+                        reply.add_error("NOPROTO unsupported protocol version");
+                        return;
+                    }
+                    reply.set_protocol(static_cast<int>(version));
+                }
+
+                reply.add_map(6);
+                reply.add_bulk_string("server");
+                reply.add_bulk_string("opus");
+                reply.add_bulk_string("version");
+                reply.add_bulk_string("0.1.0");
+                reply.add_bulk_string("proto");
+                reply.add_integer(reply.protocol());
+                reply.add_bulk_string("mode");
+                reply.add_bulk_string("standalone");
+                reply.add_bulk_string("role");
+                reply.add_bulk_string("master");
+                reply.add_bulk_string("modules");
+                reply.add_array(0);
+            }
+
+            // Turns an EXPIRE-style time into a deadline in Unix milliseconds:
+            // `value` counts `unit_ms` milliseconds, from now when `relative`.
+            // False if the result does not fit.
+            bool to_deadline(long long value, long long unit_ms, bool relative, long long &deadline)
+            {
+                if (__builtin_mul_overflow(value, unit_ms, &deadline))
+                    return false;
+                return !relative || !__builtin_add_overflow(deadline, storage::CacheManager::currentTimeMs(), &deadline);
+            }
+
+            // SET key value [EX seconds|PX milliseconds|EXAT timestamp|PXAT timestamp|KEEPTTL]
+            void cmd_set(storage::CacheManager &cache, const Args &args, ReplyWriter &reply)
+            {
+                long long expire_at = 0;
+                bool keep_ttl = false, has_expiry = false;
+                for (size_t i = 3; i < args.size(); ++i)
+                {
+                    long long unit_ms = 0;
+                    bool relative = true;
+                    if (equals_ignore_case(args[i], "EX"))
+                        unit_ms = 1000;
+                    else if (equals_ignore_case(args[i], "PX"))
+                        unit_ms = 1;
+                    else if (equals_ignore_case(args[i], "EXAT"))
+                        unit_ms = 1000, relative = false;
+                    else if (equals_ignore_case(args[i], "PXAT"))
+                        unit_ms = 1, relative = false;
+
+                    if (unit_ms != 0 && i + 1 < args.size() && !has_expiry && !keep_ttl)
+                    {
+                        long long value;
+                        if (!parse_int(args[++i], value))
+                        {
+                            reply.add_error("ERR value is not an integer or out of range");
+                            return;
+                        }
+                        if (value <= 0 || !to_deadline(value, unit_ms, relative, expire_at))
+                        {
+                            reply.add_error("ERR invalid expire time in 'set' command");
+                            return;
+                        }
+                        has_expiry = true;
+                    }
+                    else if (equals_ignore_case(args[i], "KEEPTTL") && !has_expiry)
+                    {
+                        keep_ttl = true;
+                    }
+                    else
+                    {
+                        reply.add_error("ERR syntax error");
+                        return;
+                    }
+                }
+
+                cache.set(args[1], args[2], expire_at, keep_ttl);
+                reply.add_simple_string("OK");
+            }
+
+            // Large values are pinned and sent from the keyspace's own bytes;
+            // anything shorter is cheaper to copy into the reply buffer.
+            void reply_borrowed(ReplyWriter &reply, const storage::BorrowedString &value)
+            {
+                if (value.view().size() >= ReplyBuffer::MIN_PINNED_SIZE)
+                {
+                    if (auto owner = value.pin())
+                    {
+                        reply.add_bulk_string(value.view(), std::move(owner));
+                        return;
+                    }
+                }
+                reply.add_bulk_string(value.view());
+            }
+
+            void cmd_get(storage::CacheManager &cache, const Args &args, ReplyWriter &reply)
+            {
+                if (!cache.readString(args[1], [&](const storage::BorrowedString &value)
+                                      { reply_borrowed(reply, value); }))
+                    reply.add_null();
+            }
+
+            // Key/value pairs of MSET and MSETNX; false (with the error
+            // replied) if a key lacks its value.
+            bool parse_pairs(const char *name, const Args &args, std::vector<storage::CacheManager::KeyValue> &pairs,
+                             ReplyWriter &reply)
+            {
+                if (args.size() % 2 == 0)
+                {
+                    reply.add_error(std::string("ERR wrong number of arguments for '") + name + "' command");
+                    return false;
+                }
+                pairs.reserve((args.size() - 1) / 2);
+                for (size_t i = 1; i < args.size(); i += 2)
+                {
+                    pairs.emplace_back(args[i], args[i + 1]);
+                }
+                return true;
+            }
+
+            void cmd_mset(storage::CacheManager &cache, const Args &args, ReplyWriter &reply)
+            {
+                std::vector<storage::CacheManager::KeyValue> pairs;
+                if (!parse_pairs("mset", args, pairs, reply))
+                    return;
+                cache.mset(pairs);
+                reply.add_simple_string("OK");
+            }
+
+            void cmd_msetnx(storage::CacheManager &cache, const Args &args, ReplyWriter &reply)
+            {
+                std::vector<storage::CacheManager::KeyValue> pairs;
+                if (!parse_pairs("msetnx", args, pairs, reply))
+                    return;
+                reply.add_integer(cache.msetnx(pairs) ? 1 : 0);
+            }
+
+            void cmd_mget(storage::CacheManager &cache, const Args &args, ReplyWriter &reply)
+            {
+                Args keys(args.begin() + 1, args.end());
+                reply.add_array(keys.size());
+                cache.readStrings(keys, [&](const storage::BorrowedString *value)
+                                  {
+                                      if (value)
+                                          reply_borrowed(reply, *value);
+                                      else
+                                          reply.add_null(); });
+            }
+
+            void reply_incrby(storage::CacheManager &cache, std::string_view key, long long delta, ReplyWriter &reply)
+            {
+                reply.add_integer(cache.incrby(key, delta));
+            }
+
+            void cmd_incr(storage::CacheManager &cache, const Args &args, ReplyWriter &reply)
+            {
+                reply_incrby(cache, args[1], 1, reply);
+            }
+
+            void cmd_decr(storage::CacheManager &cache, const Args &args, ReplyWriter &reply)
+            {
+                reply_incrby(cache, args[1], -1, reply);
+            }
+
+            void cmd_incrby(storage::CacheManager &cache, const Args &args, ReplyWriter &reply)
+            {
+                long long delta = 0;
+                if (!storage::StringType::parseInteger(args[2], delta))
+                {
+                    reply.add_error("ERR value is not an integer or out of range");
+                    return;
+                }
+                reply_incrby(cache, args[1], delta, reply);
+            }
+
+            void cmd_decrby(storage::CacheManager &cache, const Args &args, ReplyWriter &reply)
+            {
+                long long delta = 0;
+                if (!storage::StringType::parseInteger(args[2], delta))
+                {
+                    reply.add_error("ERR value is not an integer or out of range");
+                    return;
+                }
+                if (delta == std::numeric_limits<long long>::min())
+                {
+                    reply.add_error("ERR decrement would overflow");
+                    return;
+                }
+                reply_incrby(cache, args[1], -delta, reply);
+            }
+
+            void cmd_incrbyfloat(storage::CacheManager &cache, const Args &args, ReplyWriter &reply)
+            {
+                long double delta = 0;
+                if (!storage::StringType::parseFloat(args[2], delta))
+                {
+                    reply.add_error("ERR value is not a valid float");
+                    return;
+                }
+                reply.add_bulk_string(cache.incrbyfloat(args[1], delta));
+            }
+
+            void cmd_del(storage::CacheManager &cache, const Args &args, ReplyWriter &reply)
+            {
+                long long removed = 0;
+                for (size_t i = 1; i < args.size(); ++i)
+                {
+                    removed += cache.del(args[i]) ? 1 : 0;
+                }
+                reply.add_integer(removed);
+            }
+
+            void cmd_unlink(storage::CacheManager &cache, const Args &args, ReplyWriter &reply)
+            {
+                long long removed = 0;
+                for (size_t i = 1; i < args.size(); ++i)
+                {
+                    removed += cache.unlink(args[i]) ? 1 : 0;
+                }
+                reply.add_integer(removed);
+            }
+
+            void cmd_exists(storage::CacheManager &cache, const Args &args, ReplyWriter &reply)
+            {
+                long long found = 0;
+                for (size_t i = 1; i < args.size(); ++i)
+                {
+                    found += cache.exists(args[i]) ? 1 : 0;
+                }
+                reply.add_integer(found);
+            }
+
+            // What follows the cursor of SCAN, HSCAN, SSCAN and ZSCAN.
+            struct ScanOptions
+            {
+                unsigned long long cursor = 0;
+                std::string_view pattern;
+                bool match = false;
+                size_t count = 10;
+                bool values = true;                     // HSCAN ... NOVALUES clears it
+                std::optional<storage::ValueType> type; // SCAN ... TYPE
+            };
+
+            // Parses the cursor at args[at] and the options after it; `extra`
+            // names the one option only some commands take ("NOVALUES",
+            // "TYPE"), if any. Replies the error itself on failure.
+            bool parse_scan(const Args &args, size_t at, std::string_view extra, ScanOptions &options, ReplyWriter &reply)
+            {
+                auto [ptr, ec] = std::from_chars(args[at].data(), args[at].data() + args[at].size(), options.cursor);
+                if (ec != std::errc() || ptr != args[at].data() + args[at].size())
+                {
+                    reply.add_error("ERR invalid cursor");
+                    return false;
+                }
+
+                for (size_t i = at + 1; i < args.size(); ++i)
+                {
+                    bool has_arg = i + 1 < args.size();
+                    if (equals_ignore_case(args[i], "MATCH") && has_arg)
+                    {
+                        options.pattern = args[++i];
+                        options.match = options.pattern != "*";
+                    }
+                    else if (equals_ignore_case(args[i], "COUNT") && has_arg)
+                    {
+                        long long count = 0;
+                        if (!parse_int(args[++i], count))
+                        {
+                            reply.add_error("ERR value is not an integer or out of range");
+                            return false;
+                        }
+                        if (count < 1)
+                        {
+                            reply.add_error("ERR syntax error");
+                            return false;
+                        }
+                        options.count = static_cast<size_t>(count);
+                    }
+                    else if (extra == "NOVALUES" && equals_ignore_case(args[i], "NOVALUES"))
+                    {
+                        options.values = false;
+                    }
+                    else if (extra == "TYPE" && equals_ignore_case(args[i], "TYPE") && has_arg)
+                    {
+                        std::string_view name = args[++i];
+                        options.type.reset();
+                        for (size_t type = 0; type < storage::VALUE_TYPE_COUNT && !options.type; ++type)
+                        {
+                            if (equals_ignore_case(name, storage::typeName(static_cast<storage::ValueType>(type))))
+                                options.type = static_cast<storage::ValueType>(type);
+                        }
+                        if (!options.type)
+                        {
+                            reply.add_error("ERR unknown type name");
+                            return false;
+                        }
+                    }
+                    else
+                    {
+                        reply.add_error("ERR syntax error");
+                        return false;
+                    }
+                }
+                return true;
+            }
+
+            // Starts a SCAN-family reply: the next cursor, then an array of
+            // `count` elements for the caller to write.
+            void reply_scan_page(ReplyWriter &reply, unsigned long long cursor, size_t count)
+            {
+                char buf[24];
+                auto end = std::to_chars(buf, buf + sizeof(buf), cursor).ptr;
+                reply.add_array(2);
+                reply.add_bulk_string(std::string_view(buf, end - buf));
+                reply.add_array(count);
+            }
+
+            // MATCH filters a page after the fact, as in Redis, so a page may
+            // come back empty with a non-zero cursor.
+            template <typename T, typename Name>
+            void filter_page(const ScanOptions &options, std::vector<T> &page, Name &&name)
+            {
+                if (!options.match)
+                    return;
+                auto rejected = [&](const T &element)
+                { return !glob_match(options.pattern, name(element)); };
+                page.erase(std::remove_if(page.begin(), page.end(), rejected), page.end());
+            }
+
+            void cmd_type(storage::CacheManager &cache, const Args &args, ReplyWriter &reply)
+            {
+                auto type = cache.type(args[1]);
+                reply.add_simple_string(type ? *type : "none");
+            }
+
+            // OBJECT ENCODING|IDLETIME|FREQ key
+            void cmd_object(storage::CacheManager &cache, const Args &args, ReplyWriter &reply)
+            {
+                if (equals_ignore_case(args[1], "ENCODING"))
+                {
+                    auto encoding = cache.encoding(args[2]);
+                    if (encoding)
+                        reply.add_bulk_string(*encoding);
+                    else
+                        reply.add_null();
+                    return;
+                }
+                if (equals_ignore_case(args[1], "IDLETIME") || equals_ignore_case(args[1], "FREQ"))
+                {
+                    std::string_view key = args[2];
+                    auto value = equals_ignore_case(args[1], "FREQ") ? cache.frequency(key) : cache.idleTime(key);
+                    if (value)
+                        reply.add_integer(*value);
+                    else
+                        reply.add_null();
+                    return;
+                }
+                reply.add_error("ERR unknown subcommand '" + std::string(args[1]) + "'");
+            }
+
+            void cmd_dbsize(storage::CacheManager &cache, const Args &, ReplyWriter &reply)
+            {
+                reply.add_integer(static_cast<long long>(cache.dbsize()));
+            }
+
+            // SCAN cursor [MATCH pattern] [COUNT count] [TYPE type]
+            void cmd_scan(storage::CacheManager &cache, const Args &args, ReplyWriter &reply)
+            {
+                ScanOptions options;
+                if (!parse_scan(args, 1, "TYPE", options, reply))
+                    return;
+
+                std::vector<std::string> page;
+                unsigned long long cursor = cache.scan(options.cursor, options.count, options.type, page);
+                filter_page(options, page, [](const std::string &key) -> std::string_view
+                            { return key; });
+                reply_scan_page(reply, cursor, page.size());
+                for (const auto &key : page)
+                {
+                    reply.add_bulk_string(key);
+                }
+            }
+
+            void reply_expire(storage::CacheManager &cache, const Args &args, long long unit_ms, std::string_view name,
+                              ReplyWriter &reply)
+            {
+                long long value, deadline;
+                if (!parse_int(args[2], value))
+                {
+                    reply.add_error("ERR value is not an integer or out of range");
+                    return;
+                }
+                if (!to_deadline(value, unit_ms, true, deadline))
+                {
+                    reply.add_error("ERR invalid expire time in '" + std::string(name) + "' command");
+                    return;
+                }
+                reply.add_integer(cache.pexpireat(args[1], deadline) ? 1 : 0);
+            }
+
+            void cmd_expire(storage::CacheManager &cache, const Args &args, ReplyWriter &reply)
+            {
+                reply_expire(cache, args, 1000, "expire", reply);
+            }
+
+            void cmd_pexpire(storage::CacheManager &cache, const Args &args, ReplyWriter &reply)
+            {
+                reply_expire(cache, args, 1, "pexpire", reply);
+            }
+
+            void cmd_ttl(storage::CacheManager &cache, const Args &args, ReplyWriter &reply)
+            {
+                long long ms = cache.pttl(args[1]);
+                reply.add_integer(ms < 0 ? ms : (ms + 500) / 1000);
+            }
+
+            void cmd_pttl(storage::CacheManager &cache, const Args &args, ReplyWriter &reply)
+            {
+                reply.add_integer(cache.pttl(args[1]));
+            }
+
+            void cmd_persist(storage::CacheManager &cache, const Args &args, ReplyWriter &reply)
+            {
+                reply.add_integer(cache.persist(args[1]) ? 1 : 0);
+            }
+
+            // MEMORY USAGE key [SAMPLES count]
+            void cmd_memory(storage::CacheManager &cache, const Args &args, ReplyWriter &reply)
+            {
+                if (!equals_ignore_case(args[1], "USAGE"))
+                {
+                    reply.add_error("ERR unknown subcommand '" + std::string(args[1]) + "'");
+                    return;
+                }
+                // Sizes are tracked exactly, so there is nothing to sample;
+                // SAMPLES is accepted for compatibility.
+                long long samples;
+                if (args.size() != 3 &&
+                    (args.size() != 5 || !equals_ignore_case(args[3], "SAMPLES") || !parse_int(args[4], samples)))
+                {
+                    reply.add_error("ERR syntax error");
+                    return;
+                }
+                auto bytes = cache.memoryUsage(args[2]);
+                if (bytes)
+                    reply.add_integer(static_cast<long long>(*bytes));
+                else
+                    reply.add_null();
+            }
+
+            // Resident set size of the whole process, 0 if unknown.
+            size_t resident_memory()
+            {
+                unsigned long long size = 0, resident = 0;
+                FILE *statm = std::fopen("/proc/self/statm", "r");
+                if (!statm)
+                    return 0;
+                if (std::fscanf(statm, "%llu %llu", &size, &resident) != 2)
+                    resident = 0;
+                std::fclose(statm);
+                return static_cast<size_t>(resident * sysconf(_SC_PAGESIZE));
+            }
+
+            void info_memory(storage::CacheManager &cache, std::string &out)
+            {
+                auto memory = cache.memoryStats();
+                size_t rss = resident_memory();
+                size_t dataset = 0;
+                for (size_t bytes : memory.type_memory)
+                    dataset += bytes;
+
+                auto add = [&](const std::string &name, size_t bytes, bool human)
+                {
+                    out += name + ":" + std::to_string(bytes) + "\r\n";
+                    if (human)
+                        out += name + "_human:" + bytes_to_human(bytes) + "\r\n";
+                };
+                out += "# Memory\r\n";
+                add("used_memory", memory.used_memory, true);
+                add("used_memory_rss", rss, true);
+                add("used_memory_peak", memory.peak_memory, true);
+                add("used_memory_overhead", memory.table_bytes, false);
+                add("used_memory_dataset", dataset, false);
+                for (size_t type = 0; type < storage::VALUE_TYPE_COUNT; ++type)
+                {
+                    add("used_memory_type_" + std::string(storage::typeName(static_cast<storage::ValueType>(type))),
+                        memory.type_memory[type], false);
+                }
+                add("maxmemory", memory.max_memory, true);
+                out += "maxmemory_policy:" + std::string(storage::evictionPolicyName(memory.policy)) + "\r\n";
+                out += "mem_fragmentation_ratio:" + fragmentation_ratio(rss, memory.used_memory) + "\r\n";
+                out += "lazyfree_pending_objects:" + std::to_string(memory.lazyfree_pending) + "\r\n";
+
+                // Process-wide, whatever the core: block bytes against the
+                // pages holding them is the fragmentation the allocator adds.
+                out += std::string("mem_allocator:") + (storage::SlabAllocator::enabled() ? "slab" : "libc") + "\r\n";
+                if (storage::SlabAllocator::enabled())
+                {
+                    auto slab = storage::SlabAllocator::stats();
+                    add("allocator_allocated", slab.allocated, false);
+                    add("allocator_active", slab.active, false);
+                    add("allocator_resident", slab.resident, false);
+                    add("allocator_mapped", slab.mapped, false);
+                    out += "allocator_frag_ratio:" + fragmentation_ratio(slab.active, slab.allocated) + "\r\n";
+                    out += "allocator_rss_ratio:" + fragmentation_ratio(slab.resident, slab.active) + "\r\n";
+                    out += std::string("allocator_huge_pages:") + (storage::SlabAllocator::hugePages() ? "yes" : "no") +
+                           "\r\n";
+                }
+            }
+
+            void info_stats(storage::CacheManager &cache, std::string &out)
+            {
+                auto expiry = cache.expiryStats();
+                out += "# Stats\r\n";
+                out += "expired_keys:" + std::to_string(expiry.expired_keys) + "\r\n";
+                out += "expire_cycle_cpu_milliseconds:" + std::to_string(expiry.cycle_time_us / 1000) + "\r\n";
+                auto memory = cache.memoryStats();
+                out += "evicted_keys:" + std::to_string(memory.evicted_keys) + "\r\n";
+                out += "lazyfreed_objects:" + std::to_string(memory.lazyfreed) + "\r\n";
+
+                // The ratios are allocator_frag_ratio of this core's own heap,
+                // sampled as the last pass started and finished.
+                auto defrag = cache.defragStats();
+                auto ratio = [](double value)
+                {
+                    char buf[32];
+                    std::snprintf(buf, sizeof(buf), "%.2f", value);
+                    return std::string(buf);
+                };
+                out += "active_defrag_running:" + std::to_string(defrag.running ? 1 : 0) + "\r\n";
+                out += "active_defrag_hits:" + std::to_string(defrag.hits) + "\r\n";
+                out += "active_defrag_key_hits:" + std::to_string(defrag.key_hits) + "\r\n";
+                out += "active_defrag_key_misses:" + std::to_string(defrag.key_misses) + "\r\n";
+                out += "active_defrag_passes:" + std::to_string(defrag.passes) + "\r\n";
+                out += "total_active_defrag_time:" + std::to_string(defrag.time_us / 1000) + "\r\n";
+                out += "active_defrag_frag_ratio_before:" + ratio(defrag.ratio_start) + "\r\n";
+                out += "active_defrag_frag_ratio_after:" + ratio(defrag.ratio_end) + "\r\n";
+            }
+
+            void info_keyspace(storage::CacheManager &cache, std::string &out)
+            {
+                out += "# Keyspace\r\n";
+                size_t keys = cache.dbsize();
+                if (keys > 0)
+                {
+                    out += "db0:keys=" + std::to_string(keys) +
+                           ",expires=" + std::to_string(cache.expiryStats().keys_with_expiry) + "\r\n";
+                }
+            }
+
+            // INFO [section ...]
+            void cmd_info(storage::CacheManager &cache, const Args &args, ReplyWriter &reply)
+            {
+                using Section = void (*)(storage::CacheManager &, std::string &);
+                static const std::pair<const char *, Section> sections[] = {
+                    {"memory", info_memory},
+                    {"stats", info_stats},
+                    {"keyspace", info_keyspace},
+                };
+
+                auto wanted = [&](const char *name)
+                {
+                    if (args.size() == 1)
+                        return true;
+                    for (size_t i = 1; i < args.size(); ++i)
+                    {
+                        if (equals_ignore_case(args[i], name) || equals_ignore_case(args[i], "all") ||
+                            equals_ignore_case(args[i], "default") || equals_ignore_case(args[i], "everything"))
+                            return true;
+                    }
+                    return false;
+                };
+
+                std::string out;
+                for (const auto &[name, section] : sections)
+                {
+                    if (!wanted(name))
+                        continue;
+                    if (!out.empty())
+                        out += "\r\n";
+                    section(cache, out);
+                }
+                reply.add_bulk_string(out);
+            }
+
+            // FLUSHALL|FLUSHDB [ASYNC|SYNC]
+            void cmd_flushall(storage::CacheManager &cache, const Args &args, ReplyWriter &reply)
+            {
+                bool async = args.size() == 2 && equals_ignore_case(args[1], "ASYNC");
+                if (args.size() > 2 || (args.size() == 2 && !async && !equals_ignore_case(args[1], "SYNC")))
+                {
+                    reply.add_error("ERR syntax error");
+                    return;
+                }
+                if (async)
+                    cache.clearAsync();
+                else
+                    cache.clear();
+                reply.add_simple_string("OK");
+            }
+
+            void cmd_lpush(storage::CacheManager &cache, const Args &args, ReplyWriter &reply)
+            {
+                reply.add_integer(cache.lpush(args[1], Args(args.begin() + 2, args.end())));
+            }
+
+            void cmd_rpush(storage::CacheManager &cache, const Args &args, ReplyWriter &reply)
+            {
+                reply.add_integer(cache.rpush(args[1], Args(args.begin() + 2, args.end())));
+            }
+
+            void cmd_lpop(storage::CacheManager &cache, const Args &args, ReplyWriter &reply)
+            {
+                auto value = cache.lpop(args[1]);
+                if (value)
+                    reply.add_bulk_string(*value);
+                else
+                    reply.add_null();
+            }
+
+            void cmd_rpop(storage::CacheManager &cache, const Args &args, ReplyWriter &reply)
+            {
+                auto value = cache.rpop(args[1]);
+                if (value)
+                    reply.add_bulk_string(*value);
+                else
+                    reply.add_null();
+            }
+
+            void cmd_llen(storage::CacheManager &cache, const Args &args, ReplyWriter &reply)
+            {
+                reply.add_integer(cache.llen(args[1]));
+            }
+
+            void cmd_lrange(storage::CacheManager &cache, const Args &args, ReplyWriter &reply)
+            {
+                long long start = 0, stop = 0;
+                if (!parse_int(args[2], start) || !parse_int(args[3], stop))
+                {
+                    reply.add_error("ERR value is not an integer or out of range");
+                    return;
+                }
+                ListStream::send(std::make_unique<ListStream>(cache, start, stop), cache, args[1], reply);
+            }
+
+            void cmd_lindex(storage::CacheManager &cache, const Args &args, ReplyWriter &reply)
+            {
+                long long index = 0;
+                if (!parse_int(args[2], index))
+                {
+                    reply.add_error("ERR value is not an integer or out of range");
+                    return;
+                }
+                auto value = cache.lindex(args[1], index);
+                if (value)
+                    reply.add_bulk_string(*value);
+                else
+                    reply.add_null();
+            }
+
+            void cmd_lset(storage::CacheManager &cache, const Args &args, ReplyWriter &reply)
+            {
+                long long index = 0;
+                if (!parse_int(args[2], index))
+                {
+                    reply.add_error("ERR value is not an integer or out of range");
+                    return;
+                }
+                cache.lset(args[1], index, args[3]);
+                reply.add_simple_string("OK");
+            }
+
+            // LINSERT key BEFORE|AFTER pivot element
+            void cmd_linsert(storage::CacheManager &cache, const Args &args, ReplyWriter &reply)
+            {
+                bool before;
+                if (equals_ignore_case(args[2], "BEFORE"))
+                    before = true;
+                else if (equals_ignore_case(args[2], "AFTER"))
+                    before = false;
+                else
+                {
+                    reply.add_error("ERR syntax error");
+                    return;
+                }
+                reply.add_integer(cache.linsert(args[1], before, args[3], args[4]));
+            }
+
+            void cmd_ltrim(storage::CacheManager &cache, const Args &args, ReplyWriter &reply)
+            {
+                long long start = 0, stop = 0;
+                if (!parse_int(args[2], start) || !parse_int(args[3], stop))
+                {
+                    reply.add_error("ERR value is not an integer or out of range");
+                    return;
+                }
+                cache.ltrim(args[1], start, stop);
+                reply.add_simple_string("OK");
+            }
+
+            void cmd_lrem(storage::CacheManager &cache, const Args &args, ReplyWriter &reply)
+            {
+                long long count = 0;
+                if (!parse_int(args[2], count))
+                {
+                    reply.add_error("ERR value is not an integer or out of range");
+                    return;
+                }
+                reply.add_integer(cache.lrem(args[1], count, args[3]));
+            }
+
+            void cmd_sadd(storage::CacheManager &cache, const Args &args, ReplyWriter &reply)
+            {
+                reply.add_integer(cache.sadd(args[1], Args(args.begin() + 2, args.end())));
+            }
+
+            void cmd_srem(storage::CacheManager &cache, const Args &args, ReplyWriter &reply)
+            {
+                std::string_view key = args[1];
+                long long removed = 0;
+                for (size_t i = 2; i < args.size(); ++i)
+                {
+                    removed += cache.srem(key, args[i]);
+                }
+                reply.add_integer(removed);
+            }
+
+            void cmd_sismember(storage::CacheManager &cache, const Args &args, ReplyWriter &reply)
+            {
+                reply.add_integer(cache.sismember(args[1], args[2]) ? 1 : 0);
+            }
+
+            void cmd_scard(storage::CacheManager &cache, const Args &args, ReplyWriter &reply)
+            {
+                reply.add_integer(cache.scard(args[1]));
+            }
+
+            void reply_members(ReplyWriter &reply, const std::vector<std::string> &members)
+            {
+                reply.add_array(members.size());
+                for (const auto &member : members)
+                {
+                    reply.add_bulk_string(member);
+                }
+            }
+
+            Args keys_from(const Args &args, size_t first, size_t end)
+            {
+                return Args(args.begin() + first, args.begin() + end);
+            }
+
+            void cmd_smembers(storage::CacheManager &cache, const Args &args, ReplyWriter &reply)
+            {
+                SetStream::send(std::make_unique<SetStream>(cache), cache, args[1], reply);
+            }
+
+            // SSCAN key cursor [MATCH pattern] [COUNT count]
+            void cmd_sscan(storage::CacheManager &cache, const Args &args, ReplyWriter &reply)
+            {
+                ScanOptions options;
+                if (!parse_scan(args, 2, "", options, reply))
+                    return;
+
+                std::vector<std::string> page;
+                unsigned long long cursor = cache.sscan(args[1], options.cursor, options.count, page);
+                filter_page(options, page, [](const std::string &member) -> std::string_view
+                            { return member; });
+                reply_scan_page(reply, cursor, page.size());
+                for (const auto &member : page)
+                {
+                    reply.add_bulk_string(member);
+                }
+            }
+
+            void cmd_sinter(storage::CacheManager &cache, const Args &args, ReplyWriter &reply)
+            {
+                reply_members(reply, cache.sinter(keys_from(args, 1, args.size())));
+            }
+
+            void cmd_sunion(storage::CacheManager &cache, const Args &args, ReplyWriter &reply)
+            {
+                reply_members(reply, cache.sunion(keys_from(args, 1, args.size())));
+            }
+
+            void cmd_sdiff(storage::CacheManager &cache, const Args &args, ReplyWriter &reply)
+            {
+                reply_members(reply, cache.sdiff(keys_from(args, 1, args.size())));
+            }
+
+            void cmd_sinterstore(storage::CacheManager &cache, const Args &args, ReplyWriter &reply)
+            {
+                size_t stored = cache.sinterstore(args[1], keys_from(args, 2, args.size()));
+                reply.add_integer(static_cast<long long>(stored));
+            }
+
+            void cmd_sunionstore(storage::CacheManager &cache, const Args &args, ReplyWriter &reply)
+            {
+                size_t stored = cache.sunionstore(args[1], keys_from(args, 2, args.size()));
+                reply.add_integer(static_cast<long long>(stored));
+            }
+
+            void cmd_sdiffstore(storage::CacheManager &cache, const Args &args, ReplyWriter &reply)
+            {
+                size_t stored = cache.sdiffstore(args[1], keys_from(args, 2, args.size()));
+                reply.add_integer(static_cast<long long>(stored));
+            }
+
+            // SINTERCARD numkeys key [key ...] [LIMIT limit]
+            void cmd_sintercard(storage::CacheManager &cache, const Args &args, ReplyWriter &reply)
+            {
+                long long numkeys;
+                if (!parse_int(args[1], numkeys) || numkeys < 1)
+                {
+                    reply.add_error("ERR numkeys should be greater than 0");
+                    return;
+                }
+                if (numkeys > static_cast<long long>(args.size()) - 2)
+                {
+                    reply.add_error("ERR Number of keys can't be greater than number of args");
+                    return;
+                }
+
+                size_t end = 2 + static_cast<size_t>(numkeys);
+                long long limit = 0;
+                for (size_t i = end; i < args.size(); i += 2)
+                {
+                    if (!equals_ignore_case(args[i], "LIMIT") || i + 1 >= args.size())
+                    {
+                        reply.add_error("ERR syntax error");
+                        return;
+                    }
+                    if (!parse_int(args[i + 1], limit) || limit < 0)
+                    {
+                        reply.add_error("ERR LIMIT can't be negative");
+                        return;
+                    }
+                }
+
+                size_t count = cache.sintercard(keys_from(args, 2, end), static_cast<size_t>(limit));
+                reply.add_integer(static_cast<long long>(count));
+            }
+
+            void cmd_hset(storage::CacheManager &cache, const Args &args, ReplyWriter &reply)
+            {
+                if (args.size() % 2 != 0)
+                {
+                    reply.add_error("ERR wrong number of arguments for 'hset' command");
+                    return;
+                }
+                std::vector<storage::HashType::FieldValue> pairs;
+                pairs.reserve((args.size() - 2) / 2);
+                for (size_t i = 2; i < args.size(); i += 2)
+                {
+                    pairs.emplace_back(std::string(args[i]), std::string(args[i + 1]));
+                }
+                reply.add_integer(cache.hset(args[1], pairs));
+            }
+
+            void cmd_hget(storage::CacheManager &cache, const Args &args, ReplyWriter &reply)
+            {
+                auto value = cache.hget(args[1], args[2]);
+                if (value)
+                    reply.add_bulk_string(*value);
+                else
+                    reply.add_null();
+            }
+
+            void cmd_hmget(storage::CacheManager &cache, const Args &args, ReplyWriter &reply)
+            {
+                Args fields(args.begin() + 2, args.end());
+                auto values = cache.hmget(args[1], fields);
+                reply.add_array(values.size());
+                for (const auto &value : values)
+                {
+                    if (value)
+                        reply.add_bulk_string(*value);
+                    else
+                        reply.add_null();
+                }
+            }
+
+            void cmd_hdel(storage::CacheManager &cache, const Args &args, ReplyWriter &reply)
+            {
+                Args fields(args.begin() + 2, args.end());
+                reply.add_integer(cache.hdel(args[1], fields));
+            }
+
+            void cmd_hincrby(storage::CacheManager &cache, const Args &args, ReplyWriter &reply)
+            {
+                long long delta;
+                if (!parse_int(args[3], delta))
+                {
+                    reply.add_error("ERR value is not an integer or out of range");
+                    return;
+                }
+                reply.add_integer(cache.hincrby(args[1], args[2], delta));
+            }
+
+            void cmd_hlen(storage::CacheManager &cache, const Args &args, ReplyWriter &reply)
+            {
+                reply.add_integer(cache.hlen(args[1]));
+            }
+
+            void cmd_hexists(storage::CacheManager &cache, const Args &args, ReplyWriter &reply)
+            {
+                reply.add_integer(cache.hexists(args[1], args[2]) ? 1 : 0);
+            }
+
+            void cmd_hgetall(storage::CacheManager &cache, const Args &args, ReplyWriter &reply)
+            {
+                HashStream::send(std::make_unique<HashStream>(cache), cache, args[1], reply);
+            }
+
+            // HSCAN key cursor [MATCH pattern] [COUNT count] [NOVALUES]
+            void cmd_hscan(storage::CacheManager &cache, const Args &args, ReplyWriter &reply)
+            {
+                ScanOptions options;
+                if (!parse_scan(args, 2, "NOVALUES", options, reply))
+                    return;
+
+                std::vector<storage::HashType::FieldValue> page;
+                unsigned long long cursor = cache.hscan(args[1], options.cursor, options.count, page);
+                filter_page(options, page, [](const storage::HashType::FieldValue &pair) -> std::string_view
+                            { return pair.first; });
+                reply_scan_page(reply, cursor, page.size() * (options.values ? 2 : 1));
+                for (const auto &[field, value] : page)
+                {
+                    reply.add_bulk_string(field);
+                    if (options.values)
+                        reply.add_bulk_string(value);
+                }
+            }
+
+            // A float that fits a double; unlike INCRBYFLOAT, inf is a score.
+            bool parse_score(std::string_view str, double &out)
+            {
+                long double value;
+                if (!storage::StringType::parseFloat(str, value))
+                    return false;
+                out = static_cast<double>(value);
+                return !std::isinf(out) || std::isinf(value);
+            }
+
+            // A ZRANGEBYSCORE bound: a score, -inf/+inf, or "(score" for an
+            // exclusive one.
+            bool parse_score_bound(std::string_view str, double &out, bool &exclusive)
+            {
+                exclusive = !str.empty() && str[0] == '(';
+                if (exclusive)
+                    str.remove_prefix(1);
+                return parse_score(str, out);
+            }
+
+            bool parse_score_range(std::string_view min, std::string_view max, storage::ScoreRange &range)
+            {
+                return parse_score_bound(min, range.min, range.min_exclusive) &&
+                       parse_score_bound(max, range.max, range.max_exclusive);
+            }
+
+            // Members, or with scores as [member, score] pairs under RESP3 and
+            // as a flat member, score, ... array under RESP2.
+            void reply_scored(const std::vector<storage::SortedSetType::MemberScore> &items, bool withscores,
+                              ReplyWriter &reply)
+            {
+                bool nested = withscores && reply.protocol() >= 3;
+                reply.add_array(items.size() * (withscores && !nested ? 2 : 1));
+                for (const auto &[member, score] : items)
+                {
+                    if (nested)
+                        reply.add_array(2);
+                    reply.add_bulk_string(member);
+                    if (withscores)
+                        reply.add_double(score);
+                }
+            }
+
+            // ZADD key [NX|XX] [GT|LT] [CH] [INCR] score member [score member ...]
+            void cmd_zadd(storage::CacheManager &cache, const Args &args, ReplyWriter &reply)
+            {
+                using storage::SortedSetType;
+                unsigned flags = 0;
+                bool changed = false;
+                size_t i = 2;
+                for (; i < args.size(); ++i)
+                {
+                    if (equals_ignore_case(args[i], "NX"))
+                        flags |= SortedSetType::ADD_NX;
+                    else if (equals_ignore_case(args[i], "XX"))
+                        flags |= SortedSetType::ADD_XX;
+                    else if (equals_ignore_case(args[i], "GT"))
+                        flags |= SortedSetType::ADD_GT;
+                    else if (equals_ignore_case(args[i], "LT"))
+                        flags |= SortedSetType::ADD_LT;
+                    else if (equals_ignore_case(args[i], "CH"))
+                        changed = true;
+                    else if (equals_ignore_case(args[i], "INCR"))
+                        flags |= SortedSetType::ADD_INCR;
+                    else
+                        break;
+                }
+
+                size_t remaining = args.size() - i;
+                if (remaining == 0 || remaining % 2 != 0)
+                {
+                    reply.add_error("ERR syntax error");
+                    return;
+                }
+                if ((flags & SortedSetType::ADD_NX) && (flags & SortedSetType::ADD_XX))
+                {
+                    reply.add_error("ERR XX and NX options at the same time are not compatible");
+                    return;
+                }
+                if (((flags & SortedSetType::ADD_GT) && (flags & SortedSetType::ADD_LT)) ||
+                    ((flags & (SortedSetType::ADD_GT | SortedSetType::ADD_LT)) && (flags & SortedSetType::ADD_NX)))
+                {
+                    reply.add_error("ERR GT, LT, and/or NX options at the same time are not compatible");
+                    return;
+                }
+                if ((flags & SortedSetType::ADD_INCR) && remaining > 2)
+                {
+                    reply.add_error("ERR INCR option supports a single increment-element pair");
+                    return;
+                }
+
+                std::vector<std::pair<double, std::string>> pairs;
+                pairs.reserve(remaining / 2);
+                for (; i < args.size(); i += 2)
+                {
+                    double score;
+                    if (!parse_score(args[i], score))
+                    {
+                        reply.add_error("ERR value is not a valid float");
+                        return;
+                    }
+                    pairs.emplace_back(score, std::string(args[i + 1]));
+                }
+
+                int added = 0, updated = 0;
+                std::optional<double> last = cache.zadd(args[1], pairs, flags, added, updated);
+                if (flags & SortedSetType::ADD_INCR)
+                {
+                    if (last)
+                        reply.add_double(*last);
+                    else
+                        reply.add_null();
+                    return;
+                }
+                reply.add_integer(added + (changed ? updated : 0));
+            }
+
+            void cmd_zrem(storage::CacheManager &cache, const Args &args, ReplyWriter &reply)
+            {
+                Args members(args.begin() + 2, args.end());
+                reply.add_integer(cache.zrem(args[1], members));
+            }
+
+            void cmd_zscore(storage::CacheManager &cache, const Args &args, ReplyWriter &reply)
+            {
+                if (auto score = cache.zscore(args[1], args[2]))
+                    reply.add_double(*score);
+                else
+                    reply.add_null();
+            }
+
+            void reply_zrank(storage::CacheManager &cache, const Args &args, bool reverse, ReplyWriter &reply)
+            {
+                if (auto rank = cache.zrank(args[1], args[2], reverse))
+                    reply.add_integer(static_cast<long long>(*rank));
+                else
+                    reply.add_null();
+            }
+
+            void cmd_zrank(storage::CacheManager &cache, const Args &args, ReplyWriter &reply)
+            {
+                reply_zrank(cache, args, false, reply);
+            }
+
+            void cmd_zrevrank(storage::CacheManager &cache, const Args &args, ReplyWriter &reply)
+            {
+                reply_zrank(cache, args, true, reply);
+            }
+
+            void cmd_zcard(storage::CacheManager &cache, const Args &args, ReplyWriter &reply)
+            {
+                reply.add_integer(cache.zcard(args[1]));
+            }
+
+            struct RangeOptions
+            {
+                bool by_score = false;
+                bool reverse = false;
+                bool withscores = false;
+                bool limit = false;
+                long long offset = 0;
+                long long count = -1;
+            };
+
+            // Parses the options after a range's bounds; BYSCORE and REV are
+            // only accepted when `zrange` is set. Replies the error itself.
+            bool parse_range_options(const Args &args, size_t first, bool zrange, RangeOptions &options,
+                                     ReplyWriter &reply)
+            {
+                for (size_t i = first; i < args.size(); ++i)
+                {
+                    if (equals_ignore_case(args[i], "WITHSCORES"))
+                    {
+                        options.withscores = true;
+                    }
+                    else if (zrange && equals_ignore_case(args[i], "BYSCORE"))
+                    {
+                        options.by_score = true;
+                    }
+                    else if (zrange && equals_ignore_case(args[i], "REV"))
+                    {
+                        options.reverse = true;
+                    }
+                    else if (equals_ignore_case(args[i], "LIMIT") && i + 2 < args.size())
+                    {
+                        if (!parse_int(args[i + 1], options.offset) || !parse_int(args[i + 2], options.count))
+                        {
+                            reply.add_error("ERR value is not an integer or out of range");
+                            return false;
+                        }
+                        options.limit = true;
+                        i += 2;
+                    }
+                    else
+                    {
+                        reply.add_error("ERR syntax error");
+                        return false;
+                    }
+                }
+                return true;
+            }
+
+            void reply_range_by_score(storage::CacheManager &cache, std::string_view key, const storage::ScoreRange &range,
+                                      const RangeOptions &options, ReplyWriter &reply)
+            {
+                // A negative offset selects nothing, as in Redis.
+                if (options.offset < 0)
+                {
+                    reply_scored({}, options.withscores, reply);
+                    return;
+                }
+                auto items = cache.zrangebyscore(key, range, options.reverse,
+                                                 static_cast<size_t>(options.offset), options.count);
+                reply_scored(items, options.withscores, reply);
+            }
+
+            // ZRANGE key start stop [BYSCORE] [REV] [LIMIT offset count] [WITHSCORES]
+            void cmd_zrange(storage::CacheManager &cache, const Args &args, ReplyWriter &reply)
+            {
+                RangeOptions options;
+                if (!parse_range_options(args, 4, true, options, reply))
+                    return;
+
+                if (options.by_score)
+                {
+                    // REV takes the bounds as max, then min.
+                    storage::ScoreRange range;
+                    if (!parse_score_range(args[options.reverse ? 3 : 2], args[options.reverse ? 2 : 3], range))
+                    {
+                        reply.add_error("ERR min or max is not a float");
+                        return;
+                    }
+                    reply_range_by_score(cache, args[1], range, options, reply);
+                    return;
+                }
+
+                if (options.limit)
+                {
+                    reply.add_error("ERR syntax error, LIMIT is only supported in combination with either BYSCORE or BYLEX");
+                    return;
+                }
+                long long start, stop;
+                if (!parse_int(args[2], start) || !parse_int(args[3], stop))
+                {
+                    reply.add_error("ERR value is not an integer or out of range");
+                    return;
+                }
+                reply_scored(cache.zrange(args[1], start, stop, options.reverse), options.withscores, reply);
+            }
+
+            // ZRANGEBYSCORE key min max [WITHSCORES] [LIMIT offset count]
+            void cmd_zrangebyscore(storage::CacheManager &cache, const Args &args, ReplyWriter &reply)
+            {
+                RangeOptions options;
+                if (!parse_range_options(args, 4, false, options, reply))
+                    return;
+
+                storage::ScoreRange range;
+                if (!parse_score_range(args[2], args[3], range))
+                {
+                    reply.add_error("ERR min or max is not a float");
+                    return;
+                }
+                reply_range_by_score(cache, args[1], range, options, reply);
+            }
+
+            void cmd_zremrangebyscore(storage::CacheManager &cache, const Args &args, ReplyWriter &reply)
+            {
+                storage::ScoreRange range;
+                if (!parse_score_range(args[2], args[3], range))
+                {
+                    reply.add_error("ERR min or max is not a float");
+                    return;
+                }
+                reply.add_integer(static_cast<long long>(cache.zremrangebyscore(args[1], range)));
+            }
+
+            // ZPOPMIN key [count]
+            void cmd_zpopmin(storage::CacheManager &cache, const Args &args, ReplyWriter &reply)
+            {
+                long long count = 1;
+                if (args.size() > 3)
+                {
+                    reply.add_error("ERR syntax error");
+                    return;
+                }
+                if (args.size() == 3 && (!parse_int(args[2], count) || count < 0))
+                {
+                    reply.add_error("ERR value is out of range, must be positive");
+                    return;
+                }
+
+                auto popped = cache.zpopmin(args[1], static_cast<size_t>(count));
+                if (args.size() == 3)
+                {
+                    reply_scored(popped, true, reply);
+                    return;
+                }
+                // Without a count the reply is a flat [member, score] in both
+                // protocols.
+                reply.add_array(popped.size() * 2);
+                for (const auto &[member, score] : popped)
+                {
+                    reply.add_bulk_string(member);
+                    reply.add_double(score);
+                }
+            }
+
+            // ZSCAN key cursor [MATCH pattern] [COUNT count]
+            void cmd_zscan(storage::CacheManager &cache, const Args &args, ReplyWriter &reply)
+            {
+                ScanOptions options;
+                if (!parse_scan(args, 2, "", options, reply))
+                    return;
+
+                std::vector<storage::SortedSetType::MemberScore> page;
+                unsigned long long cursor = cache.zscan(args[1], options.cursor, options.count, page);
+                filter_page(options, page, [](const storage::SortedSetType::MemberScore &pair) -> std::string_view
+                            { return pair.first; });
+                reply_scan_page(reply, cursor, page.size() * 2);
+                for (const auto &[member, score] : page)
+                {
+                    reply.add_bulk_string(member);
+                    reply.add_double(score);
+                }
+            }
+
+            constexpr KeyScope NO_KEYS = KeyScope::NONE;
+            constexpr KeyScope KEYS = KeyScope::KEYS;
+            constexpr KeyScope ALL = KeyScope::ALL;
+            constexpr KeyScope CURSOR = KeyScope::CURSOR;
+            constexpr bool DENY_OOM = true;
+
+            const CommandSpec command_table[] = {
+                {{"PING", -1, NO_KEYS}, cmd_ping},
+                {{"ECHO", 2, NO_KEYS}, cmd_echo},
+                {{"QUIT", 1, NO_KEYS}, cmd_quit},
+                {{"COMMAND", -1, NO_KEYS}, cmd_command},
+                {{"HELLO", -1, NO_KEYS}, cmd_hello},
+                {{"SET", -3, KEYS, 1, 1, 1}, cmd_set, DENY_OOM},
+                {{"GET", 2, KEYS, 1, 1, 1}, cmd_get},
+                {{"MSET", -3, KEYS, 1, -1, 2, ReplyMerge::FIRST}, cmd_mset, DENY_OOM},
+                {{"MSETNX", -3, KEYS, 1, -1, 2}, cmd_msetnx, DENY_OOM},
+                {{"MGET", -2, KEYS, 1, -1, 1}, cmd_mget},
+                {{"INCR", 2, KEYS, 1, 1, 1}, cmd_incr, DENY_OOM},
+                {{"DECR", 2, KEYS, 1, 1, 1}, cmd_decr, DENY_OOM},
+                {{"INCRBY", 3, KEYS, 1, 1, 1}, cmd_incrby, DENY_OOM},
+                {{"DECRBY", 3, KEYS, 1, 1, 1}, cmd_decrby, DENY_OOM},
+                {{"INCRBYFLOAT", 3, KEYS, 1, 1, 1}, cmd_incrbyfloat, DENY_OOM},
+                {{"DEL", -2, KEYS, 1, -1, 1, ReplyMerge::SUM}, cmd_del},
+                {{"UNLINK", -2, KEYS, 1, -1, 1, ReplyMerge::SUM}, cmd_unlink},
+                {{"EXISTS", -2, KEYS, 1, -1, 1, ReplyMerge::SUM}, cmd_exists},
+                {{"TYPE", 2, KEYS, 1, 1, 1}, cmd_type},
+                {{"OBJECT", 3, KEYS, 2, 2, 1}, cmd_object},
+                {{"MEMORY", -3, KEYS, 2, 2, 1}, cmd_memory},
+                {{"EXPIRE", 3, KEYS, 1, 1, 1}, cmd_expire},
+                {{"PEXPIRE", 3, KEYS, 1, 1, 1}, cmd_pexpire},
+                {{"TTL", 2, KEYS, 1, 1, 1}, cmd_ttl},
+                {{"PTTL", 2, KEYS, 1, 1, 1}, cmd_pttl},
+                {{"PERSIST", 2, KEYS, 1, 1, 1}, cmd_persist},
+                {{"DBSIZE", 1, ALL, 0, 0, 0, ReplyMerge::SUM}, cmd_dbsize},
+                {{"SCAN", -2, CURSOR, 0, 0, 0}, cmd_scan},
+                {{"INFO", -1, ALL, 0, 0, 0, ReplyMerge::INFO}, cmd_info},
+                {{"FLUSHALL", -1, ALL, 0, 0, 0, ReplyMerge::FIRST}, cmd_flushall},
+                {{"FLUSHDB", -1, ALL, 0, 0, 0, ReplyMerge::FIRST}, cmd_flushall},
+                {{"LPUSH", -3, KEYS, 1, 1, 1}, cmd_lpush, DENY_OOM},
+                {{"RPUSH", -3, KEYS, 1, 1, 1}, cmd_rpush, DENY_OOM},
+                {{"LPOP", 2, KEYS, 1, 1, 1}, cmd_lpop},
+                {{"RPOP", 2, KEYS, 1, 1, 1}, cmd_rpop},
+                {{"LLEN", 2, KEYS, 1, 1, 1}, cmd_llen},
+                {{"LRANGE", 4, KEYS, 1, 1, 1}, cmd_lrange},
+                {{"LINDEX", 3, KEYS, 1, 1, 1}, cmd_lindex},
+                {{"LSET", 4, KEYS, 1, 1, 1}, cmd_lset, DENY_OOM},
+                {{"LINSERT", 5, KEYS, 1, 1, 1}, cmd_linsert, DENY_OOM},
+                {{"LTRIM", 4, KEYS, 1, 1, 1}, cmd_ltrim},
+                {{"LREM", 4, KEYS, 1, 1, 1}, cmd_lrem},
+                {{"SADD", -3, KEYS, 1, 1, 1}, cmd_sadd, DENY_OOM},
+                {{"SREM", -3, KEYS, 1, 1, 1}, cmd_srem},
+                {{"SISMEMBER", 3, KEYS, 1, 1, 1}, cmd_sismember},
+                {{"SCARD", 2, KEYS, 1, 1, 1}, cmd_scard},
+                {{"SMEMBERS", 2, KEYS, 1, 1, 1}, cmd_smembers},
+                {{"SSCAN", -3, KEYS, 1, 1, 1}, cmd_sscan},
+                {{"SINTER", -2, KEYS, 1, -1, 1}, cmd_sinter},
+                {{"SUNION", -2, KEYS, 1, -1, 1}, cmd_sunion},
+                {{"SDIFF", -2, KEYS, 1, -1, 1}, cmd_sdiff},
+                {{"SINTERCARD", -3, KEYS, 2, 0, 1, ReplyMerge::NONE, 1}, cmd_sintercard},
+                {{"SINTERSTORE", -3, KEYS, 1, -1, 1}, cmd_sinterstore, DENY_OOM},
+                {{"SUNIONSTORE", -3, KEYS, 1, -1, 1}, cmd_sunionstore, DENY_OOM},
+                {{"SDIFFSTORE", -3, KEYS, 1, -1, 1}, cmd_sdiffstore, DENY_OOM},
+                {{"HSET", -4, KEYS, 1, 1, 1}, cmd_hset, DENY_OOM},
+                {{"HGET", 3, KEYS, 1, 1, 1}, cmd_hget},
+                {{"HMGET", -3, KEYS, 1, 1, 1}, cmd_hmget},
+                {{"HDEL", -3, KEYS, 1, 1, 1}, cmd_hdel},
+                {{"HINCRBY", 4, KEYS, 1, 1, 1}, cmd_hincrby, DENY_OOM},
+                {{"HLEN", 2, KEYS, 1, 1, 1}, cmd_hlen},
+                {{"HEXISTS", 3, KEYS, 1, 1, 1}, cmd_hexists},
+                {{"HGETALL", 2, KEYS, 1, 1, 1}, cmd_hgetall},
+                {{"HSCAN", -3, KEYS, 1, 1, 1}, cmd_hscan},
+                {{"ZADD", -4, KEYS, 1, 1, 1}, cmd_zadd, DENY_OOM},
+                {{"ZREM", -3, KEYS, 1, 1, 1}, cmd_zrem},
+                {{"ZSCORE", 3, KEYS, 1, 1, 1}, cmd_zscore},
+                {{"ZRANK", 3, KEYS, 1, 1, 1}, cmd_zrank},
+                {{"ZREVRANK", 3, KEYS, 1, 1, 1}, cmd_zrevrank},
+                {{"ZCARD", 2, KEYS, 1, 1, 1}, cmd_zcard},
+                {{"ZRANGE", -4, KEYS, 1, 1, 1}, cmd_zrange},
+                {{"ZRANGEBYSCORE", -4, KEYS, 1, 1, 1}, cmd_zrangebyscore},
+                {{"ZREMRANGEBYSCORE", 4, KEYS, 1, 1, 1}, cmd_zremrangebyscore},
+                {{"ZPOPMIN", -2, KEYS, 1, 1, 1}, cmd_zpopmin},
+                {{"ZSCAN", -3, KEYS, 1, 1, 1}, cmd_zscan},
+            };
+
+            const std::unordered_map<std::string_view, const CommandSpec *> &commands()
+            {
+                static const std::unordered_map<std::string_view, const CommandSpec *> table = []
+                {
+                    std::unordered_map<std::string_view, const CommandSpec *> map;
+                    for (const auto &spec : command_table)
+                    {
+                        map.emplace(spec.info.name, &spec);
+                    }
+                    return map;
+                }();
+                return table;
+            }
+
+            // Longest command name plus some slack; longer names cannot match.
+            constexpr size_t MAX_COMMAND_NAME = 32;
+
+            const CommandSpec *lookup(std::string_view name)
+            {
+                if (name.size() > MAX_COMMAND_NAME)
+                    return nullptr;
+
+                char upper[MAX_COMMAND_NAME];
+                for (size_t i = 0; i < name.size(); ++i)
+                {
+                    upper[i] = static_cast<char>(std::toupper(static_cast<unsigned char>(name[i])));
+                }
+
+                const auto &table = commands();
+                auto it = table.find(std::string_view(upper, name.size()));
+                return it == table.end() ? nullptr : it->second;
+            }
+        }
+
+        bool CommandInfo::arity_matches(size_t argc) const
+        {
+            if (arity >= 0)
+                return argc == static_cast<size_t>(arity);
+            return argc >= static_cast<size_t>(-arity);
+        }
+
+        int CommandInfo::last_key_index(const std::vector<std::string_view> &args) const
+        {
+            int argc = static_cast<int>(args.size());
+            if (numkeys_index != 0)
+            {
+                long long numkeys;
+                if (!parse_int(args[numkeys_index], numkeys) || numkeys < 1 || numkeys > argc - first_key)
+                    return -1;
+                return first_key + static_cast<int>(numkeys) - 1;
+            }
+            int last = last_key < 0 ? argc + last_key : last_key;
+            return last >= argc ? argc - 1 : last;
+        }
+
+        std::string bytes_to_human(unsigned long long bytes)
+        {
+            static const char units[] = "KMGTP";
+            if (bytes < 1024)
+                return std::to_string(bytes) + "B";
+            double value = static_cast<double>(bytes) / 1024;
+            size_t unit = 0;
+            while (value >= 1024 && unit + 1 < sizeof(units) - 1)
+            {
+                value /= 1024;
+                ++unit;
+            }
+            char buf[32];
+            std::snprintf(buf, sizeof(buf), "%.2f%c", value, units[unit]);
+            return buf;
+        }
+
+        std::string fragmentation_ratio(unsigned long long rss, unsigned long long used)
+        {
+            char buf[32];
+            std::snprintf(buf, sizeof(buf), "%.2f", used == 0 ? 0.0 : static_cast<double>(rss) / used);
+            return buf;
+        }
+
+        const CommandInfo *lookup_command(std::string_view name)
+        {
+            const CommandSpec *spec = lookup(name);
+            return spec ? &spec->info : nullptr;
+        }
+
+        CommandExecutor::CommandExecutor(storage::CacheManager &cache) : cache(cache) {}
+
+        CommandStatus CommandExecutor::execute(const std::vector<std::string_view> &args, ReplyWriter &reply)
+        {
+            if (args.empty())
+            {
+                return CommandStatus::CONTINUE;
+            }
+
+            const CommandSpec *spec = lookup(args[0]);
+            if (!spec)
+            {
+                reply.add_error("ERR unknown command '" + std::string(args[0]) + "'");
+                return CommandStatus::CONTINUE;
+            }
+
+            if (!spec->info.arity_matches(args.size()))
+            {
+                std::string name(args[0]);
+                for (auto &c : name)
+                {
+                    c = static_cast<char>(std::tolower(static_cast<unsigned char>(c)));
+                }
+                reply.add_error("ERR wrong number of arguments for '" + name + "' command");
+                return CommandStatus::CONTINUE;
+            }
+
+            // Like Redis, every command first makes room if memory is over the
+            // limit; only those that can grow the keyspace are refused when
+            // nothing could be evicted, so reads and deletes keep working.
+            if (!cache.evictIfNeeded() && spec->deny_oom)
+            {
+                reply.add_error("OOM command not allowed when used memory > 'maxmemory'.");
+                return CommandStatus::CONTINUE;
+            }
+
+            try
+            {
+                spec->handler(cache, args, reply);
+            }
+            catch (const std::exception &e)
+            {
+                reply.add_error(e.what());
+            }
+
+            return spec->handler == cmd_quit ? CommandStatus::CLOSE : CommandStatus::CONTINUE;
+        }
+
+    }
+}
@@ -0,0 +1,138 @@
+/**
+ * @file command/executor.hpp
+ * @brief Dispatches parsed client commands into the cache
+ */
+
+#ifndef OPUS_COMMAND_EXECUTOR_HPP
+#define OPUS_COMMAND_EXECUTOR_HPP
+
+#include <string>
+#include <string_view>
+#include <vector>
+
+#include "reply.hpp"
+#include "storage/manager.hpp"
+
+namespace opus
+{
+    namespace command
+    {
+
+        /**
+         * @enum CommandStatus
+         * @brief What the connection should do after a command has been executed
+         */
+        enum class CommandStatus
+        {
+            CONTINUE,
+            CLOSE
+        };
+
+        /**
+         * @enum KeyScope
+         * @brief Which keyspace partitions a command touches
+         */
+        enum class KeyScope
+        {
+            NONE,  // Connection-level command (PING, HELLO, ...)
+            KEYS,  // Touches the keys at the positions given by CommandInfo
+            ALL,   // Touches the whole keyspace (DBSIZE, FLUSHALL, ...)
+            CURSOR // Walks the partitions one at a time, the cursor in
+                   // args[1] naming the current one (SCAN)
+        };
+
+        /**
+         * @enum ReplyMerge
+         * @brief How replies from several partitions combine into one
+         *
+         * Commands whose keys live in different partitions can only be split
+         * when their replies merge this way; the rest must stay on one
+         * partition.
+         */
+        enum class ReplyMerge
+        {
+            NONE,  // Not splittable
+            SUM,   // Integer replies are added up (DEL, EXISTS, DBSIZE)
+            FIRST, // All parts reply the same status; the first one is kept
+            INFO   // INFO texts: integer fields are added up line by line
+        };
+
+        /**
+         * @struct CommandInfo
+         * @brief Static description of a command
+         *
+         * A positive arity is the exact argument count (including the command
+         * name); a negative arity means "at least -arity arguments". Keys sit
+         * at positions first_key, first_key + key_step, ... up to last_key,
+         * where a negative last_key counts from the end of the arguments. For
+         * commands that say how many keys follow (SINTERCARD numkeys ...),
+         * numkeys_index is the position of that count and takes the place of
+         * last_key.
+         */
+        struct CommandInfo
+        {
+            const char *name;
+            int arity;
+            KeyScope scope = KeyScope::NONE;
+            int first_key = 0;
+            int last_key = 0;
+            int key_step = 0;
+            ReplyMerge merge = ReplyMerge::NONE;
+            int numkeys_index = 0;
+
+            bool arity_matches(size_t argc) const;
+
+            /**
+             * @brief Position of the last key in `args`
+             * @return -1 if a numkeys argument is malformed or out of range
+             */
+            int last_key_index(const std::vector<std::string_view> &args) const;
+        };
+
+        /**
+         * @brief Finds a command by name, case-insensitively
+         * @return The command's description, or nullptr if it is unknown
+         */
+        const CommandInfo *lookup_command(std::string_view name);
+
+        /**
+         * @brief A byte count as INFO shows it next to the exact value
+         *        ("512B", "1.50M", ...)
+         */
+        std::string bytes_to_human(unsigned long long bytes);
+
+        /**
+         * @brief INFO's mem_fragmentation_ratio: resident over used bytes,
+         *        two decimals
+         */
+        std::string fragmentation_ratio(unsigned long long rss, unsigned long long used);
+
+        /**
+         * @class CommandExecutor
+         * @brief Looks up a command by name and runs it against a CacheManager
+         *
+         * Command names are matched case-insensitively. Errors (unknown command,
+         * wrong arity, WRONGTYPE, ...) are reported to the client as RESP error
+         * replies; the executor itself never throws.
+         */
+        class CommandExecutor
+        {
+        private:
+            storage::CacheManager &cache;
+
+        public:
+            explicit CommandExecutor(storage::CacheManager &cache);
+
+            /**
+             * @brief Executes one command and appends its reply
+             * @param args Command name followed by its arguments
+             * @param reply Writer receiving the encoded reply
+             * @return CLOSE if the client asked to disconnect, CONTINUE otherwise
+             */
+            CommandStatus execute(const std::vector<std::string_view> &args, ReplyWriter &reply);
+        };
+
+    }
+}
+
+#endif
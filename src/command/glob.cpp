@@ -0,0 +1,111 @@
+/**
+ * @file command/glob.cpp
+ * @brief Implementation of glob-style pattern matching
+ */
+
+#include "glob.hpp"
+
+#include <utility>
+
+namespace opus
+{
+    namespace command
+    {
+
+        namespace
+        {
+            // Matches one character against the class starting after '[' at
+            // pattern[p]; leaves p on the closing ']' (or the pattern's end).
+            bool match_class(std::string_view pattern, size_t &p, char c)
+            {
+                bool negate = p < pattern.size() && pattern[p] == '^';
+                if (negate)
+                    ++p;
+
+                bool matched = false;
+                while (p < pattern.size() && pattern[p] != ']')
+                {
+                    if (pattern[p] == '\\' && p + 1 < pattern.size())
+                    {
+                        ++p;
+                        matched |= pattern[p] == c;
+                    }
+                    else if (p + 2 < pattern.size() && pattern[p + 1] == '-' && pattern[p + 2] != ']')
+                    {
+                        char lo = pattern[p], hi = pattern[p + 2];
+                        if (lo > hi)
+                            std::swap(lo, hi);
+                        matched |= c >= lo && c <= hi;
+                        p += 2;
+                    }
+                    else
+                    {
+                        matched |= pattern[p] == c;
+                    }
+                    ++p;
+                }
+                return matched != negate;
+            }
+        }
+
+        bool glob_match(std::string_view pattern, std::string_view text)
+        {
+            size_t p = 0, t = 0;
+            size_t star = std::string_view::npos, star_text = 0;
+
+            while (t < text.size())
+            {
+                if (p < pattern.size())
+                {
+                    char pc = pattern[p];
+                    if (pc == '*')
+                    {
+                        star = p++;
+                        star_text = t;
+                        continue;
+                    }
+                    if (pc == '?')
+                    {
+                        ++p;
+                        ++t;
+                        continue;
+                    }
+                    if (pc == '[')
+                    {
+                        size_t q = p + 1;
+                        if (match_class(pattern, q, text[t]))
+                        {
+                            p = q < pattern.size() ? q + 1 : q;
+                            ++t;
+                            continue;
+                        }
+                    }
+                    else
+                    {
+                        if (pc == '\\' && p + 1 < pattern.size())
+                            pc = pattern[++p];
+                        if (pc == text[t])
+                        {
+                            ++p;
+                            ++t;
+                            continue;
+                        }
+                    }
+                }
+
+                // Mismatch: let the last star swallow one more character.
+                if (star == std::string_view::npos)
+                    return false;
+                p = star + 1;
+                t = ++star_text;
+            }
+
+            while (p < pattern.size() && pattern[p] == '*')
+            {
+                ++p;
+            }
+            return p == pattern.size();
+        }
+
+    }
+}
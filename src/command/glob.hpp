@@ -0,0 +1,28 @@
+/**
+ * @file command/glob.hpp
+ * @brief Glob-style pattern matching for the MATCH option of the SCAN family
+ */
+
+#ifndef OPUS_COMMAND_GLOB_HPP
+#define OPUS_COMMAND_GLOB_HPP
+
+#include <string_view>
+
+namespace opus
+{
+    namespace command
+    {
+
+        /**
+         * @brief Matches `text` against a Redis-style glob pattern
+         *
+         * Supports `*`, `?`, bracket classes (`[abc]`, `[^a-z]`) and `\`
+         * escapes. A `*` backtracks to only the most recent star, so matching
+         * stays linear in practice even for patterns like `*a*a*a*b`.
+         */
+        bool glob_match(std::string_view pattern, std::string_view text);
+
+    }
+}
+
+#endif
@@ -49,6 +49,161 @@ namespace opus
                 false // optional
             );
 
+            // Execution model
+            parser->add_option(
+                "--mode",
+                "Execution mode: 'single' (one event loop) or 'shared-nothing' (one loop and keyspace partition per core)",
+                OptionType::REQUIRED_VALUE,
+                false // optional, defaults to single
+            );
+
+            // Core count for shared-nothing mode
+            parser->add_option(
+                "--threads",
+                "Number of cores in shared-nothing mode. Defaults to the number of hardware threads",
+                OptionType::REQUIRED_VALUE,
+                false // optional
+            );
+
+            // Set encoding thresholds
+            parser->add_option(
+                "--set-max-intset-entries",
+                "Largest all-integer set kept as a sorted integer array. Defaults to 512",
+                OptionType::REQUIRED_VALUE,
+                false // optional
+            );
+
+            parser->add_option(
+                "--set-max-listpack-entries",
+                "Largest set kept as a packed buffer. Defaults to 128",
+                OptionType::REQUIRED_VALUE,
+                false // optional
+            );
+
+            parser->add_option(
+                "--set-max-listpack-value",
+                "Longest member (in bytes) allowed in a packed set. Defaults to 64",
+                OptionType::REQUIRED_VALUE,
+                false // optional
+            );
+
+            parser->add_option(
+                "--set-parallel-intersect-min",
+                "Smallest set size at which SINTER/SINTERCARD split the work across threads. Defaults to 0 (never)",
+                OptionType::REQUIRED_VALUE,
+                false // optional
+            );
+
+            // Hash encoding thresholds
+            parser->add_option(
+                "--hash-max-listpack-entries",
+                "Largest hash (in fields) kept as a packed buffer. Defaults to 128",
+                OptionType::REQUIRED_VALUE,
+                false // optional
+            );
+
+            parser->add_option(
+                "--hash-max-listpack-value",
+                "Longest field or value (in bytes) allowed in a packed hash. Defaults to 64",
+                OptionType::REQUIRED_VALUE,
+                false // optional
+            );
+
+            // Sorted set encoding thresholds
+            parser->add_option(
+                "--zset-max-listpack-entries",
+                "Largest sorted set (in members) kept as a packed buffer. Defaults to 128",
+                OptionType::REQUIRED_VALUE,
+                false // optional
+            );
+
+            parser->add_option(
+                "--zset-max-listpack-value",
+                "Longest member (in bytes) allowed in a packed sorted set. Defaults to 64",
+                OptionType::REQUIRED_VALUE,
+                false // optional
+            );
+
+            parser->add_option(
+                "--maxmemory",
+                "Memory limit for the keyspace, in bytes or with a kb/mb/gb suffix. Defaults to 0 (no limit)",
+                OptionType::REQUIRED_VALUE,
+                false // optional
+            );
+
+            parser->add_option(
+                "--maxmemory-policy",
+                "What to evict at the limit: noeviction, allkeys-lru, volatile-lru, allkeys-lfu, volatile-lfu, "
+                "allkeys-random or allkeys-tinylfu (LRU behind a W-TinyLFU admission filter). Defaults to noeviction",
+                OptionType::REQUIRED_VALUE,
+                false // optional
+            );
+
+            parser->add_option(
+                "--maxmemory-samples",
+                "Keys sampled per eviction; more is closer to true LRU but slower. Defaults to 5",
+                OptionType::REQUIRED_VALUE,
+                false // optional
+            );
+
+            parser->add_option(
+                "--lfu-log-factor",
+                "Accesses needed per step of the LFU counter grow with this factor. Defaults to 10",
+                OptionType::REQUIRED_VALUE,
+                false // optional
+            );
+
+            parser->add_option(
+                "--lfu-decay-time",
+                "Idle minutes after which the LFU counter drops by one; 0 never decays. Defaults to 1",
+                OptionType::REQUIRED_VALUE,
+                false // optional
+            );
+
+            parser->add_option(
+                "--allocator",
+                "Allocator for keys and values: slab (size-class pages) or libc (plain malloc). Defaults to slab",
+                OptionType::REQUIRED_VALUE,
+                false // optional
+            );
+
+            parser->add_option(
+                "--slab-huge-pages",
+                "Back slab pages with transparent huge pages: fewer TLB misses, but emptied pages stay resident",
+                OptionType::FLAG,
+                false // optional
+            );
+
+            parser->add_option(
+                "--activedefrag",
+                "Move keys and values out of sparsely used slab pages in the background, so freed memory "
+                "can go back to the kernel",
+                OptionType::FLAG,
+                false // optional
+            );
+
+            parser->add_option(
+                "--active-defrag-threshold",
+                "Percent by which slab pages in use may exceed live data before defragmentation starts. Defaults to 10",
+                OptionType::REQUIRED_VALUE,
+                false // optional
+            );
+
+            parser->add_option(
+                "--active-defrag-ignore-bytes",
+                "Wasted slab memory, in bytes or with a kb/mb/gb suffix, below which defragmentation never starts. "
+                "Defaults to 100mb",
+                OptionType::REQUIRED_VALUE,
+                false // optional
+            );
+
+            parser->add_option(
+                "--active-defrag-cpu",
+                "Percent of the event loop's time a running defragmentation may take, 1 to 100. Defaults to 10",
+                OptionType::REQUIRED_VALUE,
+                false // optional
+            );
+
             // Verbose output flag
             parser->add_option(
                 "--verbose",
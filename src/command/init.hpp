@@ -24,6 +24,7 @@ namespace opus
          * - Login username (-U)
          * - Registration username (-nU)
          * - Port number (-p)
+         * - Execution mode (--mode) and core count (--threads)
          * - Verbose flag (--verbose)
          */
         std::unique_ptr<CommandParser> initialize_parser();
@@ -0,0 +1,263 @@
+/**
+ * @file command/reply.cpp
+ * @brief Implementation of RESP reply encoding
+ */
+
+#include "reply.hpp"
+
+#include <charconv>
+#include <cstring>
+
+namespace opus
+{
+    namespace command
+    {
+
+        namespace
+        {
+            // Appends "<prefix><number>\r\n" without going through iostreams.
+            void append_number_line(ReplyBuffer &out, char prefix, long long value)
+            {
+                char buf[32];
+                buf[0] = prefix;
+                auto [end, ec] = std::to_chars(buf + 1, buf + sizeof(buf) - 2, value);
+                (void)ec;
+                *end++ = '\r';
+                *end++ = '\n';
+                out.append(buf, end - buf);
+            }
+        }
+
+        ReplyBuffer::Chunk &ReplyBuffer::tailWithRoom(size_t n)
+        {
+            if (!chunks.empty() && chunks.back().capacity - chunks.back().used >= n)
+                return chunks.back();
+
+            // Reuse the last drained chunk when it is big enough; oversized
+            // appends get a dedicated chunk, and the bytes between two pinned
+            // values a small one.
+            bool after_pinned = !chunks.empty() && chunks.back().external;
+            if (spare.data && spare.capacity >= n && !after_pinned)
+            {
+                chunks.push_back(std::move(spare));
+                spare = Chunk();
+            }
+            else
+            {
+                Chunk chunk;
+                size_t size = after_pinned ? PINNED_TAIL_SIZE : CHUNK_SIZE;
+                chunk.capacity = n > size ? n : size;
+                chunk.data.reset(new char[chunk.capacity]);
+                chunks.push_back(std::move(chunk));
+            }
+            return chunks.back();
+        }
+
+        void ReplyBuffer::append(const char *data, size_t len)
+        {
+            if (len == 0)
+                return;
+
+            // Fill the current tail first so small replies share chunks.
+            if (!chunks.empty() && !chunks.back().external)
+            {
+                Chunk &tail = chunks.back();
+                size_t room = tail.capacity - tail.used;
+                size_t n = room < len ? room : len;
+                std::memcpy(tail.data.get() + tail.used, data, n);
+                tail.used += n;
+                total += n;
+                data += n;
+                len -= n;
+                if (len == 0)
+                    return;
+            }
+
+            Chunk &tail = tailWithRoom(len);
+            std::memcpy(tail.data.get() + tail.used, data, len);
+            tail.used += len;
+            total += len;
+        }
+
+        void ReplyBuffer::append_pinned(std::string_view bytes, std::shared_ptr<const void> owner)
+        {
+            if (bytes.empty())
+                return;
+            Chunk chunk;
+            chunk.capacity = chunk.used = bytes.size();
+            chunk.external = bytes.data();
+            chunk.owner = std::move(owner);
+            chunks.push_back(std::move(chunk));
+            total += bytes.size();
+        }
+
+        int ReplyBuffer::gather(iovec *iov, int max) const
+        {
+            int count = 0;
+            for (size_t i = head; i < chunks.size() && count < max; ++i)
+            {
+                size_t skip = i == head ? head_offset : 0;
+                if (chunks[i].used == skip)
+                    continue;
+                iov[count].iov_base = const_cast<char *>(chunks[i].bytes()) + skip;
+                iov[count].iov_len = chunks[i].used - skip;
+                ++count;
+            }
+            return count;
+        }
+
+        void ReplyBuffer::consume(size_t n)
+        {
+            total -= n;
+            while (n > 0)
+            {
+                size_t available = chunks[head].used - head_offset;
+                if (n < available)
+                {
+                    head_offset += n;
+                    return;
+                }
+                n -= available;
+                ++head;
+                head_offset = 0;
+            }
+
+            if (total == 0)
+            {
+                clear();
+            }
+            else if (head * 2 >= chunks.size())
+            {
+                // A client that never fully drains must not keep sent chunks
+                // alive; drop them once they make up half the chain.
+                chunks.erase(chunks.begin(), chunks.begin() + head);
+                head = 0;
+            }
+        }
+
+        void ReplyBuffer::clear()
+        {
+            for (auto &chunk : chunks)
+            {
+                if (chunk.data && chunk.capacity == CHUNK_SIZE && !spare.data)
+                {
+                    chunk.used = 0;
+                    spare = std::move(chunk);
+                }
+            }
+            chunks.clear();
+            head = 0;
+            head_offset = 0;
+            total = 0;
+        }
+
+        std::string ReplyBuffer::take()
+        {
+            std::string result;
+            result.reserve(total);
+            for (size_t i = head; i < chunks.size(); ++i)
+            {
+                size_t skip = i == head ? head_offset : 0;
+                result.append(chunks[i].bytes() + skip, chunks[i].used - skip);
+            }
+            clear();
+            return result;
+        }
+
+        ReplyWriter::ReplyWriter(ReplyBuffer &buffer) : out(buffer) {}
+
+        void ReplyWriter::add_simple_string(std::string_view str)
+        {
+            out.push_back('+');
+            out.append(str);
+            out.append("\r\n", 2);
+        }
+
+        void ReplyWriter::add_error(std::string_view message)
+        {
+            out.push_back('-');
+            out.append(message);
+            out.append("\r\n", 2);
+        }
+
+        void ReplyWriter::add_integer(long long value)
+        {
+            append_number_line(out, ':', value);
+        }
+
+        void ReplyWriter::add_bulk_string(std::string_view str)
+        {
+            append_number_line(out, '$', static_cast<long long>(str.size()));
+            out.append(str);
+            out.append("\r\n", 2);
+        }
+
+        void ReplyWriter::add_bulk_string(std::string_view str, std::shared_ptr<const void> owner)
+        {
+            append_number_line(out, '$', static_cast<long long>(str.size()));
+            out.append_pinned(str, std::move(owner));
+            out.append("\r\n", 2);
+        }
+
+        void ReplyWriter::add_double(double value)
+        {
+            // Shortest text that reads back as the same double; to_chars
+            // already spells infinities "inf" and "-inf" as RESP expects.
+            char buf[32];
+            auto end = std::to_chars(buf, buf + sizeof(buf), value).ptr;
+            std::string_view text(buf, static_cast<size_t>(end - buf));
+            if (protocol_version >= 3)
+            {
+                out.append(",", 1);
+                out.append(text);
+                out.append("\r\n", 2);
+            }
+            else
+            {
+                add_bulk_string(text);
+            }
+        }
+
+        void ReplyWriter::add_null()
+        {
+            if (protocol_version >= 3)
+                out.append("_\r\n", 3);
+            else
+                out.append("$-1\r\n", 5);
+        }
+
+        void ReplyWriter::add_array(size_t count)
+        {
+            append_number_line(out, '*', static_cast<long long>(count));
+        }
+
+        void ReplyWriter::add_null_array()
+        {
+            if (protocol_version >= 3)
+                out.append("_\r\n", 3);
+            else
+                out.append("*-1\r\n", 5);
+        }
+
+        void ReplyWriter::add_map(size_t count)
+        {
+            if (protocol_version >= 3)
+                append_number_line(out, '%', static_cast<long long>(count));
+            else
+                append_number_line(out, '*', static_cast<long long>(count * 2));
+        }
+
+        void ReplyWriter::add_stream(std::unique_ptr<ReplyStream> rest)
+        {
+            if (streaming)
+            {
+                stream = std::move(rest);
+                return;
+            }
+            while (rest->resume(*this))
+            {
+            }
+        }
+
+    }
+}
@@ -0,0 +1,197 @@
+/**
+ * @file command/reply.hpp
+ * @brief RESP reply encoding
+ */
+
+#ifndef OPUS_COMMAND_REPLY_HPP
+#define OPUS_COMMAND_REPLY_HPP
+
+#include <cstddef>
+#include <memory>
+#include <string>
+#include <string_view>
+#include <sys/uio.h>
+#include <vector>
+
+namespace opus
+{
+    namespace command
+    {
+
+        /**
+         * @class ReplyBuffer
+         * @brief Chain of fixed-size chunks holding encoded replies
+         *
+         * Replies for a whole pipeline are appended here and later handed to
+         * the kernel in one writev/sendmsg via gather(). Appending never moves
+         * bytes that were already written, unlike a growing std::string, and a
+         * drained chunk is kept for reuse so steady-state traffic does not
+         * allocate.
+         *
+         * Large values can be appended by reference instead (append_pinned):
+         * the chain then points at the value's own bytes, which go to the
+         * kernel from where they are, and holds a handle that keeps them
+         * alive until they have been sent.
+         */
+        class ReplyBuffer
+        {
+        private:
+            struct Chunk
+            {
+                std::unique_ptr<char[]> data;
+                size_t capacity = 0;
+                size_t used = 0;
+
+                // Set for pinned bytes, which are full from the start.
+                const char *external = nullptr;
+                std::shared_ptr<const void> owner;
+
+                const char *bytes() const { return external ? external : data.get(); }
+            };
+
+            std::vector<Chunk> chunks;
+            size_t head = 0;        // First chunk holding unsent bytes
+            size_t head_offset = 0; // Bytes of chunks[head] already sent
+            size_t total = 0;       // Unsent bytes across the chain
+            Chunk spare;
+
+            Chunk &tailWithRoom(size_t n);
+
+        public:
+            static constexpr size_t CHUNK_SIZE = 16 * 1024;
+
+            // Values at least this long are worth pinning rather than copying.
+            static constexpr size_t MIN_PINNED_SIZE = 4 * 1024;
+
+            // Chunk allocated for what follows pinned bytes; usually just the
+            // end of that reply and the start of the next.
+            static constexpr size_t PINNED_TAIL_SIZE = 1024;
+
+            void append(const char *data, size_t len);
+            void append(std::string_view str) { append(str.data(), str.size()); }
+            void push_back(char c) { append(&c, 1); }
+
+            /**
+             * @brief Appends `bytes` without copying them; `owner` must keep
+             *        them unchanged for as long as it lives
+             */
+            void append_pinned(std::string_view bytes, std::shared_ptr<const void> owner);
+
+            size_t size() const { return total; }
+            bool empty() const { return total == 0; }
+
+            /**
+             * @brief Fills up to `max` iovecs describing the unsent bytes
+             * @return Number of iovecs filled
+             */
+            int gather(iovec *iov, int max) const;
+
+            /**
+             * @brief Drops `n` bytes from the front after they were written
+             */
+            void consume(size_t n);
+
+            void clear();
+
+            /**
+             * @brief Returns the unsent bytes as one string and empties the buffer
+             */
+            std::string take();
+        };
+
+        class ReplyWriter;
+
+        /**
+         * @class ReplyStream
+         * @brief The rest of a reply too long to write in one go
+         *
+         * A command replying with a large collection writes the first part
+         * and leaves the remainder here; the connection resumes it a slice at
+         * a time between other clients' commands, so neither the whole reply
+         * nor the wait for it has to happen at once.
+         */
+        class ReplyStream
+        {
+        public:
+            virtual ~ReplyStream() = default;
+
+            /**
+             * @brief Appends the next part of the reply
+             * @return false once the reply is complete
+             */
+            virtual bool resume(ReplyWriter &reply) = 0;
+        };
+
+        /**
+         * @class ReplyWriter
+         * @brief Appends RESP-encoded replies to a connection's output buffer
+         *
+         * The writer does not own the buffer; it only appends to it, so several
+         * replies can be accumulated before the connection flushes. Replies are
+         * RESP2 until the client switches with HELLO 3, after which nulls and
+         * maps use their native RESP3 encodings.
+         */
+        class ReplyWriter
+        {
+        private:
+            ReplyBuffer &out;
+            int protocol_version = 2;
+            bool streaming = false;
+            std::unique_ptr<ReplyStream> stream;
+
+        public:
+            explicit ReplyWriter(ReplyBuffer &buffer);
+
+            int protocol() const { return protocol_version; }
+            void set_protocol(int version) { protocol_version = version; }
+
+            void add_simple_string(std::string_view str);
+            void add_error(std::string_view message);
+            void add_integer(long long value);
+            void add_bulk_string(std::string_view str);
+
+            /**
+             * @brief A bulk string sent straight from `str`, which `owner`
+             *        keeps alive; see ReplyBuffer::append_pinned()
+             */
+            void add_bulk_string(std::string_view str, std::shared_ptr<const void> owner);
+
+            /**
+             * @brief A RESP3 double, or its text as a bulk string for RESP2
+             */
+            void add_double(double value);
+            void add_null();
+            void add_array(size_t count);
+            void add_null_array();
+
+            /**
+             * @brief Starts a map of `count` key/value pairs
+             *
+             * RESP2 clients receive a flat array of 2 * count elements.
+             */
+            void add_map(size_t count);
+
+            /**
+             * @brief Appends bytes that are already RESP-encoded
+             */
+            void add_raw(std::string_view encoded) { out.append(encoded); }
+
+            /**
+             * @brief Lets a reply end in a ReplyStream that the owner resumes
+             *        later; only a connection's own writer does
+             */
+            void set_streaming(bool allowed) { streaming = allowed; }
+
+            /**
+             * @brief Ends the current reply with `rest`: kept for take_stream()
+             *        if streaming is allowed, written out in full otherwise
+             */
+            void add_stream(std::unique_ptr<ReplyStream> rest);
+
+            std::unique_ptr<ReplyStream> take_stream() { return std::move(stream); }
+        };
+
+    }
+}
+
+#endif
@@ -0,0 +1,232 @@
+/**
+ * @file command/resp_parser.cpp
+ * @brief Implementation of the incremental RESP request parser
+ */
+
+#include "resp_parser.hpp"
+
+#include <cstring>
+
+namespace opus
+{
+    namespace command
+    {
+
+        namespace
+        {
+            // Same limits as Redis: 1M arguments, 512MB per argument and 64KB
+            // for inline requests or count lines.
+            constexpr long long MAX_MULTIBULK_LEN = 1024 * 1024;
+            constexpr long long MAX_BULK_LEN = 512LL * 1024 * 1024;
+            constexpr size_t MAX_LINE_LEN = 64 * 1024;
+
+            // Parses a non-negative decimal (or -1 style negatives) from
+            // [begin, end); returns false on anything else.
+            bool parse_length(const char *begin, const char *end, long long &out)
+            {
+                if (begin == end)
+                    return false;
+
+                bool negative = false;
+                if (*begin == '-')
+                {
+                    negative = true;
+                    if (++begin == end)
+                        return false;
+                }
+
+                long long value = 0;
+                for (const char *p = begin; p < end; ++p)
+                {
+                    if (*p < '0' || *p > '9' || value > MAX_BULK_LEN)
+                        return false;
+                    value = value * 10 + (*p - '0');
+                }
+                out = negative ? -value : value;
+                return true;
+            }
+        }
+
+        void RespParser::reset()
+        {
+            stage = Stage::START;
+            pos = 0;
+            scan_pos = 0;
+            remaining = 0;
+            bulk_len = 0;
+            spans.clear();
+            error_message = nullptr;
+        }
+
+        ParseStatus RespParser::fail(const char *message)
+        {
+            error_message = message;
+            return ParseStatus::ERROR;
+        }
+
+        bool RespParser::findLineEnd(std::string_view data, size_t &line_end)
+        {
+            if (scan_pos < pos)
+                scan_pos = pos;
+
+            const void *cr = scan_pos < data.size()
+                                 ? std::memchr(data.data() + scan_pos, '\r', data.size() - scan_pos)
+                                 : nullptr;
+            if (!cr)
+            {
+                scan_pos = data.size();
+                return false;
+            }
+
+            line_end = static_cast<const char *>(cr) - data.data();
+            if (line_end + 1 >= data.size())
+            {
+                // Keep the '\r' in view until its '\n' arrives.
+                scan_pos = line_end;
+                return false;
+            }
+            return true;
+        }
+
+        size_t RespParser::bytesNeeded(size_t available) const
+        {
+            if (stage != Stage::BULK_DATA)
+                return 0;
+            size_t needed = pos + static_cast<size_t>(bulk_len) + 2;
+            return needed > available ? needed - available : 0;
+        }
+
+        ParseStatus RespParser::parse(std::string_view data, std::vector<std::string_view> &args)
+        {
+            if (stage == Stage::START)
+            {
+                if (data.empty())
+                    return ParseStatus::INCOMPLETE;
+
+                spans.clear();
+                if (data[0] == '*')
+                {
+                    stage = Stage::MULTIBULK_LEN;
+                    pos = 1;
+                }
+                else
+                {
+                    stage = Stage::INLINE;
+                    pos = 0;
+                }
+                scan_pos = pos;
+            }
+
+            if (stage == Stage::INLINE)
+                return parseInline(data, args);
+
+            if (stage == Stage::MULTIBULK_LEN)
+            {
+                size_t line_end;
+                if (!findLineEnd(data, line_end))
+                {
+                    if (data.size() - pos > MAX_LINE_LEN)
+                        return fail("ERR Protocol error: too big mbulk count string");
+                    return ParseStatus::INCOMPLETE;
+                }
+
+                long long count;
+                if (!parse_length(data.data() + pos, data.data() + line_end, count) || count > MAX_MULTIBULK_LEN)
+                    return fail("ERR Protocol error: invalid multibulk length");
+
+                pos = line_end + 2;
+                remaining = count > 0 ? count : 0;
+                stage = Stage::BULK_LEN;
+            }
+
+            while (remaining > 0)
+            {
+                if (stage == Stage::BULK_LEN)
+                {
+                    if (pos >= data.size())
+                        return ParseStatus::INCOMPLETE;
+                    if (data[pos] != '$')
+                        return fail("ERR Protocol error: expected '$'");
+
+                    size_t line_end;
+                    if (!findLineEnd(data, line_end))
+                    {
+                        if (data.size() - pos > MAX_LINE_LEN)
+                            return fail("ERR Protocol error: too big bulk count string");
+                        return ParseStatus::INCOMPLETE;
+                    }
+
+                    if (!parse_length(data.data() + pos + 1, data.data() + line_end, bulk_len) ||
+                        bulk_len < 0 || bulk_len > MAX_BULK_LEN)
+                        return fail("ERR Protocol error: invalid bulk length");
+
+                    pos = line_end + 2;
+                    stage = Stage::BULK_DATA;
+                }
+
+                size_t length = static_cast<size_t>(bulk_len);
+                if (data.size() < pos + length + 2)
+                    return ParseStatus::INCOMPLETE;
+                if (data[pos + length] != '\r' || data[pos + length + 1] != '\n')
+                    return fail("ERR Protocol error: bulk string not terminated by CRLF");
+
+                spans.push_back({pos, length});
+                pos += length + 2;
+                --remaining;
+                stage = Stage::BULK_LEN;
+            }
+
+            return finish(data, args);
+        }
+
+        ParseStatus RespParser::parseInline(std::string_view data, std::vector<std::string_view> &args)
+        {
+            const void *nl = scan_pos < data.size()
+                                 ? std::memchr(data.data() + scan_pos, '\n', data.size() - scan_pos)
+                                 : nullptr;
+            if (!nl)
+            {
+                scan_pos = data.size();
+                if (data.size() > MAX_LINE_LEN)
+                    return fail("ERR Protocol error: too big inline request");
+                return ParseStatus::INCOMPLETE;
+            }
+
+            size_t newline = static_cast<const char *>(nl) - data.data();
+            size_t line_end = newline;
+            if (line_end > 0 && data[line_end - 1] == '\r')
+                --line_end;
+
+            size_t i = 0;
+            while (i < line_end)
+            {
+                while (i < line_end && (data[i] == ' ' || data[i] == '\t'))
+                    ++i;
+                size_t start = i;
+                while (i < line_end && data[i] != ' ' && data[i] != '\t')
+                    ++i;
+                if (i > start)
+                    spans.push_back({start, i - start});
+            }
+
+            pos = newline + 1;
+            return finish(data, args);
+        }
+
+        ParseStatus RespParser::finish(std::string_view data, std::vector<std::string_view> &args)
+        {
+            args.clear();
+            for (const auto &span : spans)
+            {
+                args.emplace_back(data.data() + span.offset, span.length);
+            }
+
+            consumed_bytes = pos;
+            stage = Stage::START;
+            pos = 0;
+            scan_pos = 0;
+            return ParseStatus::COMPLETE;
+        }
+
+    }
+}
@@ -0,0 +1,110 @@
+/**
+ * @file command/resp_parser.hpp
+ * @brief Incremental RESP request parser
+ */
+
+#ifndef OPUS_COMMAND_RESP_PARSER_HPP
+#define OPUS_COMMAND_RESP_PARSER_HPP
+
+#include <cstddef>
+#include <string_view>
+#include <vector>
+
+namespace opus
+{
+    namespace command
+    {
+
+        /**
+         * @enum ParseStatus
+         * @brief Outcome of one RespParser::parse call
+         */
+        enum class ParseStatus
+        {
+            COMPLETE,   // A full command was parsed into the argument vector
+            INCOMPLETE, // More bytes are needed; call again once they arrive
+            ERROR       // The stream is malformed; see RespParser::error()
+        };
+
+        /**
+         * @class RespParser
+         * @brief Parses client requests (RESP multibulk or inline) out of a
+         * connection's read buffer without copying arguments
+         *
+         * Requests are identical for RESP2 and RESP3 clients; the protocol
+         * version only affects replies (see ReplyWriter). The parser keeps its
+         * position between calls, so a request split across several reads is
+         * never scanned twice. Argument positions are stored as offsets from
+         * the start of the pending request, which keeps them valid when the
+         * caller compacts or grows its buffer between calls. Offsets live in a
+         * reused vector, so steady-state parsing does not allocate.
+         */
+        class RespParser
+        {
+        private:
+            enum class Stage
+            {
+                START,
+                INLINE,
+                MULTIBULK_LEN,
+                BULK_LEN,
+                BULK_DATA
+            };
+
+            struct ArgSpan
+            {
+                size_t offset;
+                size_t length;
+            };
+
+            Stage stage = Stage::START;
+            size_t pos = 0;       // Parsed bytes of the pending request
+            size_t scan_pos = 0;  // Where the search for the next CRLF resumes
+            long long remaining = 0;
+            long long bulk_len = 0;
+            size_t consumed_bytes = 0;
+            std::vector<ArgSpan> spans;
+            const char *error_message = nullptr;
+
+            bool findLineEnd(std::string_view data, size_t &line_end);
+            ParseStatus fail(const char *message);
+            ParseStatus parseInline(std::string_view data, std::vector<std::string_view> &args);
+            ParseStatus finish(std::string_view data, std::vector<std::string_view> &args);
+
+        public:
+            /**
+             * @brief Tries to parse one request from the start of `data`
+             * @param data Unconsumed bytes; must start where the previous
+             *        COMPLETE request ended and only grow between calls
+             * @param args Receives views into `data` on COMPLETE
+             *
+             * After COMPLETE the caller drops consumed() bytes from its buffer.
+             * An empty argument vector (blank line, "*0") is a valid no-op.
+             */
+            ParseStatus parse(std::string_view data, std::vector<std::string_view> &args);
+
+            /**
+             * @brief Length of the request returned by the last COMPLETE parse
+             */
+            size_t consumed() const { return consumed_bytes; }
+
+            /**
+             * @brief Bytes still missing from the bulk string being read, or 0
+             *
+             * Lets the caller size its next read so large values arrive in one
+             * buffer growth instead of repeated doubling.
+             */
+            size_t bytesNeeded(size_t available) const;
+
+            /**
+             * @brief Description of the last ERROR, suitable for a RESP error reply
+             */
+            const char *error() const { return error_message; }
+
+            void reset();
+        };
+
+    }
+}
+
+#endif
@@ -1,9 +1,76 @@
 #include <iostream>
 #include <string>
 #include <memory>
+#include <cctype>
+#include <charconv>
+#include <csignal>
+#include <cstdint>
+#include <optional>
+#include <thread>
+#include <utility>
 #include "authentication/authentication.hpp"
 #include "command/parser.hpp"
 #include "command/init.hpp"
+#include "server/core_group.hpp"
+#include "server/server.hpp"
+#include "storage/manager.hpp"
+#include "storage/slab_allocator.hpp"
+
+namespace
+{
+    opus::server::Server *running_server = nullptr;
+    opus::server::CoreGroup *running_group = nullptr;
+
+    void handle_shutdown_signal(int)
+    {
+        if (running_server)
+        {
+            running_server->stop();
+        }
+        if (running_group)
+        {
+            running_group->stop();
+        }
+    }
+
+    /**
+     * @brief Parses a size such as "100mb" the way Redis does: k/m/g are
+     * powers of 1000, kb/mb/gb powers of 1024, no suffix means bytes
+     */
+    std::optional<size_t> parse_memory_size(const std::string &text)
+    {
+        size_t bytes = 0;
+        auto [ptr, ec] = std::from_chars(text.data(), text.data() + text.size(), bytes);
+        if (ec != std::errc() || ptr == text.data())
+            return std::nullopt;
+
+        std::string unit(ptr, text.data() + text.size());
+        for (auto &c : unit)
+        {
+            c = static_cast<char>(std::tolower(static_cast<unsigned char>(c)));
+        }
+        static const std::pair<const char *, size_t> units[] = {
+            {"", 1},
+            {"b", 1},
+            {"k", 1000},
+            {"kb", 1024},
+            {"m", 1000 * 1000},
+            {"mb", 1024 * 1024},
+            {"g", 1000 * 1000 * 1000},
+            {"gb", 1024 * 1024 * 1024},
+        };
+        for (const auto &[name, scale] : units)
+        {
+            if (unit == name)
+            {
+                if (bytes > SIZE_MAX / scale)
+                    return std::nullopt;
+                return bytes * scale;
+            }
+        }
+        return std::nullopt;
+    }
+}
 
 /**
  * @brief Handles user registration flow
@@ -157,6 +224,162 @@ int main(int argc, char *argv[])
             }
         }
 
+        std::string mode = parser->get("--mode").value_or("single");
+        if (mode != "single" && mode != "shared-nothing")
+        {
+            std::cerr << "Error: Mode must be 'single' or 'shared-nothing'\n";
+            return 1;
+        }
+
+        int threads = static_cast<int>(std::thread::hardware_concurrency());
+        if (auto threads_opt = parser->get_as<int>("--threads"))
+        {
+            threads = threads_opt.value();
+            if (threads < 1 || threads > 1024)
+            {
+                std::cerr << "Error: Threads must be between 1 and 1024\n";
+                return 1;
+            }
+        }
+        if (threads < 1)
+        {
+            threads = 1;
+        }
+
+        opus::storage::SetType::Limits set_limits;
+        opus::storage::HashType::Limits hash_limits;
+        opus::storage::SortedSetType::Limits zset_limits;
+        const std::pair<const char *, size_t *> encoding_options[] = {
+            {"--set-max-intset-entries", &set_limits.max_intset_entries},
+            {"--set-max-listpack-entries", &set_limits.max_listpack_entries},
+            {"--set-max-listpack-value", &set_limits.max_listpack_value},
+            {"--set-parallel-intersect-min", &set_limits.parallel_intersect_min},
+            {"--hash-max-listpack-entries", &hash_limits.max_listpack_entries},
+            {"--hash-max-listpack-value", &hash_limits.max_listpack_value},
+            {"--zset-max-listpack-entries", &zset_limits.max_listpack_entries},
+            {"--zset-max-listpack-value", &zset_limits.max_listpack_value},
+        };
+        for (const auto &[name, limit] : encoding_options)
+        {
+            if (auto value = parser->get_as<int>(name))
+            {
+                if (*value < 0)
+                {
+                    std::cerr << "Error: " << name << " must not be negative\n";
+                    return 1;
+                }
+                *limit = static_cast<size_t>(*value);
+            }
+        }
+        opus::storage::SetType::setLimits(set_limits);
+        opus::storage::HashType::setLimits(hash_limits);
+        opus::storage::SortedSetType::setLimits(zset_limits);
+
+        size_t max_memory = 0;
+        if (auto value = parser->get("--maxmemory"))
+        {
+            auto bytes = parse_memory_size(*value);
+            if (!bytes)
+            {
+                std::cerr << "Error: --maxmemory must be a size such as 1073741824, 512mb or 4gb\n";
+                return 1;
+            }
+            max_memory = *bytes;
+        }
+
+        auto eviction_policy = opus::storage::EvictionPolicy::NO_EVICTION;
+        if (auto value = parser->get("--maxmemory-policy"))
+        {
+            auto policy = opus::storage::parseEvictionPolicy(*value);
+            if (!policy)
+            {
+                std::cerr << "Error: --maxmemory-policy must be noeviction, allkeys-lru, volatile-lru, allkeys-lfu, "
+                             "volatile-lfu, allkeys-random or allkeys-tinylfu\n";
+                return 1;
+            }
+            eviction_policy = *policy;
+        }
+
+        size_t eviction_samples = opus::storage::CacheManager::DEFAULT_EVICTION_SAMPLES;
+        if (auto value = parser->get_as<int>("--maxmemory-samples"))
+        {
+            if (*value < 1 || *value > 64)
+            {
+                std::cerr << "Error: --maxmemory-samples must be between 1 and 64\n";
+                return 1;
+            }
+            eviction_samples = static_cast<size_t>(*value);
+        }
+
+        unsigned lfu_log_factor = opus::storage::CacheManager::DEFAULT_LFU_LOG_FACTOR;
+        unsigned lfu_decay_time = opus::storage::CacheManager::DEFAULT_LFU_DECAY_TIME;
+        const std::pair<const char *, unsigned *> lfu_options[] = {
+            {"--lfu-log-factor", &lfu_log_factor},
+            {"--lfu-decay-time", &lfu_decay_time},
+        };
+        for (const auto &[name, setting] : lfu_options)
+        {
+            if (auto value = parser->get_as<int>(name))
+            {
+                if (*value < 0)
+                {
+                    std::cerr << "Error: " << name << " must not be negative\n";
+                    return 1;
+                }
+                *setting = static_cast<unsigned>(*value);
+            }
+        }
+
+        std::string allocator = parser->get("--allocator").value_or("slab");
+        if (allocator != "slab" && allocator != "libc")
+        {
+            std::cerr << "Error: --allocator must be 'slab' or 'libc'\n";
+            return 1;
+        }
+        if (parser->has("--slab-huge-pages") && allocator != "slab")
+        {
+            std::cerr << "Error: --slab-huge-pages needs --allocator slab\n";
+            return 1;
+        }
+        // Before any key exists: blocks go back to the allocator they came from.
+        opus::storage::SlabAllocator::configure(allocator == "slab", parser->has("--slab-huge-pages"));
+
+        opus::storage::DefragConfig defrag;
+        defrag.enabled = parser->has("--activedefrag");
+        if (defrag.enabled && allocator != "slab")
+        {
+            std::cerr << "Error: --activedefrag needs --allocator slab\n";
+            return 1;
+        }
+        if (auto value = parser->get_as<int>("--active-defrag-threshold"))
+        {
+            if (*value < 0)
+            {
+                std::cerr << "Error: --active-defrag-threshold must not be negative\n";
+                return 1;
+            }
+            defrag.threshold_percent = static_cast<unsigned>(*value);
+        }
+        if (auto value = parser->get("--active-defrag-ignore-bytes"))
+        {
+            auto bytes = parse_memory_size(*value);
+            if (!bytes)
+            {
+                std::cerr << "Error: --active-defrag-ignore-bytes must be a size such as 104857600 or 100mb\n";
+                return 1;
+            }
+            defrag.ignore_bytes = *bytes;
+        }
+        if (auto value = parser->get_as<int>("--active-defrag-cpu"))
+        {
+            if (*value < 1 || *value > 100)
+            {
+                std::cerr << "Error: --active-defrag-cpu must be between 1 and 100\n";
+                return 1;
+            }
+            defrag.cpu_percent = static_cast<unsigned>(*value);
+        }
+
         bool verbose = parser->has("--verbose");
 
         // Display configuration if verbose
@@ -167,6 +390,12 @@ int main(int argc, char *argv[])
             std::cout << "Port: " << port << "\n";
             std::cout << "Username: " << username << "\n";
             std::cout << "Mode: " << (is_registration ? "Registration" : "Login") << "\n";
+            std::cout << "Execution: " << mode;
+            if (mode == "shared-nothing")
+            {
+                std::cout << " (" << threads << " cores)";
+            }
+            std::cout << "\n";
             std::cout << "================================\n\n";
         }
 
@@ -192,19 +421,39 @@ int main(int argc, char *argv[])
 
         // Start the server/application
         std::cout << "\n🚀 Opus in-memory cache system starting...\n";
-        std::cout << "Connected to " << host << ":" << port << "\n\n";
 
-        // TODO: Start server logic here
-        while (true)
+        std::signal(SIGPIPE, SIG_IGN);
+        std::signal(SIGINT, handle_shutdown_signal);
+        std::signal(SIGTERM, handle_shutdown_signal);
+
+        if (mode == "shared-nothing")
         {
-            std::string query;
-            std::cout << "opus > ";
-            std::getline(std::cin, query);
-            if (query == "quit")
-            {
-                return 0;
-            }
+            opus::server::CoreGroup group(host, port, static_cast<size_t>(threads));
+            group.setMaxMemory(max_memory, eviction_policy, eviction_samples);
+            group.setLfuTuning(lfu_log_factor, lfu_decay_time);
+            group.setActiveDefrag(defrag);
+            running_group = &group;
+
+            std::cout << "Listening on " << host << ":" << port << " with " << threads << " cores\n\n";
+            group.run();
+            running_group = nullptr;
         }
+        else
+        {
+            // Only the event loop thread touches the keyspace: no locking.
+            opus::storage::CacheManager cache(1, false);
+            cache.setMaxMemory(max_memory, eviction_policy, eviction_samples);
+            cache.setLfuTuning(lfu_log_factor, lfu_decay_time);
+            cache.setActiveDefrag(defrag);
+            opus::server::Server server(host, port, cache);
+            running_server = &server;
+
+            std::cout << "Listening on " << host << ":" << port << "\n\n";
+            server.run();
+            running_server = nullptr;
+        }
+
+        std::cout << "\nOpus shutting down\n";
 
         return 0;
     }
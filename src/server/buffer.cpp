@@ -0,0 +1,51 @@
+/**
+ * @file server/buffer.cpp
+ * @brief Implementation of the connection byte buffer
+ */
+
+#include "buffer.hpp"
+
+#include <cstring>
+
+namespace opus
+{
+    namespace server
+    {
+
+        Buffer::Buffer(size_t initial_capacity) : data(initial_capacity) {}
+
+        void Buffer::ensureWritable(size_t n)
+        {
+            if (writable() >= n)
+                return;
+
+            size_t unread = readable();
+            if (read_pos > 0)
+            {
+                std::memmove(data.data(), data.data() + read_pos, unread);
+                read_pos = 0;
+                write_pos = unread;
+            }
+
+            if (writable() < n)
+            {
+                size_t capacity = data.size() * 2;
+                while (capacity - write_pos < n)
+                {
+                    capacity *= 2;
+                }
+                data.resize(capacity);
+            }
+        }
+
+        void Buffer::consume(size_t n)
+        {
+            read_pos += n;
+            if (read_pos == write_pos)
+            {
+                read_pos = write_pos = 0;
+            }
+        }
+
+    }
+}
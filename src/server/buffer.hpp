@@ -0,0 +1,60 @@
+/**
+ * @file server/buffer.hpp
+ * @brief Growable byte buffer used for connection input
+ */
+
+#ifndef OPUS_SERVER_BUFFER_HPP
+#define OPUS_SERVER_BUFFER_HPP
+
+#include <cstddef>
+#include <string_view>
+#include <vector>
+
+namespace opus
+{
+    namespace server
+    {
+
+        /**
+         * @class Buffer
+         * @brief Contiguous byte buffer with separate read and write cursors
+         *
+         * Bytes are appended at the write cursor (typically by read(2)) and
+         * consumed from the read cursor once a full command has been handled.
+         * Consumed space is reclaimed lazily by compacting when more room is
+         * needed, so steady-state traffic does not reallocate.
+         */
+        class Buffer
+        {
+        private:
+            std::vector<char> data;
+            size_t read_pos = 0;
+            size_t write_pos = 0;
+
+        public:
+            explicit Buffer(size_t initial_capacity = 16 * 1024);
+
+            const char *readPtr() const { return data.data() + read_pos; }
+            size_t readable() const { return write_pos - read_pos; }
+            std::string_view view() const { return std::string_view(readPtr(), readable()); }
+
+            char *writePtr() { return data.data() + write_pos; }
+            size_t writable() const { return data.size() - write_pos; }
+
+            /**
+             * @brief Makes room for at least `n` more bytes at the write cursor
+             *
+             * May move unread bytes to the front of the storage, invalidating
+             * pointers and views obtained earlier.
+             */
+            void ensureWritable(size_t n);
+
+            void commitWrite(size_t n) { write_pos += n; }
+            void consume(size_t n);
+            void clear() { read_pos = write_pos = 0; }
+        };
+
+    }
+}
+
+#endif
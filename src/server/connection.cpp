@@ -0,0 +1,513 @@
+/**
+ * @file server/connection.cpp
+ * @brief Implementation of client connection I/O
+ */
+
+#include "connection.hpp"
+#include "core_router.hpp"
+#include "server.hpp"
+
+#include <algorithm>
+#include <cerrno>
+#include <charconv>
+#include <climits>
+#include <string>
+#include <string_view>
+#include <vector>
+#include <sys/epoll.h>
+#include <sys/socket.h>
+#include <unistd.h>
+
+namespace opus
+{
+    namespace server
+    {
+
+        namespace
+        {
+            // Bytes requested per read(2) call.
+            constexpr size_t READ_CHUNK = 16 * 1024;
+
+            // Reads per readiness event before yielding to other clients.
+            constexpr int MAX_READS_PER_EVENT = 16;
+
+            // iovecs handed to one sendmsg call.
+            constexpr int MAX_IOV = IOV_MAX < 256 ? IOV_MAX : 256;
+
+            // Unsent bytes above which a streamed reply waits for the client
+            // to read before encoding more.
+            constexpr size_t MAX_STREAM_BACKLOG = 256 * 1024;
+
+            bool parse_integer(std::string_view text, long long &out)
+            {
+                auto [ptr, ec] = std::from_chars(text.data(), text.data() + text.size(), out);
+                return !text.empty() && ec == std::errc() && ptr == text.data() + text.size();
+            }
+
+            std::vector<std::string_view> split(std::string_view text, std::string_view separator)
+            {
+                std::vector<std::string_view> pieces;
+                size_t start = 0;
+                for (size_t at; (at = text.find(separator, start)) != std::string_view::npos; start = at + separator.size())
+                {
+                    pieces.push_back(text.substr(start, at - start));
+                }
+                pieces.push_back(text.substr(start));
+                return pieces;
+            }
+
+            // Adds up two INFO values that are integers or matching lists of
+            // k=integer pairs (db0:keys=..,expires=..); otherwise keeps `into`.
+            std::string merge_info_value(std::string_view into, std::string_view part)
+            {
+                long long a, b;
+                if (parse_integer(into, a) && parse_integer(part, b))
+                    return std::to_string(a + b);
+
+                auto ours = split(into, ","), theirs = split(part, ",");
+                if (ours.size() != theirs.size())
+                    return std::string(into);
+
+                std::string merged;
+                for (size_t i = 0; i < ours.size(); ++i)
+                {
+                    size_t eq = ours[i].find('=');
+                    if (i > 0)
+                        merged += ',';
+                    if (eq != std::string_view::npos && theirs[i].substr(0, eq + 1) == ours[i].substr(0, eq + 1) &&
+                        parse_integer(ours[i].substr(eq + 1), a) && parse_integer(theirs[i].substr(eq + 1), b))
+                    {
+                        merged.append(ours[i].substr(0, eq + 1)).append(std::to_string(a + b));
+                    }
+                    else
+                    {
+                        merged.append(ours[i]);
+                    }
+                }
+                return merged;
+            }
+
+            std::string_view info_body(std::string_view reply)
+            {
+                size_t header = reply.find("\r\n");
+                if (reply.empty() || reply[0] != '$' || header == std::string_view::npos || reply.size() < header + 4)
+                    return std::string_view();
+                return reply.substr(header + 2, reply.size() - header - 4);
+            }
+
+            std::string info_reply(const std::vector<std::string> &lines)
+            {
+                std::string body;
+                for (size_t i = 0; i < lines.size(); ++i)
+                {
+                    if (i > 0)
+                        body += "\r\n";
+                    body += lines[i];
+                }
+                return "$" + std::to_string(body.size()) + "\r\n" + body + "\r\n";
+            }
+
+            std::string_view info_name(std::string_view line)
+            {
+                return line.substr(0, line.find(':'));
+            }
+
+            // Merges one core's INFO bulk reply into another's. Fields both
+            // have are added up, except the process-wide RSS and allocator
+            // figures every core reports alike; lines only `part` has go after the last line
+            // matched so far, which keeps them in their section.
+            std::string merge_info(std::string_view into, std::string_view part)
+            {
+                std::vector<std::string> lines;
+                for (std::string_view line : split(info_body(into), "\r\n"))
+                {
+                    lines.emplace_back(line);
+                }
+
+                size_t insert_at = 0;
+                for (std::string_view line : split(info_body(part), "\r\n"))
+                {
+                    if (line.empty())
+                        continue;
+                    std::string_view name = info_name(line);
+                    auto same = std::find_if(lines.begin(), lines.end(), [&](const std::string &ours)
+                                             { return info_name(ours) == name; });
+                    if (same == lines.end())
+                    {
+                        lines.insert(lines.begin() + insert_at++, std::string(line));
+                        continue;
+                    }
+                    if (name.size() < line.size() && name != "used_memory_rss" && name.substr(0, 10) != "allocator_")
+                    {
+                        std::string_view ours = *same;
+                        *same = std::string(name) + ":" +
+                                merge_info_value(ours.substr(name.size() + 1), line.substr(name.size() + 1));
+                    }
+                    insert_at = static_cast<size_t>(same - lines.begin()) + 1;
+                }
+                return info_reply(lines);
+            }
+
+            // Recomputes the INFO fields derived from others (the *_human
+            // sizes and the fragmentation ratio) once all cores are merged,
+            // as adding those up would not mean anything.
+            std::string finish_info(std::string_view reply)
+            {
+                std::vector<std::string> lines;
+                for (std::string_view line : split(info_body(reply), "\r\n"))
+                {
+                    lines.emplace_back(line);
+                }
+
+                auto value_of = [&](std::string_view name)
+                {
+                    long long value = 0;
+                    for (const auto &line : lines)
+                    {
+                        if (info_name(line) == name && line.size() > name.size())
+                            parse_integer(std::string_view(line).substr(name.size() + 1), value);
+                    }
+                    return static_cast<unsigned long long>(value);
+                };
+
+                constexpr std::string_view HUMAN = "_human";
+                for (auto &line : lines)
+                {
+                    std::string_view name = info_name(line);
+                    if (name == "mem_fragmentation_ratio")
+                    {
+                        line = std::string(name) + ":" +
+                               command::fragmentation_ratio(value_of("used_memory_rss"), value_of("used_memory"));
+                    }
+                    else if (name.size() > HUMAN.size() && name.substr(name.size() - HUMAN.size()) == HUMAN)
+                    {
+                        line = std::string(name) + ":" +
+                               command::bytes_to_human(value_of(name.substr(0, name.size() - HUMAN.size())));
+                    }
+                }
+                return info_reply(lines);
+            }
+        }
+
+        Connection::Connection(int fd, Server &server, EventLoop &loop, command::CommandExecutor &executor)
+            : fd(fd), server(server), loop(loop), executor(executor)
+        {
+            reply.set_streaming(true);
+        }
+
+        Connection::~Connection()
+        {
+            if (fd >= 0)
+            {
+                ::close(fd);
+            }
+        }
+
+        void Connection::handleEvent(uint32_t events)
+        {
+            if (closed)
+                return;
+
+            if (events & (EPOLLERR | EPOLLHUP))
+            {
+                close();
+                return;
+            }
+
+            if (events & EPOLLOUT)
+            {
+                flushOutput();
+                if (closed)
+                    return;
+            }
+
+            if (stream_scheduled)
+            {
+                stream_scheduled = false;
+                resumeStream();
+                if (closed)
+                    return;
+            }
+
+            // Input waits in the socket while a reply is streamed, so a client
+            // that keeps sending is held back by TCP rather than buffered.
+            if (events & (EPOLLIN | EPOLLRDHUP) && !input_closed && !stream)
+            {
+                readInput();
+            }
+        }
+
+        void Connection::readInput()
+        {
+            for (int reads = 0; reads < MAX_READS_PER_EVENT; ++reads)
+            {
+                size_t needed = parser.bytesNeeded(input.readable());
+                input.ensureWritable(needed > READ_CHUNK ? needed : READ_CHUNK);
+                ssize_t n = ::read(fd, input.writePtr(), input.writable());
+                if (n > 0)
+                {
+                    input.commitWrite(static_cast<size_t>(n));
+                    continue;
+                }
+
+                if (n == 0)
+                {
+                    // Peer closed its side; answer what was already received,
+                    // after a streamed reply or forwarded commands have
+                    // finished if there are any.
+                    input_closed = true;
+                    processInput();
+                    closeIfAnswered();
+                    return;
+                }
+
+                if (errno == EINTR)
+                    continue;
+                if (errno != EAGAIN && errno != EWOULDBLOCK)
+                {
+                    close();
+                    return;
+                }
+
+                // Drained: the next edge will wake us up again.
+                processInput();
+                return;
+            }
+
+            // Budget exhausted with data possibly still pending; since the
+            // socket is edge-triggered, schedule ourselves explicitly.
+            processInput();
+            if (!closed)
+            {
+                loop.defer(this);
+            }
+        }
+
+        void Connection::processInput()
+        {
+            while (!closing && !stream && input.readable() > 0)
+            {
+                command::ParseStatus status = parser.parse(input.view(), args);
+                if (status == command::ParseStatus::INCOMPLETE)
+                    break;
+
+                if (status == command::ParseStatus::ERROR)
+                {
+                    reply.add_error(parser.error());
+                    closing = true;
+                    break;
+                }
+
+                CoreRouter *router = server.router();
+                if (!router || !router->route(*this, args))
+                {
+                    executeLocal();
+                }
+                input.consume(parser.consumed());
+            }
+
+            if (!output.empty() || closing)
+            {
+                queueWrite();
+            }
+            if (stream)
+            {
+                scheduleStream();
+            }
+        }
+
+        void Connection::executeLocal()
+        {
+            if (pending.empty())
+            {
+                if (executor.execute(args, reply) == command::CommandStatus::CLOSE)
+                {
+                    closing = true;
+                }
+                stream = reply.take_stream();
+                return;
+            }
+
+            // An earlier reply is still outstanding; park this one behind it.
+            command::ReplyWriter writer(deferred_output);
+            writer.set_protocol(reply.protocol());
+            if (executor.execute(args, writer) == command::CommandStatus::CLOSE)
+            {
+                closing = true;
+            }
+            reply.set_protocol(writer.protocol());
+
+            std::string data = deferred_output.take();
+            completePart(openPendingReply(1, command::ReplyMerge::NONE), data);
+        }
+
+        uint64_t Connection::openPendingReply(int parts, command::ReplyMerge merge)
+        {
+            PendingReply slot;
+            slot.parts_left = parts;
+            slot.merge = merge;
+            pending.push_back(std::move(slot));
+            return first_pending_seq + pending.size() - 1;
+        }
+
+        void Connection::completePart(uint64_t seq, std::string_view part)
+        {
+            PendingReply &slot = pending[seq - first_pending_seq];
+            bool is_error = !part.empty() && part[0] == '-';
+
+            switch (slot.merge)
+            {
+            case command::ReplyMerge::NONE:
+                slot.data.assign(part);
+                break;
+            case command::ReplyMerge::SUM:
+                if (is_error)
+                {
+                    if (slot.data.empty())
+                        slot.data.assign(part);
+                }
+                else if (part.size() > 3 && part[0] == ':')
+                {
+                    long long value = 0;
+                    std::from_chars(part.data() + 1, part.data() + part.size() - 2, value);
+                    slot.sum += value;
+                }
+                break;
+            case command::ReplyMerge::FIRST:
+                if (slot.data.empty() || (is_error && slot.data[0] != '-'))
+                    slot.data.assign(part);
+                break;
+            case command::ReplyMerge::INFO:
+                if (slot.data.empty() || (is_error && slot.data[0] != '-'))
+                    slot.data.assign(part);
+                else if (!is_error && slot.data[0] != '-')
+                    slot.data = merge_info(slot.data, part);
+                break;
+            }
+
+            if (--slot.parts_left > 0)
+                return;
+
+            if (slot.merge == command::ReplyMerge::SUM && slot.data.empty())
+            {
+                slot.data = ":" + std::to_string(slot.sum) + "\r\n";
+            }
+            else if (slot.merge == command::ReplyMerge::INFO && !slot.data.empty() && slot.data[0] != '-')
+            {
+                slot.data = finish_info(slot.data);
+            }
+            releaseReadyReplies();
+        }
+
+        void Connection::releaseReadyReplies()
+        {
+            while (!pending.empty() && pending.front().parts_left == 0)
+            {
+                output.append(pending.front().data);
+                pending.pop_front();
+                ++first_pending_seq;
+            }
+            queueWrite();
+        }
+
+        void Connection::queueWrite()
+        {
+            if (write_queued)
+                return;
+            write_queued = true;
+            server.queueWrite(this);
+        }
+
+        void Connection::scheduleStream()
+        {
+            if (stream_scheduled)
+                return;
+            stream_scheduled = true;
+            loop.defer(this);
+        }
+
+        void Connection::resumeStream()
+        {
+            // A client that is not reading gets nothing more until what is
+            // queued has gone out; flushOutput() schedules us again then.
+            if (output.size() >= MAX_STREAM_BACKLOG)
+                return;
+
+            if (!stream->resume(reply))
+                stream.reset();
+            queueWrite();
+            if (stream)
+            {
+                scheduleStream();
+                return;
+            }
+
+            // Done: serve whatever the client sent in the meantime.
+            if (!input_closed)
+            {
+                readInput();
+                return;
+            }
+            processInput();
+            closeIfAnswered();
+        }
+
+        void Connection::closeIfAnswered()
+        {
+            if (closed || !input_closed || stream || hasOutstanding())
+                return;
+            // flushOutput() closes once everything queued has gone out; a
+            // full socket buffer resumes it on EPOLLOUT.
+            closing = true;
+            flushOutput();
+        }
+
+        void Connection::flushOutput()
+        {
+            write_queued = false;
+            if (closed)
+                return;
+
+            iovec iov[MAX_IOV];
+            while (!output.empty())
+            {
+                msghdr msg{};
+                msg.msg_iov = iov;
+                msg.msg_iovlen = output.gather(iov, MAX_IOV);
+
+                ssize_t n = ::sendmsg(fd, &msg, MSG_NOSIGNAL);
+                if (n > 0)
+                {
+                    output.consume(static_cast<size_t>(n));
+                    continue;
+                }
+                if (n < 0 && errno == EINTR)
+                    continue;
+                if (n < 0 && (errno == EAGAIN || errno == EWOULDBLOCK))
+                    return; // EPOLLOUT will resume the flush
+                close();
+                return;
+            }
+
+            if (stream)
+            {
+                scheduleStream();
+            }
+            else if (closing && pending.empty())
+            {
+                close();
+            }
+        }
+
+        void Connection::close()
+        {
+            if (closed)
+                return;
+            closed = true;
+            loop.cancelDeferred(this);
+            loop.remove(fd);
+            server.release(this);
+        }
+
+    }
+}
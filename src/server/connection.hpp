@@ -0,0 +1,146 @@
+/**
+ * @file server/connection.hpp
+ * @brief Per-client connection state
+ */
+
+#ifndef OPUS_SERVER_CONNECTION_HPP
+#define OPUS_SERVER_CONNECTION_HPP
+
+#include <cstdint>
+#include <deque>
+#include <memory>
+#include <string>
+#include <string_view>
+#include <vector>
+
+#include "buffer.hpp"
+#include "event_loop.hpp"
+#include "command/executor.hpp"
+#include "command/reply.hpp"
+#include "command/resp_parser.hpp"
+
+namespace opus
+{
+    namespace server
+    {
+
+        class Server;
+
+        /**
+         * @class Connection
+         * @brief One accepted client socket with its read and write buffers
+         *
+         * The socket is registered edge-triggered for both directions once, so
+         * no epoll_ctl calls are needed while the connection is alive. All
+         * complete commands found in the input are executed in one pass and
+         * their replies are gathered in a ReplyBuffer; the server flushes it
+         * once before the loop goes back to sleep. A reply too large to build in
+         * one go is streamed instead, one slice per loop iteration, and only
+         * while the client keeps up with reading it.
+         */
+        class Connection : public EventHandler
+        {
+        private:
+            int fd;
+            Server &server;
+            EventLoop &loop;
+            command::CommandExecutor &executor;
+
+            Buffer input;
+            command::ReplyBuffer output;
+            command::ReplyWriter reply{output};
+            command::RespParser parser;
+            std::vector<std::string_view> args;
+            bool closing = false;
+            bool closed = false;
+            bool write_queued = false;
+            bool input_closed = false;
+
+            // The rest of a large reply (see command::ReplyStream), written a
+            // slice per loop iteration; later commands wait until it is done.
+            std::unique_ptr<command::ReplyStream> stream;
+            bool stream_scheduled = false;
+
+            // Replies that cannot be written yet because an earlier command of
+            // this client is still being served by another core. Slots are
+            // addressed by sequence number: pending.front() is first_pending_seq.
+            struct PendingReply
+            {
+                std::string data;
+                int parts_left = 0;
+                command::ReplyMerge merge = command::ReplyMerge::NONE;
+                long long sum = 0;
+            };
+            std::deque<PendingReply> pending;
+            uint64_t first_pending_seq = 0;
+            command::ReplyBuffer deferred_output;
+            size_t outstanding = 0;
+
+            void readInput();
+            void processInput();
+            void executeLocal();
+            void releaseReadyReplies();
+            void queueWrite();
+            void scheduleStream();
+            void resumeStream();
+
+        public:
+            Connection(int fd, Server &server, EventLoop &loop, command::CommandExecutor &executor);
+            ~Connection() override;
+
+            Connection(const Connection &) = delete;
+            Connection &operator=(const Connection &) = delete;
+
+            void handleEvent(uint32_t events) override;
+
+            /**
+             * @brief Writes as much queued output as the socket accepts
+             *
+             * Replies for every command executed in this loop iteration go
+             * out together in one sendmsg call (more only if the kernel takes
+             * them partially).
+             */
+            void flushOutput();
+
+            /**
+             * @brief Unregisters the socket and hands the connection back to the
+             * server for destruction at the end of the loop iteration
+             */
+            void close();
+
+            int descriptor() const { return fd; }
+            bool isClosed() const { return closed; }
+            int protocol() const { return reply.protocol(); }
+
+            /**
+             * @brief Reserves the reply position for a command answered in
+             * `parts` pieces (by other cores), merged according to `merge`
+             * @return Sequence number to pass to completePart()
+             */
+            uint64_t openPendingReply(int parts, command::ReplyMerge merge);
+
+            /**
+             * @brief Supplies one encoded part of a pending reply; replies are
+             * released to the socket strictly in command order
+             */
+            void completePart(uint64_t seq, std::string_view part);
+
+            /**
+             * @brief Bookkeeping for messages in flight to other cores; a closed
+             * connection is only destroyed once none are left
+             */
+            void remoteSent() { ++outstanding; }
+            void remoteReturned() { --outstanding; }
+            bool hasOutstanding() const { return outstanding > 0; }
+
+            /**
+             * @brief Closes a connection whose peer shut its side once every
+             * command it sent has been answered; a no-op otherwise
+             */
+            void closeIfAnswered();
+        };
+
+    }
+}
+
+#endif
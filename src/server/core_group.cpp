@@ -0,0 +1,151 @@
+/**
+ * @file server/core_group.cpp
+ * @brief Implementation of the thread-per-core server
+ */
+
+#include "core_group.hpp"
+
+#include <functional>
+#include <pthread.h>
+#include <sched.h>
+#include <thread>
+
+namespace opus
+{
+    namespace server
+    {
+
+        namespace
+        {
+            // Per-direction queue depth; senders keep a local backlog beyond it.
+            constexpr size_t QUEUE_CAPACITY = 4096;
+
+            void pin_to_cpu(size_t index)
+            {
+                unsigned cpus = std::thread::hardware_concurrency();
+                if (cpus == 0)
+                    return;
+
+                cpu_set_t set;
+                CPU_ZERO(&set);
+                CPU_SET(index % cpus, &set);
+                pthread_setaffinity_np(pthread_self(), sizeof(set), &set);
+            }
+        }
+
+        CoreGroup::CoreGroup(const std::string &host, int port, size_t core_count)
+        {
+            if (core_count == 0)
+                core_count = 1;
+
+            cores.resize(core_count);
+            for (size_t from = 0; from < core_count; ++from)
+            {
+                for (size_t to = 0; to < core_count; ++to)
+                {
+                    queues.push_back(std::make_unique<SpscQueue<CoreMessage>>(QUEUE_CAPACITY));
+                }
+            }
+
+            for (size_t i = 0; i < core_count; ++i)
+            {
+                Core &core = cores[i];
+                core.cache = std::make_unique<storage::CacheManager>(1, false);
+                core.server = std::make_unique<Server>(host, port, *core.cache, true);
+                core.router = std::make_unique<CoreRouter>(*this, i, *core.server);
+                if (core_count > 1)
+                {
+                    core.server->setRouter(core.router.get());
+                }
+            }
+        }
+
+        CoreGroup::~CoreGroup()
+        {
+            // Connections go away with their servers; drop whatever was still
+            // in flight between cores.
+            for (auto &queue : queues)
+            {
+                while (CoreMessage *msg = queue->pop())
+                {
+                    delete msg;
+                }
+            }
+        }
+
+        void CoreGroup::run()
+        {
+            std::vector<std::thread> threads;
+            for (size_t i = 1; i < cores.size(); ++i)
+            {
+                threads.emplace_back([this, i]
+                                     {
+                    pin_to_cpu(i);
+                    cores[i].server->run(); });
+            }
+
+            pin_to_cpu(0);
+            cores[0].server->run();
+
+            for (auto &thread : threads)
+            {
+                thread.join();
+            }
+        }
+
+        void CoreGroup::stop()
+        {
+            for (auto &core : cores)
+            {
+                core.server->stop();
+            }
+        }
+
+        void CoreGroup::setMaxMemory(size_t bytes, storage::EvictionPolicy policy, size_t samples)
+        {
+            // Round up so a small non-zero limit does not become "no limit".
+            size_t share = bytes == 0 ? 0 : (bytes + cores.size() - 1) / cores.size();
+            for (auto &core : cores)
+            {
+                core.cache->setMaxMemory(share, policy, samples);
+            }
+        }
+
+        void CoreGroup::setLfuTuning(unsigned log_factor, unsigned decay_time)
+        {
+            for (auto &core : cores)
+            {
+                core.cache->setLfuTuning(log_factor, decay_time);
+            }
+        }
+
+        void CoreGroup::setActiveDefrag(const storage::DefragConfig &config)
+        {
+            storage::DefragConfig share = config;
+            share.ignore_bytes = (config.ignore_bytes + cores.size() - 1) / cores.size();
+            for (auto &core : cores)
+            {
+                core.cache->setActiveDefrag(share);
+            }
+        }
+
+        size_t CoreGroup::ownerOf(std::string_view key) const
+        {
+            // Redis-style hash tags: hash only what is between the first '{'
+            // and the next '}', when that is non-empty.
+            size_t open = key.find('{');
+            if (open != std::string_view::npos)
+            {
+                size_t close = key.find('}', open + 1);
+                if (close != std::string_view::npos && close > open + 1)
+                {
+                    key = key.substr(open + 1, close - open - 1);
+                }
+            }
+
+            unsigned __int128 hash = std::hash<std::string_view>{}(key);
+            return static_cast<size_t>((hash * cores.size()) >> 64);
+        }
+
+    }
+}
@@ -0,0 +1,98 @@
+/**
+ * @file server/core_group.hpp
+ * @brief Shared-nothing, thread-per-core server
+ */
+
+#ifndef OPUS_SERVER_CORE_GROUP_HPP
+#define OPUS_SERVER_CORE_GROUP_HPP
+
+#include <cstddef>
+#include <memory>
+#include <string>
+#include <string_view>
+#include <vector>
+
+#include "core_router.hpp"
+#include "server.hpp"
+#include "spsc_queue.hpp"
+#include "storage/manager.hpp"
+
+namespace opus
+{
+    namespace server
+    {
+
+        /**
+         * @class CoreGroup
+         * @brief One Server, keyspace partition and thread per core
+         *
+         * Every core listens on the same address through SO_REUSEPORT, so the
+         * kernel spreads accepted clients across cores. Each key is owned by
+         * exactly one core; its CacheManager partition is only touched by that
+         * core's thread and therefore takes no locks. Cores exchange commands
+         * through one SPSC queue per ordered pair of cores.
+         */
+        class CoreGroup
+        {
+        private:
+            struct Core
+            {
+                std::unique_ptr<storage::CacheManager> cache;
+                std::unique_ptr<Server> server;
+                std::unique_ptr<CoreRouter> router;
+            };
+
+            std::vector<Core> cores;
+            std::vector<std::unique_ptr<SpscQueue<CoreMessage>>> queues;
+
+        public:
+            /**
+             * @brief Binds every core to host:port; throws std::runtime_error on failure
+             */
+            CoreGroup(const std::string &host, int port, size_t core_count);
+            ~CoreGroup();
+
+            CoreGroup(const CoreGroup &) = delete;
+            CoreGroup &operator=(const CoreGroup &) = delete;
+
+            /**
+             * @brief Runs core 0 on the calling thread and the others on their
+             * own threads until stop() is called
+             */
+            void run();
+
+            /**
+             * @brief Makes run() return; async-signal-safe
+             */
+            void stop();
+
+            /**
+             * @brief Splits a memory limit evenly over the cores' partitions;
+             *        each core evicts from its own keys only
+             */
+            void setMaxMemory(size_t bytes, storage::EvictionPolicy policy, size_t samples);
+
+            void setLfuTuning(unsigned log_factor, unsigned decay_time);
+
+            /**
+             * @brief Each core defragments the heap of its own thread, so the
+             *        wasted-bytes floor is split over the cores like maxmemory
+             */
+            void setActiveDefrag(const storage::DefragConfig &config);
+
+            size_t size() const { return cores.size(); }
+
+            /**
+             * @brief Core owning `key`; only the part inside a {hash tag} counts
+             */
+            size_t ownerOf(std::string_view key) const;
+
+            SpscQueue<CoreMessage> &queue(size_t from, size_t to) { return *queues[from * cores.size() + to]; }
+
+            EventLoop &loopOf(size_t core) { return cores[core].server->eventLoop(); }
+        };
+
+    }
+}
+
+#endif
@@ -0,0 +1,317 @@
+/**
+ * @file server/core_router.cpp
+ * @brief Implementation of cross-core command forwarding
+ */
+
+#include "core_router.hpp"
+#include "connection.hpp"
+#include "core_group.hpp"
+#include "server.hpp"
+
+#include "command/executor.hpp"
+
+#include <charconv>
+
+namespace opus
+{
+    namespace server
+    {
+
+        namespace
+        {
+            void append_bulk(std::string &out, std::string_view arg)
+            {
+                out.push_back('$');
+                out.append(std::to_string(arg.size()));
+                out.append("\r\n", 2);
+                out.append(arg);
+                out.append("\r\n", 2);
+            }
+
+            std::string encode_request(const std::vector<std::string_view> &args)
+            {
+                size_t size = 16;
+                for (auto arg : args)
+                {
+                    size += arg.size() + 16;
+                }
+
+                std::string out;
+                out.reserve(size);
+                out.push_back('*');
+                out.append(std::to_string(args.size()));
+                out.append("\r\n", 2);
+                for (auto arg : args)
+                {
+                    append_bulk(out, arg);
+                }
+                return out;
+            }
+        }
+
+        CoreRouter::CoreRouter(CoreGroup &group, size_t core_id, Server &server)
+            : group(group), core_id(core_id), server(server),
+              backlog(group.size()), needs_wake(group.size(), 0) {}
+
+        CoreRouter::~CoreRouter()
+        {
+            for (auto &pending : backlog)
+            {
+                for (CoreMessage *msg : pending)
+                {
+                    delete msg;
+                }
+            }
+        }
+
+        bool CoreRouter::route(Connection &conn, const std::vector<std::string_view> &args)
+        {
+            const command::CommandInfo *info = command::lookup_command(args[0]);
+            if (!info || info->scope == command::KeyScope::NONE || !info->arity_matches(args.size()))
+                return false;
+
+            if (info->scope == command::KeyScope::CURSOR)
+                return routeCursor(conn, args);
+
+            size_t cores = group.size();
+
+            if (info->scope == command::KeyScope::ALL)
+            {
+                uint64_t seq = conn.openPendingReply(static_cast<int>(cores), info->merge);
+                for (size_t target = 0; target < cores; ++target)
+                {
+                    if (target != core_id)
+                        sendRequest(target, conn, seq, args);
+                }
+                conn.completePart(seq, executeHere(args, conn.protocol()));
+                return true;
+            }
+
+            int argc = static_cast<int>(args.size());
+            int last = info->last_key_index(args);
+            if (last < 0)
+                return false; // malformed key count: let the executor report it
+            if (info->last_key < 0 && (argc - info->first_key) % info->key_step != 0)
+                return false; // a key without its value (MSET k1 v1 k2): likewise
+
+            size_t owner = group.ownerOf(args[info->first_key]);
+            bool single_owner = true;
+            for (int i = info->first_key + info->key_step; i <= last; i += info->key_step)
+            {
+                if (group.ownerOf(args[i]) != owner)
+                {
+                    single_owner = false;
+                    break;
+                }
+            }
+
+            if (single_owner)
+            {
+                if (owner == core_id)
+                    return false;
+                uint64_t seq = conn.openPendingReply(1, command::ReplyMerge::NONE);
+                sendRequest(owner, conn, seq, args);
+                return true;
+            }
+
+            if (info->merge == command::ReplyMerge::NONE)
+            {
+                uint64_t seq = conn.openPendingReply(1, command::ReplyMerge::NONE);
+                conn.completePart(seq, "-CROSSSLOT Keys in request don't hash to the same slot\r\n");
+                return true;
+            }
+
+            // Split into one sub-command per owning core, each carrying its
+            // keys together with the arguments that follow them (values for
+            // key/value commands).
+            std::vector<std::vector<std::string_view>> parts(cores);
+            for (int i = info->first_key; i <= last; i += info->key_step)
+            {
+                auto &part = parts[group.ownerOf(args[i])];
+                if (part.empty())
+                {
+                    part.insert(part.end(), args.begin(), args.begin() + info->first_key);
+                }
+                for (int j = i; j < i + info->key_step && j < argc; ++j)
+                {
+                    part.push_back(args[j]);
+                }
+            }
+
+            int involved = 0;
+            for (const auto &part : parts)
+            {
+                involved += part.empty() ? 0 : 1;
+            }
+
+            uint64_t seq = conn.openPendingReply(involved, info->merge);
+            for (size_t target = 0; target < cores; ++target)
+            {
+                if (!parts[target].empty() && target != core_id)
+                    sendRequest(target, conn, seq, parts[target]);
+            }
+            if (!parts[core_id].empty())
+            {
+                conn.completePart(seq, executeHere(parts[core_id], conn.protocol()));
+            }
+            return true;
+        }
+
+        bool CoreRouter::routeCursor(Connection &conn, const std::vector<std::string_view> &args)
+        {
+            unsigned long long cursor;
+            auto [ptr, ec] = std::from_chars(args[1].data(), args[1].data() + args[1].size(), cursor);
+            if (ec != std::errc() || ptr != args[1].data() + args[1].size())
+                return false; // let the executor report it
+
+            size_t cores = group.size();
+            size_t target = cursor % cores;
+            std::string local = std::to_string(cursor / cores);
+            std::vector<std::string_view> forwarded(args);
+            forwarded[1] = local;
+
+            uint64_t seq = conn.openPendingReply(1, command::ReplyMerge::NONE);
+            if (target == core_id)
+                conn.completePart(seq, globalCursor(executeHere(forwarded, conn.protocol())));
+            else
+                sendRequest(target, conn, seq, forwarded);
+            return true;
+        }
+
+        std::string CoreRouter::globalCursor(std::string reply) const
+        {
+            // "*2\r\n$<length>\r\n<cursor>\r\n<page>"; errors pass through.
+            if (reply.compare(0, 5, "*2\r\n$") != 0)
+                return reply;
+            size_t start = reply.find("\r\n", 5) + 2;
+            size_t end = reply.find("\r\n", start);
+            unsigned long long cursor = 0;
+            std::from_chars(reply.data() + start, reply.data() + end, cursor);
+
+            // A finished core hands over to the next one, at its cursor 0.
+            size_t cores = group.size();
+            unsigned long long global = cursor != 0         ? cursor * cores + core_id
+                                        : core_id + 1 < cores ? core_id + 1
+                                                              : 0;
+            std::string text = std::to_string(global);
+            std::string out = "*2\r\n$" + std::to_string(text.size()) + "\r\n" + text;
+            out.append(reply, end, std::string::npos);
+            return out;
+        }
+
+        std::string CoreRouter::executeHere(const std::vector<std::string_view> &args, int protocol)
+        {
+            command::ReplyWriter writer(scratch);
+            writer.set_protocol(protocol);
+            server.commandExecutor().execute(args, writer);
+            return scratch.take();
+        }
+
+        void CoreRouter::sendRequest(size_t target, Connection &conn, uint64_t seq,
+                                     const std::vector<std::string_view> &args)
+        {
+            auto *msg = new CoreMessage();
+            msg->origin = core_id;
+            msg->conn = &conn;
+            msg->reply_seq = seq;
+            msg->protocol = conn.protocol();
+            msg->payload = encode_request(args);
+            conn.remoteSent();
+            send(target, msg);
+        }
+
+        void CoreRouter::send(size_t target, CoreMessage *msg)
+        {
+            needs_wake[target] = 1;
+            auto &waiting = backlog[target];
+            if (!waiting.empty() || !group.queue(core_id, target).push(msg))
+            {
+                waiting.push_back(msg);
+            }
+        }
+
+        void CoreRouter::poll()
+        {
+            size_t cores = group.size();
+            for (size_t from = 0; from < cores; ++from)
+            {
+                if (from == core_id)
+                    continue;
+
+                auto &queue = group.queue(from, core_id);
+                while (CoreMessage *msg = queue.pop())
+                {
+                    if (msg->phase == CoreMessage::Phase::REQUEST)
+                        handleRequest(msg);
+                    else
+                        handleResponse(msg);
+                }
+            }
+        }
+
+        void CoreRouter::handleRequest(CoreMessage *msg)
+        {
+            parser.reset();
+            if (parser.parse(msg->payload, request_args) == command::ParseStatus::COMPLETE)
+            {
+                // The arguments point into the payload the reply replaces.
+                const command::CommandInfo *info = command::lookup_command(request_args[0]);
+                msg->payload = executeHere(request_args, msg->protocol);
+                if (info && info->scope == command::KeyScope::CURSOR)
+                    msg->payload = globalCursor(std::move(msg->payload));
+            }
+            else
+            {
+                msg->payload = "-ERR internal forwarding error\r\n";
+            }
+            msg->phase = CoreMessage::Phase::RESPONSE;
+            send(msg->origin, msg);
+        }
+
+        void CoreRouter::handleResponse(CoreMessage *msg)
+        {
+            Connection *conn = msg->conn;
+            conn->remoteReturned();
+            if (!conn->isClosed())
+            {
+                conn->completePart(msg->reply_seq, msg->payload);
+                conn->closeIfAnswered();
+            }
+            delete msg;
+        }
+
+        void CoreRouter::flush()
+        {
+            size_t cores = group.size();
+            for (size_t target = 0; target < cores; ++target)
+            {
+                auto &waiting = backlog[target];
+                auto &queue = group.queue(core_id, target);
+                while (!waiting.empty() && queue.push(waiting.front()))
+                {
+                    waiting.pop_front();
+                }
+
+                if (needs_wake[target])
+                {
+                    needs_wake[target] = 0;
+                    group.loopOf(target).wake();
+                }
+            }
+        }
+
+        bool CoreRouter::hasPendingWork() const
+        {
+            size_t cores = group.size();
+            for (size_t other = 0; other < cores; ++other)
+            {
+                if (!backlog[other].empty())
+                    return true;
+                if (other != core_id && group.queue(other, core_id).hasItems())
+                    return true;
+            }
+            return false;
+        }
+
+    }
+}
@@ -0,0 +1,125 @@
+/**
+ * @file server/core_router.hpp
+ * @brief Forwards commands to the core owning their keys in shared-nothing mode
+ */
+
+#ifndef OPUS_SERVER_CORE_ROUTER_HPP
+#define OPUS_SERVER_CORE_ROUTER_HPP
+
+#include <cstddef>
+#include <cstdint>
+#include <deque>
+#include <string>
+#include <string_view>
+#include <vector>
+
+#include "command/reply.hpp"
+#include "command/resp_parser.hpp"
+
+namespace opus
+{
+    namespace server
+    {
+
+        class Connection;
+        class CoreGroup;
+        class Server;
+
+        /**
+         * @struct CoreMessage
+         * @brief A command travelling to the core that owns its keys, and the
+         * reply travelling back
+         *
+         * The same object makes the round trip: the owner overwrites `payload`
+         * with the encoded reply and returns it to the origin core, which
+         * deletes it.
+         */
+        struct CoreMessage
+        {
+            enum class Phase
+            {
+                REQUEST,
+                RESPONSE
+            };
+
+            Phase phase = Phase::REQUEST;
+            size_t origin = 0;          // Core that owns the client connection
+            Connection *conn = nullptr; // Only dereferenced on the origin core
+            uint64_t reply_seq = 0;     // Pending reply slot on the connection
+            int protocol = 2;           // Client's RESP version
+            std::string payload;        // RESP request, then RESP reply
+        };
+
+        /**
+         * @class CoreRouter
+         * @brief Per-core side of shared-nothing mode
+         *
+         * Commands whose keys all belong to this core run locally with no
+         * locking. Otherwise the command (or, for splittable multi-key
+         * commands, each per-core part of it) is sent over the lock-free queue
+         * to the owning core and the client's reply slot is filled when the
+         * answer comes back. Commands touching the whole keyspace are sent to
+         * every core. Non-splittable commands spanning cores are refused with
+         * CROSSSLOT; hash tags ("{user1}.name") keep related keys together.
+         * SCAN visits the cores one after another: the cursor a client sees is
+         * a core's own cursor times the number of cores, plus that core's id.
+         */
+        class CoreRouter
+        {
+        private:
+            CoreGroup &group;
+            size_t core_id;
+            Server &server;
+
+            command::ReplyBuffer scratch;
+            command::RespParser parser;
+            std::vector<std::string_view> request_args;
+            std::vector<std::deque<CoreMessage *>> backlog; // Per target, when its queue is full
+            std::vector<char> needs_wake;                   // Per target, set by send()
+
+            std::string executeHere(const std::vector<std::string_view> &args, int protocol);
+            bool routeCursor(Connection &conn, const std::vector<std::string_view> &args);
+
+            // This core's SCAN reply with its cursor made group-wide.
+            std::string globalCursor(std::string reply) const;
+            void sendRequest(size_t target, Connection &conn, uint64_t seq,
+                             const std::vector<std::string_view> &args);
+            void send(size_t target, CoreMessage *msg);
+            void handleRequest(CoreMessage *msg);
+            void handleResponse(CoreMessage *msg);
+
+        public:
+            CoreRouter(CoreGroup &group, size_t core_id, Server &server);
+            ~CoreRouter();
+
+            CoreRouter(const CoreRouter &) = delete;
+            CoreRouter &operator=(const CoreRouter &) = delete;
+
+            /**
+             * @brief Takes over a command that must not run (only) on this core
+             * @return false if the caller should simply execute it locally
+             */
+            bool route(Connection &conn, const std::vector<std::string_view> &args);
+
+            /**
+             * @brief Serves requests and delivers replies queued by other cores
+             */
+            void poll();
+
+            /**
+             * @brief Retries messages that found a full queue and wakes the
+             * cores that were sent anything this iteration
+             */
+            void flush();
+
+            /**
+             * @brief True if another core has queued work for this one, or this
+             * core still has messages waiting for queue space
+             */
+            bool hasPendingWork() const;
+        };
+
+    }
+}
+
+#endif
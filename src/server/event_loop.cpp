@@ -0,0 +1,234 @@
+/**
+ * @file server/event_loop.cpp
+ * @brief Implementation of the epoll reactor
+ */
+
+#include "event_loop.hpp"
+
+#include <algorithm>
+#include <cerrno>
+#include <cstring>
+#include <stdexcept>
+#include <string>
+#include <sys/epoll.h>
+#include <sys/eventfd.h>
+#include <sys/timerfd.h>
+#include <unistd.h>
+
+namespace opus
+{
+    namespace server
+    {
+
+        namespace
+        {
+            constexpr int MAX_EVENTS_PER_WAIT = 1024;
+        }
+
+        /**
+         * @brief Periodic task driven by a timerfd
+         */
+        class EventLoop::Timer : public EventHandler
+        {
+        private:
+            EventLoop &loop;
+            int fd;
+            std::function<bool()> task;
+
+        public:
+            Timer(EventLoop &loop, std::chrono::milliseconds interval, std::function<bool()> task)
+                : loop(loop), task(std::move(task))
+            {
+                fd = timerfd_create(CLOCK_MONOTONIC, TFD_NONBLOCK | TFD_CLOEXEC);
+                if (fd < 0)
+                {
+                    throw std::runtime_error(std::string("timerfd_create failed: ") + std::strerror(errno));
+                }
+
+                itimerspec spec{};
+                spec.it_interval.tv_sec = interval.count() / 1000;
+                spec.it_interval.tv_nsec = (interval.count() % 1000) * 1000000;
+                spec.it_value = spec.it_interval;
+                if (timerfd_settime(fd, 0, &spec, nullptr) < 0)
+                {
+                    ::close(fd);
+                    throw std::runtime_error(std::string("timerfd_settime failed: ") + std::strerror(errno));
+                }
+            }
+
+            ~Timer() override
+            {
+                ::close(fd);
+            }
+
+            int descriptor() const { return fd; }
+
+            void handleEvent(uint32_t) override
+            {
+                // Also reached through defer(), with nothing to read.
+                uint64_t expirations;
+                ssize_t got = ::read(fd, &expirations, sizeof(expirations));
+                (void)got;
+                if (task())
+                    loop.defer(this);
+            }
+        };
+
+        EventLoop::EventLoop()
+        {
+            epoll_fd = epoll_create1(EPOLL_CLOEXEC);
+            if (epoll_fd < 0)
+            {
+                throw std::runtime_error(std::string("epoll_create1 failed: ") + std::strerror(errno));
+            }
+
+            wake_fd = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+            if (wake_fd < 0)
+            {
+                ::close(epoll_fd);
+                throw std::runtime_error(std::string("eventfd failed: ") + std::strerror(errno));
+            }
+
+            // The wake-up descriptor is identified by a null handler pointer.
+            epoll_event ev{};
+            ev.events = EPOLLIN;
+            ev.data.ptr = nullptr;
+            if (epoll_ctl(epoll_fd, EPOLL_CTL_ADD, wake_fd, &ev) < 0)
+            {
+                ::close(wake_fd);
+                ::close(epoll_fd);
+                throw std::runtime_error(std::string("epoll_ctl failed: ") + std::strerror(errno));
+            }
+        }
+
+        EventLoop::~EventLoop()
+        {
+            timers.clear();
+            ::close(wake_fd);
+            ::close(epoll_fd);
+        }
+
+        void EventLoop::add(int fd, uint32_t events, EventHandler *handler)
+        {
+            epoll_event ev{};
+            ev.events = events;
+            ev.data.ptr = handler;
+            if (epoll_ctl(epoll_fd, EPOLL_CTL_ADD, fd, &ev) < 0)
+            {
+                throw std::runtime_error(std::string("epoll_ctl(ADD) failed: ") + std::strerror(errno));
+            }
+        }
+
+        void EventLoop::remove(int fd)
+        {
+            epoll_ctl(epoll_fd, EPOLL_CTL_DEL, fd, nullptr);
+        }
+
+        void EventLoop::defer(EventHandler *handler)
+        {
+            deferred.push_back(handler);
+        }
+
+        void EventLoop::cancelDeferred(EventHandler *handler)
+        {
+            deferred.erase(std::remove(deferred.begin(), deferred.end(), handler), deferred.end());
+        }
+
+        void EventLoop::addBeforeSleep(std::function<void()> hook)
+        {
+            before_sleep.push_back(std::move(hook));
+        }
+
+        void EventLoop::addTimer(std::chrono::milliseconds interval, std::function<bool()> task)
+        {
+            auto timer = std::make_unique<Timer>(*this, interval, std::move(task));
+            add(timer->descriptor(), EPOLLIN | EPOLLET, timer.get());
+            timers.push_back(std::move(timer));
+        }
+
+        void EventLoop::drainWakeup()
+        {
+            uint64_t value;
+            while (::read(wake_fd, &value, sizeof(value)) > 0)
+            {
+            }
+        }
+
+        void EventLoop::run()
+        {
+            epoll_event events[MAX_EVENTS_PER_WAIT];
+            std::vector<EventHandler *> ready;
+
+            while (running.load(std::memory_order_relaxed))
+            {
+                // Never block while deferred work is waiting.
+                int timeout = deferred.empty() ? -1 : 0;
+                if (timeout != 0 && has_pending_work)
+                {
+                    // Pairs with the fence in wake(): either the producer sees
+                    // sleeping == true and signals, or we see its work here.
+                    sleeping.store(true, std::memory_order_relaxed);
+                    std::atomic_thread_fence(std::memory_order_seq_cst);
+                    if (has_pending_work())
+                        timeout = 0;
+                }
+                int n = epoll_wait(epoll_fd, events, MAX_EVENTS_PER_WAIT, timeout);
+                sleeping.store(false, std::memory_order_relaxed);
+                if (n < 0)
+                {
+                    if (errno == EINTR)
+                        continue;
+                    throw std::runtime_error(std::string("epoll_wait failed: ") + std::strerror(errno));
+                }
+
+                for (int i = 0; i < n; ++i)
+                {
+                    auto *handler = static_cast<EventHandler *>(events[i].data.ptr);
+                    if (!handler)
+                    {
+                        drainWakeup();
+                        continue;
+                    }
+                    handler->handleEvent(events[i].events);
+                }
+
+                // Handlers deferred during this pass run on the next one.
+                ready.swap(deferred);
+                for (auto *handler : ready)
+                {
+                    handler->handleEvent(EPOLLIN);
+                }
+                ready.clear();
+
+                for (auto &hook : before_sleep)
+                {
+                    hook();
+                }
+            }
+        }
+
+        void EventLoop::setPendingWorkCheck(std::function<bool()> check)
+        {
+            has_pending_work = std::move(check);
+        }
+
+        void EventLoop::wake()
+        {
+            std::atomic_thread_fence(std::memory_order_seq_cst);
+            if (!sleeping.load(std::memory_order_relaxed))
+                return;
+            uint64_t one = 1;
+            ssize_t written = ::write(wake_fd, &one, sizeof(one));
+            (void)written;
+        }
+
+        void EventLoop::stop()
+        {
+            running.store(false);
+            uint64_t one = 1;
+            ssize_t written = ::write(wake_fd, &one, sizeof(one));
+            (void)written;
+        }
+
+    }
+}
@@ -0,0 +1,135 @@
+/**
+ * @file server/event_loop.hpp
+ * @brief Edge-triggered epoll reactor
+ */
+
+#ifndef OPUS_SERVER_EVENT_LOOP_HPP
+#define OPUS_SERVER_EVENT_LOOP_HPP
+
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <vector>
+
+namespace opus
+{
+    namespace server
+    {
+
+        /**
+         * @class EventHandler
+         * @brief Receiver of readiness notifications for one file descriptor
+         */
+        class EventHandler
+        {
+        public:
+            virtual ~EventHandler() = default;
+
+            /**
+             * @brief Called with the epoll event mask when the descriptor is ready
+             */
+            virtual void handleEvent(uint32_t events) = 0;
+        };
+
+        /**
+         * @class EventLoop
+         * @brief Single-threaded epoll loop dispatching to EventHandlers
+         *
+         * Descriptors are expected to be registered edge-triggered, so handlers
+         * must drain them until EAGAIN. A handler that stops early to stay fair
+         * to other clients calls defer() and is invoked again on the next
+         * iteration without waiting for a new edge.
+         */
+        class EventLoop
+        {
+        private:
+            class Timer;
+
+            int epoll_fd = -1;
+            int wake_fd = -1;
+            std::atomic<bool> running{true};
+            std::atomic<bool> sleeping{false};
+            std::vector<EventHandler *> deferred;
+            std::vector<std::function<void()>> before_sleep;
+            std::vector<std::unique_ptr<Timer>> timers;
+            std::function<bool()> has_pending_work;
+
+            void drainWakeup();
+
+        public:
+            EventLoop();
+            ~EventLoop();
+
+            EventLoop(const EventLoop &) = delete;
+            EventLoop &operator=(const EventLoop &) = delete;
+
+            /**
+             * @brief Registers a descriptor; throws std::runtime_error on failure
+             */
+            void add(int fd, uint32_t events, EventHandler *handler);
+
+            /**
+             * @brief Unregisters a descriptor (closing it is up to the caller)
+             */
+            void remove(int fd);
+
+            /**
+             * @brief Re-invokes handler->handleEvent(EPOLLIN) on the next iteration
+             */
+            void defer(EventHandler *handler);
+
+            /**
+             * @brief Drops `handler` from the next iteration's deferred calls,
+             *        for a handler that is about to be destroyed
+             */
+            void cancelDeferred(EventHandler *handler);
+
+            /**
+             * @brief Adds a hook run once per iteration, after all events were handled
+             */
+            void addBeforeSleep(std::function<void()> hook);
+
+            /**
+             * @brief Runs `task` on the loop thread every `interval`
+             *
+             * A task that returns true runs again on the next iteration
+             * instead of waiting for the next tick, so background work can be
+             * done in bounded slices between client events.
+             */
+            void addTimer(std::chrono::milliseconds interval, std::function<bool()> task);
+
+            /**
+             * @brief Installs a check run right before the loop blocks
+             *
+             * Work queued by other threads (see wake()) that arrives between the
+             * before-sleep hooks and epoll_wait is caught by this check, which
+             * then turns the wait into a poll.
+             */
+            void setPendingWorkCheck(std::function<bool()> check);
+
+            /**
+             * @brief Wakes the loop if it is blocked (or about to block) in
+             * epoll_wait; cheap no-op otherwise. Safe to call from other threads.
+             *
+             * Callers must publish their work before calling this.
+             */
+            void wake();
+
+            /**
+             * @brief Dispatches events until stop() is called
+             */
+            void run();
+
+            /**
+             * @brief Asks run() to return; safe to call from other threads and
+             * from signal handlers
+             */
+            void stop();
+        };
+
+    }
+}
+
+#endif
@@ -0,0 +1,238 @@
+/**
+ * @file server/server.cpp
+ * @brief Implementation of the TCP front end
+ */
+
+#include "server.hpp"
+#include "core_router.hpp"
+
+#include <cerrno>
+#include <chrono>
+#include <cstring>
+#include <iostream>
+#include <netdb.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <stdexcept>
+#include <sys/epoll.h>
+#include <sys/resource.h>
+#include <sys/socket.h>
+#include <unistd.h>
+
+namespace opus
+{
+    namespace server
+    {
+
+        namespace
+        {
+            constexpr int LISTEN_BACKLOG = 511;
+
+            // Active expiry runs ten times a second, a millisecond at most each
+            // time; slices follow back to back only while they keep finding
+            // expired keys, so a mass expiry never holds clients up for long.
+            constexpr std::chrono::milliseconds EXPIRE_CYCLE_INTERVAL(100);
+            constexpr std::chrono::microseconds EXPIRE_CYCLE_BUDGET(1000);
+
+            // Active defragmentation gets its configured share of each such
+            // interval, e.g. 10 ms of every 100 at the default 10%.
+            constexpr std::chrono::milliseconds DEFRAG_CYCLE_INTERVAL(100);
+
+            // Thousands of clients need more descriptors than the usual soft
+            // limit of 1024; raise it as far as the hard limit allows.
+            void raise_descriptor_limit()
+            {
+                rlimit limit{};
+                if (getrlimit(RLIMIT_NOFILE, &limit) == 0 && limit.rlim_cur < limit.rlim_max)
+                {
+                    limit.rlim_cur = limit.rlim_max;
+                    setrlimit(RLIMIT_NOFILE, &limit);
+                }
+            }
+        }
+
+        Server::Server(std::string host, int port, storage::CacheManager &cache, bool reuse_port)
+            : host(std::move(host)), port(port), reuse_port(reuse_port), cache(cache), executor(cache)
+        {
+            raise_descriptor_limit();
+            bindAndListen();
+            loop.add(listen_fd, EPOLLIN | EPOLLET, this);
+            loop.addBeforeSleep([this]
+                                {
+                                    if (core_router)
+                                        core_router->poll();
+                                    handlePendingWrites();
+                                    if (core_router)
+                                        core_router->flush();
+                                    destroyReleased();
+                                    // Finish keyspace growth on idle turns too,
+                                    // not only when writes arrive.
+                                    this->cache.rehashStep(); });
+            loop.addTimer(EXPIRE_CYCLE_INTERVAL, [this]
+                          {
+                              // The access clock only needs second resolution;
+                              // keeping it here spares every lookup a syscall.
+                              this->cache.updateLruClock();
+                              return this->cache.activeExpireCycle(EXPIRE_CYCLE_BUDGET); });
+            loop.addTimer(DEFRAG_CYCLE_INTERVAL, [this]
+                          {
+                              this->cache.activeDefragCycle(DEFRAG_CYCLE_INTERVAL);
+                              return false; });
+        }
+
+        Server::~Server()
+        {
+            connections.clear();
+            if (listen_fd >= 0)
+            {
+                ::close(listen_fd);
+            }
+        }
+
+        void Server::bindAndListen()
+        {
+            addrinfo hints{};
+            hints.ai_family = AF_UNSPEC;
+            hints.ai_socktype = SOCK_STREAM;
+            hints.ai_flags = AI_PASSIVE;
+
+            addrinfo *results = nullptr;
+            std::string service = std::to_string(port);
+            int rc = getaddrinfo(host.c_str(), service.c_str(), &hints, &results);
+            if (rc != 0)
+            {
+                throw std::runtime_error("Cannot resolve " + host + ": " + gai_strerror(rc));
+            }
+
+            std::string last_error = "no usable address";
+            for (addrinfo *ai = results; ai; ai = ai->ai_next)
+            {
+                int fd = socket(ai->ai_family, ai->ai_socktype | SOCK_NONBLOCK | SOCK_CLOEXEC, ai->ai_protocol);
+                if (fd < 0)
+                {
+                    last_error = std::strerror(errno);
+                    continue;
+                }
+
+                int yes = 1;
+                setsockopt(fd, SOL_SOCKET, SO_REUSEADDR, &yes, sizeof(yes));
+                if (reuse_port)
+                {
+                    setsockopt(fd, SOL_SOCKET, SO_REUSEPORT, &yes, sizeof(yes));
+                }
+
+                if (bind(fd, ai->ai_addr, ai->ai_addrlen) == 0 && listen(fd, LISTEN_BACKLOG) == 0)
+                {
+                    listen_fd = fd;
+                    break;
+                }
+
+                last_error = std::strerror(errno);
+                ::close(fd);
+            }
+            freeaddrinfo(results);
+
+            if (listen_fd < 0)
+            {
+                throw std::runtime_error("Cannot listen on " + host + ":" + std::to_string(port) + ": " + last_error);
+            }
+        }
+
+        void Server::handleEvent(uint32_t)
+        {
+            acceptClients();
+        }
+
+        void Server::acceptClients()
+        {
+            while (true)
+            {
+                int fd = accept4(listen_fd, nullptr, nullptr, SOCK_NONBLOCK | SOCK_CLOEXEC);
+                if (fd < 0)
+                {
+                    if (errno == EINTR || errno == ECONNABORTED)
+                        continue;
+                    if (errno != EAGAIN && errno != EWOULDBLOCK)
+                    {
+                        std::cerr << "accept failed: " << std::strerror(errno) << "\n";
+                    }
+                    return;
+                }
+
+                int yes = 1;
+                setsockopt(fd, IPPROTO_TCP, TCP_NODELAY, &yes, sizeof(yes));
+
+                auto conn = std::make_unique<Connection>(fd, *this, loop, executor);
+                try
+                {
+                    loop.add(fd, EPOLLIN | EPOLLOUT | EPOLLRDHUP | EPOLLET, conn.get());
+                }
+                catch (const std::exception &e)
+                {
+                    std::cerr << e.what() << "\n";
+                    continue; // conn's destructor closes fd
+                }
+                connections[fd] = std::move(conn);
+            }
+        }
+
+        void Server::queueWrite(Connection *conn)
+        {
+            pending_writes.push_back(conn);
+        }
+
+        void Server::handlePendingWrites()
+        {
+            // Connections released this iteration are still alive here; their
+            // flushOutput() is a no-op.
+            for (Connection *conn : pending_writes)
+            {
+                conn->flushOutput();
+            }
+            pending_writes.clear();
+        }
+
+        void Server::release(Connection *conn)
+        {
+            released.push_back(conn->descriptor());
+        }
+
+        void Server::destroyReleased()
+        {
+            // A connection still waiting for replies from other cores stays
+            // alive (but silent) until the last one has come back.
+            size_t kept = 0;
+            for (int fd : released)
+            {
+                auto it = connections.find(fd);
+                if (it == connections.end())
+                    continue;
+                if (it->second->hasOutstanding())
+                {
+                    released[kept++] = fd;
+                    continue;
+                }
+                connections.erase(it);
+            }
+            released.resize(kept);
+        }
+
+        void Server::setRouter(CoreRouter *router)
+        {
+            core_router = router;
+            loop.setPendingWorkCheck([router]
+                                     { return router->hasPendingWork(); });
+        }
+
+        void Server::run()
+        {
+            loop.run();
+        }
+
+        void Server::stop()
+        {
+            loop.stop();
+        }
+
+    }
+}
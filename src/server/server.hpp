@@ -0,0 +1,103 @@
+/**
+ * @file server/server.hpp
+ * @brief TCP front end accepting clients and serving the cache
+ */
+
+#ifndef OPUS_SERVER_SERVER_HPP
+#define OPUS_SERVER_SERVER_HPP
+
+#include <memory>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+#include "connection.hpp"
+#include "event_loop.hpp"
+#include "command/executor.hpp"
+#include "storage/manager.hpp"
+
+namespace opus
+{
+    namespace server
+    {
+
+        class CoreRouter;
+
+        /**
+         * @class Server
+         * @brief Listening socket plus the event loop driving all its clients
+         *
+         * Every client is served from the thread that calls run(); there is no
+         * thread per connection. Closed connections are destroyed at the end of
+         * the loop iteration so handlers never observe a dangling pointer.
+         */
+        class Server : public EventHandler
+        {
+        private:
+            std::string host;
+            int port;
+            bool reuse_port;
+            int listen_fd = -1;
+            EventLoop loop;
+            storage::CacheManager &cache;
+            command::CommandExecutor executor;
+            std::unordered_map<int, std::unique_ptr<Connection>> connections;
+            std::vector<int> released;
+            std::vector<Connection *> pending_writes;
+            CoreRouter *core_router = nullptr;
+
+            void bindAndListen();
+            void acceptClients();
+            void handlePendingWrites();
+            void destroyReleased();
+
+        public:
+            /**
+             * @brief Binds host:port; throws std::runtime_error if that fails
+             * @param reuse_port Set SO_REUSEPORT so several servers (one per
+             *        core) can share the address
+             */
+            Server(std::string host, int port, storage::CacheManager &cache, bool reuse_port = false);
+            ~Server() override;
+
+            Server(const Server &) = delete;
+            Server &operator=(const Server &) = delete;
+
+            void handleEvent(uint32_t events) override;
+
+            /**
+             * @brief Serves clients until stop() is called
+             */
+            void run();
+
+            /**
+             * @brief Makes run() return; async-signal-safe
+             */
+            void stop();
+
+            /**
+             * @brief Schedules a connection's output for the end-of-iteration flush
+             */
+            void queueWrite(Connection *conn);
+
+            /**
+             * @brief Called by a connection that has closed itself
+             */
+            void release(Connection *conn);
+
+            /**
+             * @brief Hands commands for keys owned by other cores to `router`
+             */
+            void setRouter(CoreRouter *router);
+
+            CoreRouter *router() const { return core_router; }
+            EventLoop &eventLoop() { return loop; }
+            command::CommandExecutor &commandExecutor() { return executor; }
+
+            size_t connectionCount() const { return connections.size() - released.size(); }
+        };
+
+    }
+}
+
+#endif
@@ -0,0 +1,108 @@
+/**
+ * @file server/spsc_queue.hpp
+ * @brief Bounded lock-free single-producer single-consumer queue
+ */
+
+#ifndef OPUS_SERVER_SPSC_QUEUE_HPP
+#define OPUS_SERVER_SPSC_QUEUE_HPP
+
+#include <atomic>
+#include <cstddef>
+#include <memory>
+
+namespace opus
+{
+    namespace server
+    {
+
+        /**
+         * @class SpscQueue
+         * @brief Ring buffer of pointers between exactly one producer thread and
+         * one consumer thread
+         *
+         * Producer and consumer indices live on separate cache lines, and each
+         * side caches the other's index so that the shared line is only read
+         * when the cached view says the queue looks full (or empty).
+         */
+        template <typename T>
+        class SpscQueue
+        {
+        private:
+            static constexpr size_t CACHE_LINE = 64;
+
+            const size_t mask;
+            std::unique_ptr<T *[]> slots;
+
+            alignas(CACHE_LINE) std::atomic<size_t> tail{0}; // Written by the producer
+            size_t cached_head = 0;
+
+            alignas(CACHE_LINE) std::atomic<size_t> head{0}; // Written by the consumer
+            size_t cached_tail = 0;
+
+            static size_t roundUp(size_t n)
+            {
+                size_t capacity = 2;
+                while (capacity < n)
+                {
+                    capacity <<= 1;
+                }
+                return capacity;
+            }
+
+        public:
+            /**
+             * @param capacity Slot count; rounded up to a power of two
+             */
+            explicit SpscQueue(size_t capacity)
+                : mask(roundUp(capacity) - 1), slots(new T *[mask + 1]) {}
+
+            SpscQueue(const SpscQueue &) = delete;
+            SpscQueue &operator=(const SpscQueue &) = delete;
+
+            /**
+             * @brief Producer side; returns false if the queue is full
+             */
+            bool push(T *item)
+            {
+                size_t t = tail.load(std::memory_order_relaxed);
+                if (t - cached_head > mask)
+                {
+                    cached_head = head.load(std::memory_order_acquire);
+                    if (t - cached_head > mask)
+                        return false;
+                }
+                slots[t & mask] = item;
+                tail.store(t + 1, std::memory_order_release);
+                return true;
+            }
+
+            /**
+             * @brief Consumer side; returns nullptr if the queue is empty
+             */
+            T *pop()
+            {
+                size_t h = head.load(std::memory_order_relaxed);
+                if (h == cached_tail)
+                {
+                    cached_tail = tail.load(std::memory_order_acquire);
+                    if (h == cached_tail)
+                        return nullptr;
+                }
+                T *item = slots[h & mask];
+                head.store(h + 1, std::memory_order_release);
+                return item;
+            }
+
+            /**
+             * @brief Consumer side; true if an item may be waiting
+             */
+            bool hasItems() const
+            {
+                return head.load(std::memory_order_relaxed) != tail.load(std::memory_order_acquire);
+            }
+        };
+
+    }
+}
+
+#endif
@@ -1,5 +1,51 @@
 #include "base_datastructure.hpp"
 
-// Implementation file intentionally left minimal; the type is declared in the header.
+namespace opus
+{
+    namespace storage
+    {
 
-// No definitions needed here; header provides the abstract base.
\ No newline at end of file
+        std::string_view typeName(ValueType type)
+        {
+            switch (type)
+            {
+            case ValueType::STRING:
+                return "string";
+            case ValueType::LIST:
+                return "list";
+            case ValueType::SET:
+                return "set";
+            case ValueType::HASH:
+                return "hash";
+            case ValueType::ZSET:
+                return "zset";
+            }
+            return "none";
+        }
+
+        std::string_view encodingName(Encoding encoding)
+        {
+            switch (encoding)
+            {
+            case Encoding::INT:
+                return "int";
+            case Encoding::EMBSTR:
+                return "embstr";
+            case Encoding::RAW:
+                return "raw";
+            case Encoding::QUICKLIST:
+                return "quicklist";
+            case Encoding::INTSET:
+                return "intset";
+            case Encoding::LISTPACK:
+                return "listpack";
+            case Encoding::HASHTABLE:
+                return "hashtable";
+            case Encoding::SKIPLIST:
+                return "skiplist";
+            }
+            return "unknown";
+        }
+
+    } // namespace storage
+} // namespace opus
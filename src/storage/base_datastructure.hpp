@@ -1,18 +1,76 @@
 #ifndef OPUS_STORAGE_BASE_DATASTRUCTURE_HPP
 #define OPUS_STORAGE_BASE_DATASTRUCTURE_HPP
 
-#include <string>
+#include <cstddef>
+#include <cstdint>
+#include <string_view>
+
+#include "slab_allocator.hpp"
 
 namespace opus
 {
     namespace storage
     {
 
+        /**
+         * @brief Type tag of a stored value, as reported by TYPE
+         */
+        enum class ValueType : uint8_t
+        {
+            STRING,
+            LIST,
+            SET,
+            HASH,
+            ZSET
+        };
+
+        constexpr size_t VALUE_TYPE_COUNT = 5;
+
+        /**
+         * @brief How a value of a given type is laid out in memory
+         */
+        enum class Encoding : uint8_t
+        {
+            INT,        // string that is a canonical 64-bit integer, kept as a number
+            EMBSTR,     // string bytes stored inside the key's entry
+            RAW,        // string bytes in their own allocation
+            QUICKLIST,  // linked chunks of packed list elements
+            INTSET,     // sorted array of integer set members
+            LISTPACK,   // small collection packed into one buffer
+            HASHTABLE,  // hash table of set members or hash fields
+            SKIPLIST    // skiplist plus member index of a sorted set
+        };
+
+        std::string_view typeName(ValueType type);
+
+        /**
+         * @brief Encoding as reported by OBJECT ENCODING
+         */
+        std::string_view encodingName(Encoding encoding);
+
+        /**
+         * @brief Common base of the stored data types
+         *
+         * Deliberately not polymorphic: no vtable, no virtual destructor.
+         * Each type declares its tag as `static constexpr ValueType TYPE`,
+         * and the Entry holding it keeps the type and encoding tags in its
+         * header, so type checks are a byte compare instead of a
+         * dynamic_cast. Each also has an O(1) `size_t memoryUsage() const`,
+         * kept up to date by its own writes, which is what maxmemory,
+         * MEMORY USAGE and INFO memory add up.
+         *
+         * These objects are allocated from the slab allocator; deleting one
+         * through its own type passes the size back as slab blocks need.
+         */
         class BaseDataStructure
         {
         public:
-            virtual ~BaseDataStructure() = default;
-            virtual std::string getType() const = 0;
+            static void *operator new(size_t size) { return SlabAllocator::allocate(size); }
+            static void operator delete(void *ptr, size_t size) noexcept { SlabAllocator::deallocate(ptr, size); }
+
+        protected:
+            BaseDataStructure() = default;
+            ~BaseDataStructure() = default;
         };
 
     } // namespace storage
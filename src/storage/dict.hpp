@@ -0,0 +1,646 @@
+#ifndef OPUS_STORAGE_DICT_HPP
+#define OPUS_STORAGE_DICT_HPP
+
+#include <cstddef>
+#include <cstdint>
+#include <cstdlib>
+#include <cstring>
+#include <functional>
+#include <memory>
+#include <new>
+#include <string_view>
+#include <utility>
+
+#include <sys/mman.h>
+#include <unistd.h>
+
+#ifdef __SSE2__
+#include <emmintrin.h>
+#endif
+
+namespace opus
+{
+    namespace storage
+    {
+
+        namespace dict_detail
+        {
+            // Control byte per slot: a full slot has the top bit set plus the
+            // low 7 bits of its key's hash (H2). EMPTY is zero so a fresh
+            // control array comes straight from calloc, which for big tables
+            // means untouched zero pages rather than a memset pause.
+            constexpr int8_t CTRL_EMPTY = 0;
+            constexpr int8_t CTRL_DELETED = 1;
+
+            inline bool isFull(int8_t ctrl) { return ctrl < 0; }
+
+            constexpr size_t GROUP_WIDTH = 16;
+
+            inline unsigned lowestBit(uint32_t mask)
+            {
+                return static_cast<unsigned>(__builtin_ctz(mask));
+            }
+
+            /**
+             * @brief Sixteen control bytes matched at once (SSE2 when available)
+             *
+             * Each match returns a bitmask with bit i set when slot i of the
+             * group qualifies.
+             */
+            class Group
+            {
+            private:
+#ifdef __SSE2__
+                __m128i ctrl;
+#else
+                int8_t ctrl[GROUP_WIDTH];
+#endif
+
+            public:
+                explicit Group(const int8_t *pos)
+                {
+#ifdef __SSE2__
+                    ctrl = _mm_load_si128(reinterpret_cast<const __m128i *>(pos));
+#else
+                    std::memcpy(ctrl, pos, GROUP_WIDTH);
+#endif
+                }
+
+                uint32_t match(int8_t h2) const
+                {
+#ifdef __SSE2__
+                    return static_cast<uint32_t>(_mm_movemask_epi8(_mm_cmpeq_epi8(_mm_set1_epi8(h2), ctrl)));
+#else
+                    uint32_t mask = 0;
+                    for (size_t i = 0; i < GROUP_WIDTH; ++i)
+                        mask |= static_cast<uint32_t>(ctrl[i] == h2) << i;
+                    return mask;
+#endif
+                }
+
+                uint32_t matchEmpty() const
+                {
+                    return match(CTRL_EMPTY);
+                }
+
+                // Full slots are the only ones with the top bit set.
+                uint32_t matchFull() const
+                {
+#ifdef __SSE2__
+                    return static_cast<uint32_t>(_mm_movemask_epi8(ctrl));
+#else
+                    uint32_t mask = 0;
+                    for (size_t i = 0; i < GROUP_WIDTH; ++i)
+                        mask |= static_cast<uint32_t>(isFull(ctrl[i])) << i;
+                    return mask;
+#endif
+                }
+
+                uint32_t matchEmptyOrDeleted() const
+                {
+                    return ~matchFull() & 0xFFFFu;
+                }
+            };
+        }
+
+        /**
+         * @brief Open-addressing hash table for the keyspace
+         *
+         * SwissTable layout: entries are stored inline in a flat slot array
+         * (no allocation per key) next to one control byte per slot. A lookup
+         * hashes once, then compares 16 control bytes per probe step with a
+         * single SSE2 instruction, so the key itself is only compared on a
+         * 7-bit hash match. Probing goes group by group (triangular sequence).
+         *
+         * Growth never rehashes the whole table in one go. When the table is
+         * full a second, larger table is allocated; new entries go there and
+         * every write moves a few groups across, and rehashStep() lets idle
+         * time finish the job. Lookups consult both tables meanwhile.
+         *
+         * `Traits::key(const Entry &)` must return the entry's key as a
+         * std::string_view. Reads (find, scan, sample, forEach) never modify
+         * the table, so they may run concurrently under a shared lock.
+         */
+        template <typename Entry, typename Traits>
+        class Dict
+        {
+        private:
+            static constexpr size_t WIDTH = dict_detail::GROUP_WIDTH;
+
+            // Groups migrated by each write while a rehash is in progress.
+            static constexpr size_t REHASH_GROUPS_PER_WRITE = 2;
+
+            // Drained slot memory of the old table is handed back to the kernel
+            // in steps of this size during the rehash, so freeing the old table
+            // at the end does not unmap hundreds of megabytes in one call.
+            static constexpr size_t RELEASE_CHUNK = 1 << 20;
+
+            struct Table
+            {
+                int8_t *ctrl = nullptr;
+                Entry *slots = nullptr;
+                size_t group_mask = 0; // groups - 1
+                size_t size = 0;
+                size_t growth_left = 0;
+
+                size_t capacity() const { return ctrl ? (group_mask + 1) * WIDTH : 0; }
+            };
+
+            Table tables[2]; // [0] is the table being drained while rehashing
+            bool rehashing = false;
+            size_t rehash_group = 0;
+            size_t released_bytes = 0; // prefix of tables[0].slots already released
+
+            static size_t h1(size_t hash) { return hash >> 7; }
+            static int8_t h2(size_t hash) { return static_cast<int8_t>((hash & 0x7F) | 0x80); }
+
+            static Table allocate(size_t groups)
+            {
+                Table table;
+                size_t capacity = groups * WIDTH;
+                // malloc alignment is 16 on every 64-bit glibc target, which
+                // the aligned group loads rely on.
+                table.ctrl = static_cast<int8_t *>(std::calloc(capacity, 1));
+                if (!table.ctrl)
+                    throw std::bad_alloc();
+                table.slots = std::allocator<Entry>().allocate(capacity);
+                table.group_mask = groups - 1;
+                table.growth_left = capacity - capacity / 8; // 7/8 max load
+                return table;
+            }
+
+            static void release(Table &table, bool destroy_entries)
+            {
+                if (!table.ctrl)
+                    return;
+
+                size_t capacity = table.capacity();
+                if (destroy_entries)
+                {
+                    for (size_t i = 0; i < capacity; ++i)
+                    {
+                        if (dict_detail::isFull(table.ctrl[i]))
+                            table.slots[i].~Entry();
+                    }
+                }
+                std::allocator<Entry>().deallocate(table.slots, capacity);
+                std::free(table.ctrl);
+                table = Table();
+            }
+
+            static Entry *findIn(const Table &table, std::string_view key, size_t hash)
+            {
+                if (!table.ctrl)
+                    return nullptr;
+
+                size_t group = h1(hash) & table.group_mask;
+                for (size_t step = 1;; ++step)
+                {
+                    dict_detail::Group g(table.ctrl + group * WIDTH);
+                    for (uint32_t m = g.match(h2(hash)); m; m &= m - 1)
+                    {
+                        size_t slot = group * WIDTH + dict_detail::lowestBit(m);
+                        if (Traits::key(table.slots[slot]) == key)
+                            return &table.slots[slot];
+                    }
+                    if (g.matchEmpty() || step > table.group_mask)
+                        return nullptr;
+                    group = (group + step) & table.group_mask;
+                }
+            }
+
+            // First EMPTY or DELETED slot on the key's probe sequence.
+            static size_t findFreeSlot(const Table &table, size_t hash)
+            {
+                size_t group = h1(hash) & table.group_mask;
+                for (size_t step = 1;; ++step)
+                {
+                    dict_detail::Group g(table.ctrl + group * WIDTH);
+                    if (uint32_t m = g.matchEmptyOrDeleted())
+                        return group * WIDTH + dict_detail::lowestBit(m);
+                    group = (group + step) & table.group_mask;
+                }
+            }
+
+            static Entry *place(Table &table, size_t hash, Entry &&entry)
+            {
+                size_t slot = findFreeSlot(table, hash);
+                if (table.ctrl[slot] == dict_detail::CTRL_EMPTY)
+                    --table.growth_left;
+                table.ctrl[slot] = h2(hash);
+                ++table.size;
+                return new (&table.slots[slot]) Entry(std::move(entry));
+            }
+
+            static void eraseSlot(Table &table, size_t slot)
+            {
+                table.slots[slot].~Entry();
+                --table.size;
+
+                // A group that still has an EMPTY slot ends every probe
+                // sequence passing through it, so the slot can become EMPTY
+                // again; otherwise leave a tombstone to keep probes going.
+                size_t group_start = slot & ~(WIDTH - 1);
+                if (dict_detail::Group(table.ctrl + group_start).matchEmpty())
+                {
+                    table.ctrl[slot] = dict_detail::CTRL_EMPTY;
+                    ++table.growth_left;
+                }
+                else
+                {
+                    table.ctrl[slot] = dict_detail::CTRL_DELETED;
+                }
+            }
+
+            static bool eraseIn(Table &table, std::string_view key, size_t hash)
+            {
+                Entry *entry = findIn(table, key, hash);
+                if (!entry)
+                    return false;
+                eraseSlot(table, static_cast<size_t>(entry - table.slots));
+                return true;
+            }
+
+            Table &insertTable() { return rehashing ? tables[1] : tables[0]; }
+
+            void startRehash()
+            {
+                Table &current = tables[0];
+                size_t groups = current.ctrl ? current.group_mask + 1 : 1;
+
+                // Double when genuinely loaded; same size when the table is
+                // mostly tombstones.
+                if (current.size * 16 > current.capacity() * 7)
+                    groups *= 2;
+
+                if (!current.ctrl)
+                {
+                    tables[0] = allocate(groups);
+                    return;
+                }
+
+                tables[1] = allocate(groups);
+                rehashing = true;
+                rehash_group = 0;
+                released_bytes = 0;
+            }
+
+            // Only slot storage is released: the drained groups' control bytes
+            // (tombstones) are still read by probes into the old table.
+            void releaseDrainedSlots()
+            {
+                static const size_t page = static_cast<size_t>(sysconf(_SC_PAGESIZE));
+
+                uintptr_t base = reinterpret_cast<uintptr_t>(tables[0].slots);
+                uintptr_t drained = base + rehash_group * WIDTH * sizeof(Entry);
+                uintptr_t from = (base + released_bytes + page - 1) & ~(page - 1);
+                uintptr_t to = drained & ~(page - 1);
+                if (to <= from || to - from < RELEASE_CHUNK)
+                    return;
+
+                madvise(reinterpret_cast<void *>(from), to - from, MADV_DONTNEED);
+                released_bytes = to - base;
+            }
+
+            void finishRehash()
+            {
+                release(tables[0], false);
+                tables[0] = tables[1];
+                tables[1] = Table();
+                rehashing = false;
+            }
+
+            void migrateGroup(size_t group)
+            {
+                Table &from = tables[0];
+                dict_detail::Group g(from.ctrl + group * WIDTH);
+                for (uint32_t m = g.matchFull(); m; m &= m - 1)
+                {
+                    size_t slot = group * WIDTH + dict_detail::lowestBit(m);
+                    Entry &entry = from.slots[slot];
+                    size_t hash = hashKey(Traits::key(entry));
+                    place(tables[1], hash, std::move(entry));
+                    entry.~Entry();
+                    // Tombstone, so probes for keys still in the old table
+                    // keep walking past this group.
+                    from.ctrl[slot] = dict_detail::CTRL_DELETED;
+                    --from.size;
+                }
+            }
+
+            // Calls f(entry) for the entries of `table` whose probe sequence
+            // starts at group `home`. They all lie on that sequence no later
+            // than its first group with an EMPTY slot, where find() stops too.
+            template <typename F>
+            static void visitHome(const Table &table, size_t home, F &f)
+            {
+                size_t group = home;
+                for (size_t step = 1;; ++step)
+                {
+                    dict_detail::Group g(table.ctrl + group * WIDTH);
+                    for (uint32_t m = g.matchFull(); m; m &= m - 1)
+                    {
+                        const Entry &entry = table.slots[group * WIDTH + dict_detail::lowestBit(m)];
+                        if ((h1(hashKey(Traits::key(entry))) & table.group_mask) == home)
+                            f(entry);
+                    }
+                    if (g.matchEmpty() || step > table.group_mask)
+                        return;
+                    group = (group + step) & table.group_mask;
+                }
+            }
+
+            static size_t reverseBits(size_t v)
+            {
+                static_assert(sizeof(size_t) == 8, "64-bit cursors");
+                v = ((v >> 1) & 0x5555555555555555ULL) | ((v & 0x5555555555555555ULL) << 1);
+                v = ((v >> 2) & 0x3333333333333333ULL) | ((v & 0x3333333333333333ULL) << 2);
+                v = ((v >> 4) & 0x0F0F0F0F0F0F0F0FULL) | ((v & 0x0F0F0F0F0F0F0F0FULL) << 4);
+                return __builtin_bswap64(v);
+            }
+
+            void prepareInsert()
+            {
+                if (rehashing)
+                    rehashStep(REHASH_GROUPS_PER_WRITE);
+
+                if (insertTable().growth_left > 0)
+                    return;
+
+                if (rehashing)
+                {
+                    // Cannot happen with doubling, but never overfill.
+                    while (rehashStep(64))
+                    {
+                    }
+                }
+                startRehash();
+            }
+
+        public:
+            Dict() = default;
+            ~Dict()
+            {
+                release(tables[0], true);
+                release(tables[1], true);
+            }
+
+            Dict(const Dict &) = delete;
+            Dict &operator=(const Dict &) = delete;
+
+            static size_t hashKey(std::string_view key)
+            {
+                return std::hash<std::string_view>{}(key);
+            }
+
+            size_t size() const { return tables[0].size + tables[1].size; }
+            bool empty() const { return size() == 0; }
+            bool isRehashing() const { return rehashing; }
+
+            /**
+             * @brief Slots across both tables (for load and memory reporting)
+             */
+            size_t capacity() const { return tables[0].capacity() + tables[1].capacity(); }
+
+            /**
+             * @brief Bytes held by control bytes and slot arrays
+             */
+            size_t tableBytes() const { return capacity() * (sizeof(Entry) + 1); }
+
+            Entry *find(std::string_view key, size_t hash) const
+            {
+                if (Entry *entry = findIn(tables[0], key, hash))
+                    return entry;
+                return rehashing ? findIn(tables[1], key, hash) : nullptr;
+            }
+
+            Entry *find(std::string_view key) const { return find(key, hashKey(key)); }
+
+            /**
+             * @brief Starts loading the control group and slots that a find or
+             *        insert for `hash` probes first
+             *
+             * Batch operations call it a few keys ahead, so the cache misses
+             * of consecutive keys overlap instead of being paid one by one.
+             */
+            void prefetch(size_t hash) const
+            {
+                for (const Table &table : tables)
+                {
+                    if (!table.ctrl)
+                        continue;
+                    size_t first = (h1(hash) & table.group_mask) * WIDTH;
+                    __builtin_prefetch(table.ctrl + first);
+                    __builtin_prefetch(table.slots + first);
+                }
+            }
+
+            /**
+             * @brief Inserts an entry whose key is known to be absent
+             */
+            Entry *insertUnique(Entry &&entry, size_t hash)
+            {
+                prepareInsert();
+                return place(insertTable(), hash, std::move(entry));
+            }
+
+            bool erase(std::string_view key, size_t hash)
+            {
+                if (rehashing)
+                    rehashStep(REHASH_GROUPS_PER_WRITE);
+                if (eraseIn(tables[0], key, hash))
+                    return true;
+                return rehashing && eraseIn(tables[1], key, hash);
+            }
+
+            bool erase(std::string_view key) { return erase(key, hashKey(key)); }
+
+            /**
+             * @brief Erases the entry at `entry`, a pointer find() returned,
+             *        without probing for it again
+             */
+            void erase(Entry *entry)
+            {
+                const Table &old = tables[0];
+                Table &table = entry >= old.slots && entry < old.slots + old.capacity() ? tables[0] : tables[1];
+                eraseSlot(table, static_cast<size_t>(entry - table.slots));
+                if (rehashing)
+                    rehashStep(REHASH_GROUPS_PER_WRITE);
+            }
+
+            /**
+             * @brief Moves up to `groups` groups into the new table
+             * @return true while the rehash is still in progress
+             */
+            bool rehashStep(size_t groups)
+            {
+                if (!rehashing)
+                    return false;
+
+                size_t total = tables[0].group_mask + 1;
+                for (size_t n = 0; n < groups && rehash_group < total; ++n, ++rehash_group)
+                {
+                    migrateGroup(rehash_group);
+                }
+
+                if (rehash_group < total)
+                {
+                    releaseDrainedSlots();
+                    return true;
+                }
+                finishRehash();
+                return false;
+            }
+
+            void clear()
+            {
+                release(tables[0], true);
+                release(tables[1], true);
+                rehashing = false;
+                rehash_group = 0;
+            }
+
+            /**
+             * @brief Exchanges contents with `other` in O(1), rehash in
+             *        progress included
+             */
+            void swap(Dict &other) noexcept
+            {
+                std::swap(tables[0], other.tables[0]);
+                std::swap(tables[1], other.tables[1]);
+                std::swap(rehashing, other.rehashing);
+                std::swap(rehash_group, other.rehash_group);
+                std::swap(released_bytes, other.released_bytes);
+            }
+
+            /**
+             * @brief Visits up to `count` slots from `cursor` on, calling
+             *        f(entry) for the full ones
+             *
+             * A cursor indexes the slots of both tables in turn, so a scan
+             * that spans a resize may miss or repeat entries: fine for
+             * background sweeps that come round again. `f` must not modify
+             * the table.
+             * @return the cursor to continue from, 0 once the end is reached
+             */
+            template <typename F>
+            size_t scan(size_t cursor, size_t count, F &&f) const
+            {
+                size_t first = tables[0].capacity();
+                size_t total = first + tables[1].capacity();
+                size_t end = cursor + count < total ? cursor + count : total;
+                for (; cursor < end; ++cursor)
+                {
+                    const Table &table = cursor < first ? tables[0] : tables[1];
+                    size_t slot = cursor < first ? cursor : cursor - first;
+                    if (dict_detail::isFull(table.ctrl[slot]))
+                        f(table.slots[slot]);
+                }
+                return cursor < total ? cursor : 0;
+            }
+
+            /**
+             * @brief Calls f(entry) for the entries hashing to the group
+             *        `cursor` names, and returns the cursor naming the next
+             *        group to visit, 0 once all were
+             *
+             * This is Redis's dictScan over home groups: the cursor counts up
+             * with its bits reversed, so the groups a group splits into when
+             * the table doubles all come after it. A scan from cursor 0 to
+             * the next 0 therefore sees every entry that was in the table for
+             * the whole of it, even across resizes and with a rehash midway;
+             * an entry moved between tables meanwhile may be seen twice. Each
+             * call costs about one group's probe sequence per table. `f` must
+             * not modify the table.
+             */
+            template <typename F>
+            size_t scanGroup(size_t cursor, F &&f) const
+            {
+                if (!tables[0].ctrl)
+                    return 0;
+                if (!rehashing)
+                {
+                    size_t mask = tables[0].group_mask;
+                    visitHome(tables[0], cursor & mask, f);
+                    return reverseBits(reverseBits(cursor | ~mask) + 1);
+                }
+
+                // Visit the group in the smaller table, then every group of
+                // the larger one that it expands to.
+                const Table *small = &tables[0], *large = &tables[1];
+                if (small->group_mask > large->group_mask)
+                    std::swap(small, large);
+                size_t m0 = small->group_mask, m1 = large->group_mask;
+                visitHome(*small, cursor & m0, f);
+                do
+                {
+                    visitHome(*large, cursor & m1, f);
+                    cursor = (((cursor | m0) + 1) & ~m0) | (cursor & m0);
+                } while (cursor & (m0 ^ m1));
+                return reverseBits(reverseBits(cursor | ~m0) + 1);
+            }
+
+            /**
+             * @brief scan() with the entries handed out mutable, for sweeps
+             *        that update them in place; `f` must leave keys unchanged
+             */
+            template <typename F>
+            size_t scan(size_t cursor, size_t count, F &&f)
+            {
+                return std::as_const(*this).scan(cursor, count,
+                                                 [&](const Entry &entry) { f(const_cast<Entry &>(entry)); });
+            }
+
+            /**
+             * @brief Calls f(entry) for up to `count` entries found walking
+             *        the slots from `start` on, wrapping around
+             *
+             * With a random `start` this is a random sample at the cost of a
+             * few cache lines, in the manner of Redis's dictGetSomeKeys:
+             * neighbouring entries are not independent draws, which is good
+             * enough for picking eviction candidates. Only a nearly empty
+             * table makes the walk long. `f` must not modify the table.
+             */
+            template <typename F>
+            void sample(size_t start, size_t count, F &&f) const
+            {
+                size_t first = tables[0].capacity();
+                size_t groups = (first + tables[1].capacity()) / WIDTH;
+                if (count == 0 || empty())
+                    return;
+
+                size_t group = start % groups;
+                for (size_t visited = 0; visited < groups; ++visited, group = group + 1 < groups ? group + 1 : 0)
+                {
+                    size_t base = group * WIDTH;
+                    const Table &table = base < first ? tables[0] : tables[1];
+                    size_t offset = base < first ? base : base - first;
+                    dict_detail::Group g(table.ctrl + offset);
+                    for (uint32_t m = g.matchFull(); m; m &= m - 1)
+                    {
+                        f(table.slots[offset + dict_detail::lowestBit(m)]);
+                        if (--count == 0)
+                            return;
+                    }
+                }
+            }
+
+            template <typename F>
+            void forEach(F &&f) const
+            {
+                for (const Table &table : tables)
+                {
+                    size_t capacity = table.capacity();
+                    for (size_t i = 0; i < capacity; ++i)
+                    {
+                        if (dict_detail::isFull(table.ctrl[i]))
+                            f(table.slots[i]);
+                    }
+                }
+            }
+        };
+
+    } // namespace storage
+} // namespace opus
+
+#endif // OPUS_STORAGE_DICT_HPP
@@ -0,0 +1,341 @@
+#include "entry.hpp"
+
+#include <algorithm>
+#include <cstring>
+#include <new>
+#include <utility>
+
+namespace opus
+{
+    namespace storage
+    {
+
+        namespace
+        {
+            // A value object in a sparse page is move-constructed in a fuller
+            // one; its buffers and nodes move with it, untouched.
+            template <typename T>
+            T *relocateObject(T *object, size_t &moved)
+            {
+                if (!SlabAllocator::shouldMove(object, sizeof(T)))
+                    return object;
+                T *copy;
+                {
+                    SlabAllocator::DefragScope scope;
+                    copy = new T(std::move(*object));
+                }
+                delete object;
+                ++moved;
+                return copy;
+            }
+
+            template <typename T>
+            BaseDataStructure *defragObject(BaseDataStructure *object, size_t &moved)
+            {
+                T *relocated = relocateObject(static_cast<T *>(object), moved);
+                moved += relocated->defrag();
+                return relocated;
+            }
+        }
+
+        Entry::Entry(std::string_view key, ValueType type, Encoding encoding)
+            : object(nullptr), key_len(static_cast<uint32_t>(key.size())), embedded_len(0),
+              value_type(type), value_encoding(encoding), flags(0), lru{}
+        {
+            static_assert(offsetof(Entry, lru) + sizeof(lru) == DATA_OFFSET,
+                          "key bytes must start right after the header");
+            std::memcpy(data(), key.data(), key.size());
+        }
+
+        // Never less than sizeof(Entry), so the object itself is always
+        // fully backed even for a tiny key.
+        size_t Entry::allocationSize(size_t data_len)
+        {
+            return std::max(sizeof(Entry), DATA_OFFSET + data_len);
+        }
+
+        void *Entry::allocate(size_t data_len)
+        {
+            return SlabAllocator::allocate(allocationSize(data_len));
+        }
+
+        Entry *Entry::createString(std::string_view key, std::string_view value)
+        {
+            long long number;
+            if (StringType::parseInteger(value, number))
+                return createInteger(key, number);
+
+            if (value.size() <= MAX_EMBEDDED)
+            {
+                Entry *entry = new (allocate(key.size() + value.size())) Entry(key, ValueType::STRING, Encoding::EMBSTR);
+                entry->embedded_len = static_cast<uint32_t>(value.size());
+                std::memcpy(entry->data() + key.size(), value.data(), value.size());
+                return entry;
+            }
+
+            StringType *raw = new StringType(value);
+            void *memory;
+            try
+            {
+                memory = allocate(key.size());
+            }
+            catch (...)
+            {
+                delete raw;
+                throw;
+            }
+            Entry *entry = new (memory) Entry(key, ValueType::STRING, Encoding::RAW);
+            entry->raw = raw;
+            return entry;
+        }
+
+        Entry *Entry::createInteger(std::string_view key, long long value)
+        {
+            Entry *entry = new (allocate(key.size())) Entry(key, ValueType::STRING, Encoding::INT);
+            entry->number = value;
+            return entry;
+        }
+
+        template <>
+        Entry *Entry::create<ListType>(std::string_view key)
+        {
+            void *memory = allocate(key.size());
+            Entry *entry = new (memory) Entry(key, ValueType::LIST, Encoding::QUICKLIST);
+            try
+            {
+                entry->object = new ListType();
+            }
+            catch (...)
+            {
+                SlabAllocator::deallocate(memory, allocationSize(key.size()));
+                throw;
+            }
+            return entry;
+        }
+
+        template <>
+        Entry *Entry::create<SetType>(std::string_view key)
+        {
+            void *memory = allocate(key.size());
+            Entry *entry = new (memory) Entry(key, ValueType::SET, Encoding::INTSET);
+            try
+            {
+                entry->object = new SetType();
+            }
+            catch (...)
+            {
+                SlabAllocator::deallocate(memory, allocationSize(key.size()));
+                throw;
+            }
+            return entry;
+        }
+
+        template <>
+        Entry *Entry::create<HashType>(std::string_view key)
+        {
+            void *memory = allocate(key.size());
+            Entry *entry = new (memory) Entry(key, ValueType::HASH, Encoding::LISTPACK);
+            try
+            {
+                entry->object = new HashType();
+            }
+            catch (...)
+            {
+                SlabAllocator::deallocate(memory, allocationSize(key.size()));
+                throw;
+            }
+            return entry;
+        }
+
+        template <>
+        Entry *Entry::create<SortedSetType>(std::string_view key)
+        {
+            void *memory = allocate(key.size());
+            Entry *entry = new (memory) Entry(key, ValueType::ZSET, Encoding::LISTPACK);
+            try
+            {
+                entry->object = new SortedSetType();
+            }
+            catch (...)
+            {
+                SlabAllocator::deallocate(memory, allocationSize(key.size()));
+                throw;
+            }
+            return entry;
+        }
+
+        void Entry::destroy(Entry *entry)
+        {
+            switch (entry->value_type)
+            {
+            case ValueType::STRING:
+                if (entry->value_encoding == Encoding::RAW)
+                    StringType::release(entry->raw);
+                break;
+            case ValueType::LIST:
+                delete static_cast<ListType *>(entry->object);
+                break;
+            case ValueType::SET:
+                delete static_cast<SetType *>(entry->object);
+                break;
+            case ValueType::HASH:
+                delete static_cast<HashType *>(entry->object);
+                break;
+            case ValueType::ZSET:
+                delete static_cast<SortedSetType *>(entry->object);
+                break;
+            }
+            size_t bytes = allocationSize(entry->key_len + entry->embedded_len);
+            entry->~Entry();
+            SlabAllocator::deallocate(entry, bytes);
+        }
+
+        size_t Entry::memoryUsage() const
+        {
+            size_t bytes = SlabAllocator::usableSize(allocationSize(key_len + embedded_len));
+            switch (value_type)
+            {
+            case ValueType::STRING:
+                return value_encoding == Encoding::RAW ? bytes + raw->memoryUsage() : bytes;
+            case ValueType::LIST:
+                return bytes + static_cast<const ListType *>(object)->memoryUsage();
+            case ValueType::SET:
+                return bytes + static_cast<const SetType *>(object)->memoryUsage();
+            case ValueType::HASH:
+                return bytes + static_cast<const HashType *>(object)->memoryUsage();
+            case ValueType::ZSET:
+                return bytes + static_cast<const SortedSetType *>(object)->memoryUsage();
+            }
+            return bytes;
+        }
+
+        size_t Entry::freeEffort() const
+        {
+            switch (value_type)
+            {
+            case ValueType::STRING:
+                return 1;
+            case ValueType::LIST:
+                return static_cast<const ListType *>(object)->chunkCount();
+            case ValueType::SET:
+            {
+                auto set = static_cast<const SetType *>(object);
+                return set->encoding() == Encoding::HASHTABLE ? static_cast<size_t>(set->scard()) : 1;
+            }
+            case ValueType::HASH:
+            {
+                auto hash = static_cast<const HashType *>(object);
+                return hash->encoding() == Encoding::HASHTABLE ? static_cast<size_t>(hash->hlen()) : 1;
+            }
+            case ValueType::ZSET:
+            {
+                auto zset = static_cast<const SortedSetType *>(object);
+                return zset->encoding() == Encoding::SKIPLIST ? static_cast<size_t>(zset->zcard()) : 1;
+            }
+            }
+            return 1;
+        }
+
+        size_t Entry::defragValue()
+        {
+            size_t moved = 0;
+            switch (value_type)
+            {
+            case ValueType::STRING:
+                // A string a reply has pinned must stay where the reply
+                // points.
+                if (value_encoding == Encoding::RAW && !raw->shared())
+                {
+                    raw = relocateObject(raw, moved);
+                    moved += raw->defrag() ? 1 : 0;
+                }
+                break;
+            case ValueType::LIST:
+                object = defragObject<ListType>(object, moved);
+                break;
+            case ValueType::SET:
+                object = defragObject<SetType>(object, moved);
+                break;
+            case ValueType::HASH:
+                object = defragObject<HashType>(object, moved);
+                break;
+            case ValueType::ZSET:
+                object = defragObject<SortedSetType>(object, moved);
+                break;
+            }
+            return moved;
+        }
+
+        Entry *Entry::relocate(Entry *entry)
+        {
+            size_t bytes = allocationSize(entry->key_len + entry->embedded_len);
+            return static_cast<Entry *>(SlabAllocator::relocate(entry, bytes));
+        }
+
+        std::string_view Entry::stringBytes() const
+        {
+            if (value_encoding == Encoding::RAW)
+                return raw->view();
+            return std::string_view(data() + key_len, embedded_len);
+        }
+
+        std::string Entry::stringValue() const
+        {
+            if (value_encoding == Encoding::INT)
+            {
+                char buf[StringType::MAX_INTEGER_DIGITS];
+                return std::string(buf, StringType::formatInteger(number, buf));
+            }
+            return std::string(stringBytes());
+        }
+
+        BorrowedString::BorrowedString(const Entry &entry)
+        {
+            if (entry.value_encoding == Encoding::INT)
+                bytes = std::string_view(digits, StringType::formatInteger(entry.number, digits));
+            else
+                bytes = entry.stringBytes();
+            if (entry.value_encoding == Encoding::RAW)
+                raw = entry.raw;
+        }
+
+        std::shared_ptr<const void> BorrowedString::pin() const
+        {
+            if (!raw)
+                return nullptr;
+            raw->retain();
+            return std::shared_ptr<const void>(raw, [](const void *string)
+                                               { StringType::release(static_cast<const StringType *>(string)); });
+        }
+
+        bool Entry::integerValue(long long &out) const
+        {
+            if (value_encoding == Encoding::INT)
+            {
+                out = number;
+                return true;
+            }
+            return StringType::parseInteger(stringBytes(), out);
+        }
+
+        bool Entry::floatValue(long double &out) const
+        {
+            if (value_encoding == Encoding::INT)
+            {
+                out = static_cast<long double>(number);
+                return true;
+            }
+            return StringType::parseFloat(stringBytes(), out);
+        }
+
+        void Entry::setInteger(long long value)
+        {
+            if (value_encoding == Encoding::RAW)
+                StringType::release(raw);
+            // embedded_len stays: it still sizes the allocation.
+            value_encoding = Encoding::INT;
+            number = value;
+        }
+
+    } // namespace storage
+} // namespace opus
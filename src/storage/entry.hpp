@@ -0,0 +1,321 @@
+#ifndef OPUS_STORAGE_ENTRY_HPP
+#define OPUS_STORAGE_ENTRY_HPP
+
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <string_view>
+#include <type_traits>
+
+#include "base_datastructure.hpp"
+#include "string_type.hpp"
+#include "list_type.hpp"
+#include "set_type.hpp"
+#include "hash_type.hpp"
+#include "sorted_set_type.hpp"
+
+namespace opus
+{
+    namespace storage
+    {
+
+        /**
+         * @brief One key and its value, in a single allocation
+         *
+         * Layout: a 22-byte header (payload pointer, key length, embedded
+         * value length, type tag, encoding tag, flags, access clock), then the
+         * key bytes, then, for short strings, the value bytes. A SET of a 40
+         * byte key and a 60 byte value is therefore one 122 byte allocation. Strings that are
+         * canonical integers keep the number in the payload word instead (INT
+         * encoding), longer strings spill to a separately allocated StringType
+         * (RAW encoding), and the collection types live behind the payload
+         * pointer.
+         *
+         * Entries are created and destroyed only through the static factories
+         * and destroy(); the keyspace holds them through EntryPtr.
+         */
+        class Entry
+        {
+        private:
+            friend class BorrowedString;
+
+            union
+            {
+                BaseDataStructure *object; // LIST, SET, HASH, ZSET
+                StringType *raw;           // STRING with RAW encoding
+                long long number;          // STRING with INT encoding
+            };
+            uint32_t key_len;
+            uint32_t embedded_len;
+            ValueType value_type;
+            Encoding value_encoding;
+            uint8_t flags;
+            uint8_t lru[3]; // 24-bit access clock or LFU stamp, little-endian
+
+            static constexpr size_t DATA_OFFSET = 22;
+
+            // The key has a TTL, recorded in the keyspace's expiry table.
+            static constexpr uint8_t FLAG_EXPIRING = 1 << 0;
+
+            // A ValueReader is attached to the value (see CacheManager).
+            static constexpr uint8_t FLAG_READERS = 1 << 1;
+
+            Entry(std::string_view key, ValueType type, Encoding encoding);
+
+            static size_t allocationSize(size_t data_len);
+            static void *allocate(size_t data_len);
+
+            char *data() { return reinterpret_cast<char *>(this) + DATA_OFFSET; }
+            const char *data() const { return reinterpret_cast<const char *>(this) + DATA_OFFSET; }
+
+            // Value bytes of an EMBSTR or RAW string.
+            std::string_view stringBytes() const;
+
+        public:
+            // Strings up to this length are stored inside the entry.
+            static constexpr size_t MAX_EMBEDDED = 256;
+
+            // Access clocks count modulo 2^24.
+            static constexpr uint32_t LRU_CLOCK_MAX = (1u << 24) - 1;
+
+            /**
+             * @brief A string entry, integer-encoded when `value` is the
+             *        canonical form of a 64-bit integer
+             */
+            static Entry *createString(std::string_view key, std::string_view value);
+            static Entry *createInteger(std::string_view key, long long value);
+
+            /**
+             * @brief An entry holding a new, empty collection of type T
+             */
+            template <typename T>
+            static Entry *create(std::string_view key);
+
+            static void destroy(Entry *entry);
+
+            Entry(const Entry &) = delete;
+            Entry &operator=(const Entry &) = delete;
+
+            std::string_view key() const { return std::string_view(data(), key_len); }
+            ValueType type() const { return value_type; }
+
+            /**
+             * @brief Whether the key has a TTL; the deadline itself is kept by
+             *        the keyspace, so keys without one pay a single bit
+             */
+            bool hasExpiry() const { return flags & FLAG_EXPIRING; }
+            void setHasExpiry(bool expiring)
+            {
+                flags = expiring ? (flags | FLAG_EXPIRING) : (flags & ~FLAG_EXPIRING);
+            }
+
+            bool hasReaders() const { return flags & FLAG_READERS; }
+            void setHasReaders(bool readers)
+            {
+                flags = readers ? (flags | FLAG_READERS) : (flags & ~FLAG_READERS);
+            }
+
+            /**
+             * @brief Clock value of the last access, for approximated LRU
+             *
+             * Under an LFU policy the manager keeps a minute stamp in the top
+             * 16 bits and a frequency counter in the low 8 instead.
+             *
+             * Stamped by readers that may hold only a shared lock, so the
+             * bytes are read and written with relaxed atomics.
+             */
+            uint32_t lruClock() const
+            {
+                uint32_t clock = 0;
+                for (int i = 0; i < 3; ++i)
+                    clock |= static_cast<uint32_t>(__atomic_load_n(&lru[i], __ATOMIC_RELAXED)) << (8 * i);
+                return clock;
+            }
+
+            void setLruClock(uint32_t clock)
+            {
+                for (int i = 0; i < 3; ++i)
+                    __atomic_store_n(&lru[i], static_cast<uint8_t>(clock >> (8 * i)), __ATOMIC_RELAXED);
+            }
+
+            /**
+             * @brief Estimated bytes held by the entry and its value; O(1)
+             */
+            size_t memoryUsage() const;
+
+            /**
+             * @brief Roughly how many allocations freeing the value takes:
+             *        chunks of a list, elements of a set, hash or sorted set
+             *        kept in a table, 1 for anything packed; O(1)
+             */
+            size_t freeEffort() const;
+
+            /**
+             * @brief Moves the value's object and its buffers, chunks or nodes
+             *        out of sparsely used allocator pages
+             * @return blocks moved
+             */
+            size_t defragValue();
+
+            /**
+             * @brief Moves the entry itself out of a sparsely used allocator
+             *        page
+             *
+             * Returns the new address, or nullptr if the entry stays. The old
+             * address is freed, so whatever else points at the entry must be
+             * found before the call.
+             */
+            static Entry *relocate(Entry *entry);
+
+            /**
+             * @brief Current encoding; sets, hashes and sorted sets report
+             *        their own, since they change representation as they grow
+             */
+            Encoding encoding() const
+            {
+                switch (value_type)
+                {
+                case ValueType::SET:
+                    return static_cast<const SetType *>(object)->encoding();
+                case ValueType::HASH:
+                    return static_cast<const HashType *>(object)->encoding();
+                case ValueType::ZSET:
+                    return static_cast<const SortedSetType *>(object)->encoding();
+                default:
+                    return value_encoding;
+                }
+            }
+
+            /**
+             * @brief A STRING value as bytes; INT values are formatted here
+             */
+            std::string stringValue() const;
+
+            /**
+             * @brief Reads a STRING value as an integer (INCR semantics)
+             * @return false if the value is not a canonical integer
+             */
+            bool integerValue(long long &out) const;
+
+            /**
+             * @brief Reads a STRING value as a float (INCRBYFLOAT semantics)
+             */
+            bool floatValue(long double &out) const;
+
+            /**
+             * @brief Stores `value` in place, switching the entry to INT
+             *
+             * Any embedded bytes stay allocated, and counted, but unused until
+             * the key is next rewritten; a RAW buffer is freed.
+             */
+            void setInteger(long long value);
+
+            /**
+             * @brief The collection held by this entry, or nullptr if it holds
+             *        another type
+             */
+            template <typename T>
+            T *as()
+            {
+                static_assert(!std::is_same_v<T, StringType>, "strings are read through stringValue()");
+                return value_type == T::TYPE ? static_cast<T *>(object) : nullptr;
+            }
+        };
+
+        template <>
+        Entry *Entry::create<ListType>(std::string_view key);
+
+        template <>
+        Entry *Entry::create<SetType>(std::string_view key);
+
+        template <>
+        Entry *Entry::create<HashType>(std::string_view key);
+
+        template <>
+        Entry *Entry::create<SortedSetType>(std::string_view key);
+
+        /**
+         * @brief A STRING value read in place, for replies that should not
+         *        copy it
+         *
+         * view() is valid while the key is neither written nor deleted, i.e.
+         * for as long as its shard stays locked. A value in its own
+         * allocation (RAW) can also be pinned past that.
+         */
+        class BorrowedString
+        {
+        private:
+            char digits[StringType::MAX_INTEGER_DIGITS]; // INT values, formatted
+            std::string_view bytes;
+            const StringType *raw = nullptr;
+
+        public:
+            explicit BorrowedString(const Entry &entry);
+
+            BorrowedString(const BorrowedString &) = delete;
+            BorrowedString &operator=(const BorrowedString &) = delete;
+
+            std::string_view view() const { return bytes; }
+
+            /**
+             * @brief A handle that keeps view() valid for as long as it
+             *        lives, or null for values stored inside the entry
+             *        (which have to be copied)
+             */
+            std::shared_ptr<const void> pin() const;
+        };
+
+        /**
+         * @brief Owning handle to an Entry, as stored in the keyspace slots
+         */
+        class EntryPtr
+        {
+        private:
+            Entry *entry = nullptr;
+
+        public:
+            EntryPtr() = default;
+            explicit EntryPtr(Entry *entry) : entry(entry) {}
+
+            EntryPtr(EntryPtr &&other) noexcept : entry(other.entry)
+            {
+                other.entry = nullptr;
+            }
+
+            EntryPtr &operator=(EntryPtr &&other) noexcept
+            {
+                if (this != &other)
+                {
+                    reset();
+                    entry = other.entry;
+                    other.entry = nullptr;
+                }
+                return *this;
+            }
+
+            EntryPtr(const EntryPtr &) = delete;
+            EntryPtr &operator=(const EntryPtr &) = delete;
+
+            ~EntryPtr() { reset(); }
+
+            void reset()
+            {
+                if (entry)
+                    Entry::destroy(entry);
+                entry = nullptr;
+            }
+
+            /**
+             * @brief Takes the entry's new address after Entry::relocate()
+             */
+            void relocated(Entry *moved) { entry = moved; }
+
+            Entry *get() const { return entry; }
+            Entry *operator->() const { return entry; }
+            Entry &operator*() const { return *entry; }
+        };
+
+    } // namespace storage
+} // namespace opus
+
+#endif // OPUS_STORAGE_ENTRY_HPP
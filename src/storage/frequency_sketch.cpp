@@ -0,0 +1,144 @@
+#include "frequency_sketch.hpp"
+
+namespace opus
+{
+    namespace storage
+    {
+
+        namespace
+        {
+            // One multiplier per sketch row, so the four counters of a key
+            // land in unrelated words.
+            constexpr uint64_t ROW_SEEDS[4] = {0xC3A5C85C97CB3127ULL, 0xB492B66FBE98F273ULL, 0x9AE16A3B2F90404FULL,
+                                               0xCBF29CE484222325ULL};
+
+            // Doorkeeper probes per key.
+            constexpr unsigned DOORKEEPER_HASHES = 3;
+
+            // Keeps the low bits of the incoming hash from deciding everything:
+            // std::hash need not mix well, and the shard choice already used
+            // its high bits.
+            uint64_t spread(uint64_t hash)
+            {
+                hash *= 0x9E3779B97F4A7C15ULL;
+                return hash ^ (hash >> 32);
+            }
+
+            size_t ceilPowerOfTwo(size_t n)
+            {
+                size_t power = 1;
+                while (power < n)
+                    power <<= 1;
+                return power;
+            }
+        }
+
+        FrequencySketch::FrequencySketch(size_t capacity)
+        {
+            size_t words = ceilPowerOfTwo(capacity < 64 ? 64 : capacity);
+            table.reset(new std::atomic<uint64_t>[words]);
+            table_mask = words - 1;
+
+            // One byte of doorkeeper per key keeps its false positives near
+            // 3% with three probes.
+            doorkeeper.reset(new std::atomic<uint64_t>[words / 8]);
+            doorkeeper_mask = words * 8 - 1;
+
+            for (size_t i = 0; i < words; ++i)
+                table[i].store(0, std::memory_order_relaxed);
+            for (size_t i = 0; i < words / 8; ++i)
+                doorkeeper[i].store(0, std::memory_order_relaxed);
+            sample_size = words * 10;
+        }
+
+        bool FrequencySketch::doorkeeperContains(uint64_t hash) const
+        {
+            uint64_t step = (hash >> 32) | 1;
+            for (unsigned i = 0; i < DOORKEEPER_HASHES; ++i)
+            {
+                size_t bit = (hash + i * step) & doorkeeper_mask;
+                if (!(doorkeeper[bit >> 6].load(std::memory_order_relaxed) & (1ULL << (bit & 63))))
+                    return false;
+            }
+            return true;
+        }
+
+        bool FrequencySketch::doorkeeperPut(uint64_t hash)
+        {
+            uint64_t step = (hash >> 32) | 1;
+            bool added = false;
+            for (unsigned i = 0; i < DOORKEEPER_HASHES; ++i)
+            {
+                size_t bit = (hash + i * step) & doorkeeper_mask;
+                uint64_t mask = 1ULL << (bit & 63);
+                if (!(doorkeeper[bit >> 6].load(std::memory_order_relaxed) & mask))
+                {
+                    doorkeeper[bit >> 6].fetch_or(mask, std::memory_order_relaxed);
+                    added = true;
+                }
+            }
+            return added;
+        }
+
+        void FrequencySketch::increment(uint64_t hash)
+        {
+            hash = spread(hash);
+            if (!doorkeeperPut(hash))
+            {
+                // Each row uses its own nibble out of a group of four picked
+                // by the key, so rows never share a counter.
+                unsigned start = static_cast<unsigned>(hash & 3) << 2;
+                for (unsigned row = 0; row < 4; ++row)
+                {
+                    uint64_t index = (hash + ROW_SEEDS[row]) * ROW_SEEDS[row];
+                    index += index >> 32;
+                    std::atomic<uint64_t> &word = table[index & table_mask];
+                    unsigned shift = (start + row) << 2;
+                    uint64_t value = word.load(std::memory_order_relaxed);
+                    if (((value >> shift) & 0xF) < MAX_FREQUENCY)
+                        word.store(value + (1ULL << shift), std::memory_order_relaxed);
+                }
+            }
+
+            // Exactly one caller sees the count reach the sample size, and the
+            // reset takes it back down by half, so aging keeps recurring.
+            if (additions.fetch_add(1, std::memory_order_relaxed) + 1 == sample_size)
+                reset();
+        }
+
+        unsigned FrequencySketch::frequency(uint64_t hash) const
+        {
+            hash = spread(hash);
+            unsigned start = static_cast<unsigned>(hash & 3) << 2;
+            unsigned frequency = MAX_FREQUENCY;
+            for (unsigned row = 0; row < 4; ++row)
+            {
+                uint64_t index = (hash + ROW_SEEDS[row]) * ROW_SEEDS[row];
+                index += index >> 32;
+                unsigned shift = (start + row) << 2;
+                unsigned count = (table[index & table_mask].load(std::memory_order_relaxed) >> shift) & 0xF;
+                if (count < frequency)
+                    frequency = count;
+            }
+            return doorkeeperContains(hash) ? frequency + 1 : frequency;
+        }
+
+        void FrequencySketch::reset()
+        {
+            for (size_t i = 0; i <= table_mask; ++i)
+            {
+                uint64_t value = table[i].load(std::memory_order_relaxed);
+                table[i].store((value >> 1) & 0x7777777777777777ULL, std::memory_order_relaxed);
+            }
+            for (size_t i = 0; i <= doorkeeper_mask >> 6; ++i)
+                doorkeeper[i].store(0, std::memory_order_relaxed);
+            additions.fetch_sub(sample_size / 2, std::memory_order_relaxed);
+        }
+
+        size_t FrequencySketch::bytes() const
+        {
+            return (table_mask + 1 + ((doorkeeper_mask + 1) >> 6)) * sizeof(uint64_t);
+        }
+
+    } // namespace storage
+} // namespace opus
@@ -0,0 +1,78 @@
+#ifndef OPUS_STORAGE_FREQUENCY_SKETCH_HPP
+#define OPUS_STORAGE_FREQUENCY_SKETCH_HPP
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+
+namespace opus
+{
+    namespace storage
+    {
+
+        /**
+         * @brief Approximate access counts for W-TinyLFU admission
+         *
+         * A count-min sketch of 4-bit counters, sixteen to a 64-bit word, in
+         * front of which sits a doorkeeper Bloom filter: a key's first access
+         * only sets its doorkeeper bits, so the one-off keys that make up most
+         * of a scan never reach the counters. After ten accesses per tracked
+         * key every counter is halved and the doorkeeper cleared, so old
+         * popularity fades.
+         *
+         * Counter words are updated with relaxed loads and stores rather than
+         * read-modify-write: two threads bumping the same word at once may
+         * lose one increment, which an estimate can afford.
+         */
+        class FrequencySketch
+        {
+        private:
+            std::unique_ptr<std::atomic<uint64_t>[]> table;
+            std::unique_ptr<std::atomic<uint64_t>[]> doorkeeper;
+            size_t table_mask;
+            size_t doorkeeper_mask; // in bits
+            size_t sample_size;
+            std::atomic<size_t> additions{0};
+
+            bool doorkeeperContains(uint64_t hash) const;
+
+            // Sets the key's doorkeeper bits; false if they were all set.
+            bool doorkeeperPut(uint64_t hash);
+
+            void reset();
+
+        public:
+            // Counters saturate here.
+            static constexpr unsigned MAX_FREQUENCY = 15;
+
+            /**
+             * @param capacity Number of distinct keys expected to be tracked;
+             *        the sketch takes about 9 bytes per key
+             */
+            explicit FrequencySketch(size_t capacity);
+
+            FrequencySketch(const FrequencySketch &) = delete;
+            FrequencySketch &operator=(const FrequencySketch &) = delete;
+
+            /**
+             * @brief Records one access of the key with this hash
+             */
+            void increment(uint64_t hash);
+
+            /**
+             * @brief Estimated accesses since the last aging, at most
+             *        MAX_FREQUENCY + 1; never an underestimate
+             */
+            unsigned frequency(uint64_t hash) const;
+
+            /**
+             * @brief Heap bytes held by the counters and the doorkeeper
+             */
+            size_t bytes() const;
+        };
+
+    } // namespace storage
+} // namespace opus
+
+#endif // OPUS_STORAGE_FREQUENCY_SKETCH_HPP
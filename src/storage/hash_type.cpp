@@ -0,0 +1,207 @@
+#include "hash_type.hpp"
+#include "string_type.hpp"
+
+#include <cstdint>
+#include <stdexcept>
+
+namespace opus
+{
+    namespace storage
+    {
+
+        HashType::Limits HashType::limits;
+
+        HashType::HashType() = default;
+
+        HashType::~HashType() = default;
+
+        HashType::HashType(HashType &&other) noexcept = default;
+
+        size_t HashType::defrag()
+        {
+            if (auto *listpack = std::get_if<Listpack>(&fields))
+                return listpack->defrag() ? 1 : 0;
+            Table &table = *std::get<std::unique_ptr<Table>>(fields);
+            return defragTable(table) ? table.size() : 0;
+        }
+
+        void HashType::setLimits(const Limits &new_limits)
+        {
+            limits = new_limits;
+        }
+
+        Encoding HashType::encoding() const
+        {
+            return std::holds_alternative<Listpack>(fields) ? Encoding::LISTPACK : Encoding::HASHTABLE;
+        }
+
+        size_t HashType::pairBytes(const Table::value_type &pair)
+        {
+            return StringType::heapBytes(pair.first.capacity()) + StringType::heapBytes(pair.second.capacity());
+        }
+
+        size_t HashType::memoryUsage() const
+        {
+            if (const Listpack *packed = std::get_if<Listpack>(&fields))
+                return sizeof(HashType) + packed->bytes();
+            const Table &table = *std::get<std::unique_ptr<Table>>(fields);
+            return sizeof(HashType) + sizeof(Table) + table.bucket_count() * sizeof(void *) +
+                   table.size() * TABLE_NODE_BYTES + string_bytes;
+        }
+
+        HashType::Table &HashType::convertToTable()
+        {
+            const Listpack &packed = std::get<Listpack>(fields);
+            auto table = std::make_unique<Table>();
+            table->reserve(packed.size() / 2 + 1);
+            for (size_t offset = 0, next; offset < packed.end(); offset = next)
+            {
+                std::string_view field = packed.at(offset, next);
+                auto it = table->emplace(field, packed.at(next, next)).first;
+                string_bytes += pairBytes(*it);
+            }
+            fields = std::move(table);
+            return *std::get<std::unique_ptr<Table>>(fields);
+        }
+
+        bool HashType::store(std::string_view field, std::string_view value)
+        {
+            if (Listpack *packed = std::get_if<Listpack>(&fields))
+            {
+                bool fits = field.size() <= limits.max_listpack_value && value.size() <= limits.max_listpack_value;
+                size_t offset = packed->find(field, 2);
+                if (offset != Listpack::npos && fits)
+                {
+                    size_t value_offset;
+                    packed->at(offset, value_offset);
+                    packed->replace(value_offset, value);
+                    return false;
+                }
+                if (offset == Listpack::npos && fits && packed->size() / 2 < limits.max_listpack_entries)
+                {
+                    packed->append(field);
+                    packed->append(value);
+                    return true;
+                }
+                convertToTable();
+            }
+
+            Table &table = *std::get<std::unique_ptr<Table>>(fields);
+            auto [it, inserted] = table.try_emplace(std::string(field), value);
+            if (!inserted)
+            {
+                string_bytes -= pairBytes(*it);
+                it->second = value;
+            }
+            string_bytes += pairBytes(*it);
+            return inserted;
+        }
+
+        int HashType::hset(const std::string &field, const std::string &value)
+        {
+            return store(field, value) ? 1 : 0;
+        }
+
+        std::optional<std::string> HashType::hget(std::string_view field) const
+        {
+            if (const Listpack *packed = std::get_if<Listpack>(&fields))
+            {
+                size_t offset = packed->find(field, 2);
+                if (offset == Listpack::npos)
+                    return std::nullopt;
+                size_t value_offset, next;
+                packed->at(offset, value_offset);
+                return std::string(packed->at(value_offset, next));
+            }
+
+            // C++17 unordered containers probe with a key_type only.
+            const Table &table = *std::get<std::unique_ptr<Table>>(fields);
+            auto it = table.find(std::string(field));
+            if (it == table.end())
+                return std::nullopt;
+            return it->second;
+        }
+
+        bool HashType::hexists(std::string_view field) const
+        {
+            if (const Listpack *packed = std::get_if<Listpack>(&fields))
+                return packed->find(field, 2) != Listpack::npos;
+            return std::get<std::unique_ptr<Table>>(fields)->count(std::string(field)) != 0;
+        }
+
+        int HashType::hdel(std::string_view field)
+        {
+            if (Listpack *packed = std::get_if<Listpack>(&fields))
+            {
+                size_t offset = packed->find(field, 2);
+                if (offset == Listpack::npos)
+                    return 0;
+                // The value slides down into the field's place.
+                packed->erase(offset);
+                packed->erase(offset);
+                return 1;
+            }
+            Table &table = *std::get<std::unique_ptr<Table>>(fields);
+            auto it = table.find(std::string(field));
+            if (it == table.end())
+                return 0;
+            string_bytes -= pairBytes(*it);
+            table.erase(it);
+            return 1;
+        }
+
+        int HashType::hlen() const
+        {
+            if (const Listpack *packed = std::get_if<Listpack>(&fields))
+                return packed->size() / 2;
+            return std::get<std::unique_ptr<Table>>(fields)->size();
+        }
+
+        long long HashType::hincrby(std::string_view field, long long delta)
+        {
+            long long current = 0;
+            if (auto value = hget(field))
+            {
+                if (!StringType::parseInteger(*value, current))
+                    throw std::runtime_error("ERR hash value is not an integer");
+            }
+
+            long long result;
+            if (__builtin_add_overflow(current, delta, &result))
+                throw std::runtime_error("ERR increment or decrement would overflow");
+
+            char buf[StringType::MAX_INTEGER_DIGITS];
+            store(field, std::string_view(buf, StringType::formatInteger(result, buf)));
+            return result;
+        }
+
+        std::vector<HashType::FieldValue> HashType::hgetall() const
+        {
+            std::vector<FieldValue> result;
+            result.reserve(hlen());
+            visitPairs(0, SIZE_MAX, [&](std::string_view field, std::string_view value)
+                       { result.emplace_back(field, value); });
+            return result;
+        }
+
+        unsigned long long HashType::hscan(unsigned long long cursor, size_t count, std::vector<FieldValue> &out) const
+        {
+            auto append = [&](std::string_view field, std::string_view value)
+            { out.emplace_back(field, value); };
+            // A compact hash is returned whole, as Redis does; the client's
+            // cursor is never used as an offset into it.
+            if (std::holds_alternative<Listpack>(fields))
+            {
+                visitPairs(0, SIZE_MAX, append);
+                return 0;
+            }
+            return visitPairs(static_cast<size_t>(cursor), count, append);
+        }
+
+        bool HashType::isEmpty() const
+        {
+            return hlen() == 0;
+        }
+
+    } // namespace storage
+} // namespace opus
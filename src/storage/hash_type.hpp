@@ -0,0 +1,173 @@
+#ifndef OPUS_STORAGE_HASH_TYPE_HPP
+#define OPUS_STORAGE_HASH_TYPE_HPP
+
+#include "base_datastructure.hpp"
+#include "listpack.hpp"
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <optional>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+#include <utility>
+#include <variant>
+#include <vector>
+
+namespace opus
+{
+    namespace storage
+    {
+
+        /**
+         * @brief Hash of field/value pairs with a compact encoding for small
+         *        sizes
+         *
+         * A small hash is a Listpack of alternating fields and values: one
+         * buffer, one byte of overhead per short field or value. Once it has
+         * too many fields, or a field or value too long to scan past cheaply,
+         * it converts (once, inside hset()/hincrby()) to a hash table.
+         */
+        class HashType : public BaseDataStructure
+        {
+        public:
+            /**
+             * @brief Size thresholds for the compact encoding (the
+             *        hash-max-listpack-* options, with Redis's defaults)
+             */
+            struct Limits
+            {
+                size_t max_listpack_entries = 128;
+                size_t max_listpack_value = 64;
+            };
+
+            using FieldValue = std::pair<std::string, std::string>;
+
+        private:
+            using Table = std::unordered_map<std::string, std::string, std::hash<std::string>, std::equal_to<std::string>,
+                                             SlabStlAllocator<std::pair<const std::string, std::string>>>;
+
+            std::variant<Listpack, std::unique_ptr<Table>> fields;
+
+            // Heap bytes of the table's field and value strings, for
+            // memoryUsage().
+            size_t string_bytes = 0;
+
+            static Limits limits;
+
+            // A table node: next pointer, field, value, cached hash.
+            static constexpr size_t TABLE_NODE_BYTES = sizeof(void *) + 2 * sizeof(std::string) + sizeof(size_t);
+
+            static size_t pairBytes(const Table::value_type &pair);
+
+            Table &convertToTable();
+
+            // Stores `value` under `field`; returns true if the field is new.
+            bool store(std::string_view field, std::string_view value);
+
+        public:
+            HashType();
+            ~HashType();
+            HashType(HashType &&other) noexcept;
+
+            static constexpr ValueType TYPE = ValueType::HASH;
+
+            /**
+             * @brief Replaces the thresholds; called once at startup, before
+             *        any worker runs
+             */
+            static void setLimits(const Limits &new_limits);
+
+            Encoding encoding() const;
+
+            /**
+             * @brief Estimated bytes held, the object included; O(1)
+             */
+            size_t memoryUsage() const;
+
+            /**
+             * @brief Moves the hash's buffer or table nodes out of sparsely
+             *        used allocator pages (tables of up to
+             *        DEFRAG_MAX_TABLE_SIZE)
+             * @return blocks moved
+             */
+            size_t defrag();
+
+            /**
+             * @return 1 if the field is new, 0 if an existing one was updated
+             */
+            int hset(const std::string &field, const std::string &value);
+            std::optional<std::string> hget(std::string_view field) const;
+            bool hexists(std::string_view field) const;
+            int hdel(std::string_view field);
+            int hlen() const;
+
+            /**
+             * @brief Adds `delta` to an integer field (a missing field counts
+             *        as 0); throws std::runtime_error if the value is not an
+             *        integer or the result would overflow
+             */
+            long long hincrby(std::string_view field, long long delta);
+
+            std::vector<FieldValue> hgetall() const;
+
+            /**
+             * @brief Appends roughly `count` pairs starting at `cursor`
+             *
+             * A compact hash is returned whole. A table is walked a bucket at
+             * a time, the cursor being the next bucket, and no more than
+             * 10 * `count` buckets are visited per call; a scan may repeat or
+             * miss fields if the table grows between calls.
+             * @return the cursor for the next call, 0 when the scan is done
+             */
+            unsigned long long hscan(unsigned long long cursor, size_t count, std::vector<FieldValue> &out) const;
+
+            /**
+             * @brief Calls f(std::string_view field, std::string_view value)
+             *        for roughly `count` pairs from `cursor` on (0 starts a
+             *        walk)
+             *
+             * The cursor is a byte offset into a compact hash and a bucket of
+             * a table, whose buckets are visited whole; it is only meaningful
+             * while the hash is unchanged and must come from a previous call,
+             * never from a client.
+             * @return the cursor to continue from, 0 once every pair was seen
+             */
+            template <typename F>
+            size_t visitPairs(size_t cursor, size_t count, F &&f) const;
+
+            bool isEmpty() const;
+        };
+
+        template <typename F>
+        size_t HashType::visitPairs(size_t cursor, size_t count, F &&f) const
+        {
+            if (const Listpack *packed = std::get_if<Listpack>(&fields))
+            {
+                for (size_t next; cursor < packed->end() && count > 0; cursor = next, --count)
+                {
+                    std::string_view field = packed->at(cursor, next);
+                    f(field, packed->at(next, next));
+                }
+                return cursor < packed->end() ? cursor : 0;
+            }
+            // Empty buckets count against a budget, as in CacheManager::scan():
+            // a table shrunk by HDEL keeps its buckets.
+            const Table &table = *std::get<std::unique_ptr<Table>>(fields);
+            size_t buckets = table.bucket_count();
+            size_t budget = count < SIZE_MAX / 10 ? count * 10 : SIZE_MAX;
+            size_t visited = 0;
+            for (; cursor < buckets && visited < count && budget > 0; ++cursor, --budget)
+            {
+                for (auto it = table.begin(cursor); it != table.end(cursor); ++it, ++visited)
+                {
+                    f(std::string_view(it->first), std::string_view(it->second));
+                }
+            }
+            return cursor < buckets ? cursor : 0;
+        }
+
+    } // namespace storage
+} // namespace opus
+
+#endif // OPUS_STORAGE_HASH_TYPE_HPP
@@ -0,0 +1,219 @@
+#include "intset.hpp"
+
+#include <cstring>
+
+#ifdef __SSE2__
+#include <emmintrin.h>
+#endif
+
+namespace opus
+{
+    namespace storage
+    {
+
+        namespace
+        {
+            // Binary search stops once the candidate range is this small; the
+            // rest is one or two SIMD compares rather than unpredictable
+            // branches.
+            constexpr size_t SCAN_WINDOW = 16;
+
+            uint8_t widthFor(int64_t value)
+            {
+                if (value >= INT16_MIN && value <= INT16_MAX)
+                    return sizeof(int16_t);
+                if (value >= INT32_MIN && value <= INT32_MAX)
+                    return sizeof(int32_t);
+                return sizeof(int64_t);
+            }
+
+            // Index of `value` among n elements of the given width, or n.
+            size_t scan(const char *p, size_t n, uint8_t width, int64_t value)
+            {
+                size_t i = 0;
+#ifdef __SSE2__
+                const __m128i *v = reinterpret_cast<const __m128i *>(p);
+                size_t lanes = 16 / width;
+                __m128i needle;
+                if (width == sizeof(int16_t))
+                    needle = _mm_set1_epi16(static_cast<int16_t>(value));
+                else if (width == sizeof(int32_t))
+                    needle = _mm_set1_epi32(static_cast<int32_t>(value));
+                else
+                    needle = _mm_set1_epi64x(value);
+
+                for (; i + lanes <= n; i += lanes, ++v)
+                {
+                    __m128i chunk = _mm_loadu_si128(v);
+                    __m128i eq;
+                    if (width == sizeof(int16_t))
+                        eq = _mm_cmpeq_epi16(chunk, needle);
+                    else
+                    {
+                        eq = _mm_cmpeq_epi32(chunk, needle);
+                        // SSE2 has no 64-bit compare: both halves must match.
+                        if (width == sizeof(int64_t))
+                            eq = _mm_and_si128(eq, _mm_shuffle_epi32(eq, _MM_SHUFFLE(2, 3, 0, 1)));
+                    }
+                    if (int mask = _mm_movemask_epi8(eq))
+                        return i + static_cast<size_t>(__builtin_ctz(static_cast<unsigned>(mask))) / width;
+                }
+#endif
+                for (; i < n; ++i)
+                {
+                    int64_t element;
+                    if (width == sizeof(int16_t))
+                    {
+                        int16_t x;
+                        std::memcpy(&x, p + i * width, width);
+                        element = x;
+                    }
+                    else if (width == sizeof(int32_t))
+                    {
+                        int32_t x;
+                        std::memcpy(&x, p + i * width, width);
+                        element = x;
+                    }
+                    else
+                    {
+                        std::memcpy(&element, p + i * width, width);
+                    }
+                    if (element == value)
+                        return i;
+                }
+                return n;
+            }
+        }
+
+        int64_t IntSet::get(size_t index) const
+        {
+            const char *p = data.data() + index * width;
+            if (width == sizeof(int16_t))
+            {
+                int16_t x;
+                std::memcpy(&x, p, sizeof(x));
+                return x;
+            }
+            if (width == sizeof(int32_t))
+            {
+                int32_t x;
+                std::memcpy(&x, p, sizeof(x));
+                return x;
+            }
+            int64_t x;
+            std::memcpy(&x, p, sizeof(x));
+            return x;
+        }
+
+        void IntSet::put(size_t index, int64_t value)
+        {
+            char *p = data.data() + index * width;
+            if (width == sizeof(int16_t))
+            {
+                int16_t x = static_cast<int16_t>(value);
+                std::memcpy(p, &x, sizeof(x));
+            }
+            else if (width == sizeof(int32_t))
+            {
+                int32_t x = static_cast<int32_t>(value);
+                std::memcpy(p, &x, sizeof(x));
+            }
+            else
+            {
+                std::memcpy(p, &value, sizeof(value));
+            }
+        }
+
+        void IntSet::upgrade(uint8_t new_width)
+        {
+            uint8_t old_width = width;
+            data.resize(static_cast<size_t>(count) * new_width);
+            // Back to front, so no element is overwritten before it is read.
+            for (size_t i = count; i-- > 0;)
+            {
+                width = old_width;
+                int64_t value = get(i);
+                width = new_width;
+                put(i, value);
+            }
+            width = new_width;
+        }
+
+        bool IntSet::search(int64_t value, size_t &pos) const
+        {
+            if (widthFor(value) > width)
+            {
+                // Outside the current range: it belongs at one end.
+                pos = value < 0 ? 0 : count;
+                return false;
+            }
+
+            size_t lo = 0, hi = count;
+            while (hi - lo > SCAN_WINDOW)
+            {
+                size_t mid = lo + (hi - lo) / 2;
+                int64_t element = get(mid);
+                if (element == value)
+                {
+                    pos = mid;
+                    return true;
+                }
+                if (element < value)
+                    lo = mid + 1;
+                else
+                    hi = mid;
+            }
+
+            size_t found = lo + scan(data.data() + lo * width, hi - lo, width, value);
+            if (found < hi)
+            {
+                pos = found;
+                return true;
+            }
+
+            // Not present: position for insertion within the window.
+            pos = lo;
+            while (pos < hi && get(pos) < value)
+                ++pos;
+            return false;
+        }
+
+        bool IntSet::contains(int64_t value) const
+        {
+            size_t pos;
+            return search(value, pos);
+        }
+
+        bool IntSet::insert(int64_t value)
+        {
+            size_t pos;
+            if (search(value, pos))
+                return false;
+
+            uint8_t needed = widthFor(value);
+            if (needed > width)
+                upgrade(needed);
+
+            data.resize(static_cast<size_t>(count + 1) * width);
+            char *at = data.data() + pos * width;
+            std::memmove(at + width, at, (count - pos) * width);
+            ++count;
+            put(pos, value);
+            return true;
+        }
+
+        bool IntSet::erase(int64_t value)
+        {
+            size_t pos;
+            if (!search(value, pos))
+                return false;
+
+            char *at = data.data() + pos * width;
+            std::memmove(at, at + width, (count - pos - 1) * width);
+            --count;
+            data.resize(static_cast<size_t>(count) * width);
+            return true;
+        }
+
+    } // namespace storage
+} // namespace opus
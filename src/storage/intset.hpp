@@ -0,0 +1,72 @@
+#ifndef OPUS_STORAGE_INTSET_HPP
+#define OPUS_STORAGE_INTSET_HPP
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+#include "slab_allocator.hpp"
+
+namespace opus
+{
+    namespace storage
+    {
+
+        /**
+         * @brief Sorted array of distinct integers with adaptive element width
+         *
+         * Elements are stored as int16, int32 or int64, whichever is the
+         * narrowest that fits every member; adding a wider value upgrades the
+         * whole array once. Lookups binary-search down to a small window and
+         * finish with an SSE2 compare of several elements per instruction.
+         */
+        class IntSet
+        {
+        private:
+            std::vector<char, SlabStlAllocator<char>> data;
+            uint32_t count = 0;
+            uint8_t width = sizeof(int16_t);
+
+            int64_t get(size_t index) const;
+            void put(size_t index, int64_t value);
+            void upgrade(uint8_t new_width);
+
+            /**
+             * @return true if found; `pos` is the element's index or, if
+             *         absent, where it would be inserted
+             */
+            bool search(int64_t value, size_t &pos) const;
+
+        public:
+            size_t size() const { return count; }
+
+            /**
+             * @brief Heap bytes held by the element array
+             */
+            size_t bytes() const { return data.capacity(); }
+
+            /**
+             * @brief Moves the element array out of a sparsely used allocator page
+             * @return whether it moved
+             */
+            bool defrag() { return defragVector(data); }
+
+            bool contains(int64_t value) const;
+
+            /**
+             * @return false if the value was already present
+             */
+            bool insert(int64_t value);
+
+            /**
+             * @return false if the value was not present
+             */
+            bool erase(int64_t value);
+
+            int64_t at(size_t index) const { return get(index); }
+        };
+
+    } // namespace storage
+} // namespace opus
+
+#endif // OPUS_STORAGE_INTSET_HPP
@@ -0,0 +1,57 @@
+#include "lazy_free.hpp"
+
+namespace opus
+{
+    namespace storage
+    {
+
+        LazyFree::~LazyFree()
+        {
+            {
+                std::lock_guard<std::mutex> guard(lock);
+                stopping = true;
+            }
+            ready.notify_one();
+            if (worker.joinable())
+                worker.join();
+        }
+
+        void LazyFree::release(EntryPtr entry)
+        {
+            if (entry.get() && entry->freeEffort() > LAZYFREE_THRESHOLD)
+                releaseLater(std::move(entry), 1);
+        }
+
+        void LazyFree::push(std::unique_ptr<Garbage> garbage, size_t objects)
+        {
+            pending.fetch_add(objects, std::memory_order_relaxed);
+            {
+                std::lock_guard<std::mutex> guard(lock);
+                queue.push_back(Job{std::move(garbage), objects});
+                if (!worker.joinable())
+                    worker = std::thread([this] { run(); });
+            }
+            ready.notify_one();
+        }
+
+        void LazyFree::run()
+        {
+            std::unique_lock<std::mutex> guard(lock);
+            for (;;)
+            {
+                ready.wait(guard, [this] { return stopping || !queue.empty(); });
+                if (queue.empty())
+                    return; // stopping, and nothing left to free
+
+                Job job = std::move(queue.front());
+                queue.pop_front();
+                guard.unlock();
+                job.garbage.reset();
+                pending.fetch_sub(job.objects, std::memory_order_relaxed);
+                freed.fetch_add(job.objects, std::memory_order_relaxed);
+                guard.lock();
+            }
+        }
+
+    } // namespace storage
+} // namespace opus
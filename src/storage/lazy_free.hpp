@@ -0,0 +1,109 @@
+#ifndef OPUS_STORAGE_LAZY_FREE_HPP
+#define OPUS_STORAGE_LAZY_FREE_HPP
+
+#include <atomic>
+#include <condition_variable>
+#include <cstddef>
+#include <cstdint>
+#include <deque>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <utility>
+
+#include "entry.hpp"
+
+namespace opus
+{
+    namespace storage
+    {
+
+        /**
+         * @brief Background thread freeing what the keyspace has let go of
+         *
+         * Taking a key out of the keyspace is O(1), but freeing its value can
+         * mean millions of deallocations for a big collection, and an
+         * asynchronous flush lets go of every value at once. Work of that
+         * kind is queued here and done on a thread of its own, so the threads
+         * serving clients never wait for it. A value no costlier to free than
+         * LAZYFREE_THRESHOLD allocations (Redis's heuristic and default) is
+         * freed on the spot instead, where queueing it would cost more than
+         * it saves.
+         *
+         * The thread starts with the first queued job; the destructor lets it
+         * finish the queue before joining it.
+         */
+        class LazyFree
+        {
+        private:
+            struct Garbage
+            {
+                virtual ~Garbage() = default;
+            };
+
+            template <typename T>
+            struct Holder final : Garbage
+            {
+                T value;
+                explicit Holder(T &&value) : value(std::move(value)) {}
+            };
+
+            struct Job
+            {
+                std::unique_ptr<Garbage> garbage;
+                size_t objects;
+            };
+
+            std::mutex lock;
+            std::condition_variable ready;
+            std::deque<Job> queue;
+            bool stopping = false;
+            std::thread worker;
+
+            std::atomic<uint64_t> pending{0};
+            std::atomic<uint64_t> freed{0};
+
+            void push(std::unique_ptr<Garbage> garbage, size_t objects);
+            void run();
+
+        public:
+            // Allocations above which a value is freed in the background.
+            static constexpr size_t LAZYFREE_THRESHOLD = 64;
+
+            LazyFree() = default;
+            ~LazyFree();
+
+            LazyFree(const LazyFree &) = delete;
+            LazyFree &operator=(const LazyFree &) = delete;
+
+            /**
+             * @brief Frees an entry taken out of the keyspace, here or in the
+             *        background depending on Entry::freeEffort()
+             */
+            void release(EntryPtr entry);
+
+            /**
+             * @brief Hands `value` to the background thread, whose destroying
+             *        it frees the `objects` keys it holds
+             */
+            template <typename T>
+            void releaseLater(T value, size_t objects)
+            {
+                push(std::make_unique<Holder<T>>(std::move(value)), objects);
+            }
+
+            /**
+             * @brief Keys queued and not freed yet
+             */
+            uint64_t pendingObjects() const { return pending.load(std::memory_order_relaxed); }
+
+            /**
+             * @brief Keys freed by the background thread so far
+             */
+            uint64_t freedObjects() const { return freed.load(std::memory_order_relaxed); }
+        };
+
+    } // namespace storage
+} // namespace opus
+
+#endif // OPUS_STORAGE_LAZY_FREE_HPP
@@ -1,60 +1,478 @@
 #include "list_type.hpp"
 
 #include <algorithm>
+#include <cstdlib>
+#include <cstring>
+#include <new>
 
 namespace opus
 {
     namespace storage
     {
 
+        namespace
+        {
+            // Element lengths are LEB128 varints: 1 byte below 128, 2 below 16K.
+            size_t varintSize(uint32_t value)
+            {
+                size_t n = 1;
+                while (value >= 0x80)
+                {
+                    value >>= 7;
+                    ++n;
+                }
+                return n;
+            }
+
+            size_t encodedSize(size_t len)
+            {
+                return len + 2 * varintSize(static_cast<uint32_t>(len));
+            }
+
+            char *writeVarint(char *p, uint32_t value)
+            {
+                while (value >= 0x80)
+                {
+                    *p++ = static_cast<char>((value & 0x7F) | 0x80);
+                    value >>= 7;
+                }
+                *p++ = static_cast<char>(value);
+                return p;
+            }
+
+            // Same bytes in reverse, so the last byte is the least significant
+            // group and the length can be read walking backwards.
+            void writeVarintReversed(char *end, uint32_t value)
+            {
+                while (value >= 0x80)
+                {
+                    *--end = static_cast<char>((value & 0x7F) | 0x80);
+                    value >>= 7;
+                }
+                *--end = static_cast<char>(value);
+            }
+
+            // Encodes one element at `at`; returns the end of its bytes.
+            char *writeElement(char *at, std::string_view value)
+            {
+                uint32_t len = static_cast<uint32_t>(value.size());
+                char *p = writeVarint(at, len);
+                std::memcpy(p, value.data(), value.size());
+                p += value.size();
+                p += varintSize(len);
+                writeVarintReversed(p, len);
+                return p;
+            }
+
+            uint32_t readVarint(const char *p, uint32_t &bytes)
+            {
+                uint32_t value = 0;
+                unsigned shift = 0;
+                bytes = 0;
+                unsigned char c;
+                do
+                {
+                    c = static_cast<unsigned char>(p[bytes++]);
+                    value |= static_cast<uint32_t>(c & 0x7F) << shift;
+                    shift += 7;
+                } while (c & 0x80);
+                return value;
+            }
+
+            uint32_t readVarintBackward(const char *end, uint32_t &bytes)
+            {
+                uint32_t value = 0;
+                unsigned shift = 0;
+                bytes = 0;
+                unsigned char c;
+                do
+                {
+                    c = static_cast<unsigned char>(*(end - 1 - bytes++));
+                    value |= static_cast<uint32_t>(c & 0x7F) << shift;
+                    shift += 7;
+                } while (c & 0x80);
+                return value;
+            }
+        }
+
         ListType::ListType() = default;
 
-        ListType::~ListType() = default;
+        ListType::ListType(ListType &&other) noexcept
+            : head(other.head), tail(other.tail), length(other.length), chunk_count(other.chunk_count),
+              buffer_bytes(other.buffer_bytes)
+        {
+            other.head = other.tail = nullptr;
+            other.length = other.chunk_count = other.buffer_bytes = 0;
+        }
+
+        ListType::~ListType()
+        {
+            while (head)
+            {
+                freeChunk(head);
+            }
+        }
 
-        std::string ListType::getType() const
+        ListType::Chunk *ListType::newChunk(Chunk *prev, Chunk *next)
         {
-            return "list";
+            Chunk *chunk = new (SlabAllocator::allocate(sizeof(Chunk))) Chunk();
+            chunk->prev = prev;
+            chunk->next = next;
+            if (prev)
+                prev->next = chunk;
+            else
+                head = chunk;
+            if (next)
+                next->prev = chunk;
+            else
+                tail = chunk;
+            ++chunk_count;
+            return chunk;
         }
 
-        int ListType::lpush(const std::string &val)
+        void ListType::freeChunk(Chunk *chunk)
         {
-            values.push_front(val);
-            return values.size();
+            if (chunk->prev)
+                chunk->prev->next = chunk->next;
+            else
+                head = chunk->next;
+            if (chunk->next)
+                chunk->next->prev = chunk->prev;
+            else
+                tail = chunk->prev;
+            buffer_bytes -= chunk->capacity;
+            SlabAllocator::deallocate(chunk->data, chunk->capacity);
+            chunk->~Chunk();
+            SlabAllocator::deallocate(chunk, sizeof(Chunk));
+            --chunk_count;
         }
 
-        int ListType::rpush(const std::string &val)
+        void ListType::reserve(Chunk *chunk, size_t bytes)
         {
-            values.push_back(val);
-            return values.size();
+            size_t needed = chunk->size + bytes;
+            if (needed <= chunk->capacity)
+                return;
+
+            // Grow geometrically up to the chunk cap so pushes stay amortized
+            // O(1), but never allocate more than one chunk's worth up front.
+            // The whole size class is used, since it is allocated anyway.
+            size_t capacity = std::max<size_t>(chunk->capacity * 2, 64);
+            capacity = SlabAllocator::usableSize(std::max(std::min(capacity, MAX_CHUNK_BYTES), needed));
+            char *data = static_cast<char *>(SlabAllocator::reallocate(chunk->data, chunk->capacity, capacity));
+            buffer_bytes += capacity - chunk->capacity;
+            chunk->data = data;
+            chunk->capacity = static_cast<uint32_t>(capacity);
         }
 
-        std::optional<std::string> ListType::lpop()
+        size_t ListType::defrag()
         {
-            if (values.empty())
-                return std::nullopt;
-            std::string val = values.front();
-            values.pop_front();
-            return val;
+            size_t moved = 0;
+            for (Chunk *chunk = head; chunk; chunk = chunk->next)
+            {
+                if (void *data = SlabAllocator::relocate(chunk->data, chunk->capacity))
+                {
+                    chunk->data = static_cast<char *>(data);
+                    ++moved;
+                }
+                if (void *copy = SlabAllocator::relocate(chunk, sizeof(Chunk)))
+                {
+                    chunk = static_cast<Chunk *>(copy);
+                    if (chunk->prev)
+                        chunk->prev->next = chunk;
+                    else
+                        head = chunk;
+                    if (chunk->next)
+                        chunk->next->prev = chunk;
+                    else
+                        tail = chunk;
+                    ++moved;
+                }
+            }
+            return moved;
         }
 
-        std::optional<std::string> ListType::rpop()
+        std::string_view ListType::elementAt(const Chunk *chunk, uint32_t offset, uint32_t *next_offset)
         {
-            if (values.empty())
-                return std::nullopt;
-            std::string val = values.back();
-            values.pop_back();
-            return val;
+            uint32_t header;
+            uint32_t len = readVarint(chunk->data + offset, header);
+            if (next_offset)
+                *next_offset = offset + 2 * header + len;
+            return std::string_view(chunk->data + offset + header, len);
         }
 
-        int ListType::llen() const
+        uint32_t ListType::previousOffset(const Chunk *chunk, uint32_t offset)
         {
-            return values.size();
+            uint32_t header;
+            uint32_t len = readVarintBackward(chunk->data + offset, header);
+            return offset - 2 * header - len;
         }
 
-        std::vector<std::string> ListType::lrange(int start, int stop) const
+        bool ListType::fits(const Chunk *chunk, size_t element_bytes)
         {
-            std::vector<std::string> result;
-            int size = values.size();
+            return chunk->count == 0 || chunk->size + element_bytes <= MAX_CHUNK_BYTES;
+        }
+
+        void ListType::insertAt(Chunk *chunk, uint32_t offset, std::string_view value)
+        {
+            size_t bytes = encodedSize(value.size());
+            reserve(chunk, bytes);
+
+            char *at = chunk->data + offset;
+            std::memmove(at + bytes, at, chunk->size - offset);
+            writeElement(at, value);
+
+            chunk->size += static_cast<uint32_t>(bytes);
+            ++chunk->count;
+            ++length;
+        }
+
+        uint32_t ListType::eraseAt(Chunk *chunk, uint32_t offset)
+        {
+            uint32_t next;
+            elementAt(chunk, offset, &next);
+            std::memmove(chunk->data + offset, chunk->data + next, chunk->size - next);
+            chunk->size -= next - offset;
+            --chunk->count;
+            --length;
+            return offset;
+        }
+
+        ListType::Chunk *ListType::split(Chunk *chunk, uint32_t offset)
+        {
+            Chunk *right = newChunk(chunk, chunk->next);
+            uint32_t moved = 0;
+            for (uint32_t off = offset; off < chunk->size; ++moved)
+            {
+                elementAt(chunk, off, &off);
+            }
+
+            reserve(right, chunk->size - offset);
+            std::memcpy(right->data, chunk->data + offset, chunk->size - offset);
+            right->size = chunk->size - offset;
+            right->count = moved;
+            chunk->size = offset;
+            chunk->count -= moved;
+            return right;
+        }
+
+        void ListType::mergeWithNext(Chunk *chunk)
+        {
+            Chunk *next = chunk->next;
+            reserve(chunk, next->size);
+            std::memcpy(chunk->data + chunk->size, next->data, next->size);
+            chunk->size += next->size;
+            chunk->count += next->count;
+            freeChunk(next);
+        }
+
+        // `at` may point one past the last element of its chunk.
+        void ListType::insertBefore(Cursor at, std::string_view value)
+        {
+            Chunk *chunk = at.chunk;
+            size_t bytes = encodedSize(value.size());
+
+            if (fits(chunk, bytes))
+            {
+                insertAt(chunk, at.offset, value);
+                return;
+            }
+            if (at.offset == 0 && chunk->prev && fits(chunk->prev, bytes))
+            {
+                insertAt(chunk->prev, chunk->prev->size, value);
+                return;
+            }
+            if (at.offset == chunk->size && chunk->next && fits(chunk->next, bytes))
+            {
+                insertAt(chunk->next, 0, value);
+                return;
+            }
+
+            if (at.offset == 0)
+            {
+                insertAt(newChunk(chunk->prev, chunk), 0, value);
+                return;
+            }
+            if (at.offset == chunk->size)
+            {
+                insertAt(newChunk(chunk, chunk->next), 0, value);
+                return;
+            }
+
+            // Full chunk, insertion in the middle: split at the insertion
+            // point and add the element to whichever half has room.
+            Chunk *right = split(chunk, at.offset);
+            if (fits(chunk, bytes))
+                insertAt(chunk, chunk->size, value);
+            else if (fits(right, bytes))
+                insertAt(right, 0, value);
+            else
+                insertAt(newChunk(chunk, right), 0, value);
+        }
+
+        void ListType::pushFront(std::string_view value)
+        {
+            if (!head || !fits(head, encodedSize(value.size())))
+                newChunk(nullptr, head);
+            insertAt(head, 0, value);
+        }
+
+        void ListType::pushBack(std::string_view value)
+        {
+            if (!tail || !fits(tail, encodedSize(value.size())))
+                newChunk(tail, nullptr);
+            insertAt(tail, tail->size, value);
+        }
+
+        size_t ListType::runEnd(const Chunk *chunk, const std::vector<std::string_view> &values, size_t begin,
+                                size_t &bytes)
+        {
+            bytes = encodedSize(values[begin].size());
+            size_t end = begin + 1;
+            while (end < values.size() && chunk->size + bytes + encodedSize(values[end].size()) <= MAX_CHUNK_BYTES)
+            {
+                bytes += encodedSize(values[end++].size());
+            }
+            return end;
+        }
+
+        void ListType::pushFront(const std::vector<std::string_view> &values)
+        {
+            for (size_t begin = 0, end; begin < values.size(); begin = end)
+            {
+                if (!head || !fits(head, encodedSize(values[begin].size())))
+                    newChunk(nullptr, head);
+                size_t bytes;
+                end = runEnd(head, values, begin, bytes);
+                reserve(head, bytes);
+
+                // Each value goes in front of the previous one, so the run is
+                // written last value first.
+                std::memmove(head->data + bytes, head->data, head->size);
+                char *p = head->data;
+                for (size_t i = end; i-- > begin;)
+                {
+                    p = writeElement(p, values[i]);
+                }
+                head->size += static_cast<uint32_t>(bytes);
+                head->count += static_cast<uint32_t>(end - begin);
+                length += end - begin;
+            }
+        }
+
+        void ListType::pushBack(const std::vector<std::string_view> &values)
+        {
+            for (size_t begin = 0, end; begin < values.size(); begin = end)
+            {
+                if (!tail || !fits(tail, encodedSize(values[begin].size())))
+                    newChunk(tail, nullptr);
+                size_t bytes;
+                end = runEnd(tail, values, begin, bytes);
+                reserve(tail, bytes);
+
+                char *p = tail->data + tail->size;
+                for (size_t i = begin; i < end; ++i)
+                {
+                    p = writeElement(p, values[i]);
+                }
+                tail->size += static_cast<uint32_t>(bytes);
+                tail->count += static_cast<uint32_t>(end - begin);
+                length += end - begin;
+            }
+        }
+
+        void ListType::dropFront(size_t n)
+        {
+            while (n > 0 && head && n >= head->count)
+            {
+                n -= head->count;
+                length -= head->count;
+                freeChunk(head);
+            }
+            if (n == 0 || !head)
+                return;
+
+            uint32_t offset = 0;
+            for (size_t i = 0; i < n; ++i)
+            {
+                elementAt(head, offset, &offset);
+            }
+            std::memmove(head->data, head->data + offset, head->size - offset);
+            head->size -= offset;
+            head->count -= static_cast<uint32_t>(n);
+            length -= n;
+        }
+
+        void ListType::dropBack(size_t n)
+        {
+            while (n > 0 && tail && n >= tail->count)
+            {
+                n -= tail->count;
+                length -= tail->count;
+                freeChunk(tail);
+            }
+            if (n == 0 || !tail)
+                return;
+
+            uint32_t offset = tail->size;
+            for (size_t i = 0; i < n; ++i)
+            {
+                offset = previousOffset(tail, offset);
+            }
+            tail->size = offset;
+            tail->count -= static_cast<uint32_t>(n);
+            length -= n;
+        }
+
+        ListType::Cursor ListType::seek(size_t index) const
+        {
+            Chunk *chunk;
+            size_t in_chunk;
+            if (index < length / 2)
+            {
+                chunk = head;
+                while (index >= chunk->count)
+                {
+                    index -= chunk->count;
+                    chunk = chunk->next;
+                }
+                in_chunk = index;
+            }
+            else
+            {
+                size_t from_tail = length - 1 - index;
+                chunk = tail;
+                while (from_tail >= chunk->count)
+                {
+                    from_tail -= chunk->count;
+                    chunk = chunk->prev;
+                }
+                in_chunk = chunk->count - 1 - from_tail;
+            }
+
+            // Walk inside the chunk from whichever of its ends is nearer.
+            uint32_t offset;
+            if (in_chunk <= chunk->count / 2)
+            {
+                offset = 0;
+                for (size_t i = 0; i < in_chunk; ++i)
+                {
+                    elementAt(chunk, offset, &offset);
+                }
+            }
+            else
+            {
+                offset = chunk->size;
+                for (size_t i = chunk->count; i > in_chunk; --i)
+                {
+                    offset = previousOffset(chunk, offset);
+                }
+            }
+            return Cursor{chunk, offset};
+        }
+
+        bool ListType::normalizeRange(long long &start, long long &stop) const
+        {
+            long long size = static_cast<long long>(length);
 
             // Handle negative indices
             if (start < 0)
@@ -67,23 +485,209 @@ namespace opus
             if (stop >= size)
                 stop = size - 1;
 
-            if (start > stop || start >= size)
-                return result;
+            return start <= stop && start < size;
+        }
+
+        int ListType::lpush(std::string_view val)
+        {
+            pushFront(val);
+            return static_cast<int>(length);
+        }
+
+        int ListType::rpush(std::string_view val)
+        {
+            pushBack(val);
+            return static_cast<int>(length);
+        }
+
+        int ListType::lpush(const std::vector<std::string_view> &values)
+        {
+            pushFront(values);
+            return static_cast<int>(length);
+        }
 
-            auto it = values.begin();
-            std::advance(it, start);
+        int ListType::rpush(const std::vector<std::string_view> &values)
+        {
+            pushBack(values);
+            return static_cast<int>(length);
+        }
 
-            for (int i = start; i <= stop && it != values.end(); ++i, ++it)
+        std::optional<std::string> ListType::lpop()
+        {
+            if (length == 0)
+                return std::nullopt;
+            std::string val(elementAt(head, 0));
+            eraseAt(head, 0);
+            if (head->count == 0)
+                freeChunk(head);
+            return val;
+        }
+
+        std::optional<std::string> ListType::rpop()
+        {
+            if (length == 0)
+                return std::nullopt;
+            uint32_t offset = previousOffset(tail, tail->size);
+            std::string val(elementAt(tail, offset));
+            eraseAt(tail, offset);
+            if (tail->count == 0)
+                freeChunk(tail);
+            return val;
+        }
+
+        int ListType::llen() const
+        {
+            return static_cast<int>(length);
+        }
+
+        ListType::RangeCursor ListType::range(long long start, long long stop) const
+        {
+            RangeCursor cursor;
+            if (!normalizeRange(start, stop))
+                return cursor;
+            cursor.at = seek(static_cast<size_t>(start));
+            cursor.left = static_cast<size_t>(stop - start + 1);
+            return cursor;
+        }
+
+        std::vector<std::string> ListType::lrange(long long start, long long stop) const
+        {
+            RangeCursor cursor = range(start, stop);
+            std::vector<std::string> result;
+            result.reserve(cursor.left);
+            forEachInRange(cursor, cursor.left, [&](std::string_view element) { result.emplace_back(element); });
+            return result;
+        }
+
+        std::optional<std::string> ListType::lindex(long long index) const
+        {
+            if (index < 0)
+                index += static_cast<long long>(length);
+            if (index < 0 || index >= static_cast<long long>(length))
+                return std::nullopt;
+
+            Cursor at = seek(static_cast<size_t>(index));
+            return std::string(elementAt(at.chunk, at.offset));
+        }
+
+        bool ListType::lset(long long index, std::string_view val)
+        {
+            if (index < 0)
+                index += static_cast<long long>(length);
+            if (index < 0 || index >= static_cast<long long>(length))
+                return false;
+
+            // The emptied chunk (if any) is reused by the insert.
+            Cursor at = seek(static_cast<size_t>(index));
+            eraseAt(at.chunk, at.offset);
+            insertBefore(at, val);
+            return true;
+        }
+
+        int ListType::linsert(bool before, std::string_view pivot, std::string_view val)
+        {
+            for (Chunk *chunk = head; chunk; chunk = chunk->next)
             {
-                result.push_back(*it);
+                for (uint32_t offset = 0; offset < chunk->size;)
+                {
+                    uint32_t next;
+                    if (elementAt(chunk, offset, &next) == pivot)
+                    {
+                        insertBefore(Cursor{chunk, before ? offset : next}, val);
+                        return static_cast<int>(length);
+                    }
+                    offset = next;
+                }
             }
+            return -1;
+        }
 
-            return result;
+        void ListType::ltrim(long long start, long long stop)
+        {
+            if (!normalizeRange(start, stop))
+            {
+                dropFront(length);
+                return;
+            }
+            size_t keep_end = static_cast<size_t>(stop) + 1;
+            dropBack(length - keep_end);
+            dropFront(static_cast<size_t>(start));
+        }
+
+        int ListType::lrem(long long count, std::string_view val)
+        {
+            size_t limit = length;
+            if (count > 0)
+                limit = static_cast<size_t>(count);
+            else if (count < 0)
+                limit = static_cast<size_t>(-(count + 1)) + 1;
+            size_t removed = 0;
+
+            if (count >= 0)
+            {
+                Chunk *chunk = head;
+                while (chunk && removed < limit)
+                {
+                    Chunk *next_chunk = chunk->next;
+                    uint32_t offset = 0;
+                    while (offset < chunk->size && removed < limit)
+                    {
+                        uint32_t next;
+                        if (elementAt(chunk, offset, &next) == val)
+                        {
+                            offset = eraseAt(chunk, offset);
+                            ++removed;
+                        }
+                        else
+                        {
+                            offset = next;
+                        }
+                    }
+                    if (chunk->count == 0)
+                        freeChunk(chunk);
+                    chunk = next_chunk;
+                }
+            }
+            else
+            {
+                Chunk *chunk = tail;
+                while (chunk && removed < limit)
+                {
+                    Chunk *prev_chunk = chunk->prev;
+                    uint32_t offset = chunk->size;
+                    while (offset > 0 && removed < limit)
+                    {
+                        offset = previousOffset(chunk, offset);
+                        if (elementAt(chunk, offset) == val)
+                        {
+                            eraseAt(chunk, offset);
+                            ++removed;
+                        }
+                    }
+                    if (chunk->count == 0)
+                        freeChunk(chunk);
+                    chunk = prev_chunk;
+                }
+            }
+
+            // Removals can leave runs of small chunks; fold neighbours back
+            // together while the result stays within the chunk cap.
+            if (removed > 0)
+            {
+                for (Chunk *chunk = head; chunk && chunk->next;)
+                {
+                    if (chunk->size + chunk->next->size <= MAX_CHUNK_BYTES)
+                        mergeWithNext(chunk);
+                    else
+                        chunk = chunk->next;
+                }
+            }
+            return static_cast<int>(removed);
         }
 
         bool ListType::isEmpty() const
         {
-            return values.empty();
+            return length == 0;
         }
 
     } // namespace storage
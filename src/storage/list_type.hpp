@@ -2,8 +2,10 @@
 #define OPUS_STORAGE_LIST_TYPE_HPP
 
 #include "base_datastructure.hpp"
+#include <cstddef>
+#include <cstdint>
 #include <string>
-#include <list>
+#include <string_view>
 #include <vector>
 #include <optional>
 
@@ -12,29 +14,193 @@ namespace opus
     namespace storage
     {
 
+        /**
+         * @brief List stored as a quicklist
+         *
+         * A doubly linked list of chunks. Each chunk is one contiguous buffer
+         * of packed elements, encoded as `<len varint><bytes><len varint,
+         * reversed>` so a chunk can be walked in both directions. Chunks are
+         * capped at MAX_CHUNK_BYTES (an element larger than that gets a chunk
+         * of its own), so pushes and pops at either end move at most one
+         * chunk's bytes. Indexing skips whole chunks by their element counts,
+         * starting from the nearer end of the list. A short element costs two
+         * bytes of overhead.
+         */
         class ListType : public BaseDataStructure
         {
         private:
-            std::list<std::string> values;
+            struct Chunk
+            {
+                Chunk *prev = nullptr;
+                Chunk *next = nullptr;
+                char *data = nullptr;
+                uint32_t size = 0;     // bytes used
+                uint32_t capacity = 0; // bytes allocated
+                uint32_t count = 0;    // elements
+            };
+
+            // Position of one element: its chunk and byte offset inside it.
+            struct Cursor
+            {
+                Chunk *chunk = nullptr;
+                uint32_t offset = 0;
+            };
+
+            Chunk *head = nullptr;
+            Chunk *tail = nullptr;
+            size_t length = 0;
+            size_t chunk_count = 0;
+            size_t buffer_bytes = 0; // chunk capacities added up
+
+            Chunk *newChunk(Chunk *prev, Chunk *next);
+            void freeChunk(Chunk *chunk);
+            void reserve(Chunk *chunk, size_t bytes);
+
+            static std::string_view elementAt(const Chunk *chunk, uint32_t offset, uint32_t *next_offset = nullptr);
+            static uint32_t previousOffset(const Chunk *chunk, uint32_t offset);
+
+            static bool fits(const Chunk *chunk, size_t element_bytes);
+            void insertAt(Chunk *chunk, uint32_t offset, std::string_view value);
+            uint32_t eraseAt(Chunk *chunk, uint32_t offset);
+            Chunk *split(Chunk *chunk, uint32_t offset);
+            void mergeWithNext(Chunk *chunk);
+
+            void insertBefore(Cursor at, std::string_view value);
+            void pushFront(std::string_view value);
+            void pushBack(std::string_view value);
+
+            // Values from `begin` on that fit in `chunk` together (at least
+            // one), and their encoded `bytes`.
+            static size_t runEnd(const Chunk *chunk, const std::vector<std::string_view> &values, size_t begin,
+                                 size_t &bytes);
+
+            // Pushes one value after another, writing each run that shares a
+            // chunk with a single move of the chunk's bytes.
+            void pushFront(const std::vector<std::string_view> &values);
+            void pushBack(const std::vector<std::string_view> &values);
+
+            void dropFront(size_t n);
+            void dropBack(size_t n);
+
+            Cursor seek(size_t index) const;
+            bool normalizeRange(long long &start, long long &stop) const;
 
         public:
+            // Redis's default list-max-listpack-size of -2 (8 KB per node).
+            static constexpr size_t MAX_CHUNK_BYTES = 8 * 1024;
+
             ListType();
-            ~ListType() override;
+            ~ListType();
+
+            ListType(const ListType &) = delete;
+            ListType &operator=(const ListType &) = delete;
+
+            // Takes over the chunks; `other` is left empty.
+            ListType(ListType &&other) noexcept;
+
+            static constexpr ValueType TYPE = ValueType::LIST;
 
-            std::string getType() const override;
+            int lpush(std::string_view val);
+            int rpush(std::string_view val);
 
-            int lpush(const std::string &val);
-            int rpush(const std::string &val);
+            /**
+             * @brief Pushes `values` in order, as LPUSH/RPUSH with several
+             *        arguments do (LPUSH leaves the last one at the head)
+             * @return the new length
+             */
+            int lpush(const std::vector<std::string_view> &values);
+            int rpush(const std::vector<std::string_view> &values);
 
             std::optional<std::string> lpop();
             std::optional<std::string> rpop();
 
             int llen() const;
-            std::vector<std::string> lrange(int start, int stop) const;
+            std::vector<std::string> lrange(long long start, long long stop) const;
+
+            /**
+             * @brief Where a walk through a range of the list stands; only
+             *        valid while the list is unchanged
+             */
+            struct RangeCursor
+            {
+                Cursor at;
+                size_t left = 0; // elements still to visit
+            };
+
+            /**
+             * @brief A cursor on elements `start` to `stop`, normalized as
+             *        LRANGE does; `left` is the number of elements in range
+             */
+            RangeCursor range(long long start, long long stop) const;
+
+            /**
+             * @brief Calls f(element) for up to `count` elements from `cursor`
+             *        on, advancing it past them
+             * @return whether elements are left in the range
+             */
+            template <typename F>
+            bool forEachInRange(RangeCursor &cursor, size_t count, F &&f) const;
+
+            std::optional<std::string> lindex(long long index) const;
+
+            /**
+             * @return false if the index is out of range
+             */
+            bool lset(long long index, std::string_view val);
+
+            /**
+             * @brief Inserts `val` before or after the first `pivot`
+             * @return the new length, or -1 if the pivot was not found
+             */
+            int linsert(bool before, std::string_view pivot, std::string_view val);
+
+            void ltrim(long long start, long long stop);
+
+            /**
+             * @brief Removes up to |count| occurrences of `val`: from the head
+             *        when count > 0, from the tail when count < 0, all when 0
+             */
+            int lrem(long long count, std::string_view val);
 
             bool isEmpty() const;
+
+            /**
+             * @brief Number of chunks, for memory reporting
+             */
+            size_t chunkCount() const { return chunk_count; }
+
+            /**
+             * @brief Moves chunks and chunk buffers out of sparsely used
+             *        allocator pages (see SlabAllocator::relocate)
+             * @return blocks moved
+             */
+            size_t defrag();
+
+            /**
+             * @brief Estimated bytes held, the object included
+             */
+            size_t memoryUsage() const
+            {
+                return sizeof(ListType) + chunk_count * SlabAllocator::usableSize(sizeof(Chunk)) + buffer_bytes;
+            }
         };
 
+        template <typename F>
+        bool ListType::forEachInRange(RangeCursor &cursor, size_t count, F &&f) const
+        {
+            for (; count > 0 && cursor.left > 0; --count, --cursor.left)
+            {
+                Cursor &at = cursor.at;
+                if (at.offset == at.chunk->size)
+                {
+                    at.chunk = at.chunk->next;
+                    at.offset = 0;
+                }
+                f(elementAt(at.chunk, at.offset, &at.offset));
+            }
+            return cursor.left > 0;
+        }
+
     } // namespace storage
 } // namespace opus
 
@@ -0,0 +1,136 @@
+#include "listpack.hpp"
+
+#include <cstring>
+
+namespace opus
+{
+    namespace storage
+    {
+
+        namespace
+        {
+            // Same LEB128 length prefix as the quicklist chunks.
+            size_t varintSize(uint32_t value)
+            {
+                size_t n = 1;
+                while (value >= 0x80)
+                {
+                    value >>= 7;
+                    ++n;
+                }
+                return n;
+            }
+
+            char *writeVarint(char *p, uint32_t value)
+            {
+                while (value >= 0x80)
+                {
+                    *p++ = static_cast<char>((value & 0x7F) | 0x80);
+                    value >>= 7;
+                }
+                *p++ = static_cast<char>(value);
+                return p;
+            }
+
+            uint32_t readVarint(const char *p, size_t &bytes)
+            {
+                uint32_t value = 0;
+                unsigned shift = 0;
+                bytes = 0;
+                unsigned char c;
+                do
+                {
+                    c = static_cast<unsigned char>(p[bytes++]);
+                    value |= static_cast<uint32_t>(c & 0x7F) << shift;
+                    shift += 7;
+                } while (c & 0x80);
+                return value;
+            }
+        }
+
+        void Listpack::grow(size_t bytes)
+        {
+            size_t needed = data.size() + bytes;
+            if (needed > data.capacity())
+                data.reserve(needed + needed / 8);
+        }
+
+        std::string_view Listpack::at(size_t offset, size_t &next) const
+        {
+            size_t header;
+            uint32_t len = readVarint(data.data() + offset, header);
+            next = offset + header + len;
+            return std::string_view(data.data() + offset + header, len);
+        }
+
+        size_t Listpack::find(std::string_view value, size_t stride) const
+        {
+            size_t offset = 0;
+            while (offset < data.size())
+            {
+                size_t next;
+                std::string_view element = at(offset, next);
+                if (element.size() == value.size() && std::memcmp(element.data(), value.data(), value.size()) == 0)
+                    return offset;
+                offset = next;
+                for (size_t skip = 1; skip < stride && offset < data.size(); ++skip)
+                {
+                    at(offset, next);
+                    offset = next;
+                }
+            }
+            return npos;
+        }
+
+        void Listpack::append(std::string_view value)
+        {
+            uint32_t len = static_cast<uint32_t>(value.size());
+            size_t offset = data.size();
+            grow(varintSize(len) + len);
+            data.resize(offset + varintSize(len) + len);
+            char *p = writeVarint(data.data() + offset, len);
+            std::memcpy(p, value.data(), len);
+            ++count;
+        }
+
+        void Listpack::insert(size_t offset, std::string_view value)
+        {
+            uint32_t len = static_cast<uint32_t>(value.size());
+            size_t bytes = varintSize(len) + len;
+            grow(bytes);
+            data.insert(data.begin() + offset, bytes, '\0');
+            char *p = writeVarint(data.data() + offset, len);
+            std::memcpy(p, value.data(), len);
+            ++count;
+        }
+
+        void Listpack::replace(size_t offset, std::string_view value)
+        {
+            size_t next;
+            at(offset, next);
+            uint32_t len = static_cast<uint32_t>(value.size());
+            size_t old_bytes = next - offset;
+            size_t new_bytes = varintSize(len) + len;
+            if (new_bytes > old_bytes)
+            {
+                grow(new_bytes - old_bytes);
+                data.insert(data.begin() + next, new_bytes - old_bytes, '\0');
+            }
+            else if (new_bytes < old_bytes)
+            {
+                data.erase(data.begin() + offset + new_bytes, data.begin() + next);
+            }
+            char *p = writeVarint(data.data() + offset, len);
+            std::memcpy(p, value.data(), len);
+        }
+
+        void Listpack::erase(size_t offset)
+        {
+            size_t next;
+            at(offset, next);
+            data.erase(data.begin() + offset, data.begin() + next);
+            --count;
+        }
+
+    } // namespace storage
+} // namespace opus
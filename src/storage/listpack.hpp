@@ -0,0 +1,95 @@
+#ifndef OPUS_STORAGE_LISTPACK_HPP
+#define OPUS_STORAGE_LISTPACK_HPP
+
+#include <cstddef>
+#include <cstdint>
+#include <string_view>
+#include <vector>
+
+#include "slab_allocator.hpp"
+
+namespace opus
+{
+    namespace storage
+    {
+
+        /**
+         * @brief Small collection of strings packed into one buffer
+         *
+         * Each element is `<len varint><bytes>`, one after another with no
+         * per-element allocation, so a short member costs one byte of
+         * overhead. Elements are addressed by byte offset; lookups are a
+         * linear walk, which is why owners convert to a real table once a
+         * listpack grows past a few hundred bytes of entries.
+         */
+        class Listpack
+        {
+        private:
+            std::vector<char, SlabStlAllocator<char>> data;
+            uint32_t count = 0;
+
+            // Makes room for `bytes` more, growing by an eighth at a time
+            // rather than doubling: a listpack is rewritten in place, and
+            // slack would cost more than the occasional extra copy.
+            void grow(size_t bytes);
+
+        public:
+            static constexpr size_t npos = SIZE_MAX;
+
+            size_t size() const { return count; }
+            bool empty() const { return count == 0; }
+
+            /**
+             * @brief Heap bytes held by the buffer
+             */
+            size_t bytes() const { return data.capacity(); }
+
+            /**
+             * @brief Moves the buffer out of a sparsely used allocator page
+             * @return whether it moved
+             */
+            bool defrag() { return defragVector(data); }
+
+            /**
+             * @brief Offset one past the last element, for walking with at()
+             */
+            size_t end() const { return data.size(); }
+
+            /**
+             * @brief The element at `offset`; `next` receives the offset of
+             *        the element after it
+             */
+            std::string_view at(size_t offset, size_t &next) const;
+
+            /**
+             * @brief Compares every `stride`-th element, starting with the
+             *        first (a stride of 2 looks only at the keys of key/value
+             *        pairs)
+             * @return offset of the first matching element, or npos
+             */
+            size_t find(std::string_view value, size_t stride = 1) const;
+
+            void append(std::string_view value);
+
+            /**
+             * @brief Inserts `value` before the element at `offset` (at the
+             *        end if `offset` is end())
+             */
+            void insert(size_t offset, std::string_view value);
+
+            /**
+             * @brief Overwrites the element at `offset`, moving the ones
+             *        after it if the size changes
+             */
+            void replace(size_t offset, std::string_view value);
+
+            /**
+             * @brief Removes the element at `offset`
+             */
+            void erase(size_t offset);
+        };
+
+    } // namespace storage
+} // namespace opus
+
+#endif // OPUS_STORAGE_LISTPACK_HPP
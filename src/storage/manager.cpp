@@ -1,200 +1,1769 @@
-#include <unordered_map>
-#include <memory>
-#include <optional>
-#include <stdexcept>
+#include "manager.hpp"
+#include "slab_allocator.hpp"
 
-#include "base_datastructure.hpp"
-#include "string_type.hpp"
-#include "list_type.hpp"
-#include "set_type.hpp"
+#include <algorithm>
+#include <cctype>
+#include <cmath>
+#include <mutex>
+#include <stdexcept>
 
 namespace opus
 {
     namespace storage
     {
-        class CacheManager
+        using ReadLock = std::shared_lock<std::shared_mutex>;
+        using WriteLock = std::unique_lock<std::shared_mutex>;
+
+        namespace
+        {
+            // The sketch is sized for the keys maxmemory could hold if each
+            // took this much, up to a few million keys.
+            constexpr size_t SKETCH_BYTES_PER_KEY = 64;
+            constexpr size_t MAX_SKETCH_KEYS = size_t(1) << 22;
+
+            // Over-limit evictIfNeeded() calls between recounts of the
+            // admission window's share of the keys.
+            constexpr size_t WINDOW_REFRESH_INTERVAL = 256;
+
+            // Coin flips for the LFU counter; readers bump counters under a
+            // shared lock, so each thread keeps its own generator.
+            double randomUnit()
+            {
+                thread_local uint64_t state = 0x2545F4914F6CDD1DULL ^ reinterpret_cast<uintptr_t>(&state);
+                state ^= state >> 12;
+                state ^= state << 25;
+                state ^= state >> 27;
+                return static_cast<double>((state * 0x2545F4914F6CDD1DULL) >> 11) * 0x1.0p-53;
+            }
+        }
+
+        std::string_view evictionPolicyName(EvictionPolicy policy)
+        {
+            switch (policy)
+            {
+            case EvictionPolicy::NO_EVICTION:
+                return "noeviction";
+            case EvictionPolicy::ALLKEYS_LRU:
+                return "allkeys-lru";
+            case EvictionPolicy::VOLATILE_LRU:
+                return "volatile-lru";
+            case EvictionPolicy::ALLKEYS_LFU:
+                return "allkeys-lfu";
+            case EvictionPolicy::VOLATILE_LFU:
+                return "volatile-lfu";
+            case EvictionPolicy::ALLKEYS_RANDOM:
+                return "allkeys-random";
+            case EvictionPolicy::ALLKEYS_TINYLFU:
+                return "allkeys-tinylfu";
+            }
+            return "unknown";
+        }
+
+        std::optional<EvictionPolicy> parseEvictionPolicy(std::string_view name)
+        {
+            for (EvictionPolicy policy : {EvictionPolicy::NO_EVICTION, EvictionPolicy::ALLKEYS_LRU,
+                                          EvictionPolicy::VOLATILE_LRU, EvictionPolicy::ALLKEYS_LFU,
+                                          EvictionPolicy::VOLATILE_LFU, EvictionPolicy::ALLKEYS_RANDOM,
+                                          EvictionPolicy::ALLKEYS_TINYLFU})
+            {
+                std::string_view known = evictionPolicyName(policy);
+                if (std::equal(known.begin(), known.end(), name.begin(), name.end(), [](char a, char b)
+                               { return a == std::tolower(static_cast<unsigned char>(b)); }))
+                    return policy;
+            }
+            return std::nullopt;
+        }
+
+        CacheManager::CacheManager(size_t shards, bool thread_safe)
+            : shard_count(1), shard_bits(0), thread_safe(thread_safe)
+        {
+            while (shard_count < shards)
+            {
+                shard_count <<= 1;
+                ++shard_bits;
+            }
+            this->shards.reset(new Shard[shard_count]);
+            updateLruClock();
+        }
+
+        CacheManager::Shard &CacheManager::shardFor(size_t hash) const
+        {
+            if (shard_bits == 0)
+                return shards[0];
+
+            // Fibonacci hashing takes the shard from the high bits, leaving the
+            // bits the shard's Dict probes with uncorrelated with it.
+            return shards[(hash * 0x9E3779B97F4A7C15ULL) >> (64 - shard_bits)];
+        }
+
+        ReadLock CacheManager::readLock(Shard &shard) const
+        {
+            return thread_safe ? ReadLock(shard.lock) : ReadLock();
+        }
+
+        WriteLock CacheManager::writeLock(Shard &shard) const
+        {
+            return thread_safe ? WriteLock(shard.lock) : WriteLock();
+        }
+
+        long long CacheManager::currentTimeMs()
+        {
+            using namespace std::chrono;
+            return duration_cast<milliseconds>(system_clock::now().time_since_epoch()).count();
+        }
+
+        EntryPtr *CacheManager::findLive(Shard &shard, std::string_view key, size_t hash, bool touch) const
         {
-        private:
-            std::unordered_map<std::string, std::unique_ptr<BaseDataStructure>> store;
+            EntryPtr *slot = shard.store.find(key, hash);
+            if (!slot)
+                return nullptr;
 
-            template <typename T>
-            T *getAs(const std::string &key)
+            if ((*slot)->hasExpiry() && shard.expires.find(key, hash)->when <= currentTimeMs())
             {
-                auto it = store.find(key);
-                if (it == store.end())
+                if (!thread_safe)
                 {
-                    return nullptr;
+                    eraseKey(shard, key, hash);
+                    expired_keys.fetch_add(1, std::memory_order_relaxed);
                 }
-                T *ptr = dynamic_cast<T *>(it->second.get());
-                if (!ptr)
+                return nullptr;
+            }
+
+            if (touch)
+                this->touch(**slot, hash);
+            return slot;
+        }
+
+        void CacheManager::touch(Entry &entry, size_t hash) const
+        {
+            if (lfuPolicy())
+            {
+                // Logarithmic increment: the higher the counter, the less
+                // likely another access moves it.
+                uint32_t counter = lfuCounter(entry);
+                if (counter < 255)
                 {
-                    throw std::runtime_error("WRONGTYPE: Operation against a key holding the wrong kind of value");
+                    double base = counter > LFU_INIT_VAL ? counter - LFU_INIT_VAL : 0;
+                    if (randomUnit() < 1.0 / (base * lfu_log_factor + 1))
+                        ++counter;
                 }
-                return ptr;
+                entry.setLruClock(lfu_clock.load(std::memory_order_relaxed) << 8 | counter);
+                return;
+            }
+
+            // Skip the store when the stamp is current, so hot keys read in a
+            // tight loop do not keep dirtying their cache line.
+            uint32_t now = lru_clock.load(std::memory_order_relaxed);
+            if (entry.lruClock() != now)
+                entry.setLruClock(now);
+            if (sketch)
+                sketch->increment(hash);
+        }
+
+        uint32_t CacheManager::lfuCounter(const Entry &entry) const
+        {
+            uint32_t stamp = entry.lruClock();
+            uint32_t counter = stamp & 0xFF;
+            if (lfu_decay_time == 0)
+                return counter;
+            uint32_t idle_minutes = (lfu_clock.load(std::memory_order_relaxed) - (stamp >> 8)) & 0xFFFF;
+            uint32_t periods = idle_minutes / lfu_decay_time;
+            return periods >= counter ? 0 : counter - periods;
+        }
+
+        bool CacheManager::eraseKey(Shard &shard, std::string_view key, size_t hash, bool lazy) const
+        {
+            EntryPtr *slot = shard.store.find(key, hash);
+            if (!slot)
+                return false;
+
+            releaseReaders(**slot);
+
+            // The deadline goes first: its key view points into the entry.
+            if ((*slot)->hasExpiry())
+                shard.expires.erase(key, hash);
+            ValueType type = (*slot)->type();
+            size_t usage = (*slot)->memoryUsage();
+            EntryPtr doomed = std::move(*slot);
+            shard.store.erase(slot);
+            account(shard, type, usage, 0);
+            if (lazy)
+                lazy_free.release(std::move(doomed));
+            return true;
+        }
+
+        void CacheManager::releaseReaders(const Entry &entry) const
+        {
+            if (!entry.hasReaders())
+                return;
+            auto [first, last] = readers.equal_range(&entry);
+            std::vector<ValueReader *> released;
+            for (auto it = first; it != last; ++it)
+            {
+                it->second->attached = nullptr;
+                released.push_back(it->second);
             }
+            readers.erase(first, last);
+            const_cast<Entry &>(entry).setHasReaders(false);
+            for (ValueReader *reader : released)
+            {
+                reader->valueChanging();
+            }
+        }
+
+        void CacheManager::detachReader(ValueReader &reader)
+        {
+            if (!reader.attached)
+                return;
+            auto [first, last] = readers.equal_range(reader.attached);
+            readers.erase(std::find_if(first, last, [&](const auto &attached) { return attached.second == &reader; }));
+            if (readers.count(reader.attached) == 0)
+                const_cast<Entry *>(reader.attached)->setHasReaders(false);
+            reader.attached = nullptr;
+        }
+
+        void CacheManager::account(Shard &shard, ValueType type, size_t before, size_t after)
+        {
+            // Only the write lock holder changes the counts, so this needs no
+            // atomic read-modify-write. Table sizes are refreshed here too,
+            // since inserts and erases are what grow and swap the tables.
+            auto move = [&](std::atomic<size_t> &count)
+            { count.store(count.load(std::memory_order_relaxed) - before + after, std::memory_order_relaxed); };
+            move(shard.used_memory);
+            move(shard.type_memory[static_cast<size_t>(type)]);
+            accountTables(shard);
+        }
 
-            template <typename T>
-            T *getOrCreate(const std::string &key)
+        void CacheManager::accountTables(Shard &shard)
+        {
+            shard.table_bytes.store(shard.store.tableBytes() + shard.expires.tableBytes(), std::memory_order_relaxed);
+        }
+
+        template <typename F>
+        decltype(auto) CacheManager::update(Shard &shard, Entry *entry, F &&mutate)
+        {
+            // Settles on the way out, so a mutation that throws halfway (a
+            // ZADD INCR that gives NaN) is still accounted for.
+            struct Settle
+            {
+                Shard &shard;
+                Entry *entry;
+                size_t before;
+                ~Settle() { account(shard, entry->type(), before, entry->memoryUsage()); }
+            } settle{shard, entry, entry->memoryUsage()};
+            releaseReaders(*entry);
+            return mutate();
+        }
+
+        Entry *CacheManager::storeEntry(Shard &shard, size_t hash, EntryPtr created, bool keep_ttl)
+        {
+            std::string_view key = created->key();
+            EntryPtr *slot = shard.store.find(key, hash);
+            if (lfuPolicy() && !slot)
             {
-                auto it = store.find(key);
-                if (it == store.end())
+                created->setLruClock(lfu_clock.load(std::memory_order_relaxed) << 8 | LFU_INIT_VAL);
+            }
+            else
+            {
+                // As in Redis, overwriting a key keeps its popularity.
+                if (lfuPolicy())
+                    created->setLruClock((*slot)->lruClock());
+                touch(*created, hash);
+            }
+
+            if (!slot)
+            {
+                Entry *entry = shard.store.insertUnique(std::move(created), hash)->get();
+                account(shard, entry->type(), 0, entry->memoryUsage());
+                if (sketch)
+                    enterAdmissionWindow(entry->key(), hash);
+                return entry;
+            }
+
+            releaseReaders(**slot);
+            if ((*slot)->hasExpiry())
+            {
+                ExpiryRecord *record = shard.expires.find(key, hash);
+                if (keep_ttl && record->when > currentTimeMs())
                 {
-                    auto newObj = std::make_unique<T>();
-                    T *ptr = newObj.get();
-                    store[key] = std::move(newObj);
-                    return ptr;
+                    record->entry = created.get();
+                    created->setHasExpiry(true);
                 }
-
-                T *ptr = dynamic_cast<T *>(it->second.get());
-                if (!ptr)
+                else
                 {
-                    throw std::runtime_error("WRONGTYPE: Operation against a key holding the wrong kind of value");
+                    shard.expires.erase(key, hash);
                 }
-                return ptr;
             }
+            account(shard, (*slot)->type(), (*slot)->memoryUsage(), 0);
+            account(shard, created->type(), 0, created->memoryUsage());
+            EntryPtr replaced = std::move(*slot);
+            *slot = std::move(created);
+            lazy_free.release(std::move(replaced));
+            return slot->get();
+        }
+
+        void CacheManager::setDeadline(Shard &shard, Entry *entry, size_t hash, long long when)
+        {
+            if (entry->hasExpiry())
+            {
+                shard.expires.find(entry->key(), hash)->when = when;
+                return;
+            }
+            shard.expires.insertUnique(ExpiryRecord{entry, when}, hash);
+            entry->setHasExpiry(true);
+            accountTables(shard);
+        }
 
-        public:
-            void set(const std::string &key, const std::string &value)
+        Entry *CacheManager::lookup(Shard &shard, std::string_view key, size_t hash, ValueType expected) const
+        {
+            EntryPtr *slot = findLive(shard, key, hash);
+            if (!slot)
             {
-                store[key] = std::make_unique<StringType>(value);
+                return nullptr;
             }
+            if ((*slot)->type() != expected)
+            {
+                throw std::runtime_error("WRONGTYPE: Operation against a key holding the wrong kind of value");
+            }
+            return slot->get();
+        }
+
+        template <typename T>
+        T *CacheManager::getAs(Shard &shard, std::string_view key, size_t hash) const
+        {
+            Entry *entry = lookup(shard, key, hash, T::TYPE);
+            return entry ? entry->as<T>() : nullptr;
+        }
 
-            std::optional<std::string> get(const std::string &key)
+        template <typename T>
+        Entry *CacheManager::getOrCreate(Shard &shard, std::string_view key, size_t hash)
+        {
+            if (Entry *entry = lookup(shard, key, hash, T::TYPE))
             {
-                StringType *str = getAs<StringType>(key);
-                if (!str)
-                    return std::nullopt;
-                return str->get();
+                return entry;
             }
+            return storeEntry(shard, hash, EntryPtr(Entry::create<T>(key)));
+        }
+
+        template <typename Lock>
+        std::vector<Lock> CacheManager::lockKeys(const std::vector<std::string_view> &keys, const std::string_view *extra) const
+        {
+            if (!thread_safe)
+                return {};
 
-            int lpush(const std::string &key, const std::string &value)
+            std::vector<size_t> hashes;
+            hashes.reserve(keys.size() + 1);
+            for (std::string_view key : keys)
+            {
+                hashes.push_back(Keyspace::hashKey(key));
+            }
+            if (extra)
             {
-                ListType *list = getOrCreate<ListType>(key);
-                return list->lpush(value);
+                hashes.push_back(Keyspace::hashKey(*extra));
             }
+            return lockHashes<Lock>(hashes);
+        }
 
-            int rpush(const std::string &key, const std::string &value)
+        void CacheManager::prefetchAhead(const std::vector<size_t> &hashes, size_t i) const
+        {
+            size_t from = i == 0 ? 0 : i + PREFETCH_DISTANCE;
+            size_t to = std::min(hashes.size(), i + PREFETCH_DISTANCE + 1);
+            for (size_t j = from; j < to; ++j)
             {
-                ListType *list = getOrCreate<ListType>(key);
-                return list->rpush(value);
+                shardFor(hashes[j]).store.prefetch(hashes[j]);
             }
+        }
 
-            std::optional<std::string> lpop(const std::string &key)
+        std::vector<const SetType *> CacheManager::setsFor(const std::vector<std::string_view> &keys) const
+        {
+            std::vector<const SetType *> sets;
+            sets.reserve(keys.size());
+            for (std::string_view key : keys)
             {
-                ListType *list = getAs<ListType>(key);
-                if (!list)
-                    return std::nullopt;
+                size_t hash = Keyspace::hashKey(key);
+                sets.push_back(getAs<SetType>(shardFor(hash), key, hash));
+            }
+            return sets;
+        }
 
-                auto result = list->lpop();
-                if (list->isEmpty())
-                {
-                    store.erase(key);
-                }
-                return result;
+        size_t CacheManager::storeSet(std::string_view dest, std::vector<std::string> members)
+        {
+            size_t hash = Keyspace::hashKey(dest);
+            Shard &shard = shardFor(hash);
+            if (members.empty())
+            {
+                eraseKey(shard, dest, hash);
+                return 0;
+            }
+
+            size_t count = members.size();
+            EntryPtr created(Entry::create<SetType>(dest));
+            created->as<SetType>()->sadd(std::move(members));
+            storeEntry(shard, hash, std::move(created));
+            return count;
+        }
+
+        void CacheManager::set(std::string_view key, std::string_view value, long long expire_at, bool keep_ttl)
+        {
+            EntryPtr created(Entry::createString(key, value));
+            size_t hash = Keyspace::hashKey(key);
+            Shard &shard = shardFor(hash);
+            WriteLock guard = writeLock(shard);
+            Entry *entry = storeEntry(shard, hash, std::move(created), keep_ttl);
+            if (expire_at != 0)
+                setDeadline(shard, entry, hash, expire_at);
+        }
+
+        void CacheManager::storePairs(const std::vector<KeyValue> &pairs, const std::vector<size_t> &hashes)
+        {
+            for (size_t i = 0; i < pairs.size(); ++i)
+            {
+                prefetchAhead(hashes, i);
+                EntryPtr created(Entry::createString(pairs[i].first, pairs[i].second));
+                storeEntry(shardFor(hashes[i]), hashes[i], std::move(created));
+            }
+        }
+
+        void CacheManager::mset(const std::vector<KeyValue> &pairs)
+        {
+            std::vector<size_t> hashes;
+            hashes.reserve(pairs.size());
+            for (const auto &pair : pairs)
+            {
+                hashes.push_back(Keyspace::hashKey(pair.first));
+            }
+            auto guards = lockHashes<WriteLock>(hashes);
+            storePairs(pairs, hashes);
+        }
+
+        bool CacheManager::msetnx(const std::vector<KeyValue> &pairs)
+        {
+            std::vector<size_t> hashes;
+            hashes.reserve(pairs.size());
+            for (const auto &pair : pairs)
+            {
+                hashes.push_back(Keyspace::hashKey(pair.first));
+            }
+            auto guards = lockHashes<WriteLock>(hashes);
+            for (size_t i = 0; i < pairs.size(); ++i)
+            {
+                prefetchAhead(hashes, i);
+                if (findLive(shardFor(hashes[i]), pairs[i].first, hashes[i], false))
+                    return false;
+            }
+            storePairs(pairs, hashes);
+            return true;
+        }
+
+        std::optional<std::string> CacheManager::get(std::string_view key)
+        {
+            size_t hash = Keyspace::hashKey(key);
+            Shard &shard = shardFor(hash);
+            ReadLock guard = readLock(shard);
+            Entry *entry = lookup(shard, key, hash, ValueType::STRING);
+            if (!entry)
+                return std::nullopt;
+            return entry->stringValue();
+        }
+
+        long long CacheManager::incrby(std::string_view key, long long delta)
+        {
+            size_t hash = Keyspace::hashKey(key);
+            Shard &shard = shardFor(hash);
+            WriteLock guard = writeLock(shard);
+            Entry *entry = lookup(shard, key, hash, ValueType::STRING);
+            if (!entry)
+            {
+                storeEntry(shard, hash, EntryPtr(Entry::createInteger(key, delta)));
+                return delta;
+            }
+
+            long long current;
+            if (!entry->integerValue(current))
+            {
+                throw std::runtime_error("ERR value is not an integer or out of range");
+            }
+            long long result;
+            if (__builtin_add_overflow(current, delta, &result))
+            {
+                throw std::runtime_error("ERR increment or decrement would overflow");
+            }
+            update(shard, entry, [&] { entry->setInteger(result); });
+            return result;
+        }
+
+        std::string CacheManager::incrbyfloat(std::string_view key, long double delta)
+        {
+            size_t hash = Keyspace::hashKey(key);
+            Shard &shard = shardFor(hash);
+            WriteLock guard = writeLock(shard);
+            Entry *entry = lookup(shard, key, hash, ValueType::STRING);
+
+            long double current = 0;
+            if (entry && !entry->floatValue(current))
+            {
+                throw std::runtime_error("ERR value is not a valid float");
+            }
+            long double result = current + delta;
+            if (std::isnan(result) || std::isinf(result))
+            {
+                throw std::runtime_error("ERR increment would produce NaN or Infinity");
+            }
+
+            // Float results are kept as their string form, which is what
+            // GET must return byte for byte. Like INCR, this keeps the TTL.
+            std::string text = StringType::formatFloat(result);
+            storeEntry(shard, hash, EntryPtr(Entry::createString(key, text)), true);
+            return text;
+        }
+
+        int CacheManager::lpush(std::string_view key, std::string_view value)
+        {
+            size_t hash = Keyspace::hashKey(key);
+            Shard &shard = shardFor(hash);
+            WriteLock guard = writeLock(shard);
+            Entry *entry = getOrCreate<ListType>(shard, key, hash);
+            return update(shard, entry, [&] { return entry->as<ListType>()->lpush(value); });
+        }
+
+        int CacheManager::rpush(std::string_view key, std::string_view value)
+        {
+            size_t hash = Keyspace::hashKey(key);
+            Shard &shard = shardFor(hash);
+            WriteLock guard = writeLock(shard);
+            Entry *entry = getOrCreate<ListType>(shard, key, hash);
+            return update(shard, entry, [&] { return entry->as<ListType>()->rpush(value); });
+        }
+
+        int CacheManager::lpush(std::string_view key, const std::vector<std::string_view> &values)
+        {
+            size_t hash = Keyspace::hashKey(key);
+            Shard &shard = shardFor(hash);
+            WriteLock guard = writeLock(shard);
+            Entry *entry = getOrCreate<ListType>(shard, key, hash);
+            return update(shard, entry, [&] { return entry->as<ListType>()->lpush(values); });
+        }
+
+        int CacheManager::rpush(std::string_view key, const std::vector<std::string_view> &values)
+        {
+            size_t hash = Keyspace::hashKey(key);
+            Shard &shard = shardFor(hash);
+            WriteLock guard = writeLock(shard);
+            Entry *entry = getOrCreate<ListType>(shard, key, hash);
+            return update(shard, entry, [&] { return entry->as<ListType>()->rpush(values); });
+        }
+
+        std::optional<std::string> CacheManager::lpop(std::string_view key)
+        {
+            size_t hash = Keyspace::hashKey(key);
+            Shard &shard = shardFor(hash);
+            WriteLock guard = writeLock(shard);
+            Entry *entry = lookup(shard, key, hash, ListType::TYPE);
+            ListType *list = entry ? entry->as<ListType>() : nullptr;
+            if (!list)
+                return std::nullopt;
+
+            auto result = update(shard, entry, [&] { return list->lpop(); });
+            if (list->isEmpty())
+            {
+                eraseKey(shard, key, hash);
+            }
+            return result;
+        }
+
+        std::optional<std::string> CacheManager::rpop(std::string_view key)
+        {
+            size_t hash = Keyspace::hashKey(key);
+            Shard &shard = shardFor(hash);
+            WriteLock guard = writeLock(shard);
+            Entry *entry = lookup(shard, key, hash, ListType::TYPE);
+            ListType *list = entry ? entry->as<ListType>() : nullptr;
+            if (!list)
+                return std::nullopt;
+
+            auto result = update(shard, entry, [&] { return list->rpop(); });
+            if (list->isEmpty())
+            {
+                eraseKey(shard, key, hash);
+            }
+            return result;
+        }
+
+        int CacheManager::llen(std::string_view key)
+        {
+            size_t hash = Keyspace::hashKey(key);
+            Shard &shard = shardFor(hash);
+            ReadLock guard = readLock(shard);
+            ListType *list = getAs<ListType>(shard, key, hash);
+            return list ? list->llen() : 0;
+        }
+
+        std::vector<std::string> CacheManager::lrange(std::string_view key, long long start, long long stop)
+        {
+            size_t hash = Keyspace::hashKey(key);
+            Shard &shard = shardFor(hash);
+            ReadLock guard = readLock(shard);
+            ListType *list = getAs<ListType>(shard, key, hash);
+            if (!list)
+                return {};
+            return list->lrange(start, stop);
+        }
+
+        std::optional<std::string> CacheManager::lindex(std::string_view key, long long index)
+        {
+            size_t hash = Keyspace::hashKey(key);
+            Shard &shard = shardFor(hash);
+            ReadLock guard = readLock(shard);
+            ListType *list = getAs<ListType>(shard, key, hash);
+            if (!list)
+                return std::nullopt;
+            return list->lindex(index);
+        }
+
+        void CacheManager::lset(std::string_view key, long long index, std::string_view value)
+        {
+            size_t hash = Keyspace::hashKey(key);
+            Shard &shard = shardFor(hash);
+            WriteLock guard = writeLock(shard);
+            Entry *entry = lookup(shard, key, hash, ListType::TYPE);
+            ListType *list = entry ? entry->as<ListType>() : nullptr;
+            if (!list)
+            {
+                throw std::runtime_error("ERR no such key");
+            }
+            if (!update(shard, entry, [&] { return list->lset(index, value); }))
+            {
+                throw std::runtime_error("ERR index out of range");
+            }
+        }
+
+        int CacheManager::linsert(std::string_view key, bool before, std::string_view pivot, std::string_view value)
+        {
+            size_t hash = Keyspace::hashKey(key);
+            Shard &shard = shardFor(hash);
+            WriteLock guard = writeLock(shard);
+            Entry *entry = lookup(shard, key, hash, ListType::TYPE);
+            ListType *list = entry ? entry->as<ListType>() : nullptr;
+            if (!list)
+                return 0;
+            return update(shard, entry, [&] { return list->linsert(before, pivot, value); });
+        }
+
+        void CacheManager::ltrim(std::string_view key, long long start, long long stop)
+        {
+            size_t hash = Keyspace::hashKey(key);
+            Shard &shard = shardFor(hash);
+            WriteLock guard = writeLock(shard);
+            Entry *entry = lookup(shard, key, hash, ListType::TYPE);
+            ListType *list = entry ? entry->as<ListType>() : nullptr;
+            if (!list)
+                return;
+
+            update(shard, entry, [&] { list->ltrim(start, stop); });
+            if (list->isEmpty())
+            {
+                eraseKey(shard, key, hash);
             }
+        }
 
-            std::optional<std::string> rpop(const std::string &key)
+        int CacheManager::lrem(std::string_view key, long long count, std::string_view value)
+        {
+            size_t hash = Keyspace::hashKey(key);
+            Shard &shard = shardFor(hash);
+            WriteLock guard = writeLock(shard);
+            Entry *entry = lookup(shard, key, hash, ListType::TYPE);
+            ListType *list = entry ? entry->as<ListType>() : nullptr;
+            if (!list)
+                return 0;
+
+            int removed = update(shard, entry, [&] { return list->lrem(count, value); });
+            if (list->isEmpty())
             {
-                ListType *list = getAs<ListType>(key);
-                if (!list)
-                    return std::nullopt;
+                eraseKey(shard, key, hash);
+            }
+            return removed;
+        }
+
+        int CacheManager::sadd(std::string_view key, std::string_view value)
+        {
+            size_t hash = Keyspace::hashKey(key);
+            Shard &shard = shardFor(hash);
+            WriteLock guard = writeLock(shard);
+            Entry *entry = getOrCreate<SetType>(shard, key, hash);
+            return update(shard, entry, [&] { return entry->as<SetType>()->sadd(value); });
+        }
+
+        int CacheManager::sadd(std::string_view key, const std::vector<std::string_view> &values)
+        {
+            size_t hash = Keyspace::hashKey(key);
+            Shard &shard = shardFor(hash);
+            WriteLock guard = writeLock(shard);
+            Entry *entry = getOrCreate<SetType>(shard, key, hash);
+            return update(shard, entry, [&] { return entry->as<SetType>()->sadd(values); });
+        }
+
+        int CacheManager::sadd(std::string_view key, std::vector<std::string> &&values)
+        {
+            size_t hash = Keyspace::hashKey(key);
+            Shard &shard = shardFor(hash);
+            WriteLock guard = writeLock(shard);
+            Entry *entry = getOrCreate<SetType>(shard, key, hash);
+            return update(shard, entry, [&] { return entry->as<SetType>()->sadd(std::move(values)); });
+        }
 
-                auto result = list->rpop();
-                if (list->isEmpty())
+        bool CacheManager::sismember(std::string_view key, std::string_view value)
+        {
+            size_t hash = Keyspace::hashKey(key);
+            Shard &shard = shardFor(hash);
+            ReadLock guard = readLock(shard);
+            SetType *set = getAs<SetType>(shard, key, hash);
+            return set ? set->sismember(value) : false;
+        }
+
+        int CacheManager::srem(std::string_view key, std::string_view value)
+        {
+            size_t hash = Keyspace::hashKey(key);
+            Shard &shard = shardFor(hash);
+            WriteLock guard = writeLock(shard);
+            Entry *entry = lookup(shard, key, hash, SetType::TYPE);
+            SetType *set = entry ? entry->as<SetType>() : nullptr;
+            if (!set)
+                return 0;
+
+            int result = update(shard, entry, [&] { return set->srem(value); });
+            if (set->isEmpty())
+            {
+                eraseKey(shard, key, hash);
+            }
+            return result;
+        }
+
+        int CacheManager::scard(std::string_view key)
+        {
+            size_t hash = Keyspace::hashKey(key);
+            Shard &shard = shardFor(hash);
+            ReadLock guard = readLock(shard);
+            SetType *set = getAs<SetType>(shard, key, hash);
+            return set ? set->scard() : 0;
+        }
+
+        std::vector<std::string> CacheManager::smembers(std::string_view key)
+        {
+            size_t hash = Keyspace::hashKey(key);
+            Shard &shard = shardFor(hash);
+            ReadLock guard = readLock(shard);
+            SetType *set = getAs<SetType>(shard, key, hash);
+            if (!set)
+                return {};
+            return set->smembers();
+        }
+
+        unsigned long long CacheManager::sscan(std::string_view key, unsigned long long cursor, size_t count,
+                                               std::vector<std::string> &out)
+        {
+            size_t hash = Keyspace::hashKey(key);
+            Shard &shard = shardFor(hash);
+            ReadLock guard = readLock(shard);
+            SetType *set = getAs<SetType>(shard, key, hash);
+            return set ? set->sscan(cursor, count, out) : 0;
+        }
+
+        std::vector<std::string> CacheManager::sinter(const std::vector<std::string_view> &keys)
+        {
+            auto guards = lockKeys<ReadLock>(keys);
+            return SetType::intersect(setsFor(keys));
+        }
+
+        std::vector<std::string> CacheManager::sunion(const std::vector<std::string_view> &keys)
+        {
+            auto guards = lockKeys<ReadLock>(keys);
+            return SetType::unite(setsFor(keys));
+        }
+
+        std::vector<std::string> CacheManager::sdiff(const std::vector<std::string_view> &keys)
+        {
+            auto guards = lockKeys<ReadLock>(keys);
+            return SetType::difference(setsFor(keys));
+        }
+
+        size_t CacheManager::sintercard(const std::vector<std::string_view> &keys, size_t limit)
+        {
+            auto guards = lockKeys<ReadLock>(keys);
+            return SetType::intersectCount(setsFor(keys), limit);
+        }
+
+        size_t CacheManager::sinterstore(std::string_view dest, const std::vector<std::string_view> &keys)
+        {
+            auto guards = lockKeys<WriteLock>(keys, &dest);
+            return storeSet(dest, SetType::intersect(setsFor(keys)));
+        }
+
+        size_t CacheManager::sunionstore(std::string_view dest, const std::vector<std::string_view> &keys)
+        {
+            auto guards = lockKeys<WriteLock>(keys, &dest);
+            return storeSet(dest, SetType::unite(setsFor(keys)));
+        }
+
+        size_t CacheManager::sdiffstore(std::string_view dest, const std::vector<std::string_view> &keys)
+        {
+            auto guards = lockKeys<WriteLock>(keys, &dest);
+            return storeSet(dest, SetType::difference(setsFor(keys)));
+        }
+
+        int CacheManager::hset(std::string_view key, const std::vector<HashType::FieldValue> &pairs)
+        {
+            size_t hash = Keyspace::hashKey(key);
+            Shard &shard = shardFor(hash);
+            WriteLock guard = writeLock(shard);
+            Entry *entry = getOrCreate<HashType>(shard, key, hash);
+            HashType *fields = entry->as<HashType>();
+            int added = 0;
+            update(shard, entry, [&]
+                   {
+                       for (const auto &[field, value] : pairs)
+                       {
+                           added += fields->hset(field, value);
+                       }
+                   });
+            return added;
+        }
+
+        std::optional<std::string> CacheManager::hget(std::string_view key, std::string_view field)
+        {
+            size_t hash = Keyspace::hashKey(key);
+            Shard &shard = shardFor(hash);
+            ReadLock guard = readLock(shard);
+            HashType *fields = getAs<HashType>(shard, key, hash);
+            return fields ? fields->hget(field) : std::nullopt;
+        }
+
+        std::vector<std::optional<std::string>> CacheManager::hmget(std::string_view key, const std::vector<std::string_view> &fields)
+        {
+            size_t hash = Keyspace::hashKey(key);
+            Shard &shard = shardFor(hash);
+            ReadLock guard = readLock(shard);
+            HashType *stored = getAs<HashType>(shard, key, hash);
+            std::vector<std::optional<std::string>> values(fields.size());
+            if (stored)
+            {
+                for (size_t i = 0; i < fields.size(); ++i)
                 {
-                    store.erase(key);
+                    values[i] = stored->hget(fields[i]);
                 }
-                return result;
             }
+            return values;
+        }
+
+        int CacheManager::hdel(std::string_view key, const std::vector<std::string_view> &fields)
+        {
+            size_t hash = Keyspace::hashKey(key);
+            Shard &shard = shardFor(hash);
+            WriteLock guard = writeLock(shard);
+            Entry *entry = lookup(shard, key, hash, HashType::TYPE);
+            HashType *stored = entry ? entry->as<HashType>() : nullptr;
+            if (!stored)
+                return 0;
+
+            int removed = 0;
+            update(shard, entry, [&]
+                   {
+                       for (std::string_view field : fields)
+                       {
+                           removed += stored->hdel(field);
+                       }
+                   });
+            if (stored->isEmpty())
+            {
+                eraseKey(shard, key, hash);
+            }
+            return removed;
+        }
+
+        long long CacheManager::hincrby(std::string_view key, std::string_view field, long long delta)
+        {
+            size_t hash = Keyspace::hashKey(key);
+            Shard &shard = shardFor(hash);
+            WriteLock guard = writeLock(shard);
+            Entry *entry = getOrCreate<HashType>(shard, key, hash);
+            return update(shard, entry, [&] { return entry->as<HashType>()->hincrby(field, delta); });
+        }
+
+        int CacheManager::hlen(std::string_view key)
+        {
+            size_t hash = Keyspace::hashKey(key);
+            Shard &shard = shardFor(hash);
+            ReadLock guard = readLock(shard);
+            HashType *fields = getAs<HashType>(shard, key, hash);
+            return fields ? fields->hlen() : 0;
+        }
+
+        bool CacheManager::hexists(std::string_view key, std::string_view field)
+        {
+            size_t hash = Keyspace::hashKey(key);
+            Shard &shard = shardFor(hash);
+            ReadLock guard = readLock(shard);
+            HashType *fields = getAs<HashType>(shard, key, hash);
+            return fields ? fields->hexists(field) : false;
+        }
+
+        std::vector<HashType::FieldValue> CacheManager::hgetall(std::string_view key)
+        {
+            size_t hash = Keyspace::hashKey(key);
+            Shard &shard = shardFor(hash);
+            ReadLock guard = readLock(shard);
+            HashType *fields = getAs<HashType>(shard, key, hash);
+            if (!fields)
+                return {};
+            return fields->hgetall();
+        }
 
-            int llen(const std::string &key)
+        unsigned long long CacheManager::hscan(std::string_view key, unsigned long long cursor, size_t count,
+                                               std::vector<HashType::FieldValue> &out)
+        {
+            size_t hash = Keyspace::hashKey(key);
+            Shard &shard = shardFor(hash);
+            ReadLock guard = readLock(shard);
+            HashType *fields = getAs<HashType>(shard, key, hash);
+            return fields ? fields->hscan(cursor, count, out) : 0;
+        }
+
+        std::optional<double> CacheManager::zadd(std::string_view key,
+                                                 const std::vector<std::pair<double, std::string>> &pairs,
+                                                 unsigned flags, int &added, int &updated)
+        {
+            size_t hash = Keyspace::hashKey(key);
+            Shard &shard = shardFor(hash);
+            WriteLock guard = writeLock(shard);
+            Entry *entry = lookup(shard, key, hash, SortedSetType::TYPE);
+            SortedSetType *zset = entry ? entry->as<SortedSetType>() : nullptr;
+            if (!zset && (flags & SortedSetType::ADD_XX))
+                return std::nullopt;
+            if (!zset)
             {
-                ListType *list = getAs<ListType>(key);
-                return list ? list->llen() : 0;
+                entry = getOrCreate<SortedSetType>(shard, key, hash);
+                zset = entry->as<SortedSetType>();
             }
 
-            std::vector<std::string> lrange(const std::string &key, int start, int stop)
+            std::optional<double> last;
+            update(shard, entry, [&]
+                   {
+                       for (const auto &[score, member] : pairs)
+                       {
+                           double result = score;
+                           switch (zset->zadd(member, result, flags))
+                           {
+                           case SortedSetType::AddResult::ADDED:
+                               ++added;
+                               last = result;
+                               break;
+                           case SortedSetType::AddResult::UPDATED:
+                               ++updated;
+                               last = result;
+                               break;
+                           case SortedSetType::AddResult::UNCHANGED:
+                               last = result;
+                               break;
+                           case SortedSetType::AddResult::SKIPPED:
+                               last = std::nullopt;
+                               break;
+                           }
+                       }
+                   });
+            return last;
+        }
+
+        int CacheManager::zrem(std::string_view key, const std::vector<std::string_view> &members)
+        {
+            size_t hash = Keyspace::hashKey(key);
+            Shard &shard = shardFor(hash);
+            WriteLock guard = writeLock(shard);
+            Entry *entry = lookup(shard, key, hash, SortedSetType::TYPE);
+            SortedSetType *zset = entry ? entry->as<SortedSetType>() : nullptr;
+            if (!zset)
+                return 0;
+
+            int removed = 0;
+            update(shard, entry, [&]
+                   {
+                       for (std::string_view member : members)
+                       {
+                           removed += zset->zrem(member);
+                       }
+                   });
+            if (zset->isEmpty())
+            {
+                eraseKey(shard, key, hash);
+            }
+            return removed;
+        }
+
+        std::optional<double> CacheManager::zscore(std::string_view key, std::string_view member)
+        {
+            size_t hash = Keyspace::hashKey(key);
+            Shard &shard = shardFor(hash);
+            ReadLock guard = readLock(shard);
+            SortedSetType *zset = getAs<SortedSetType>(shard, key, hash);
+            return zset ? zset->zscore(member) : std::nullopt;
+        }
+
+        std::optional<size_t> CacheManager::zrank(std::string_view key, std::string_view member, bool reverse)
+        {
+            size_t hash = Keyspace::hashKey(key);
+            Shard &shard = shardFor(hash);
+            ReadLock guard = readLock(shard);
+            SortedSetType *zset = getAs<SortedSetType>(shard, key, hash);
+            return zset ? zset->zrank(member, reverse) : std::nullopt;
+        }
+
+        int CacheManager::zcard(std::string_view key)
+        {
+            size_t hash = Keyspace::hashKey(key);
+            Shard &shard = shardFor(hash);
+            ReadLock guard = readLock(shard);
+            SortedSetType *zset = getAs<SortedSetType>(shard, key, hash);
+            return zset ? zset->zcard() : 0;
+        }
+
+        std::vector<SortedSetType::MemberScore> CacheManager::zrange(std::string_view key, long long start,
+                                                                     long long stop, bool reverse)
+        {
+            size_t hash = Keyspace::hashKey(key);
+            Shard &shard = shardFor(hash);
+            ReadLock guard = readLock(shard);
+            SortedSetType *zset = getAs<SortedSetType>(shard, key, hash);
+            if (!zset)
+                return {};
+            return zset->zrange(start, stop, reverse);
+        }
+
+        std::vector<SortedSetType::MemberScore> CacheManager::zrangebyscore(std::string_view key,
+                                                                            const ScoreRange &range, bool reverse,
+                                                                            size_t offset, long long count)
+        {
+            size_t hash = Keyspace::hashKey(key);
+            Shard &shard = shardFor(hash);
+            ReadLock guard = readLock(shard);
+            SortedSetType *zset = getAs<SortedSetType>(shard, key, hash);
+            if (!zset)
+                return {};
+            return zset->zrangebyscore(range, reverse, offset, count);
+        }
+
+        size_t CacheManager::zremrangebyscore(std::string_view key, const ScoreRange &range)
+        {
+            size_t hash = Keyspace::hashKey(key);
+            Shard &shard = shardFor(hash);
+            WriteLock guard = writeLock(shard);
+            Entry *entry = lookup(shard, key, hash, SortedSetType::TYPE);
+            SortedSetType *zset = entry ? entry->as<SortedSetType>() : nullptr;
+            if (!zset)
+                return 0;
+
+            size_t removed = update(shard, entry, [&] { return zset->zremrangebyscore(range); });
+            if (zset->isEmpty())
             {
-                ListType *list = getAs<ListType>(key);
-                if (!list)
-                    return {};
-                return list->lrange(start, stop);
+                eraseKey(shard, key, hash);
             }
+            return removed;
+        }
+
+        std::vector<SortedSetType::MemberScore> CacheManager::zpopmin(std::string_view key, size_t count)
+        {
+            size_t hash = Keyspace::hashKey(key);
+            Shard &shard = shardFor(hash);
+            WriteLock guard = writeLock(shard);
+            Entry *entry = lookup(shard, key, hash, SortedSetType::TYPE);
+            SortedSetType *zset = entry ? entry->as<SortedSetType>() : nullptr;
+            if (!zset)
+                return {};
 
-            int sadd(const std::string &key, const std::string &value)
+            std::vector<SortedSetType::MemberScore> popped = update(shard, entry, [&] { return zset->zpopmin(count); });
+            if (zset->isEmpty())
             {
-                SetType *set = getOrCreate<SetType>(key);
-                return set->sadd(value);
+                eraseKey(shard, key, hash);
             }
+            return popped;
+        }
+
+        unsigned long long CacheManager::zscan(std::string_view key, unsigned long long cursor, size_t count,
+                                               std::vector<SortedSetType::MemberScore> &out)
+        {
+            size_t hash = Keyspace::hashKey(key);
+            Shard &shard = shardFor(hash);
+            ReadLock guard = readLock(shard);
+            SortedSetType *zset = getAs<SortedSetType>(shard, key, hash);
+            return zset ? zset->zscan(cursor, count, out) : 0;
+        }
+
+        bool CacheManager::exists(std::string_view key) const
+        {
+            size_t hash = Keyspace::hashKey(key);
+            Shard &shard = shardFor(hash);
+            ReadLock guard = readLock(shard);
+            // Like TYPE and TTL, EXISTS does not count as an access.
+            return findLive(shard, key, hash, false) != nullptr;
+        }
+
+        bool CacheManager::del(std::string_view key)
+        {
+            size_t hash = Keyspace::hashKey(key);
+            Shard &shard = shardFor(hash);
+            WriteLock guard = writeLock(shard);
+            return eraseKey(shard, key, hash, false);
+        }
+
+        bool CacheManager::unlink(std::string_view key)
+        {
+            size_t hash = Keyspace::hashKey(key);
+            Shard &shard = shardFor(hash);
+            WriteLock guard = writeLock(shard);
+            return eraseKey(shard, key, hash);
+        }
+
+        std::optional<std::string_view> CacheManager::type(std::string_view key) const
+        {
+            size_t hash = Keyspace::hashKey(key);
+            Shard &shard = shardFor(hash);
+            ReadLock guard = readLock(shard);
+            EntryPtr *slot = findLive(shard, key, hash, false);
+            if (!slot)
+                return std::nullopt;
+            return typeName((*slot)->type());
+        }
+
+        std::optional<std::string_view> CacheManager::encoding(std::string_view key) const
+        {
+            size_t hash = Keyspace::hashKey(key);
+            Shard &shard = shardFor(hash);
+            ReadLock guard = readLock(shard);
+            EntryPtr *slot = findLive(shard, key, hash, false);
+            if (!slot)
+                return std::nullopt;
+            return encodingName((*slot)->encoding());
+        }
+
+        std::optional<uint32_t> CacheManager::idleTime(std::string_view key) const
+        {
+            size_t hash = Keyspace::hashKey(key);
+            Shard &shard = shardFor(hash);
+            ReadLock guard = readLock(shard);
+            EntryPtr *slot = findLive(shard, key, hash, false);
+            if (!slot)
+                return std::nullopt;
+            if (lfuPolicy())
+                throw std::runtime_error("ERR An LFU maxmemory policy is selected, idle time not tracked");
+            return (lru_clock.load(std::memory_order_relaxed) - (*slot)->lruClock()) & Entry::LRU_CLOCK_MAX;
+        }
 
-            int sadd(const std::string &key, const std::vector<std::string> &values)
+        std::optional<size_t> CacheManager::memoryUsage(std::string_view key) const
+        {
+            size_t hash = Keyspace::hashKey(key);
+            Shard &shard = shardFor(hash);
+            ReadLock guard = readLock(shard);
+            EntryPtr *slot = findLive(shard, key, hash, false);
+            if (!slot)
+                return std::nullopt;
+
+            // A slot and its control byte per table the key is in.
+            size_t bytes = (*slot)->memoryUsage() + sizeof(EntryPtr) + 1;
+            if ((*slot)->hasExpiry())
+                bytes += sizeof(ExpiryRecord) + 1;
+            return bytes;
+        }
+
+        std::optional<uint32_t> CacheManager::frequency(std::string_view key) const
+        {
+            size_t hash = Keyspace::hashKey(key);
+            Shard &shard = shardFor(hash);
+            ReadLock guard = readLock(shard);
+            EntryPtr *slot = findLive(shard, key, hash, false);
+            if (!slot)
+                return std::nullopt;
+            if (lfuPolicy())
+                return lfuCounter(**slot);
+            if (sketch)
+                return sketch->frequency(hash);
+            throw std::runtime_error("ERR An LFU maxmemory policy is not selected, access frequency not tracked");
+        }
+
+        void CacheManager::clear()
+        {
+            // Take every shard lock (always in index order, so concurrent
+            // clears cannot deadlock) to make the flush atomic.
+            std::vector<WriteLock> guards;
+            guards.reserve(shard_count);
+            for (size_t i = 0; i < shard_count; ++i)
             {
-                SetType *set = getOrCreate<SetType>(key);
-                return set->sadd(values);
+                guards.push_back(writeLock(shards[i]));
             }
+            while (!readers.empty())
+            {
+                releaseReaders(*readers.begin()->first);
+            }
+            for (size_t i = 0; i < shard_count; ++i)
+            {
+                shards[i].expires.clear();
+                shards[i].expire_cursor = 0;
+                shards[i].store.clear();
+                shards[i].used_memory.store(0, std::memory_order_relaxed);
+                for (auto &count : shards[i].type_memory)
+                    count.store(0, std::memory_order_relaxed);
+                accountTables(shards[i]);
+            }
+
+            std::unique_lock<std::mutex> window_guard = thread_safe ? std::unique_lock<std::mutex>(window_lock)
+                                                                    : std::unique_lock<std::mutex>();
+            admission_window.clear();
+        }
 
-            bool sismember(const std::string &key, const std::string &value)
+        void CacheManager::clearAsync()
+        {
+            std::vector<WriteLock> guards;
+            guards.reserve(shard_count);
+            for (size_t i = 0; i < shard_count; ++i)
             {
-                SetType *set = getAs<SetType>(key);
-                return set ? set->sismember(value) : false;
+                guards.push_back(writeLock(shards[i]));
             }
+            while (!readers.empty())
+            {
+                releaseReaders(*readers.begin()->first);
+            }
+            for (size_t i = 0; i < shard_count; ++i)
+            {
+                // Swapped out whole, so the shard is empty at once and the
+                // entries, their values and both tables' arrays are freed on
+                // the background thread. The deadlines point into the entries
+                // but never read them on the way out, so either may go first.
+                auto store = std::make_unique<Keyspace>();
+                auto expires = std::make_unique<Expires>();
+                store->swap(shards[i].store);
+                expires->swap(shards[i].expires);
+                size_t keys = store->size();
+                lazy_free.releaseLater(std::make_pair(std::move(expires), std::move(store)), keys);
+
+                shards[i].expire_cursor = 0;
+                shards[i].used_memory.store(0, std::memory_order_relaxed);
+                for (auto &count : shards[i].type_memory)
+                    count.store(0, std::memory_order_relaxed);
+                accountTables(shards[i]);
+            }
+
+            std::unique_lock<std::mutex> window_guard = thread_safe ? std::unique_lock<std::mutex>(window_lock)
+                                                                    : std::unique_lock<std::mutex>();
+            admission_window.clear();
+        }
 
-            int srem(const std::string &key, const std::string &value)
+        size_t CacheManager::dbsize() const
+        {
+            size_t total = 0;
+            for (size_t i = 0; i < shard_count; ++i)
             {
-                SetType *set = getAs<SetType>(key);
-                if (!set)
-                    return 0;
+                ReadLock guard = readLock(shards[i]);
+                total += shards[i].store.size();
+            }
+            return total;
+        }
 
-                int result = set->srem(value);
-                if (set->isEmpty())
+        unsigned long long CacheManager::scan(unsigned long long cursor, size_t count, std::optional<ValueType> type,
+                                              std::vector<std::string> &out) const
+        {
+            size_t shard_index = cursor % shard_count;
+            size_t group_cursor = cursor / shard_count;
+            size_t budget = count < SIZE_MAX / 10 ? count * 10 : SIZE_MAX;
+            size_t first = out.size();
+            long long now = currentTimeMs();
+
+            while (shard_index < shard_count)
+            {
+                Shard &shard = shards[shard_index];
+                ReadLock guard = readLock(shard);
+                do
                 {
-                    store.erase(key);
+                    group_cursor = shard.store.scanGroup(group_cursor, [&](const EntryPtr &entry)
+                                                         {
+                        // Expired keys are left for the next lookup to erase,
+                        // as this only holds the read lock.
+                        if (type && entry->type() != *type)
+                            return;
+                        if (entry->hasExpiry() &&
+                            shard.expires.find(entry->key(), Keyspace::hashKey(entry->key()))->when <= now)
+                            return;
+                        out.emplace_back(entry->key()); });
+                } while (group_cursor != 0 && --budget > 0 && out.size() - first < count);
+
+                if (group_cursor != 0)
+                    return group_cursor * shard_count + shard_index;
+                ++shard_index;
+                if (out.size() - first >= count)
+                    break;
+            }
+            return shard_index < shard_count ? shard_index : 0;
+        }
+
+        bool CacheManager::pexpireat(std::string_view key, long long when)
+        {
+            size_t hash = Keyspace::hashKey(key);
+            Shard &shard = shardFor(hash);
+            WriteLock guard = writeLock(shard);
+            EntryPtr *slot = findLive(shard, key, hash);
+            if (!slot)
+                return false;
+
+            if (when <= currentTimeMs())
+                eraseKey(shard, key, hash);
+            else
+                setDeadline(shard, slot->get(), hash, when);
+            return true;
+        }
+
+        long long CacheManager::pttl(std::string_view key)
+        {
+            size_t hash = Keyspace::hashKey(key);
+            Shard &shard = shardFor(hash);
+            ReadLock guard = readLock(shard);
+            EntryPtr *slot = findLive(shard, key, hash, false);
+            if (!slot)
+                return -2;
+            if (!(*slot)->hasExpiry())
+                return -1;
+            return std::max(0LL, shard.expires.find(key, hash)->when - currentTimeMs());
+        }
+
+        bool CacheManager::persist(std::string_view key)
+        {
+            size_t hash = Keyspace::hashKey(key);
+            Shard &shard = shardFor(hash);
+            WriteLock guard = writeLock(shard);
+            EntryPtr *slot = findLive(shard, key, hash);
+            if (!slot || !(*slot)->hasExpiry())
+                return false;
+
+            shard.expires.erase(key, hash);
+            (*slot)->setHasExpiry(false);
+            accountTables(shard);
+            return true;
+        }
+
+        bool CacheManager::activeExpireCycle(std::chrono::microseconds budget)
+        {
+            using Clock = std::chrono::steady_clock;
+            // Deadline slots examined between clock reads.
+            constexpr size_t SCAN_BATCH = 128;
+
+            auto start = Clock::now();
+            auto deadline = start + budget;
+            size_t checked = 0, expired = 0;
+            bool out_of_time = false;
+            std::vector<std::string_view> due;
+
+            for (size_t visited = 0; visited < shard_count && !out_of_time; ++visited)
+            {
+                Shard &shard = shards[expire_shard];
+                WriteLock guard = writeLock(shard);
+                long long now = currentTimeMs();
+                do
+                {
+                    // Collect first, erase after: the scan must not see the
+                    // table change under it. The views stay valid because
+                    // each entry lives until its own erase.
+                    due.clear();
+                    shard.expire_cursor = shard.expires.scan(shard.expire_cursor, SCAN_BATCH,
+                                                             [&](const ExpiryRecord &record)
+                                                             {
+                                                                 ++checked;
+                                                                 if (record.when <= now)
+                                                                     due.push_back(record.entry->key());
+                                                             });
+                    for (std::string_view key : due)
+                    {
+                        eraseKey(shard, key, Keyspace::hashKey(key));
+                    }
+                    expired += due.size();
+                    out_of_time = Clock::now() >= deadline;
+                } while (shard.expire_cursor != 0 && !out_of_time);
+
+                // A shard left mid-sweep is where the next cycle resumes.
+                if (shard.expire_cursor == 0)
+                    expire_shard = (expire_shard + 1) & (shard_count - 1);
+            }
+
+            auto elapsed = std::chrono::duration_cast<std::chrono::microseconds>(Clock::now() - start);
+            expired_keys.fetch_add(expired, std::memory_order_relaxed);
+            expire_cycle_us.fetch_add(static_cast<uint64_t>(elapsed.count()), std::memory_order_relaxed);
+
+            // Only worth another slice soon if at least a tenth of what was
+            // checked had expired; otherwise the periodic tick is enough.
+            return out_of_time && expired * 10 >= checked;
+        }
+
+        CacheManager::ExpiryStats CacheManager::expiryStats() const
+        {
+            ExpiryStats stats{expired_keys.load(std::memory_order_relaxed),
+                              expire_cycle_us.load(std::memory_order_relaxed), 0};
+            for (size_t i = 0; i < shard_count; ++i)
+            {
+                ReadLock guard = readLock(shards[i]);
+                stats.keys_with_expiry += shards[i].expires.size();
+            }
+            return stats;
+        }
+
+        void CacheManager::setActiveDefrag(const DefragConfig &config)
+        {
+            defrag_config = config;
+            defrag_config.cpu_percent = std::clamp(config.cpu_percent, 1u, 100u);
+        }
+
+        size_t CacheManager::defragEntry(Shard &shard, EntryPtr &slot)
+        {
+            Entry *entry = slot.get();
+            if (entry->hasReaders())
+                return 0; // a streamed reply is walking the value where it is
+
+            size_t before = entry->memoryUsage();
+            size_t moved = entry->defragValue();
+
+            // The deadline record is keyed by the entry's own bytes, so it has
+            // to be found while the old address is still valid.
+            ExpiryRecord *record = entry->hasExpiry() ? shard.expires.find(entry->key()) : nullptr;
+            if (Entry *relocated = Entry::relocate(entry))
+            {
+                slot.relocated(relocated);
+                if (record)
+                    record->entry = relocated;
+                entry = relocated;
+                ++moved;
+            }
+
+            size_t after = entry->memoryUsage();
+            if (after != before)
+                account(shard, entry->type(), before, after);
+            return moved;
+        }
+
+        void CacheManager::activeDefragCycle(std::chrono::milliseconds interval)
+        {
+            using Clock = std::chrono::steady_clock;
+            // Keyspace slots examined between clock reads.
+            constexpr size_t SCAN_BATCH = 64;
+
+            if (!defrag_config.enabled || !SlabAllocator::enabled())
+                return;
+
+            auto heap = SlabAllocator::threadStats();
+            double ratio = heap.allocated ? double(heap.active) / heap.allocated : 1.0;
+            if (!defrag_running)
+            {
+                size_t waste = heap.active - heap.allocated;
+                if (ratio * 100 < 100 + defrag_config.threshold_percent || waste < defrag_config.ignore_bytes)
+                    return;
+                defrag_running = true;
+                defrag_shard = 0;
+                defrag_active.store(true, std::memory_order_relaxed);
+                defrag_ratio_start.store(ratio, std::memory_order_relaxed);
+            }
+
+            auto start = Clock::now();
+            auto deadline = start + interval * defrag_config.cpu_percent / 100;
+            SlabAllocator::sortPages();
+            size_t hits = 0, key_hits = 0, key_misses = 0;
+            bool out_of_time = false;
+
+            while (defrag_running && !out_of_time)
+            {
+                Shard &shard = shards[defrag_shard];
+                WriteLock guard = writeLock(shard);
+                do
+                {
+                    shard.defrag_cursor = shard.store.scan(shard.defrag_cursor, SCAN_BATCH,
+                                                           [&](EntryPtr &slot)
+                                                           {
+                                                               size_t moved = defragEntry(shard, slot);
+                                                               hits += moved;
+                                                               ++(moved ? key_hits : key_misses);
+                                                           });
+                    out_of_time = Clock::now() >= deadline;
+                } while (shard.defrag_cursor != 0 && !out_of_time);
+
+                if (shard.defrag_cursor == 0 && ++defrag_shard == shard_count)
+                {
+                    heap = SlabAllocator::threadStats();
+                    defrag_running = false;
+                    defrag_active.store(false, std::memory_order_relaxed);
+                    defrag_ratio_end.store(heap.allocated ? double(heap.active) / heap.allocated : 1.0,
+                                           std::memory_order_relaxed);
+                    defrag_passes.fetch_add(1, std::memory_order_relaxed);
                 }
-                return result;
             }
 
-            int scard(const std::string &key)
+            auto elapsed = std::chrono::duration_cast<std::chrono::microseconds>(Clock::now() - start);
+            defrag_hits.fetch_add(hits, std::memory_order_relaxed);
+            defrag_key_hits.fetch_add(key_hits, std::memory_order_relaxed);
+            defrag_key_misses.fetch_add(key_misses, std::memory_order_relaxed);
+            defrag_time_us.fetch_add(static_cast<uint64_t>(elapsed.count()), std::memory_order_relaxed);
+        }
+
+        CacheManager::DefragStats CacheManager::defragStats() const
+        {
+            return DefragStats{defrag_active.load(std::memory_order_relaxed),
+                               defrag_hits.load(std::memory_order_relaxed),
+                               defrag_key_hits.load(std::memory_order_relaxed),
+                               defrag_key_misses.load(std::memory_order_relaxed),
+                               defrag_time_us.load(std::memory_order_relaxed),
+                               defrag_passes.load(std::memory_order_relaxed),
+                               defrag_ratio_start.load(std::memory_order_relaxed),
+                               defrag_ratio_end.load(std::memory_order_relaxed)};
+        }
+
+        bool CacheManager::rehashStep()
+        {
+            // 16 groups (256 slots) per shard keeps each call well under a
+            // millisecond even on a large shard.
+            bool pending = false;
+            for (size_t i = 0; i < shard_count; ++i)
             {
-                SetType *set = getAs<SetType>(key);
-                return set ? set->scard() : 0;
+                Shard &shard = shards[i];
+                WriteLock guard = writeLock(shard);
+                if (shard.store.rehashStep(16))
+                    pending = true;
+                if (shard.expires.rehashStep(16))
+                    pending = true;
+                accountTables(shard);
             }
+            return pending;
+        }
+
+        void CacheManager::setMaxMemory(size_t bytes, EvictionPolicy policy, size_t samples)
+        {
+            max_memory = bytes;
+            eviction_policy = policy;
+            eviction_samples = std::max<size_t>(samples, 1);
+
+            sketch.reset();
+            if (policy == EvictionPolicy::ALLKEYS_TINYLFU && bytes > 0)
+                sketch = std::make_unique<FrequencySketch>(
+                    std::clamp<size_t>(bytes / SKETCH_BYTES_PER_KEY, MIN_ADMISSION_WINDOW, MAX_SKETCH_KEYS));
+        }
 
-            std::vector<std::string> smembers(const std::string &key)
+        void CacheManager::setLfuTuning(unsigned log_factor, unsigned decay_time)
+        {
+            lfu_log_factor = log_factor;
+            lfu_decay_time = decay_time;
+        }
+
+        size_t CacheManager::usedMemory() const
+        {
+            size_t total = 0;
+            for (size_t i = 0; i < shard_count; ++i)
             {
-                SetType *set = getAs<SetType>(key);
-                if (!set)
-                    return {};
-                return set->smembers();
+                total += shards[i].used_memory.load(std::memory_order_relaxed) +
+                         shards[i].table_bytes.load(std::memory_order_relaxed);
             }
+            return total;
+        }
 
-            bool exists(const std::string &key) const
+        void CacheManager::updateLruClock(long long now_ms)
+        {
+            lru_clock.store(static_cast<uint32_t>(now_ms / 1000) & Entry::LRU_CLOCK_MAX, std::memory_order_relaxed);
+            lfu_clock.store(static_cast<uint32_t>(now_ms / 60000) & 0xFFFF, std::memory_order_relaxed);
+        }
+
+        uint64_t CacheManager::nextRandom()
+        {
+            // xorshift64*
+            eviction_random ^= eviction_random >> 12;
+            eviction_random ^= eviction_random << 25;
+            eviction_random ^= eviction_random >> 27;
+            return eviction_random * 0x2545F4914F6CDD1DULL;
+        }
+
+        void CacheManager::populateEvictionPool(Shard &shard)
+        {
+            uint32_t now = lru_clock.load(std::memory_order_relaxed);
+            bool lfu = lfuPolicy();
+            auto consider = [&](const Entry &entry)
             {
-                return store.find(key) != store.end();
+                uint32_t score = lfu ? 255 - lfuCounter(entry) : (now - entry.lruClock()) & Entry::LRU_CLOCK_MAX;
+                if (eviction_pool.size() == EVICTION_POOL_SIZE && score <= eviction_pool.front().score)
+                    return;
+
+                std::string_view key = entry.key();
+                for (const auto &candidate : eviction_pool)
+                {
+                    if (candidate.key == key)
+                        return;
+                }
+                auto at = std::upper_bound(eviction_pool.begin(), eviction_pool.end(), score,
+                                           [](uint32_t score, const EvictionCandidate &candidate)
+                                           { return score < candidate.score; });
+                eviction_pool.insert(at, EvictionCandidate{score, std::string(key), Keyspace::hashKey(key)});
+                if (eviction_pool.size() > EVICTION_POOL_SIZE)
+                    eviction_pool.erase(eviction_pool.begin());
+            };
+
+            ReadLock guard = readLock(shard);
+            if (eviction_policy == EvictionPolicy::VOLATILE_LRU || eviction_policy == EvictionPolicy::VOLATILE_LFU)
+                shard.expires.sample(nextRandom(), eviction_samples, [&](const ExpiryRecord &record)
+                                     { consider(*record.entry); });
+            else
+                shard.store.sample(nextRandom(), eviction_samples, [&](const EntryPtr &entry)
+                                   { consider(*entry); });
+        }
+
+        bool CacheManager::evictKey(std::string_view key, size_t hash)
+        {
+            // Candidates are copies taken under another lock: the key may
+            // have gone (or, for a volatile policy, lost its TTL) since.
+            bool volatile_only = eviction_policy == EvictionPolicy::VOLATILE_LRU ||
+                                 eviction_policy == EvictionPolicy::VOLATILE_LFU;
+            Shard &owner = shardFor(hash);
+            WriteLock guard = writeLock(owner);
+            EntryPtr *slot = owner.store.find(key, hash);
+            if (!slot || (volatile_only && !(*slot)->hasExpiry()))
+                return false;
+            eraseKey(owner, key, hash);
+            evicted_keys.fetch_add(1, std::memory_order_relaxed);
+            return true;
+        }
+
+        void CacheManager::enterAdmissionWindow(std::string_view key, size_t hash)
+        {
+            std::unique_lock<std::mutex> guard = thread_safe ? std::unique_lock<std::mutex>(window_lock)
+                                                             : std::unique_lock<std::mutex>();
+            admission_window.push_back(WindowKey{std::string(key), hash});
+            // Below the limit nothing competes: the oldest keys simply move
+            // on to the main region.
+            while (admission_window.size() > window_capacity)
+                admission_window.pop_front();
+        }
+
+        bool CacheManager::evictAdmissionCandidate(Shard &shard)
+        {
+            for (;;)
+            {
+                WindowKey candidate;
+                {
+                    std::unique_lock<std::mutex> guard = thread_safe ? std::unique_lock<std::mutex>(window_lock)
+                                                                     : std::unique_lock<std::mutex>();
+                    if (admission_window.empty())
+                        return false;
+                    candidate = std::move(admission_window.front());
+                    admission_window.pop_front();
+                }
+
+                populateEvictionPool(shard);
+                bool settled = false;
+                while (!settled && !eviction_pool.empty())
+                {
+                    EvictionCandidate &victim = eviction_pool.back();
+                    if (victim.key == candidate.key)
+                    {
+                        eviction_pool.pop_back();
+                        continue;
+                    }
+
+                    // Ties go to the incumbent: a key seen as often as the
+                    // victim has not shown it is worth the room.
+                    if (sketch->frequency(candidate.hash) <= sketch->frequency(victim.hash))
+                        break;
+
+                    EvictionCandidate evicted = std::move(victim);
+                    eviction_pool.pop_back();
+                    settled = evictKey(evicted.key, evicted.hash);
+                }
+
+                // The candidate lost, or there was no victim left to weigh it
+                // against; if it was deleted meanwhile, the next one is tried.
+                if (settled || evictKey(candidate.key, candidate.hash))
+                    return true;
             }
+        }
 
-            bool del(const std::string &key)
+        bool CacheManager::evictOne()
+        {
+            for (size_t tries = 0; tries < shard_count; ++tries)
             {
-                return store.erase(key) > 0;
+                Shard &shard = shards[evict_shard];
+                evict_shard = (evict_shard + 1) & (shard_count - 1);
+
+                if (eviction_policy == EvictionPolicy::ALLKEYS_RANDOM)
+                {
+                    WriteLock guard = writeLock(shard);
+                    const Entry *victim = nullptr;
+                    shard.store.sample(nextRandom(), 1, [&](const EntryPtr &entry)
+                                       { victim = entry.get(); });
+                    if (!victim)
+                        continue;
+                    std::string_view key = victim->key();
+                    eraseKey(shard, key, Keyspace::hashKey(key));
+                    evicted_keys.fetch_add(1, std::memory_order_relaxed);
+                    return true;
+                }
+
+                if (sketch && evictAdmissionCandidate(shard))
+                    return true;
+
+                populateEvictionPool(shard);
+                while (!eviction_pool.empty())
+                {
+                    EvictionCandidate best = std::move(eviction_pool.back());
+                    eviction_pool.pop_back();
+                    if (evictKey(best.key, best.hash))
+                        return true;
+                }
             }
+            return false;
+        }
 
-            std::optional<std::string> type(const std::string &key) const
+        bool CacheManager::evictIfNeeded()
+        {
+            size_t used = usedMemory();
+            size_t peak = peak_memory.load(std::memory_order_relaxed);
+            while (used > peak)
             {
-                auto it = store.find(key);
-                if (it == store.end())
-                    return std::nullopt;
-                return it->second->getType();
+                if (peak_memory.compare_exchange_weak(peak, used, std::memory_order_relaxed))
+                    break;
             }
+            if (max_memory == 0 || used <= max_memory)
+                return true;
+            if (eviction_policy == EvictionPolicy::NO_EVICTION)
+                return false;
 
-            void clear()
+            std::unique_lock<std::mutex> guard = thread_safe ? std::unique_lock<std::mutex>(eviction_lock)
+                                                             : std::unique_lock<std::mutex>();
+            if (sketch && window_refresh-- == 0)
             {
-                store.clear();
+                size_t share = dbsize() / 100;
+                std::unique_lock<std::mutex> window_guard = thread_safe ? std::unique_lock<std::mutex>(window_lock)
+                                                                        : std::unique_lock<std::mutex>();
+                window_capacity = std::max(share, MIN_ADMISSION_WINDOW);
+                window_refresh = WINDOW_REFRESH_INTERVAL;
             }
+            while (usedMemory() > max_memory)
+            {
+                if (!evictOne())
+                    return false;
+            }
+            return true;
+        }
 
-            size_t dbsize() const
+        CacheManager::MemoryStats CacheManager::memoryStats() const
+        {
+            MemoryStats stats{};
+            stats.used_memory = usedMemory();
+            stats.peak_memory = std::max(stats.used_memory, peak_memory.load(std::memory_order_relaxed));
+            for (size_t i = 0; i < shard_count; ++i)
             {
-                return store.size();
+                stats.table_bytes += shards[i].table_bytes.load(std::memory_order_relaxed);
+                for (size_t type = 0; type < VALUE_TYPE_COUNT; ++type)
+                    stats.type_memory[type] += shards[i].type_memory[type].load(std::memory_order_relaxed);
             }
-        };
+            stats.max_memory = max_memory;
+            stats.policy = eviction_policy;
+            stats.evicted_keys = evicted_keys.load(std::memory_order_relaxed);
+            stats.lazyfree_pending = lazy_free.pendingObjects();
+            stats.lazyfreed = lazy_free.freedObjects();
+            return stats;
+        }
 
     }
 }
@@ -2,11 +2,29 @@
 #ifndef OPUS_STORAGE_MANAGER_HPP
 #define OPUS_STORAGE_MANAGER_HPP
 
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <deque>
 #include <memory>
+#include <mutex>
+#include <optional>
+#include <shared_mutex>
+#include <stdexcept>
 #include <string>
+#include <string_view>
 #include <system_error>
+#include <unordered_map>
+#include <utility>
 #include <vector>
 
+#include "dict.hpp"
+#include "entry.hpp"
+#include "frequency_sketch.hpp"
+#include "lazy_free.hpp"
+
 namespace opus
 {
     namespace storage
@@ -18,13 +36,13 @@ namespace opus
             virtual ~IStorage() = default;
 
             // Save data for a key. On failure ec is set and the function returns false.
-            virtual bool save(const std::string &key, const std::string &data, std::error_code &ec) = 0;
+            virtual bool save(std::string_view key, const std::string &data, std::error_code &ec) = 0;
 
             // Load data for a key. Returns false and sets ec on failure.
-            virtual bool load(const std::string &key, std::string &out, std::error_code &ec) = 0;
+            virtual bool load(std::string_view key, std::string &out, std::error_code &ec) = 0;
 
             // Remove a key. Returns true if removed or false + ec on error.
-            virtual bool remove(const std::string &key, std::error_code &ec) = 0;
+            virtual bool remove(std::string_view key, std::error_code &ec) = 0;
 
             // List keys under an optional prefix. Returns empty vector + ec on error.
             virtual std::vector<std::string> list(const std::string &prefix, std::error_code &ec) = 0;
@@ -35,6 +53,852 @@ namespace opus
         // relative paths (sanitized) so "user/123" => $basePath/user/123
         std::unique_ptr<IStorage> make_filesystem_storage(const std::string &basePath);
 
+        /**
+         * @brief Which keys make room once maxmemory is reached (the
+         *        maxmemory-policy option)
+         */
+        enum class EvictionPolicy : uint8_t
+        {
+            NO_EVICTION,    // refuse writes that need memory instead
+            ALLKEYS_LRU,    // least recently used key
+            VOLATILE_LRU,   // least recently used key among those with a TTL
+            ALLKEYS_LFU,    // least frequently used key
+            VOLATILE_LFU,   // least frequently used key among those with a TTL
+            ALLKEYS_RANDOM, // any key
+            ALLKEYS_TINYLFU // LRU, but new keys must be seen more often than the victim to stay
+        };
+
+        std::string_view evictionPolicyName(EvictionPolicy policy);
+
+        /**
+         * @brief Parses a policy name as written in the config
+         *        ("allkeys-lru", ...), case-insensitively
+         */
+        std::optional<EvictionPolicy> parseEvictionPolicy(std::string_view name);
+
+        /**
+         * @brief Active defragmentation settings (the activedefrag options)
+         */
+        struct DefragConfig
+        {
+            bool enabled = false;
+            unsigned threshold_percent = 10;    // start once active pages exceed live blocks by this much
+            size_t ignore_bytes = 100ULL << 20; // ...and by at least this many bytes
+            unsigned cpu_percent = 10;          // share of each cycle's interval spent moving
+        };
+
+        /**
+         * @brief Something that goes on reading a value after the call that
+         *        found it has returned, such as a reply streamed over several
+         *        event loop iterations
+         *
+         * While a reader is attached (CacheManager::attachReader), its value
+         * is never moved by defragmentation, and whatever is about to modify,
+         * replace or free it first detaches the reader and calls
+         * valueChanging(), which must be done with the value when it returns.
+         */
+        class ValueReader
+        {
+        private:
+            friend class CacheManager;
+            const Entry *attached = nullptr;
+
+        public:
+            virtual ~ValueReader() = default;
+
+            virtual void valueChanging() = 0;
+        };
+
+        /**
+         * @brief In-memory keyspace holding typed values (strings, lists, sets, hashes)
+         *
+         * The keyspace is split into a power-of-two number of shards chosen by
+         * key hash. Each shard owns an open-addressing Dict (rehashed
+         * incrementally, so growth never stalls a command) and a reader-writer
+         * lock, so
+         * commands on different shards never contend and read-only commands on
+         * the same shard run concurrently. Every public method is thread-safe
+         * unless the manager was built for single-threaded use, in which case
+         * no locks are taken at all.
+         *
+         * Operations against a key holding a different type throw
+         * std::runtime_error with a "WRONGTYPE" message.
+         *
+         * Keys may carry a deadline. An expired key reads as missing from the
+         * moment it expires; it is removed when next touched (lazily) or by
+         * activeExpireCycle(), which sweeps the keys that have a deadline a
+         * time-bounded slice at a time.
+         *
+         * Memory is accounted per entry: every write adds the change in its
+         * entry's memoryUsage() to its shard's count, so usedMemory() is a
+         * sum over shards rather than a walk. Above maxmemory, evictIfNeeded()
+         * makes room Redis's way: it samples a few keys, keeps the best
+         * candidates in a small pool, and evicts the one idle the longest by
+         * its 24-bit access clock. A write costs O(samples), never O(keys).
+         *
+         * The LFU policies reuse those 24 bits as Redis does: a minute stamp
+         * and an 8-bit logarithmic counter that climbs ever more slowly with
+         * accesses and drops by one per idle decay period, so one scan cannot
+         * outweigh steady popularity. ALLKEYS_TINYLFU instead keeps LRU order
+         * but puts new keys through a small admission window: at the limit,
+         * the oldest key there is only kept if a shared FrequencySketch has
+         * seen it more often than the main region's LRU victim.
+         */
+        class CacheManager
+        {
+        private:
+            struct EntryTraits
+            {
+                static std::string_view key(const EntryPtr &entry) { return entry->key(); }
+            };
+
+            // Slots are one pointer wide; key and value live in the Entry.
+            using Keyspace = Dict<EntryPtr, EntryTraits>;
+
+            struct ExpiryRecord
+            {
+                Entry *entry;   // owned by the keyspace slot
+                long long when; // deadline, Unix time in milliseconds
+            };
+
+            struct ExpiryTraits
+            {
+                static std::string_view key(const ExpiryRecord &record) { return record.entry->key(); }
+            };
+
+            // Deadlines of the keys that have one, keyed by the entry's own
+            // key bytes; the entry's FLAG_EXPIRING says whether to look here.
+            using Expires = Dict<ExpiryRecord, ExpiryTraits>;
+
+            // Cache-line aligned so neighbouring shards' locks do not share a line.
+            struct alignas(64) Shard
+            {
+                mutable std::shared_mutex lock;
+                Keyspace store;
+                Expires expires;
+                size_t expire_cursor = 0; // where the active sweep resumes
+                size_t defrag_cursor = 0; // where the defragmenter resumes
+
+                // memoryUsage() of the entries in `store`, in total and by
+                // value type, and the bytes of both tables' arrays; written
+                // under the write lock, read by usedMemory() without it.
+                std::atomic<size_t> used_memory{0};
+                std::atomic<size_t> type_memory[VALUE_TYPE_COUNT]{};
+                std::atomic<size_t> table_bytes{0};
+            };
+
+            struct EvictionCandidate
+            {
+                uint32_t score; // idle clock ticks, or 255 - LFU counter
+                std::string key;
+                size_t hash;
+            };
+
+            struct WindowKey
+            {
+                std::string key;
+                size_t hash;
+            };
+
+            std::unique_ptr<Shard[]> shards;
+            size_t shard_count;
+            unsigned shard_bits;
+            bool thread_safe;
+
+            size_t expire_shard = 0; // shard the next expiry cycle starts on
+            mutable std::atomic<uint64_t> expired_keys{0};
+            std::atomic<uint64_t> expire_cycle_us{0};
+
+            // Active defragmentation: settings, the pass in progress (run
+            // from one thread's cron only) and its counters.
+            DefragConfig defrag_config;
+            bool defrag_running = false;
+            size_t defrag_shard = 0;
+            std::atomic<bool> defrag_active{false};
+            std::atomic<uint64_t> defrag_hits{0};
+            std::atomic<uint64_t> defrag_key_hits{0};
+            std::atomic<uint64_t> defrag_key_misses{0};
+            std::atomic<uint64_t> defrag_time_us{0};
+            std::atomic<uint64_t> defrag_passes{0};
+            std::atomic<double> defrag_ratio_start{0};
+            std::atomic<double> defrag_ratio_end{0};
+
+            size_t max_memory = 0; // 0 for no limit
+            EvictionPolicy eviction_policy = EvictionPolicy::NO_EVICTION;
+            size_t eviction_samples = DEFAULT_EVICTION_SAMPLES;
+            std::atomic<uint32_t> lru_clock{0};
+            std::atomic<uint32_t> lfu_clock{0}; // Unix minutes modulo 2^16
+            unsigned lfu_log_factor = DEFAULT_LFU_LOG_FACTOR;
+            unsigned lfu_decay_time = DEFAULT_LFU_DECAY_TIME;
+            std::atomic<uint64_t> evicted_keys{0};
+            std::atomic<size_t> peak_memory{0};
+
+            // ALLKEYS_TINYLFU only: access counts of recent keys, and the
+            // newest keys still in the admission window, oldest first.
+            std::unique_ptr<FrequencySketch> sketch;
+            std::mutex window_lock;
+            std::deque<WindowKey> admission_window;
+            size_t window_capacity = MIN_ADMISSION_WINDOW;
+            size_t window_refresh = 0; // evictions until window_capacity is recomputed
+
+            // Guards the pool, the sampling position and the RNG when the
+            // manager is thread-safe.
+            std::mutex eviction_lock;
+            std::vector<EvictionCandidate> eviction_pool; // ascending idle time
+            size_t evict_shard = 0;
+            uint64_t eviction_random = 0x9E3779B97F4A7C15ULL;
+
+            // Frees large values and flushed keyspaces off the calling thread;
+            // deletes, overwrites, evictions and expiries all go through it.
+            mutable LazyFree lazy_free;
+
+            bool lfuPolicy() const
+            {
+                return eviction_policy == EvictionPolicy::ALLKEYS_LFU ||
+                       eviction_policy == EvictionPolicy::VOLATILE_LFU;
+            }
+
+            Shard &shardFor(size_t hash) const;
+            std::shared_lock<std::shared_mutex> readLock(Shard &shard) const;
+            std::unique_lock<std::shared_mutex> writeLock(Shard &shard) const;
+
+            // The key's slot, or nullptr if it is missing or past its deadline.
+            // Single-threaded managers remove an expired key on the spot;
+            // otherwise the caller may hold only a read lock, so removal is
+            // left to writes and the active cycle. Records the access unless
+            // `touch` is false.
+            EntryPtr *findLive(Shard &shard, std::string_view key, size_t hash, bool touch = true) const;
+
+            // Records an access for the eviction policy: stamps the access
+            // clock, or bumps the LFU counter, and feeds the sketch if any.
+            void touch(Entry &entry, size_t hash) const;
+
+            // The entry's LFU counter after decay for the time it sat idle.
+            uint32_t lfuCounter(const Entry &entry) const;
+
+            // Removes a key and its deadline; caller holds the write lock.
+            // The value is freed through lazy_free unless `lazy` is false.
+            bool eraseKey(Shard &shard, std::string_view key, size_t hash, bool lazy = true) const;
+
+            // Readers attached to values, by entry; only single-threaded
+            // managers have any. Entries with FLAG_READERS set are in here.
+            mutable std::unordered_multimap<const Entry *, ValueReader *> readers;
+
+            // Detaches the entry's readers, if any, and tells them its value
+            // is about to change; called before every modification.
+            void releaseReaders(const Entry &entry) const;
+
+            // Moves the shard's memory count for a `type` value from `before`
+            // to `after` bytes, and refreshes its table sizes.
+            static void account(Shard &shard, ValueType type, size_t before, size_t after);
+
+            // Refreshes the shard's table sizes alone, after a change that
+            // may only have grown or swapped a table.
+            static void accountTables(Shard &shard);
+
+            // Runs `mutate`, which changes `entry`'s value in place, and
+            // accounts for the change in the entry's size.
+            template <typename F>
+            decltype(auto) update(Shard &shard, Entry *entry, F &&mutate);
+
+            // Moves the slot's entry and its value out of sparse allocator
+            // pages, repointing its deadline record; caller holds the write
+            // lock. Returns blocks moved.
+            size_t defragEntry(Shard &shard, EntryPtr &slot);
+
+            uint64_t nextRandom();
+
+            // Adds a sample of `shard`'s keys (or its keys with a TTL) to the
+            // eviction pool; caller holds eviction_lock.
+            void populateEvictionPool(Shard &shard);
+
+            // Evicts one key under the current policy; false if none could
+            // be found. Caller holds eviction_lock and no shard lock.
+            bool evictOne();
+
+            // Deletes a key picked for eviction if it is still there (and,
+            // under a volatile policy, still has a TTL); takes its shard lock.
+            bool evictKey(std::string_view key, size_t hash);
+
+            // ALLKEYS_TINYLFU: settles the oldest admission window key against
+            // the LRU victim of `shard`; false if the window is empty.
+            bool evictAdmissionCandidate(Shard &shard);
+
+            // Records a key just inserted under ALLKEYS_TINYLFU, letting the
+            // oldest ones graduate once the window is full.
+            void enterAdmissionWindow(std::string_view key, size_t hash);
+
+            // Stores `created` under its key, replacing any entry there (live
+            // or expired). The old deadline is dropped unless `keep_ttl` is set
+            // and the old entry was live.
+            Entry *storeEntry(Shard &shard, size_t hash, EntryPtr created, bool keep_ttl = false);
+
+            void setDeadline(Shard &shard, Entry *entry, size_t hash, long long when);
+
+            Entry *lookup(Shard &shard, std::string_view key, size_t hash, ValueType expected) const;
+
+            template <typename T>
+            T *getAs(Shard &shard, std::string_view key, size_t hash) const;
+
+            // The entry holding the T at `key`, created empty if missing.
+            template <typename T>
+            Entry *getOrCreate(Shard &shard, std::string_view key, size_t hash);
+
+            // Locks the shards holding `keys` (and `extra`) in index order, as
+            // clear() does, so multi-key commands cannot deadlock.
+            template <typename Lock>
+            std::vector<Lock> lockKeys(const std::vector<std::string_view> &keys, const std::string_view *extra = nullptr) const;
+
+            // lockKeys() for keys already hashed.
+            template <typename Lock>
+            std::vector<Lock> lockHashes(const std::vector<size_t> &hashes) const;
+
+            // How many keys ahead of the one being looked up batch operations
+            // prefetch: enough to cover a cache miss, few enough that the
+            // lines are still cached when their turn comes.
+            static constexpr size_t PREFETCH_DISTANCE = 8;
+
+            // Prefetches the bucket of the key PREFETCH_DISTANCE after `i`,
+            // and at i == 0 those of the keys up to it as well.
+            void prefetchAhead(const std::vector<size_t> &hashes, size_t i) const;
+
+            // Stores every pair as SET does; caller holds the locks.
+            void storePairs(const std::vector<std::pair<std::string_view, std::string_view>> &pairs,
+                            const std::vector<size_t> &hashes);
+
+            // The sets at `keys`, null for missing keys; caller holds the locks.
+            std::vector<const SetType *> setsFor(const std::vector<std::string_view> &keys) const;
+
+            // Replaces `dest` with a set of `members`; caller holds the lock.
+            size_t storeSet(std::string_view dest, std::vector<std::string> members);
+
+        public:
+            static constexpr size_t DEFAULT_SHARDS = 16;
+
+            // Keys sampled per eviction (maxmemory-samples), as in Redis.
+            static constexpr size_t DEFAULT_EVICTION_SAMPLES = 5;
+
+            // Best candidates kept between evictions.
+            static constexpr size_t EVICTION_POOL_SIZE = 16;
+
+            // lfu-log-factor: about a million accesses saturate the counter.
+            static constexpr unsigned DEFAULT_LFU_LOG_FACTOR = 10;
+
+            // lfu-decay-time: idle minutes per step down of the counter.
+            static constexpr unsigned DEFAULT_LFU_DECAY_TIME = 1;
+
+            // Counter of a new key, so it is not the next one evicted.
+            static constexpr uint32_t LFU_INIT_VAL = 5;
+
+            // The W-TinyLFU window holds 1% of the keys, but never fewer.
+            static constexpr size_t MIN_ADMISSION_WINDOW = 16;
+
+            /**
+             * @param shards Number of shards; rounded up to a power of two
+             * @param thread_safe Whether shard locks are taken; pass false when
+             *        the manager is only ever touched by one thread
+             */
+            explicit CacheManager(size_t shards = DEFAULT_SHARDS, bool thread_safe = true);
+
+            CacheManager(const CacheManager &) = delete;
+            CacheManager &operator=(const CacheManager &) = delete;
+
+            size_t shardCount() const { return shard_count; }
+            bool threadSafe() const { return thread_safe; }
+
+            /**
+             * @brief SET; `expire_at` is a deadline in Unix milliseconds, or 0
+             *        for none, and `keep_ttl` keeps the key's current one
+             */
+            void set(std::string_view key, std::string_view value, long long expire_at = 0, bool keep_ttl = false);
+            std::optional<std::string> get(std::string_view key);
+
+            /**
+             * @brief GET without copying: calls f(const BorrowedString &) with
+             *        the value while its shard is still locked
+             *
+             * `f` must not call back into the manager; it can pin() the value
+             * to hold on to it after returning.
+             * @return false, without calling f, if the key is missing
+             */
+            template <typename F>
+            bool readString(std::string_view key, F &&f);
+
+            /**
+             * @brief Calls f(const T &) with the value at `key` while its shard
+             *        is still locked; `f` must not call back into the manager
+             * @return false, without calling f, if the key is missing
+             */
+            template <typename T, typename F>
+            bool readValue(std::string_view key, F &&f);
+
+            /**
+             * @brief The T at `key`, with `reader` attached to it until
+             *        detachReader() (see ValueReader), or nullptr if the key is
+             *        missing
+             *
+             * Only for single-threaded managers: nothing else could stop
+             * another thread changing the value the moment this returns.
+             */
+            template <typename T>
+            const T *attachReader(std::string_view key, ValueReader &reader);
+
+            /**
+             * @brief Detaches `reader` if it still is attached
+             */
+            void detachReader(ValueReader &reader);
+
+            using KeyValue = std::pair<std::string_view, std::string_view>;
+
+            /**
+             * @brief MSET: stores each pair as a plain SET would, a later pair
+             *        winning over an earlier one with the same key
+             *
+             * All keys are hashed and their shards locked up front, and each
+             * key's bucket is prefetched a few keys before its turn, so a big
+             * batch overlaps its cache misses instead of paying them in turn.
+             */
+            void mset(const std::vector<KeyValue> &pairs);
+
+            /**
+             * @brief MSETNX: mset() only if none of the keys exists
+             * @return whether the pairs were stored
+             */
+            bool msetnx(const std::vector<KeyValue> &pairs);
+
+            /**
+             * @brief MGET without copying: calls f(const BorrowedString *) for
+             *        each key in order, with nullptr for a key that is missing
+             *        or does not hold a string
+             *
+             * Looks the keys up as mset() stores them, with every shard
+             * involved read-locked throughout; `f` must not call back into
+             * the manager.
+             */
+            template <typename F>
+            void readStrings(const std::vector<std::string_view> &keys, F &&f);
+
+            /**
+             * @brief Adds `delta` to an integer string (missing keys count as 0)
+             *
+             * Integer-encoded values are updated in place. Throws
+             * std::runtime_error if the value is not an integer or the result
+             * would overflow.
+             */
+            long long incrby(std::string_view key, long long delta);
+
+            /**
+             * @brief Adds `delta` to a float string and returns the new value
+             *        as stored
+             */
+            std::string incrbyfloat(std::string_view key, long double delta);
+
+            int lpush(std::string_view key, std::string_view value);
+            int rpush(std::string_view key, std::string_view value);
+
+            /**
+             * @brief LPUSH/RPUSH with several values, pushed in order under a
+             *        single lookup and lock
+             */
+            int lpush(std::string_view key, const std::vector<std::string_view> &values);
+            int rpush(std::string_view key, const std::vector<std::string_view> &values);
+            std::optional<std::string> lpop(std::string_view key);
+            std::optional<std::string> rpop(std::string_view key);
+            int llen(std::string_view key);
+            std::vector<std::string> lrange(std::string_view key, long long start, long long stop);
+            std::optional<std::string> lindex(std::string_view key, long long index);
+
+            /**
+             * @brief Throws std::runtime_error for a missing key or an index
+             *        out of range
+             */
+            void lset(std::string_view key, long long index, std::string_view value);
+
+            /**
+             * @return the new length, -1 if the pivot is missing, 0 if the key is
+             */
+            int linsert(std::string_view key, bool before, std::string_view pivot, std::string_view value);
+            void ltrim(std::string_view key, long long start, long long stop);
+            int lrem(std::string_view key, long long count, std::string_view value);
+
+            int sadd(std::string_view key, std::string_view value);
+
+            /**
+             * @brief SADD with several members; the set is sized for all of them
+             *        up front, and the rvalue form moves the strings in
+             */
+            int sadd(std::string_view key, const std::vector<std::string_view> &values);
+            int sadd(std::string_view key, std::vector<std::string> &&values);
+            bool sismember(std::string_view key, std::string_view value);
+            int srem(std::string_view key, std::string_view value);
+            int scard(std::string_view key);
+            std::vector<std::string> smembers(std::string_view key);
+
+            /**
+             * @brief One SSCAN page; see SetType::sscan()
+             */
+            unsigned long long sscan(std::string_view key, unsigned long long cursor, size_t count,
+                                     std::vector<std::string> &out);
+
+            std::vector<std::string> sinter(const std::vector<std::string_view> &keys);
+            std::vector<std::string> sunion(const std::vector<std::string_view> &keys);
+            std::vector<std::string> sdiff(const std::vector<std::string_view> &keys);
+
+            /**
+             * @brief Size of the intersection, counting no further than
+             *        `limit` (0 for no limit)
+             */
+            size_t sintercard(const std::vector<std::string_view> &keys, size_t limit);
+
+            /**
+             * @brief Store the result in `dest`, replacing any value there (or
+             *        deleting it if the result is empty)
+             * @return the number of members stored
+             */
+            size_t sinterstore(std::string_view dest, const std::vector<std::string_view> &keys);
+            size_t sunionstore(std::string_view dest, const std::vector<std::string_view> &keys);
+            size_t sdiffstore(std::string_view dest, const std::vector<std::string_view> &keys);
+
+            /**
+             * @return the number of fields that were new
+             */
+            int hset(std::string_view key, const std::vector<HashType::FieldValue> &pairs);
+            std::optional<std::string> hget(std::string_view key, std::string_view field);
+            std::vector<std::optional<std::string>> hmget(std::string_view key, const std::vector<std::string_view> &fields);
+            int hdel(std::string_view key, const std::vector<std::string_view> &fields);
+            long long hincrby(std::string_view key, std::string_view field, long long delta);
+            int hlen(std::string_view key);
+            bool hexists(std::string_view key, std::string_view field);
+            std::vector<HashType::FieldValue> hgetall(std::string_view key);
+
+            /**
+             * @brief One HSCAN page; see HashType::hscan()
+             */
+            unsigned long long hscan(std::string_view key, unsigned long long cursor, size_t count,
+                                     std::vector<HashType::FieldValue> &out);
+
+            /**
+             * @brief ZADD of (score, member) pairs under SortedSetType::ADD_*
+             *
+             * Counts new members in `added` and members whose score changed
+             * in `updated`. With ADD_XX a missing key is not created.
+             * @return the last member's score, or nullopt if the options
+             *         skipped it (the ZADD INCR reply)
+             */
+            std::optional<double> zadd(std::string_view key, const std::vector<std::pair<double, std::string>> &pairs,
+                                       unsigned flags, int &added, int &updated);
+            int zrem(std::string_view key, const std::vector<std::string_view> &members);
+            std::optional<double> zscore(std::string_view key, std::string_view member);
+            std::optional<size_t> zrank(std::string_view key, std::string_view member, bool reverse);
+            int zcard(std::string_view key);
+            std::vector<SortedSetType::MemberScore> zrange(std::string_view key, long long start, long long stop,
+                                                           bool reverse);
+            std::vector<SortedSetType::MemberScore> zrangebyscore(std::string_view key, const ScoreRange &range,
+                                                                  bool reverse, size_t offset, long long count);
+            size_t zremrangebyscore(std::string_view key, const ScoreRange &range);
+            std::vector<SortedSetType::MemberScore> zpopmin(std::string_view key, size_t count);
+
+            /**
+             * @brief One ZSCAN page; see SortedSetType::zscan()
+             */
+            unsigned long long zscan(std::string_view key, unsigned long long cursor, size_t count,
+                                     std::vector<SortedSetType::MemberScore> &out);
+
+            bool exists(std::string_view key) const;
+
+            /**
+             * @brief Removes the key and frees its value before returning
+             *        (DEL)
+             */
+            bool del(std::string_view key);
+
+            /**
+             * @brief Removes the key in O(1), leaving a value that is costly
+             *        to free to the background thread (UNLINK)
+             */
+            bool unlink(std::string_view key);
+            std::optional<std::string_view> type(std::string_view key) const;
+            std::optional<std::string_view> encoding(std::string_view key) const;
+
+            /**
+             * @brief Seconds since the key was last accessed (OBJECT
+             *        IDLETIME), to the resolution of the access clock;
+             *        throws std::runtime_error under an LFU policy, which
+             *        does not track it
+             */
+            std::optional<uint32_t> idleTime(std::string_view key) const;
+
+            /**
+             * @brief The key's access frequency (OBJECT FREQ): the decayed
+             *        LFU counter, or the sketch estimate under
+             *        ALLKEYS_TINYLFU; throws std::runtime_error under other
+             *        policies, which do not track it
+             */
+            std::optional<uint32_t> frequency(std::string_view key) const;
+
+            /**
+             * @brief Bytes the key and its value take (MEMORY USAGE),
+             *        including its keyspace slot and deadline; O(1)
+             */
+            std::optional<size_t> memoryUsage(std::string_view key) const;
+            void clear();
+
+            /**
+             * @brief Empties the keyspace like clear(), but hands the old
+             *        tables and everything in them to the background thread
+             *        (FLUSHALL ASYNC); O(shards)
+             */
+            void clearAsync();
+            size_t dbsize() const;
+
+            /**
+             * @brief One SCAN page: appends the live keys of about `count`
+             *        keyspace groups from `cursor` on to `out`, only those
+             *        holding a `type` value if one is given
+             *
+             * The cursor walks the shards in turn, naming the shard in its
+             * remainder modulo the shard count and a Dict::scanGroup() cursor
+             * in its quotient, so every key present for a whole scan is
+             * returned at least once. A call visits at most ten times
+             * `count` groups, even if it finds fewer keys than that.
+             * @return the cursor for the next call, 0 when the scan is done
+             */
+            unsigned long long scan(unsigned long long cursor, size_t count, std::optional<ValueType> type,
+                                    std::vector<std::string> &out) const;
+
+            /**
+             * @brief Current Unix time in milliseconds, the clock deadlines
+             *        are measured on
+             */
+            static long long currentTimeMs();
+
+            /**
+             * @brief Sets the deadline of an existing key (Unix milliseconds);
+             *        a deadline already past deletes the key
+             * @return false if the key does not exist
+             */
+            bool pexpireat(std::string_view key, long long when);
+
+            /**
+             * @return milliseconds left, -1 if the key has no deadline, -2 if
+             *         it does not exist
+             */
+            long long pttl(std::string_view key);
+
+            /**
+             * @return true if the key had a deadline and no longer does
+             */
+            bool persist(std::string_view key);
+
+            /**
+             * @brief Removes expired keys until `budget` runs out
+             *
+             * Sweeps each shard's deadlines with a resumable cursor, so a
+             * million keys expiring in the same second are reclaimed over
+             * several slices instead of in one stall.
+             * @return true if it stopped for time while still finding a good
+             *         share of expired keys, i.e. another slice soon would pay
+             */
+            bool activeExpireCycle(std::chrono::microseconds budget);
+
+            struct ExpiryStats
+            {
+                uint64_t expired_keys;    // removed lazily or by the sweep
+                uint64_t cycle_time_us;   // total time spent in activeExpireCycle()
+                size_t keys_with_expiry;
+            };
+
+            ExpiryStats expiryStats() const;
+
+            void setActiveDefrag(const DefragConfig &config);
+
+            /**
+             * @brief Moves keyspace memory out of sparsely used allocator pages
+             *        for the configured share of `interval`
+             *
+             * Call every `interval` from the thread whose heap holds the keys
+             * (the server's loop thread). A pass starts once the calling
+             * thread's slab heap is fragmented past the threshold and then
+             * walks every shard with a resumable cursor, a time-bounded slice
+             * per call: each entry, its value object and the value's buffers,
+             * list chunks and small set and hash tables are copied into fuller
+             * pages of their class and the table slot (and deadline record)
+             * repointed. Does nothing unless the slab allocator is in use.
+             */
+            void activeDefragCycle(std::chrono::milliseconds interval);
+
+            struct DefragStats
+            {
+                bool running;
+                uint64_t hits;          // blocks moved
+                uint64_t key_hits;      // keys with something moved
+                uint64_t key_misses;    // keys visited with nothing to move
+                uint64_t time_us;       // total time spent in activeDefragCycle()
+                uint64_t passes;        // passes over the keyspace completed
+                double ratio_start;     // allocator fragmentation as the last pass started
+                double ratio_end;       // ...and when it finished (0 until one has)
+            };
+
+            DefragStats defragStats() const;
+
+            /**
+             * @brief Sets the memory limit (0 for none) and what to evict to
+             *        stay under it; called at startup, before any worker runs
+             */
+            void setMaxMemory(size_t bytes, EvictionPolicy policy, size_t samples = DEFAULT_EVICTION_SAMPLES);
+
+            /**
+             * @brief Tunes the LFU counter: a higher log factor needs more
+             *        accesses per step up; the decay time is in minutes
+             *        (0 never decays)
+             */
+            void setLfuTuning(unsigned log_factor, unsigned decay_time);
+
+            /**
+             * @brief Bytes held by the keyspace: entries and values as
+             *        accounted on each write, plus the hash table arrays
+             */
+            size_t usedMemory() const;
+
+            /**
+             * @brief Evicts keys until usedMemory() is within maxmemory
+             *
+             * Called before every command, which is also when peak memory
+             * is sampled; the caller must hold no shard lock.
+             * @return false if memory is still over the limit, i.e. the
+             *         policy is noeviction or found nothing left to evict;
+             *         the command should then be refused
+             */
+            bool evictIfNeeded();
+
+            /**
+             * @brief Refreshes the clocks that accesses are stamped with (Unix
+             *        seconds modulo 2^24, and minutes for LFU decay); call a
+             *        few times a second (the server does so from its cron)
+             *
+             * Trace replays pass a simulated time instead.
+             */
+            void updateLruClock(long long now_ms = currentTimeMs());
+
+            struct MemoryStats
+            {
+                size_t used_memory;
+                size_t peak_memory;
+                size_t table_bytes;                   // keyspace and deadline table arrays
+                size_t type_memory[VALUE_TYPE_COUNT]; // entries, by ValueType
+                size_t max_memory;
+                EvictionPolicy policy;
+                uint64_t evicted_keys;
+                uint64_t lazyfree_pending; // keys queued for background freeing
+                uint64_t lazyfreed;        // keys freed in the background so far
+            };
+
+            MemoryStats memoryStats() const;
+
+            /**
+             * @brief Advances in-progress keyspace rehashes by a bounded amount
+             *
+             * Writes already migrate a little on every call; this lets idle
+             * time finish a rehash on shards that stopped receiving writes.
+             * Covers the keyspace and the deadline tables alike.
+             * @return true if some shard still has rehashing left to do
+             */
+            bool rehashStep();
+        };
+
+        template <typename F>
+        bool CacheManager::readString(std::string_view key, F &&f)
+        {
+            size_t hash = Keyspace::hashKey(key);
+            Shard &shard = shardFor(hash);
+            auto guard = readLock(shard);
+            Entry *entry = lookup(shard, key, hash, ValueType::STRING);
+            if (!entry)
+                return false;
+            f(BorrowedString(*entry));
+            return true;
+        }
+
+        template <typename T, typename F>
+        bool CacheManager::readValue(std::string_view key, F &&f)
+        {
+            size_t hash = Keyspace::hashKey(key);
+            Shard &shard = shardFor(hash);
+            auto guard = readLock(shard);
+            Entry *entry = lookup(shard, key, hash, T::TYPE);
+            if (!entry)
+                return false;
+            f(static_cast<const T &>(*entry->as<T>()));
+            return true;
+        }
+
+        template <typename T>
+        const T *CacheManager::attachReader(std::string_view key, ValueReader &reader)
+        {
+            if (thread_safe)
+                throw std::logic_error("attachReader() on a thread-safe CacheManager");
+            size_t hash = Keyspace::hashKey(key);
+            Entry *entry = lookup(shardFor(hash), key, hash, T::TYPE);
+            if (!entry)
+                return nullptr;
+            detachReader(reader);
+            readers.emplace(entry, &reader);
+            reader.attached = entry;
+            entry->setHasReaders(true);
+            return entry->as<T>();
+        }
+
+        template <typename Lock>
+        std::vector<Lock> CacheManager::lockHashes(const std::vector<size_t> &hashes) const
+        {
+            std::vector<Lock> guards;
+            if (!thread_safe)
+                return guards;
+
+            std::vector<size_t> indices;
+            indices.reserve(hashes.size());
+            for (size_t hash : hashes)
+            {
+                indices.push_back(&shardFor(hash) - shards.get());
+            }
+            std::sort(indices.begin(), indices.end());
+            indices.erase(std::unique(indices.begin(), indices.end()), indices.end());
+
+            guards.reserve(indices.size());
+            for (size_t index : indices)
+            {
+                guards.emplace_back(shards[index].lock);
+            }
+            return guards;
+        }
+
+        template <typename F>
+        void CacheManager::readStrings(const std::vector<std::string_view> &keys, F &&f)
+        {
+            std::vector<size_t> hashes;
+            hashes.reserve(keys.size());
+            for (std::string_view key : keys)
+            {
+                hashes.push_back(Keyspace::hashKey(key));
+            }
+
+            auto guards = lockHashes<std::shared_lock<std::shared_mutex>>(hashes);
+            for (size_t i = 0; i < keys.size(); ++i)
+            {
+                prefetchAhead(hashes, i);
+                EntryPtr *slot = findLive(shardFor(hashes[i]), keys[i], hashes[i]);
+                if (slot && (*slot)->type() == ValueType::STRING)
+                {
+                    BorrowedString value(**slot);
+                    f(&value);
+                }
+                else
+                {
+                    f(static_cast<const BorrowedString *>(nullptr));
+                }
+            }
+        }
+
     } // namespace storage
 } // namespace opus
 
@@ -1,60 +1,407 @@
 #include "set_type.hpp"
 
 #include <algorithm>
+#include <atomic>
+#include <cstdint>
+#include <iterator>
+#include <thread>
 
 namespace opus
 {
     namespace storage
     {
 
+        SetType::Limits SetType::limits;
+
         SetType::SetType() = default;
 
         SetType::~SetType() = default;
 
-        std::string SetType::getType() const
+        SetType::SetType(SetType &&other) noexcept = default;
+
+        size_t SetType::defrag()
+        {
+            if (auto *intset = std::get_if<IntSet>(&values))
+                return intset->defrag() ? 1 : 0;
+            if (auto *listpack = std::get_if<Listpack>(&values))
+                return listpack->defrag() ? 1 : 0;
+            Table &table = *std::get<std::unique_ptr<Table>>(values);
+            return defragTable(table) ? table.size() : 0;
+        }
+
+        void SetType::setLimits(const Limits &new_limits)
+        {
+            limits = new_limits;
+        }
+
+        Encoding SetType::encoding() const
+        {
+            if (std::holds_alternative<IntSet>(values))
+                return Encoding::INTSET;
+            if (std::holds_alternative<Listpack>(values))
+                return Encoding::LISTPACK;
+            return Encoding::HASHTABLE;
+        }
+
+        bool SetType::tableInsert(Table &table, std::string &&member)
+        {
+            size_t length = member.size();
+            if (!table.insert(std::move(member)).second)
+                return false;
+            member_bytes += StringType::heapBytes(length);
+            return true;
+        }
+
+        size_t SetType::memoryUsage() const
+        {
+            if (const IntSet *ints = std::get_if<IntSet>(&values))
+                return sizeof(SetType) + ints->bytes();
+            if (const Listpack *packed = std::get_if<Listpack>(&values))
+                return sizeof(SetType) + packed->bytes();
+            const Table &table = *std::get<std::unique_ptr<Table>>(values);
+            return sizeof(SetType) + sizeof(Table) + table.bucket_count() * sizeof(void *) +
+                   table.size() * TABLE_NODE_BYTES + member_bytes;
+        }
+
+        void SetType::convertToListpack()
+        {
+            const IntSet &ints = std::get<IntSet>(values);
+            Listpack packed;
+            char buf[StringType::MAX_INTEGER_DIGITS];
+            for (size_t i = 0; i < ints.size(); ++i)
+            {
+                size_t len = StringType::formatInteger(ints.at(i), buf);
+                packed.append(std::string_view(buf, len));
+            }
+            values = std::move(packed);
+        }
+
+        SetType::Table &SetType::convertToTable()
+        {
+            auto table = std::make_unique<Table>();
+            if (const IntSet *ints = std::get_if<IntSet>(&values))
+            {
+                table->reserve(ints->size() + 1);
+                char buf[StringType::MAX_INTEGER_DIGITS];
+                for (size_t i = 0; i < ints->size(); ++i)
+                {
+                    size_t len = StringType::formatInteger(ints->at(i), buf);
+                    tableInsert(*table, std::string(buf, len));
+                }
+            }
+            else
+            {
+                const Listpack &packed = std::get<Listpack>(values);
+                table->reserve(packed.size() + 1);
+                for (size_t offset = 0, next; offset < packed.end(); offset = next)
+                {
+                    tableInsert(*table, std::string(packed.at(offset, next)));
+                }
+            }
+            values = std::move(table);
+            return *std::get<std::unique_ptr<Table>>(values);
+        }
+
+        int SetType::sadd(std::string_view value)
+        {
+            if (IntSet *ints = std::get_if<IntSet>(&values))
+            {
+                long long number;
+                if (StringType::parseInteger(value, number))
+                {
+                    if (!ints->insert(number))
+                        return 0;
+                    if (ints->size() > limits.max_intset_entries)
+                        convertToTable();
+                    return 1;
+                }
+
+                // A non-integer member ends the intset encoding.
+                if (ints->size() < limits.max_listpack_entries && value.size() <= limits.max_listpack_value)
+                    convertToListpack();
+                else
+                {
+                    tableInsert(convertToTable(), std::string(value));
+                    return 1;
+                }
+            }
+
+            if (Listpack *packed = std::get_if<Listpack>(&values))
+            {
+                if (packed->find(value) != Listpack::npos)
+                    return 0;
+                if (packed->size() < limits.max_listpack_entries && value.size() <= limits.max_listpack_value)
+                {
+                    packed->append(value);
+                    return 1;
+                }
+                tableInsert(convertToTable(), std::string(value));
+                return 1;
+            }
+
+            return tableInsert(*std::get<std::unique_ptr<Table>>(values), std::string(value)) ? 1 : 0;
+        }
+
+        SetType::Table *SetType::prepareBatch(size_t count)
         {
-            return "set";
+            // As in Redis, a batch that could outgrow the compact encoding
+            // converts up front, even if duplicates would have kept it small.
+            if (IntSet *ints = std::get_if<IntSet>(&values))
+            {
+                if (ints->size() + count > limits.max_intset_entries)
+                    convertToTable();
+            }
+            else if (Listpack *packed = std::get_if<Listpack>(&values))
+            {
+                if (packed->size() + count > limits.max_listpack_entries)
+                    convertToTable();
+            }
+
+            auto *table = std::get_if<std::unique_ptr<Table>>(&values);
+            if (!table)
+                return nullptr;
+            (*table)->reserve((*table)->size() + count);
+            return table->get();
         }
 
-        int SetType::sadd(const std::string &value)
+        int SetType::sadd(const std::vector<std::string_view> &members)
         {
-            auto result = values.insert(value);
-            return result.second ? 1 : 0;
+            int count = 0;
+            Table *table = prepareBatch(members.size());
+            for (std::string_view member : members)
+            {
+                count += table ? tableInsert(*table, std::string(member)) : sadd(member);
+            }
+            return count;
         }
 
-        int SetType::sadd(const std::vector<std::string> &members)
+        int SetType::sadd(std::vector<std::string> &&members)
         {
             int count = 0;
-            for (const auto &member : members)
+            Table *table = prepareBatch(members.size());
+            for (std::string &member : members)
             {
-                count += sadd(member);
+                count += table ? tableInsert(*table, std::move(member)) : sadd(member);
             }
             return count;
         }
 
-        bool SetType::sismember(const std::string &value) const
+        bool SetType::sismember(std::string_view value) const
         {
-            return values.find(value) != values.end();
+            if (const IntSet *ints = std::get_if<IntSet>(&values))
+            {
+                long long number;
+                return StringType::parseInteger(value, number) && ints->contains(number);
+            }
+            if (const Listpack *packed = std::get_if<Listpack>(&values))
+                return packed->find(value) != Listpack::npos;
+            // C++17 unordered containers probe with a key_type only.
+            const Table &table = *std::get<std::unique_ptr<Table>>(values);
+            return table.find(std::string(value)) != table.end();
         }
 
-        int SetType::srem(const std::string &value)
+        int SetType::srem(std::string_view value)
         {
-            return values.erase(value);
+            if (IntSet *ints = std::get_if<IntSet>(&values))
+            {
+                long long number;
+                return StringType::parseInteger(value, number) && ints->erase(number) ? 1 : 0;
+            }
+            if (Listpack *packed = std::get_if<Listpack>(&values))
+            {
+                size_t offset = packed->find(value);
+                if (offset == Listpack::npos)
+                    return 0;
+                packed->erase(offset);
+                return 1;
+            }
+            if (!std::get<std::unique_ptr<Table>>(values)->erase(std::string(value)))
+                return 0;
+            member_bytes -= StringType::heapBytes(value.size());
+            return 1;
         }
 
         int SetType::scard() const
         {
-            return values.size();
+            if (const IntSet *ints = std::get_if<IntSet>(&values))
+                return ints->size();
+            if (const Listpack *packed = std::get_if<Listpack>(&values))
+                return packed->size();
+            return std::get<std::unique_ptr<Table>>(values)->size();
         }
 
         std::vector<std::string> SetType::smembers() const
         {
-            return std::vector<std::string>(values.begin(), values.end());
+            std::vector<std::string> result;
+            result.reserve(scard());
+            visitMembers(0, SIZE_MAX, [&](std::string_view member) { result.emplace_back(member); });
+            return result;
+        }
+
+        unsigned long long SetType::sscan(unsigned long long cursor, size_t count, std::vector<std::string> &out) const
+        {
+            auto append = [&](std::string_view member)
+            { out.emplace_back(member); };
+            // A compact set is returned whole; the client's cursor is never
+            // used as an index or offset into it.
+            if (!std::holds_alternative<std::unique_ptr<Table>>(values))
+            {
+                visitMembers(0, SIZE_MAX, append);
+                return 0;
+            }
+            return visitMembers(static_cast<size_t>(cursor), count, append);
         }
 
         bool SetType::isEmpty() const
         {
-            return values.empty();
+            return scard() == 0;
+        }
+
+        size_t SetType::intersectInto(std::vector<const SetType *> sets, size_t limit, std::vector<std::string> *out)
+        {
+            if (sets.empty())
+                return 0;
+            for (const SetType *set : sets)
+            {
+                if (!set || set->isEmpty())
+                    return 0;
+            }
+
+            // Walk the smallest set; probe the rest smallest first, since a
+            // small set rejects a member no slower than a big one. Ties order
+            // by address so a key named twice ends up adjacent and is dropped.
+            std::sort(sets.begin(), sets.end(), [](const SetType *a, const SetType *b)
+                      { return a->scard() != b->scard() ? a->scard() < b->scard() : std::less<const SetType *>()(a, b); });
+            sets.erase(std::unique(sets.begin(), sets.end()), sets.end());
+            const SetType *smallest = sets.front();
+            std::vector<const SetType *> others(sets.begin() + 1, sets.end());
+
+            size_t parts = 1;
+            size_t threshold = limits.parallel_intersect_min;
+            if (threshold != 0 && static_cast<size_t>(smallest->scard()) >= threshold &&
+                smallest->encoding() != Encoding::LISTPACK)
+            {
+                parts = std::clamp<size_t>(std::thread::hardware_concurrency(), 1, MAX_INTERSECT_THREADS);
+            }
+
+            // Slices only read the sets, so they need no synchronization
+            // beyond the shared count that enforces the limit.
+            std::atomic<size_t> found{0};
+            std::vector<std::vector<std::string>> results(parts);
+            auto walk = [&](size_t part)
+            {
+                auto visit = [&](const std::string &member)
+                {
+                    for (const SetType *other : others)
+                    {
+                        if (!other->sismember(member))
+                            return true;
+                    }
+                    size_t count = found.fetch_add(1, std::memory_order_relaxed) + 1;
+                    if (limit != 0 && count > limit)
+                        return false;
+                    if (out)
+                        results[part].push_back(member);
+                    return limit == 0 || count < limit;
+                };
+                smallest->forEachMember(visit, part, parts);
+            };
+
+            std::vector<std::thread> workers;
+            for (size_t part = 1; part < parts; ++part)
+            {
+                workers.emplace_back(walk, part);
+            }
+            walk(0);
+            for (auto &worker : workers)
+            {
+                worker.join();
+            }
+
+            size_t total = found.load(std::memory_order_relaxed);
+            if (limit != 0 && total > limit)
+                total = limit;
+            if (out)
+            {
+                out->reserve(total);
+                for (auto &result : results)
+                {
+                    out->insert(out->end(), std::make_move_iterator(result.begin()), std::make_move_iterator(result.end()));
+                }
+            }
+            return total;
+        }
+
+        std::vector<std::string> SetType::intersect(const std::vector<const SetType *> &sets, size_t limit)
+        {
+            std::vector<std::string> result;
+            intersectInto(sets, limit, &result);
+            return result;
+        }
+
+        size_t SetType::intersectCount(const std::vector<const SetType *> &sets, size_t limit)
+        {
+            return intersectInto(sets, limit, nullptr);
+        }
+
+        std::vector<std::string> SetType::unite(const std::vector<const SetType *> &sets)
+        {
+            size_t upper = 0;
+            for (const SetType *set : sets)
+            {
+                upper += set ? set->scard() : 0;
+            }
+
+            std::unordered_set<std::string> seen;
+            seen.reserve(upper);
+            auto add = [&](const std::string &member)
+            {
+                seen.insert(member);
+                return true;
+            };
+            for (const SetType *set : sets)
+            {
+                if (set)
+                    set->forEachMember(add);
+            }
+
+            std::vector<std::string> result;
+            result.reserve(seen.size());
+            while (!seen.empty())
+            {
+                result.push_back(std::move(seen.extract(seen.begin()).value()));
+            }
+            return result;
+        }
+
+        std::vector<std::string> SetType::difference(const std::vector<const SetType *> &sets)
+        {
+            std::vector<std::string> result;
+            if (sets.empty() || !sets.front())
+                return result;
+
+            const SetType *first = sets.front();
+            std::vector<const SetType *> others;
+            for (size_t i = 1; i < sets.size(); ++i)
+            {
+                if (sets[i] == first)
+                    return result;
+                if (sets[i] && !sets[i]->isEmpty())
+                    others.push_back(sets[i]);
+            }
+
+            auto visit = [&](const std::string &member)
+            {
+                for (const SetType *other : others)
+                {
+                    if (other->sismember(member))
+                        return true;
+                }
+                result.push_back(member);
+                return true;
+            };
+            first->forEachMember(visit);
+            return result;
         }
 
     } // namespace storage
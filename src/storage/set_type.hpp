@@ -2,8 +2,16 @@
 #define OPUS_STORAGE_SET_TYPE_HPP
 
 #include "base_datastructure.hpp"
+#include "intset.hpp"
+#include "listpack.hpp"
+#include "string_type.hpp"
+#include <cstddef>
+#include <cstdint>
+#include <memory>
 #include <string>
+#include <string_view>
 #include <unordered_set>
+#include <variant>
 #include <vector>
 
 namespace opus
@@ -11,28 +19,246 @@ namespace opus
     namespace storage
     {
 
+        /**
+         * @brief Set with compact encodings for small sizes
+         *
+         * A new set is an IntSet while every member is a canonical integer,
+         * a Listpack while it is small and its members short, and a hash
+         * table otherwise. Conversions only go towards the hash table and
+         * happen inside sadd(), so callers never see the encoding change.
+         */
         class SetType : public BaseDataStructure
         {
+        public:
+            /**
+             * @brief Size thresholds for the compact encodings (the
+             *        set-max-* options, with Redis's defaults)
+             */
+            struct Limits
+            {
+                size_t max_intset_entries = 512;
+                size_t max_listpack_entries = 128;
+                size_t max_listpack_value = 64;
+
+                // Intersections whose smallest set has at least this many
+                // members are split across threads; 0 never splits.
+                size_t parallel_intersect_min = 0;
+            };
+
         private:
-            std::unordered_set<std::string> values;
+            using Table = std::unordered_set<std::string, std::hash<std::string>, std::equal_to<std::string>,
+                                             SlabStlAllocator<std::string>>;
+
+            // The table sits behind a pointer so a small set pays only for
+            // the compact representation it actually uses.
+            std::variant<IntSet, Listpack, std::unique_ptr<Table>> values;
+
+            // Heap bytes of the table's member strings, for memoryUsage().
+            size_t member_bytes = 0;
+
+            static Limits limits;
+
+            static constexpr size_t MAX_INTERSECT_THREADS = 8;
+
+            // A table node: next pointer, the member, its cached hash.
+            static constexpr size_t TABLE_NODE_BYTES = sizeof(void *) + sizeof(std::string) + sizeof(size_t);
+
+            void convertToListpack();
+            Table &convertToTable();
+            bool tableInsert(Table &table, std::string &&member);
+
+            // Readies the set for `count` new members: converts it if they
+            // could outgrow its compact encoding, and sizes the table for
+            // them. Returns the table, or nullptr if the set stays compact.
+            Table *prepareBatch(size_t count);
+
+            // Counts the intersection, appending members to `out` if given.
+            static size_t intersectInto(std::vector<const SetType *> sets, size_t limit, std::vector<std::string> *out);
 
         public:
             SetType();
-            ~SetType() override;
+            ~SetType();
+            SetType(SetType &&other) noexcept;
+
+            static constexpr ValueType TYPE = ValueType::SET;
+
+            /**
+             * @brief Replaces the thresholds; called once at startup, before
+             *        any worker runs
+             */
+            static void setLimits(const Limits &new_limits);
+
+            Encoding encoding() const;
 
-            std::string getType() const override;
+            /**
+             * @brief Estimated bytes held, the object included; O(1)
+             */
+            size_t memoryUsage() const;
 
-            int sadd(const std::string &value);
-            int sadd(const std::vector<std::string> &members);
+            /**
+             * @brief Moves the set's buffer or table nodes out of sparsely used
+             *        allocator pages (tables of up to DEFRAG_MAX_TABLE_SIZE)
+             * @return blocks moved
+             */
+            size_t defrag();
 
-            bool sismember(const std::string &value) const;
-            int srem(const std::string &value);
+            int sadd(std::string_view value);
+
+            /**
+             * @brief Adds several members, sizing the table once for all of
+             *        them; the rvalue form moves its strings into the table
+             * @return members that were new
+             */
+            int sadd(const std::vector<std::string_view> &members);
+            int sadd(std::vector<std::string> &&members);
+
+            bool sismember(std::string_view value) const;
+            int srem(std::string_view value);
             int scard() const;
             std::vector<std::string> smembers() const;
 
+            /**
+             * @brief One SSCAN page: appends about `count` members from
+             *        `cursor` on to `out`
+             *
+             * A compact set is returned whole, as Redis does. A table is
+             * walked a bucket at a time, the cursor being the next bucket,
+             * and no more than 10 * `count` buckets are visited per call; a
+             * scan may repeat or miss members if the table grows meanwhile.
+             * @return the cursor for the next call, 0 when the scan is done
+             */
+            unsigned long long sscan(unsigned long long cursor, size_t count, std::vector<std::string> &out) const;
+
             bool isEmpty() const;
+
+            /**
+             * @brief Calls f(member) for the members in slice `part` of
+             *        `parts`, stopping early if f returns false
+             *
+             * The slices partition the set, so different threads may walk
+             * different slices at once.
+             * @return false if f stopped the walk
+             */
+            template <typename F>
+            bool forEachMember(F &&f, size_t part = 0, size_t parts = 1) const;
+
+            /**
+             * @brief Calls f(std::string_view member) for roughly `count`
+             *        members from `cursor` on (0 starts a walk)
+             *
+             * The cursor is an index or byte offset into a compact set and a
+             * bucket of a table, whose buckets are visited whole; it is only
+             * meaningful while the set is unchanged and must come from a
+             * previous call, never from a client.
+             * @return the cursor to continue from, 0 once every member was seen
+             */
+            template <typename F>
+            size_t visitMembers(size_t cursor, size_t count, F &&f) const;
+
+            /**
+             * @brief Members present in every set, at most `limit` of them
+             *        (0 for no limit)
+             *
+             * Walks the smallest set and probes the others. A null entry
+             * stands for a missing key, which empties the result.
+             */
+            static std::vector<std::string> intersect(const std::vector<const SetType *> &sets, size_t limit = 0);
+
+            /**
+             * @brief Size of the intersection, counting no further than
+             *        `limit` (0 for no limit) and building no result
+             */
+            static size_t intersectCount(const std::vector<const SetType *> &sets, size_t limit = 0);
+
+            static std::vector<std::string> unite(const std::vector<const SetType *> &sets);
+
+            /**
+             * @brief Members of the first set found in none of the others
+             */
+            static std::vector<std::string> difference(const std::vector<const SetType *> &sets);
         };
 
+        template <typename F>
+        bool SetType::forEachMember(F &&f, size_t part, size_t parts) const
+        {
+            std::string member;
+            if (const IntSet *ints = std::get_if<IntSet>(&values))
+            {
+                char buf[StringType::MAX_INTEGER_DIGITS];
+                size_t end = ints->size() * (part + 1) / parts;
+                for (size_t i = ints->size() * part / parts; i < end; ++i)
+                {
+                    member.assign(buf, StringType::formatInteger(ints->at(i), buf));
+                    if (!f(static_cast<const std::string &>(member)))
+                        return false;
+                }
+                return true;
+            }
+            if (const Listpack *packed = std::get_if<Listpack>(&values))
+            {
+                // Too small to be worth splitting: the first slice has it all.
+                if (part != 0)
+                    return true;
+                for (size_t offset = 0, next; offset < packed->end(); offset = next)
+                {
+                    member.assign(packed->at(offset, next));
+                    if (!f(static_cast<const std::string &>(member)))
+                        return false;
+                }
+                return true;
+            }
+            const Table &table = *std::get<std::unique_ptr<Table>>(values);
+            size_t buckets = table.bucket_count();
+            size_t end = buckets * (part + 1) / parts;
+            for (size_t bucket = buckets * part / parts; bucket < end; ++bucket)
+            {
+                for (auto it = table.begin(bucket); it != table.end(bucket); ++it)
+                {
+                    if (!f(*it))
+                        return false;
+                }
+            }
+            return true;
+        }
+
+        template <typename F>
+        size_t SetType::visitMembers(size_t cursor, size_t count, F &&f) const
+        {
+            if (const IntSet *ints = std::get_if<IntSet>(&values))
+            {
+                char buf[StringType::MAX_INTEGER_DIGITS];
+                size_t end = count < ints->size() - cursor ? cursor + count : ints->size();
+                for (; cursor < end; ++cursor)
+                {
+                    f(std::string_view(buf, StringType::formatInteger(ints->at(cursor), buf)));
+                }
+                return cursor < ints->size() ? cursor : 0;
+            }
+            if (const Listpack *packed = std::get_if<Listpack>(&values))
+            {
+                // The cursor is a byte offset here.
+                for (size_t next; cursor < packed->end() && count > 0; cursor = next, --count)
+                {
+                    f(packed->at(cursor, next));
+                }
+                return cursor < packed->end() ? cursor : 0;
+            }
+            // Empty buckets count against a budget, as in CacheManager::scan():
+            // a table shrunk by SREM keeps its buckets.
+            const Table &table = *std::get<std::unique_ptr<Table>>(values);
+            size_t buckets = table.bucket_count();
+            size_t budget = count < SIZE_MAX / 10 ? count * 10 : SIZE_MAX;
+            size_t visited = 0;
+            for (; cursor < buckets && visited < count && budget > 0; ++cursor, --budget)
+            {
+                for (auto it = table.begin(cursor); it != table.end(cursor); ++it, ++visited)
+                {
+                    f(std::string_view(*it));
+                }
+            }
+            return cursor < buckets ? cursor : 0;
+        }
+
     } // namespace storage
 } // namespace opus
 
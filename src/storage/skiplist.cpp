@@ -0,0 +1,267 @@
+#include "skiplist.hpp"
+#include "slab_allocator.hpp"
+
+#include <cstring>
+#include <new>
+
+namespace opus
+{
+    namespace storage
+    {
+
+        size_t Skiplist::nodeBytes(int height, size_t member_len)
+        {
+            return sizeof(Node) + height * sizeof(Node::Level) + member_len;
+        }
+
+        Skiplist::Node *Skiplist::createNode(int height, double score, std::string_view member)
+        {
+            size_t bytes = nodeBytes(height, member.size());
+            Node *node = new (SlabAllocator::allocate(bytes)) Node;
+            node_bytes += bytes;
+            node->node_score = score;
+            node->backward = nullptr;
+            node->member_len = static_cast<uint32_t>(member.size());
+            node->height = static_cast<uint8_t>(height);
+            for (int i = 0; i < height; ++i)
+            {
+                new (&node->level(i)) Node::Level{nullptr, 0};
+            }
+            if (!member.empty())
+                std::memcpy(node->memberBytes(), member.data(), member.size());
+            return node;
+        }
+
+        void Skiplist::freeNode(Node *node)
+        {
+            size_t bytes = nodeBytes(node->height, node->member_len);
+            node_bytes -= bytes;
+            SlabAllocator::deallocate(node, bytes);
+        }
+
+        Skiplist::Skiplist()
+            : header(createNode(MAX_LEVEL, 0, std::string_view())),
+              random_state(reinterpret_cast<uintptr_t>(this) | 1) {}
+
+        Skiplist::~Skiplist()
+        {
+            Node *node = header->level(0).forward;
+            while (node)
+            {
+                Node *next = node->level(0).forward;
+                freeNode(node);
+                node = next;
+            }
+            freeNode(header);
+        }
+
+        int Skiplist::randomLevel()
+        {
+            // xorshift64; each extra level has probability 1/4 (two zero bits).
+            random_state ^= random_state << 13;
+            random_state ^= random_state >> 7;
+            random_state ^= random_state << 17;
+            uint64_t bits = random_state;
+            int height = 1;
+            while ((bits & 3) == 0 && height < MAX_LEVEL)
+            {
+                ++height;
+                bits >>= 2;
+            }
+            return height;
+        }
+
+        bool Skiplist::before(const Node *node, double score, std::string_view member)
+        {
+            return node->node_score < score || (node->node_score == score && node->member() < member);
+        }
+
+        Skiplist::Node *Skiplist::searchPath(double score, std::string_view member, Node **update, size_t *rank) const
+        {
+            Node *x = header;
+            for (int i = level - 1; i >= 0; --i)
+            {
+                if (rank)
+                    rank[i] = i == level - 1 ? 0 : rank[i + 1];
+                while (x->level(i).forward && before(x->level(i).forward, score, member))
+                {
+                    if (rank)
+                        rank[i] += x->level(i).span;
+                    x = x->level(i).forward;
+                }
+                update[i] = x;
+            }
+            return x->level(0).forward;
+        }
+
+        void Skiplist::link(Node *x, Node **update, size_t *rank)
+        {
+            int height = x->height;
+            if (height > level)
+            {
+                for (int i = level; i < height; ++i)
+                {
+                    rank[i] = 0;
+                    update[i] = header;
+                    header->level(i).span = length;
+                }
+                level = height;
+            }
+
+            for (int i = 0; i < height; ++i)
+            {
+                x->level(i).forward = update[i]->level(i).forward;
+                update[i]->level(i).forward = x;
+                x->level(i).span = update[i]->level(i).span - (rank[0] - rank[i]);
+                update[i]->level(i).span = (rank[0] - rank[i]) + 1;
+            }
+            for (int i = height; i < level; ++i)
+            {
+                ++update[i]->level(i).span;
+            }
+
+            x->backward = update[0] == header ? nullptr : update[0];
+            if (x->level(0).forward)
+                x->level(0).forward->backward = x;
+            else
+                tail = x;
+            ++length;
+        }
+
+        void Skiplist::unlink(Node *x, Node **update)
+        {
+            for (int i = 0; i < level; ++i)
+            {
+                if (update[i]->level(i).forward == x)
+                {
+                    update[i]->level(i).span += x->level(i).span - 1;
+                    update[i]->level(i).forward = x->level(i).forward;
+                }
+                else
+                {
+                    --update[i]->level(i).span;
+                }
+            }
+
+            if (x->level(0).forward)
+                x->level(0).forward->backward = x->backward;
+            else
+                tail = x->backward;
+
+            while (level > 1 && !header->level(level - 1).forward)
+            {
+                --level;
+            }
+            --length;
+        }
+
+        Skiplist::Node *Skiplist::insert(double score, std::string_view member)
+        {
+            Node *update[MAX_LEVEL];
+            size_t rank[MAX_LEVEL];
+            searchPath(score, member, update, rank);
+            Node *x = createNode(randomLevel(), score, member);
+            link(x, update, rank);
+            return x;
+        }
+
+        void Skiplist::erase(Node *node)
+        {
+            Node *update[MAX_LEVEL];
+            searchPath(node->node_score, node->member(), update, nullptr);
+            unlink(node, update);
+            freeNode(node);
+        }
+
+        void Skiplist::updateScore(Node *node, double score)
+        {
+            // Staying between its neighbours: no relinking needed.
+            if ((!node->backward || node->backward->node_score < score) &&
+                (!node->level(0).forward || node->level(0).forward->node_score > score))
+            {
+                node->node_score = score;
+                return;
+            }
+
+            Node *update[MAX_LEVEL];
+            size_t rank[MAX_LEVEL];
+            searchPath(node->node_score, node->member(), update, nullptr);
+            unlink(node, update);
+            node->node_score = score;
+            searchPath(score, node->member(), update, rank);
+            link(node, update, rank);
+        }
+
+        size_t Skiplist::rankOf(const Node *node) const
+        {
+            size_t rank = 0;
+            const Node *x = header;
+            for (int i = level - 1; i >= 0; --i)
+            {
+                while (x->level(i).forward && !before(node, x->level(i).forward->node_score, x->level(i).forward->member()))
+                {
+                    rank += x->level(i).span;
+                    x = x->level(i).forward;
+                }
+                if (x == node)
+                    return rank;
+            }
+            return 0;
+        }
+
+        Skiplist::Node *Skiplist::byRank(size_t rank) const
+        {
+            if (rank == 0 || rank > length)
+                return nullptr;
+
+            size_t traversed = 0;
+            Node *x = header;
+            for (int i = level - 1; i >= 0; --i)
+            {
+                while (x->level(i).forward && traversed + x->level(i).span <= rank)
+                {
+                    traversed += x->level(i).span;
+                    x = x->level(i).forward;
+                }
+                if (traversed == rank)
+                    return x;
+            }
+            return nullptr;
+        }
+
+        Skiplist::Node *Skiplist::firstInRange(const ScoreRange &range) const
+        {
+            if (range.empty() || !tail || !range.aboveMin(tail->node_score))
+                return nullptr;
+
+            Node *x = header;
+            for (int i = level - 1; i >= 0; --i)
+            {
+                while (x->level(i).forward && !range.aboveMin(x->level(i).forward->node_score))
+                {
+                    x = x->level(i).forward;
+                }
+            }
+            x = x->level(0).forward;
+            return x && range.belowMax(x->node_score) ? x : nullptr;
+        }
+
+        Skiplist::Node *Skiplist::lastInRange(const ScoreRange &range) const
+        {
+            Node *head = header->level(0).forward;
+            if (range.empty() || !head || !range.belowMax(head->node_score))
+                return nullptr;
+
+            Node *x = header;
+            for (int i = level - 1; i >= 0; --i)
+            {
+                while (x->level(i).forward && range.belowMax(x->level(i).forward->node_score))
+                {
+                    x = x->level(i).forward;
+                }
+            }
+            return x != header && range.aboveMin(x->node_score) ? x : nullptr;
+        }
+
+    } // namespace storage
+} // namespace opus
@@ -0,0 +1,189 @@
+#ifndef OPUS_STORAGE_SKIPLIST_HPP
+#define OPUS_STORAGE_SKIPLIST_HPP
+
+#include <cstddef>
+#include <cstdint>
+#include <string_view>
+
+namespace opus
+{
+    namespace storage
+    {
+
+        /**
+         * @brief Closed, open or half-open interval of scores
+         */
+        struct ScoreRange
+        {
+            double min;
+            double max;
+            bool min_exclusive = false;
+            bool max_exclusive = false;
+
+            bool aboveMin(double score) const { return min_exclusive ? score > min : score >= min; }
+            bool belowMax(double score) const { return max_exclusive ? score < max : score <= max; }
+            bool contains(double score) const { return aboveMin(score) && belowMax(score); }
+
+            /**
+             * @brief Whether no score at all can fall in the range
+             */
+            bool empty() const { return min > max || (min == max && (min_exclusive || max_exclusive)); }
+        };
+
+        /**
+         * @brief Skiplist of (score, member) ordered by score, then member
+         *
+         * Every forward link records its span, the number of level-0 steps
+         * it jumps, so a node's rank and the node at a given rank are both
+         * found in O(log n) along the search path. A node is one allocation:
+         * the header, its level array and the member bytes. Node addresses
+         * are stable for the node's lifetime, including across score
+         * updates, so owners may index nodes by pointer or by member view.
+         */
+        class Skiplist
+        {
+        public:
+            class Node
+            {
+                friend class Skiplist;
+
+            private:
+                struct Level
+                {
+                    Node *forward;
+                    size_t span;
+                };
+
+                double node_score;
+                Node *backward;
+                uint32_t member_len;
+                uint8_t height;
+
+                // The level array follows the node, then the member bytes.
+                Level *levels() { return reinterpret_cast<Level *>(this + 1); }
+                const Level *levels() const { return reinterpret_cast<const Level *>(this + 1); }
+                Level &level(int i) { return levels()[i]; }
+                const Level &level(int i) const { return levels()[i]; }
+                char *memberBytes() { return reinterpret_cast<char *>(levels() + height); }
+
+            public:
+                double score() const { return node_score; }
+                std::string_view member() const
+                {
+                    return std::string_view(reinterpret_cast<const char *>(levels() + height), member_len);
+                }
+
+                Node *next() const { return level(0).forward; }
+                Node *prev() const { return backward; }
+            };
+
+            // Redis's ZSKIPLIST_MAXLEVEL; with p = 1/4 that covers 2^64 nodes.
+            static constexpr int MAX_LEVEL = 32;
+
+        private:
+            size_t node_bytes = 0; // allocated by the nodes, header included
+            Node *header;
+            Node *tail = nullptr;
+            size_t length = 0;
+            int level = 1;
+            uint64_t random_state;
+
+            static size_t nodeBytes(int height, size_t member_len);
+            Node *createNode(int height, double score, std::string_view member);
+            void freeNode(Node *node);
+            int randomLevel();
+
+            static bool before(const Node *node, double score, std::string_view member);
+
+            // Fills update[] with the rightmost node before (score, member) on
+            // each level, and rank[] with their ranks; returns the candidate.
+            Node *searchPath(double score, std::string_view member, Node **update, size_t *rank) const;
+            void link(Node *node, Node **update, size_t *rank);
+            void unlink(Node *node, Node **update);
+
+        public:
+            Skiplist();
+            ~Skiplist();
+
+            Skiplist(const Skiplist &) = delete;
+            Skiplist &operator=(const Skiplist &) = delete;
+
+            size_t size() const { return length; }
+
+            /**
+             * @brief Heap bytes held by the nodes
+             */
+            size_t bytes() const { return node_bytes; }
+
+            Node *first() const { return header->level(0).forward; }
+            Node *last() const { return tail; }
+
+            /**
+             * @brief Adds a member that is not already in the list
+             */
+            Node *insert(double score, std::string_view member);
+
+            /**
+             * @brief Removes `node`, which must belong to this list
+             */
+            void erase(Node *node);
+
+            /**
+             * @brief Moves `node` to `score`; the node itself is kept
+             */
+            void updateScore(Node *node, double score);
+
+            /**
+             * @return 1-based rank of `node`
+             */
+            size_t rankOf(const Node *node) const;
+
+            /**
+             * @return the node at 1-based `rank`, or nullptr if out of range
+             */
+            Node *byRank(size_t rank) const;
+
+            Node *firstInRange(const ScoreRange &range) const;
+            Node *lastInRange(const ScoreRange &range) const;
+
+            /**
+             * @brief Removes every node whose score is in `range`, calling
+             *        removed(node) before each is freed
+             * @return the number removed
+             */
+            template <typename F>
+            size_t eraseRange(const ScoreRange &range, F &&removed);
+        };
+
+        template <typename F>
+        size_t Skiplist::eraseRange(const ScoreRange &range, F &&removed)
+        {
+            Node *update[MAX_LEVEL];
+            Node *x = header;
+            for (int i = level - 1; i >= 0; --i)
+            {
+                while (x->level(i).forward && !range.aboveMin(x->level(i).forward->node_score))
+                {
+                    x = x->level(i).forward;
+                }
+                update[i] = x;
+            }
+
+            size_t count = 0;
+            x = x->level(0).forward;
+            while (x && range.belowMax(x->node_score))
+            {
+                Node *next = x->level(0).forward;
+                unlink(x, update);
+                removed(x);
+                freeNode(x);
+                ++count;
+                x = next;
+            }
+            return count;
+        }
+
+    } // namespace storage
+} // namespace opus
+
+#endif // OPUS_STORAGE_SKIPLIST_HPP
@@ -0,0 +1,607 @@
+#include "slab_allocator.hpp"
+
+#include <algorithm>
+#include <atomic>
+#include <cstdlib>
+#include <cstring>
+#include <mutex>
+#include <vector>
+#include <sys/mman.h>
+
+namespace opus
+{
+    namespace storage
+    {
+
+        namespace
+        {
+            constexpr size_t PAGE_SHIFT = 16;
+            constexpr size_t PAGE_SIZE = size_t(1) << PAGE_SHIFT;
+            constexpr size_t SEGMENT_SIZE = size_t(2) << 20; // one huge page
+            constexpr size_t PAGES_PER_SEGMENT = SEGMENT_SIZE / PAGE_SIZE;
+            constexpr size_t OS_PAGE_SIZE = 4096;
+
+            // 16..256 in steps of 16, then eight classes per doubling up to 8 KB,
+            // so rounding up never costs more than an eighth of a block.
+            constexpr size_t CLASS_COUNT = 56;
+
+            // Pages a defragmenting allocation looks at for a fuller one.
+            constexpr size_t DEFRAG_PROBE_PAGES = 16;
+
+            // Emptied pages a heap keeps resident for reuse before returning
+            // further ones to the kernel: 1 MB, enough to absorb churn without
+            // an madvise() per page.
+            constexpr size_t CACHED_EMPTY_PAGES = 16;
+
+            constexpr size_t classSize(size_t size_class)
+            {
+                if (size_class < 16)
+                    return (size_class + 1) * 16;
+                size_t group = (size_class - 16) / 8;
+                size_t step = (size_class - 16) % 8 + 1;
+                return (size_t(256) << group) + step * (size_t(32) << group);
+            }
+
+            static_assert(classSize(CLASS_COUNT - 1) == SlabAllocator::MAX_SMALL_SIZE, "last class is MAX_SMALL_SIZE");
+
+            size_t classOf(size_t size)
+            {
+                if (size <= 256)
+                    return size == 0 ? 0 : (size - 1) / 16;
+                size_t rest = size - 1;
+                unsigned top = 63 - __builtin_clzll(rest);
+                return 16 + (top - 8) * 8 + ((rest >> (top - 3)) & 7);
+            }
+
+            struct Heap;
+
+            struct Page
+            {
+                Page *prev = nullptr; // neighbours in the heap's list for this class
+                Page *next = nullptr; // (or in a free page list, singly linked)
+                void *free_blocks = nullptr;
+                char *start = nullptr;
+                uint32_t area = 0; // usable bytes from start
+                uint32_t block_size = 0;
+                uint16_t capacity = 0; // blocks that fit
+                uint16_t carved = 0;   // blocks handed out from fresh space so far
+                uint16_t used = 0;     // live blocks, remote frees not yet counted
+                uint8_t size_class = 0;
+                bool full = false; // out of blocks and off its class list
+            };
+
+            struct Segment
+            {
+                Heap *heap;
+                Segment *next;
+                Page pages[PAGES_PER_SEGMENT];
+            };
+
+            // The first page of a segment starts after the header.
+            constexpr size_t SEGMENT_HEADER = (sizeof(Segment) + 63) & ~size_t(63);
+
+            struct Heap
+            {
+                Page *classes[CLASS_COUNT] = {};
+
+                // Blocks in use and block capacity of each class's pages, and
+                // the blocks of its full pages, for the average use of the
+                // partly used ones that tells sparse pages from dense ones.
+                size_t class_used[CLASS_COUNT] = {};
+                size_t class_capacity[CLASS_COUNT] = {};
+                size_t class_full[CLASS_COUNT] = {};
+
+                Page *empty_pages = nullptr;    // resident, ready for any class
+                Page *released_pages = nullptr; // given back to (or never touched by) the kernel
+                size_t cached_pages = 0;
+                Segment *segments = nullptr;
+                Heap *next = nullptr; // in the registry
+                bool orphaned = false;
+
+                // Written only by the owning thread; read by stats().
+                std::atomic<size_t> allocated{0};
+                std::atomic<size_t> active{0};
+                std::atomic<size_t> resident{0};
+                std::atomic<size_t> mapped{0};
+
+                // Blocks freed by other threads, linked through their first word.
+                alignas(64) std::atomic<void *> remote_frees{nullptr};
+            };
+
+            bool slab_enabled = true;
+            bool huge_pages = false;
+
+            std::mutex registry_lock;
+            Heap *heaps = nullptr;
+            std::atomic<size_t> large_bytes{0};
+
+            thread_local Heap *local_heap = nullptr;
+            thread_local bool defrag_allocation = false;
+
+            void add(std::atomic<size_t> &counter, size_t bytes)
+            {
+                counter.store(counter.load(std::memory_order_relaxed) + bytes, std::memory_order_relaxed);
+            }
+
+            void subtract(std::atomic<size_t> &counter, size_t bytes)
+            {
+                counter.store(counter.load(std::memory_order_relaxed) - bytes, std::memory_order_relaxed);
+            }
+
+            Segment *segmentOf(const void *ptr)
+            {
+                return reinterpret_cast<Segment *>(reinterpret_cast<uintptr_t>(ptr) & ~(SEGMENT_SIZE - 1));
+            }
+
+            Page *pageOf(Segment *segment, const void *ptr)
+            {
+                uintptr_t offset = reinterpret_cast<uintptr_t>(ptr) - reinterpret_cast<uintptr_t>(segment);
+                return &segment->pages[offset >> PAGE_SHIFT];
+            }
+
+            void *&nextBlock(void *block)
+            {
+                return *static_cast<void **>(block);
+            }
+
+            // Marks the thread's heap as free for adoption when the thread exits.
+            struct HeapRelease
+            {
+                ~HeapRelease()
+                {
+                    std::lock_guard<std::mutex> guard(registry_lock);
+                    if (local_heap)
+                        local_heap->orphaned = true;
+                    local_heap = nullptr;
+                }
+            };
+
+            void drainRemoteFrees(Heap *heap);
+
+            Heap *acquireHeap()
+            {
+                Heap *heap = nullptr;
+                {
+                    std::lock_guard<std::mutex> guard(registry_lock);
+                    for (Heap *candidate = heaps; candidate; candidate = candidate->next)
+                    {
+                        if (candidate->orphaned)
+                        {
+                            candidate->orphaned = false;
+                            heap = candidate;
+                            break;
+                        }
+                    }
+                    if (!heap)
+                    {
+                        heap = new Heap();
+                        heap->next = heaps;
+                        heaps = heap;
+                    }
+                }
+                local_heap = heap;
+
+                // An adopted heap may have blocks freed while it had no owner.
+                drainRemoteFrees(heap);
+
+                // A thread that allocates again after its thread_locals are
+                // gone keeps the heap it gets here for good.
+                static thread_local HeapRelease release;
+                (void)release;
+                return heap;
+            }
+
+            void linkPage(Heap *heap, Page *page)
+            {
+                Page *&head = heap->classes[page->size_class];
+                page->prev = nullptr;
+                page->next = head;
+                if (head)
+                    head->prev = page;
+                head = page;
+            }
+
+            void unlinkPage(Heap *heap, Page *page)
+            {
+                if (page->prev)
+                    page->prev->next = page->next;
+                else
+                    heap->classes[page->size_class] = page->next;
+                if (page->next)
+                    page->next->prev = page->prev;
+                page->prev = page->next = nullptr;
+            }
+
+            void mapSegment(Heap *heap)
+            {
+                // Map twice the size and trim, so the segment is aligned and
+                // any pointer finds its header by masking.
+                void *raw = mmap(nullptr, 2 * SEGMENT_SIZE, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+                if (raw == MAP_FAILED)
+                    throw std::bad_alloc();
+                uintptr_t begin = reinterpret_cast<uintptr_t>(raw);
+                uintptr_t base = (begin + SEGMENT_SIZE - 1) & ~(SEGMENT_SIZE - 1);
+                if (base > begin)
+                    munmap(raw, base - begin);
+                if (base + SEGMENT_SIZE < begin + 2 * SEGMENT_SIZE)
+                    munmap(reinterpret_cast<void *>(base + SEGMENT_SIZE), begin + 2 * SEGMENT_SIZE - base - SEGMENT_SIZE);
+                if (huge_pages)
+                    madvise(reinterpret_cast<void *>(base), SEGMENT_SIZE, MADV_HUGEPAGE);
+
+                Segment *segment = new (reinterpret_cast<void *>(base)) Segment{heap, heap->segments, {}};
+                heap->segments = segment;
+                char *bytes = reinterpret_cast<char *>(base);
+                for (size_t i = PAGES_PER_SEGMENT; i-- > 0;)
+                {
+                    Page *page = &segment->pages[i];
+                    size_t skip = i == 0 ? SEGMENT_HEADER : 0;
+                    page->start = bytes + i * PAGE_SIZE + skip;
+                    page->area = static_cast<uint32_t>(PAGE_SIZE - skip);
+                    page->next = heap->released_pages;
+                    heap->released_pages = page;
+                }
+                add(heap->mapped, SEGMENT_SIZE);
+            }
+
+            Page *takePage(Heap *heap, size_t size_class)
+            {
+                Page *page = heap->empty_pages;
+                if (page)
+                {
+                    heap->empty_pages = page->next;
+                    --heap->cached_pages;
+                }
+                else
+                {
+                    if (!heap->released_pages)
+                        mapSegment(heap);
+                    page = heap->released_pages;
+                    heap->released_pages = page->next;
+                    add(heap->resident, page->area);
+                }
+                add(heap->active, page->area);
+
+                page->free_blocks = nullptr;
+                page->block_size = static_cast<uint32_t>(classSize(size_class));
+                page->capacity = static_cast<uint16_t>(page->area / page->block_size);
+                page->carved = 0;
+                page->used = 0;
+                page->size_class = static_cast<uint8_t>(size_class);
+                page->full = false;
+                heap->class_capacity[size_class] += page->capacity;
+                linkPage(heap, page);
+                return page;
+            }
+
+            void retirePage(Heap *heap, Page *page)
+            {
+                if (!page->full)
+                    unlinkPage(heap, page);
+                else
+                    heap->class_full[page->size_class] -= page->capacity;
+                heap->class_capacity[page->size_class] -= page->capacity;
+                subtract(heap->active, page->area);
+
+                // Under huge pages a partial MADV_DONTNEED would split the huge
+                // page, so emptied pages stay resident.
+                if (huge_pages || heap->cached_pages < CACHED_EMPTY_PAGES)
+                {
+                    page->next = heap->empty_pages;
+                    heap->empty_pages = page;
+                    ++heap->cached_pages;
+                    return;
+                }
+                uintptr_t begin = (reinterpret_cast<uintptr_t>(page->start) + OS_PAGE_SIZE - 1) & ~(OS_PAGE_SIZE - 1);
+                uintptr_t end = reinterpret_cast<uintptr_t>(page->start) + page->area;
+                madvise(reinterpret_cast<void *>(begin), end - begin, MADV_DONTNEED);
+                subtract(heap->resident, page->area);
+                page->next = heap->released_pages;
+                heap->released_pages = page;
+            }
+
+            void freeLocal(Heap *heap, Page *page, void *block)
+            {
+                nextBlock(block) = page->free_blocks;
+                page->free_blocks = block;
+                --page->used;
+                --heap->class_used[page->size_class];
+                subtract(heap->allocated, page->block_size);
+
+                if (page->used == 0)
+                    retirePage(heap, page);
+                else if (page->full)
+                {
+                    page->full = false;
+                    heap->class_full[page->size_class] -= page->capacity;
+                    linkPage(heap, page);
+                }
+            }
+
+            void drainRemoteFrees(Heap *heap)
+            {
+                if (!heap->remote_frees.load(std::memory_order_relaxed))
+                    return;
+                void *block = heap->remote_frees.exchange(nullptr, std::memory_order_acquire);
+                while (block)
+                {
+                    void *next = nextBlock(block);
+                    freeLocal(heap, pageOf(segmentOf(block), block), block);
+                    block = next;
+                }
+            }
+
+            void *takeBlock(Heap *heap, Page *page)
+            {
+                void *block = page->free_blocks;
+                if (block)
+                    page->free_blocks = nextBlock(block);
+                else
+                    block = page->start + size_t(page->carved++) * page->block_size;
+                ++page->used;
+                ++heap->class_used[page->size_class];
+                add(heap->allocated, page->block_size);
+                return block;
+            }
+
+            bool hasBlocks(const Page *page)
+            {
+                return page->free_blocks || page->carved < page->capacity;
+            }
+
+            // Used below the average of its class's partly used pages; moving
+            // blocks out of such pages lets them empty and be reused. Full
+            // pages are left out of the average, or once most pages were full
+            // every other one would count as sparse and none as a destination.
+            bool isSparse(const Heap *heap, const Page *page)
+            {
+                size_t size_class = page->size_class;
+                size_t full = heap->class_full[size_class];
+                return page->used < page->capacity &&
+                       page->used * (heap->class_capacity[size_class] - full) <
+                           (heap->class_used[size_class] - full) * page->capacity;
+            }
+
+            // A block from one of the first pages of the class that is not
+            // sparse, or nullptr; never maps or takes a new page.
+            void *takeDenseBlock(Heap *heap, size_t size_class)
+            {
+                Page *page = heap->classes[size_class];
+                for (size_t probed = 0; page && probed < DEFRAG_PROBE_PAGES; ++probed, page = page->next)
+                {
+                    if (hasBlocks(page) && !isSparse(heap, page))
+                        return takeBlock(heap, page);
+                }
+                return nullptr;
+            }
+
+            void *allocateSlow(Heap *heap, size_t size_class)
+            {
+                drainRemoteFrees(heap);
+                if (defrag_allocation)
+                {
+                    if (void *block = takeDenseBlock(heap, size_class))
+                        return block;
+                }
+                Page *page = heap->classes[size_class];
+                while (page && !hasBlocks(page))
+                {
+                    // Out of blocks: off the list until one is freed.
+                    Page *next = page->next;
+                    unlinkPage(heap, page);
+                    page->full = true;
+                    heap->class_full[size_class] += page->capacity;
+                    page = next;
+                }
+                if (!page)
+                    page = takePage(heap, size_class);
+                else if (page != heap->classes[size_class])
+                {
+                    unlinkPage(heap, page);
+                    linkPage(heap, page);
+                }
+                return takeBlock(heap, page);
+            }
+
+            void *allocateLarge(size_t size)
+            {
+                void *ptr = std::malloc(size);
+                if (!ptr)
+                    throw std::bad_alloc();
+                if (slab_enabled)
+                    large_bytes.fetch_add(size, std::memory_order_relaxed);
+                return ptr;
+            }
+
+            void deallocateLarge(void *ptr, size_t size)
+            {
+                if (slab_enabled)
+                    large_bytes.fetch_sub(size, std::memory_order_relaxed);
+                std::free(ptr);
+            }
+        }
+
+        void SlabAllocator::configure(bool enabled, bool huge)
+        {
+            slab_enabled = enabled;
+            huge_pages = enabled && huge;
+        }
+
+        bool SlabAllocator::enabled()
+        {
+            return slab_enabled;
+        }
+
+        bool SlabAllocator::hugePages()
+        {
+            return huge_pages;
+        }
+
+        void *SlabAllocator::allocate(size_t size)
+        {
+            if (!slab_enabled || size > MAX_SMALL_SIZE)
+                return allocateLarge(size ? size : 1);
+
+            size_t size_class = classOf(size);
+            Heap *heap = local_heap ? local_heap : acquireHeap();
+            Page *page = heap->classes[size_class];
+            if (page && hasBlocks(page) && !defrag_allocation)
+                return takeBlock(heap, page);
+            return allocateSlow(heap, size_class);
+        }
+
+        void SlabAllocator::deallocate(void *ptr, size_t size) noexcept
+        {
+            if (!ptr)
+                return;
+            if (!slab_enabled || size > MAX_SMALL_SIZE)
+                return deallocateLarge(ptr, size ? size : 1);
+
+            Segment *segment = segmentOf(ptr);
+            Heap *owner = segment->heap;
+            if (owner == local_heap)
+                return freeLocal(owner, pageOf(segment, ptr), ptr);
+
+            void *head = owner->remote_frees.load(std::memory_order_relaxed);
+            do
+            {
+                nextBlock(ptr) = head;
+            } while (!owner->remote_frees.compare_exchange_weak(head, ptr, std::memory_order_release,
+                                                                std::memory_order_relaxed));
+        }
+
+        void *SlabAllocator::reallocate(void *ptr, size_t old_size, size_t new_size)
+        {
+            if (!ptr)
+                return allocate(new_size);
+            new_size = new_size ? new_size : 1;
+            old_size = old_size ? old_size : 1;
+
+            bool old_small = slab_enabled && old_size <= MAX_SMALL_SIZE;
+            bool new_small = slab_enabled && new_size <= MAX_SMALL_SIZE;
+            if (old_small && new_small && classOf(old_size) == classOf(new_size))
+                return ptr;
+            if (!old_small && !new_small)
+            {
+                void *moved = std::realloc(ptr, new_size);
+                if (!moved)
+                    throw std::bad_alloc();
+                if (slab_enabled)
+                {
+                    large_bytes.fetch_add(new_size, std::memory_order_relaxed);
+                    large_bytes.fetch_sub(old_size, std::memory_order_relaxed);
+                }
+                return moved;
+            }
+
+            void *moved = allocate(new_size);
+            std::memcpy(moved, ptr, std::min(old_size, new_size));
+            deallocate(ptr, old_size);
+            return moved;
+        }
+
+        size_t SlabAllocator::usableSize(size_t size)
+        {
+            if (!slab_enabled || size > MAX_SMALL_SIZE)
+                return size;
+            return classSize(classOf(size));
+        }
+
+        SlabAllocator::Stats SlabAllocator::threadStats()
+        {
+            Stats stats;
+            if (Heap *heap = local_heap)
+            {
+                stats.allocated = heap->allocated.load(std::memory_order_relaxed);
+                stats.active = heap->active.load(std::memory_order_relaxed);
+                stats.resident = heap->resident.load(std::memory_order_relaxed);
+                stats.mapped = heap->mapped.load(std::memory_order_relaxed);
+            }
+            return stats;
+        }
+
+        bool SlabAllocator::shouldMove(const void *ptr, size_t size)
+        {
+            if (!ptr || !slab_enabled || size > MAX_SMALL_SIZE)
+                return false;
+            Segment *segment = segmentOf(ptr);
+            return segment->heap == local_heap && isSparse(local_heap, pageOf(segment, ptr));
+        }
+
+        void SlabAllocator::sortPages()
+        {
+            Heap *heap = local_heap;
+            if (!heap)
+                return;
+            drainRemoteFrees(heap);
+            std::vector<Page *> pages;
+            for (size_t size_class = 0; size_class < CLASS_COUNT; ++size_class)
+            {
+                pages.clear();
+                for (Page *page = heap->classes[size_class]; page; page = page->next)
+                    pages.push_back(page);
+                std::stable_sort(pages.begin(), pages.end(),
+                                 [](const Page *a, const Page *b) { return a->used > b->used; });
+
+                // Relinked back to front, as linkPage() pushes at the head.
+                heap->classes[size_class] = nullptr;
+                for (size_t i = pages.size(); i-- > 0;)
+                {
+                    if (hasBlocks(pages[i]))
+                        linkPage(heap, pages[i]);
+                    else
+                    {
+                        pages[i]->prev = pages[i]->next = nullptr;
+                        pages[i]->full = true;
+                        heap->class_full[size_class] += pages[i]->capacity;
+                    }
+                }
+            }
+        }
+
+        void *SlabAllocator::relocate(void *ptr, size_t size)
+        {
+            if (!shouldMove(ptr, size))
+                return nullptr;
+            Segment *segment = segmentOf(ptr);
+            Page *page = pageOf(segment, ptr);
+            void *block = takeDenseBlock(local_heap, page->size_class);
+            if (!block)
+                return nullptr;
+            std::memcpy(block, ptr, size);
+            freeLocal(local_heap, page, ptr);
+            return block;
+        }
+
+        SlabAllocator::DefragScope::DefragScope()
+        {
+            defrag_allocation = true;
+        }
+
+        SlabAllocator::DefragScope::~DefragScope()
+        {
+            defrag_allocation = false;
+        }
+
+        SlabAllocator::Stats SlabAllocator::stats()
+        {
+            Stats stats;
+            {
+                std::lock_guard<std::mutex> guard(registry_lock);
+                for (Heap *heap = heaps; heap; heap = heap->next)
+                {
+                    stats.allocated += heap->allocated.load(std::memory_order_relaxed);
+                    stats.active += heap->active.load(std::memory_order_relaxed);
+                    stats.resident += heap->resident.load(std::memory_order_relaxed);
+                    stats.mapped += heap->mapped.load(std::memory_order_relaxed);
+                }
+            }
+            stats.large = large_bytes.load(std::memory_order_relaxed);
+            stats.allocated += stats.large;
+            stats.active += stats.large;
+            stats.resident += stats.large;
+            stats.mapped += stats.large;
+            return stats;
+        }
+
+    } // namespace storage
+} // namespace opus
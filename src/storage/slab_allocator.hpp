@@ -0,0 +1,230 @@
+#ifndef OPUS_STORAGE_SLAB_ALLOCATOR_HPP
+#define OPUS_STORAGE_SLAB_ALLOCATOR_HPP
+
+#include <cstddef>
+#include <cstdint>
+#include <limits>
+#include <new>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+namespace opus
+{
+    namespace storage
+    {
+
+        /**
+         * @brief Size-class allocator for keyspace memory
+         *
+         * Requests up to MAX_SMALL_SIZE bytes are rounded up to one of 56 size
+         * classes (16-byte steps up to 256, then eight per doubling) and carved
+         * out of 64 KB pages that each hold a single class. A freed block is
+         * simply handed to the next request of its class, so churn never
+         * splits or coalesces anything and a page whose blocks are all freed
+         * can be reused whole, by any class. Pages come from 2 MB segments
+         * mapped straight from the kernel, optionally backed by transparent
+         * huge pages; emptied pages beyond a small per-thread cache go back to
+         * the kernel with MADV_DONTNEED. Larger requests are left to malloc.
+         *
+         * Each thread allocates from its own heap without locking. A block
+         * freed by another thread is pushed onto its heap's lock-free list and
+         * taken back the next time that heap runs out of blocks; the heap of
+         * a thread that exits is adopted by the next thread that needs one.
+         *
+         * Like sized delete, deallocate() must be given the size that was
+         * asked for (any size of the same class will do).
+         */
+        class SlabAllocator
+        {
+        public:
+            static constexpr size_t MAX_SMALL_SIZE = 8192;
+
+            struct Stats
+            {
+                size_t allocated = 0; // bytes of live blocks, class-rounded
+                size_t active = 0;    // bytes of pages holding live blocks
+                size_t resident = 0;  // active plus emptied pages still cached
+                size_t mapped = 0;    // segment address space
+                size_t large = 0;     // bytes handed to malloc, in all four above
+            };
+
+            /**
+             * @brief Picks slab pages or plain malloc, and whether segments ask
+             *        for transparent huge pages
+             *
+             * Must run before anything is allocated: a block is freed by
+             * whichever of the two is selected at the time.
+             */
+            static void configure(bool enabled, bool huge_pages);
+
+            static bool enabled();
+            static bool hugePages();
+
+            static void *allocate(size_t size);
+            static void deallocate(void *ptr, size_t size) noexcept;
+
+            /**
+             * @brief realloc() for a block of `old_size` bytes; returns `ptr`
+             *        itself when both sizes fall in one class
+             */
+            static void *reallocate(void *ptr, size_t old_size, size_t new_size);
+
+            /**
+             * @brief Bytes actually set aside for a request of `size`
+             */
+            static size_t usableSize(size_t size);
+
+            /**
+             * @brief Totals over every thread's heap; takes the heap registry
+             *        lock, so meant for INFO rather than hot paths
+             */
+            static Stats stats();
+
+            /**
+             * @brief The calling thread's heap alone, malloc'd blocks left out
+             */
+            static Stats threadStats();
+
+            /**
+             * @brief Whether the block lies in a page of the calling thread's
+             *        heap that is less used than its class's pages on average,
+             *        which is what active defragmentation moves blocks out of
+             */
+            static bool shouldMove(const void *ptr, size_t size);
+
+            /**
+             * @brief Reorders the calling thread's partly used pages of each
+             *        class fullest first
+             *
+             * Allocations take from the head of the list, so afterwards both
+             * relocations and ordinary traffic fill the fullest pages while
+             * the emptiest drain. Linear in the heap's pages; a defragmenter
+             * calls it once per slice.
+             */
+            static void sortPages();
+
+            /**
+             * @brief Moves a block out of a sparse page into a fuller one of the
+             *        same class
+             *
+             * Copies `size` bytes and frees the old block. Returns nullptr, and
+             * leaves the block alone, when shouldMove() is false or no fuller
+             * page has room.
+             */
+            static void *relocate(void *ptr, size_t size);
+
+            /**
+             * @brief While alive, the calling thread's allocations prefer the
+             *        fuller pages of their class, so objects rebuilt during
+             *        defragmentation fill gaps rather than the pages being
+             *        emptied
+             */
+            class DefragScope
+            {
+            public:
+                DefragScope();
+                ~DefragScope();
+
+                DefragScope(const DefragScope &) = delete;
+                DefragScope &operator=(const DefragScope &) = delete;
+            };
+        };
+
+        /**
+         * @brief Standard library allocator on top of SlabAllocator, for the
+         *        nodes and buffers of the collection types
+         */
+        template <typename T>
+        struct SlabStlAllocator
+        {
+            static_assert(alignof(T) <= alignof(std::max_align_t), "slab blocks are 16-byte aligned");
+
+            using value_type = T;
+
+            SlabStlAllocator() noexcept = default;
+
+            template <typename U>
+            SlabStlAllocator(const SlabStlAllocator<U> &) noexcept {}
+
+            T *allocate(size_t n)
+            {
+                if (n > std::numeric_limits<size_t>::max() / sizeof(T))
+                    throw std::bad_array_new_length();
+                return static_cast<T *>(SlabAllocator::allocate(n * sizeof(T)));
+            }
+
+            void deallocate(T *ptr, size_t n) noexcept
+            {
+                SlabAllocator::deallocate(ptr, n * sizeof(T));
+            }
+
+            template <typename U>
+            bool operator==(const SlabStlAllocator<U> &) const noexcept { return true; }
+
+            template <typename U>
+            bool operator!=(const SlabStlAllocator<U> &) const noexcept { return false; }
+        };
+
+        /**
+         * @brief Copies a slab-backed vector into fuller pages, capacity kept,
+         *        if its buffer sits in a sparse one
+         * @return whether it moved
+         */
+        template <typename T>
+        bool defragVector(std::vector<T, SlabStlAllocator<T>> &vector)
+        {
+            if (!SlabAllocator::shouldMove(vector.data(), vector.capacity() * sizeof(T)))
+                return false;
+            SlabAllocator::DefragScope scope;
+            std::vector<T, SlabStlAllocator<T>> copy;
+            copy.reserve(vector.capacity());
+            copy.assign(vector.begin(), vector.end());
+            vector.swap(copy);
+            return true;
+        }
+
+        // Largest table defragTable() rebuilds; a rebuild is one uninterrupted
+        // step, so bigger ones are left as they are.
+        constexpr size_t DEFRAG_MAX_TABLE_SIZE = 1024;
+
+        /**
+         * @brief Rebuilds a slab-backed unordered set or map in fuller pages
+         *        when at least a quarter of its nodes sit in sparse ones
+         *
+         * Nodes are extracted one by one and their contents moved into a
+         * table of the same bucket count, so no string is copied.
+         * @return whether it was rebuilt
+         */
+        template <typename Table>
+        bool defragTable(Table &table)
+        {
+            if (table.empty() || table.size() > DEFRAG_MAX_TABLE_SIZE)
+                return false;
+            size_t sparse = 0;
+            for (const auto &value : table)
+            {
+                if (SlabAllocator::shouldMove(&value, sizeof(value)))
+                    ++sparse;
+            }
+            if (sparse * 4 < table.size())
+                return false;
+
+            SlabAllocator::DefragScope scope;
+            Table copy(table.bucket_count());
+            while (!table.empty())
+            {
+                auto node = table.extract(table.begin());
+                if constexpr (std::is_same_v<typename Table::key_type, typename Table::value_type>)
+                    copy.insert(std::move(node.value()));
+                else
+                    copy.emplace(std::move(node.key()), std::move(node.mapped()));
+            }
+            table.swap(copy);
+            return true;
+        }
+
+    } // namespace storage
+} // namespace opus
+
+#endif // OPUS_STORAGE_SLAB_ALLOCATOR_HPP
@@ -0,0 +1,414 @@
+#include "sorted_set_type.hpp"
+
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include <stdexcept>
+
+namespace opus
+{
+    namespace storage
+    {
+
+        namespace
+        {
+            constexpr size_t SCORE_BYTES = sizeof(double);
+
+            std::string_view encodeScore(double score, char (&buf)[SCORE_BYTES])
+            {
+                std::memcpy(buf, &score, SCORE_BYTES);
+                return std::string_view(buf, SCORE_BYTES);
+            }
+
+            double decodeScore(std::string_view bytes)
+            {
+                double score;
+                std::memcpy(&score, bytes.data(), SCORE_BYTES);
+                return score;
+            }
+
+            // Clamps a ZRANGE start/stop pair to [0, length); false if empty.
+            bool normalizeRange(long long &start, long long &stop, size_t length)
+            {
+                long long len = static_cast<long long>(length);
+                if (start < 0)
+                    start += len;
+                if (stop < 0)
+                    stop += len;
+                if (start < 0)
+                    start = 0;
+                if (stop >= len)
+                    stop = len - 1;
+                return start <= stop && start < len;
+            }
+        }
+
+        SortedSetType::Limits SortedSetType::limits;
+
+        SortedSetType::SortedSetType() = default;
+
+        SortedSetType::~SortedSetType() = default;
+
+        SortedSetType::SortedSetType(SortedSetType &&other) noexcept = default;
+
+        size_t SortedSetType::defrag()
+        {
+            auto *listpack = std::get_if<Listpack>(&entries);
+            return listpack && listpack->defrag() ? 1 : 0;
+        }
+
+        void SortedSetType::setLimits(const Limits &new_limits)
+        {
+            limits = new_limits;
+        }
+
+        Encoding SortedSetType::encoding() const
+        {
+            return std::holds_alternative<Listpack>(entries) ? Encoding::LISTPACK : Encoding::SKIPLIST;
+        }
+
+        size_t SortedSetType::memoryUsage() const
+        {
+            if (const Listpack *packed = std::get_if<Listpack>(&entries))
+                return sizeof(SortedSetType) + packed->bytes();
+            const Index &index = *std::get<std::unique_ptr<Index>>(entries);
+            return sizeof(SortedSetType) + sizeof(Index) + index.list.bytes() +
+                   index.members.bucket_count() * sizeof(void *) + index.members.size() * INDEX_NODE_BYTES;
+        }
+
+        SortedSetType::Index &SortedSetType::convertToSkiplist()
+        {
+            auto index = std::make_unique<Index>();
+            const Listpack &packed = std::get<Listpack>(entries);
+            index->members.reserve(packed.size() / 2 + 1);
+            for (const auto &[member, score] : packedPairs())
+            {
+                Skiplist::Node *node = index->list.insert(score, member);
+                index->members.emplace(node->member(), node);
+            }
+            entries = std::move(index);
+            return *std::get<std::unique_ptr<Index>>(entries);
+        }
+
+        std::vector<std::pair<std::string_view, double>> SortedSetType::packedPairs() const
+        {
+            const Listpack &packed = std::get<Listpack>(entries);
+            std::vector<std::pair<std::string_view, double>> pairs;
+            pairs.reserve(packed.size() / 2);
+            for (size_t offset = 0, next; offset < packed.end(); offset = next)
+            {
+                std::string_view member = packed.at(offset, next);
+                pairs.emplace_back(member, decodeScore(packed.at(next, next)));
+            }
+            return pairs;
+        }
+
+        void SortedSetType::packedInsert(std::string_view member, double score)
+        {
+            Listpack &packed = std::get<Listpack>(entries);
+            size_t offset = 0;
+            while (offset < packed.end())
+            {
+                size_t score_offset, next;
+                std::string_view existing = packed.at(offset, score_offset);
+                double existing_score = decodeScore(packed.at(score_offset, next));
+                if (existing_score > score || (existing_score == score && existing > member))
+                    break;
+                offset = next;
+            }
+
+            char buf[SCORE_BYTES];
+            packed.insert(offset, encodeScore(score, buf));
+            packed.insert(offset, member);
+        }
+
+        void SortedSetType::insert(const std::string &member, double score)
+        {
+            if (std::holds_alternative<Listpack>(entries))
+            {
+                const Listpack &packed = std::get<Listpack>(entries);
+                if (packed.size() / 2 < limits.max_listpack_entries && member.size() <= limits.max_listpack_value)
+                {
+                    packedInsert(member, score);
+                    return;
+                }
+                convertToSkiplist();
+            }
+
+            Index &index = *std::get<std::unique_ptr<Index>>(entries);
+            Skiplist::Node *node = index.list.insert(score, member);
+            index.members.emplace(node->member(), node);
+        }
+
+        SortedSetType::AddResult SortedSetType::zadd(const std::string &member, double &score, unsigned flags)
+        {
+            std::optional<double> current = zscore(member);
+            if (!current)
+            {
+                if (flags & ADD_XX)
+                    return AddResult::SKIPPED;
+                insert(member, score);
+                return AddResult::ADDED;
+            }
+
+            if (flags & ADD_NX)
+                return AddResult::SKIPPED;
+
+            double updated = score;
+            if (flags & ADD_INCR)
+            {
+                updated = *current + score;
+                if (std::isnan(updated))
+                    throw std::runtime_error("ERR resulting score is not a number (NaN)");
+            }
+            if (((flags & ADD_GT) && updated <= *current) || ((flags & ADD_LT) && updated >= *current))
+                return AddResult::SKIPPED;
+            if (updated == *current)
+            {
+                score = updated;
+                return AddResult::UNCHANGED;
+            }
+
+            score = updated;
+            if (Listpack *packed = std::get_if<Listpack>(&entries))
+            {
+                size_t offset = packed->find(member, 2);
+                packed->erase(offset);
+                packed->erase(offset);
+                packedInsert(member, updated);
+            }
+            else
+            {
+                Index &index = *std::get<std::unique_ptr<Index>>(entries);
+                index.list.updateScore(index.members.find(member)->second, updated);
+            }
+            return AddResult::UPDATED;
+        }
+
+        int SortedSetType::zrem(std::string_view member)
+        {
+            if (Listpack *packed = std::get_if<Listpack>(&entries))
+            {
+                size_t offset = packed->find(member, 2);
+                if (offset == Listpack::npos)
+                    return 0;
+                packed->erase(offset);
+                packed->erase(offset);
+                return 1;
+            }
+
+            Index &index = *std::get<std::unique_ptr<Index>>(entries);
+            auto it = index.members.find(member);
+            if (it == index.members.end())
+                return 0;
+            // The key views the node's bytes: drop it before the node goes.
+            Skiplist::Node *node = it->second;
+            index.members.erase(it);
+            index.list.erase(node);
+            return 1;
+        }
+
+        std::optional<double> SortedSetType::zscore(std::string_view member) const
+        {
+            if (const Listpack *packed = std::get_if<Listpack>(&entries))
+            {
+                size_t offset = packed->find(member, 2);
+                if (offset == Listpack::npos)
+                    return std::nullopt;
+                size_t score_offset, next;
+                packed->at(offset, score_offset);
+                return decodeScore(packed->at(score_offset, next));
+            }
+
+            const Index &index = *std::get<std::unique_ptr<Index>>(entries);
+            auto it = index.members.find(member);
+            if (it == index.members.end())
+                return std::nullopt;
+            return it->second->score();
+        }
+
+        std::optional<size_t> SortedSetType::zrank(std::string_view member, bool reverse) const
+        {
+            size_t rank;
+            if (std::holds_alternative<Listpack>(entries))
+            {
+                auto pairs = packedPairs();
+                rank = 0;
+                while (rank < pairs.size() && pairs[rank].first != member)
+                {
+                    ++rank;
+                }
+                if (rank == pairs.size())
+                    return std::nullopt;
+            }
+            else
+            {
+                const Index &index = *std::get<std::unique_ptr<Index>>(entries);
+                auto it = index.members.find(member);
+                if (it == index.members.end())
+                    return std::nullopt;
+                rank = index.list.rankOf(it->second) - 1;
+            }
+            return reverse ? zcard() - 1 - rank : rank;
+        }
+
+        int SortedSetType::zcard() const
+        {
+            if (const Listpack *packed = std::get_if<Listpack>(&entries))
+                return packed->size() / 2;
+            return std::get<std::unique_ptr<Index>>(entries)->list.size();
+        }
+
+        std::vector<SortedSetType::MemberScore> SortedSetType::zrange(long long start, long long stop, bool reverse) const
+        {
+            std::vector<MemberScore> result;
+            size_t length = zcard();
+            if (!normalizeRange(start, stop, length))
+                return result;
+
+            size_t count = static_cast<size_t>(stop - start + 1);
+            result.reserve(count);
+            if (std::holds_alternative<Listpack>(entries))
+            {
+                auto pairs = packedPairs();
+                for (size_t i = 0; i < count; ++i)
+                {
+                    size_t at = reverse ? length - 1 - (start + i) : start + i;
+                    result.emplace_back(std::string(pairs[at].first), pairs[at].second);
+                }
+                return result;
+            }
+
+            const Skiplist &list = std::get<std::unique_ptr<Index>>(entries)->list;
+            Skiplist::Node *node = list.byRank(reverse ? length - start : start + 1);
+            for (size_t i = 0; i < count && node; ++i)
+            {
+                result.emplace_back(std::string(node->member()), node->score());
+                node = reverse ? node->prev() : node->next();
+            }
+            return result;
+        }
+
+        std::vector<SortedSetType::MemberScore> SortedSetType::zrangebyscore(const ScoreRange &range, bool reverse,
+                                                                             size_t offset, long long count) const
+        {
+            std::vector<MemberScore> result;
+            if (range.empty() || count == 0)
+                return result;
+
+            auto wanted = [&]()
+            { return count < 0 || result.size() < static_cast<size_t>(count); };
+
+            if (std::holds_alternative<Listpack>(entries))
+            {
+                auto pairs = packedPairs();
+                for (size_t i = 0; i < pairs.size() && wanted(); ++i)
+                {
+                    const auto &[member, score] = pairs[reverse ? pairs.size() - 1 - i : i];
+                    if (!range.contains(score))
+                        continue;
+                    if (offset > 0)
+                        --offset;
+                    else
+                        result.emplace_back(std::string(member), score);
+                }
+                return result;
+            }
+
+            const Skiplist &list = std::get<std::unique_ptr<Index>>(entries)->list;
+            Skiplist::Node *node = reverse ? list.lastInRange(range) : list.firstInRange(range);
+            for (; node && offset > 0; --offset)
+            {
+                node = reverse ? node->prev() : node->next();
+            }
+            while (node && range.contains(node->score()) && wanted())
+            {
+                result.emplace_back(std::string(node->member()), node->score());
+                node = reverse ? node->prev() : node->next();
+            }
+            return result;
+        }
+
+        size_t SortedSetType::zremrangebyscore(const ScoreRange &range)
+        {
+            if (range.empty())
+                return 0;
+
+            if (Listpack *packed = std::get_if<Listpack>(&entries))
+            {
+                size_t removed = 0;
+                size_t offset = 0;
+                while (offset < packed->end())
+                {
+                    size_t score_offset, next;
+                    packed->at(offset, score_offset);
+                    double score = decodeScore(packed->at(score_offset, next));
+                    if (!range.belowMax(score))
+                        break;
+                    if (range.aboveMin(score))
+                    {
+                        packed->erase(offset);
+                        packed->erase(offset);
+                        ++removed;
+                    }
+                    else
+                    {
+                        offset = next;
+                    }
+                }
+                return removed;
+            }
+
+            Index &index = *std::get<std::unique_ptr<Index>>(entries);
+            return index.list.eraseRange(range, [&](Skiplist::Node *node)
+                                         { index.members.erase(node->member()); });
+        }
+
+        std::vector<SortedSetType::MemberScore> SortedSetType::zpopmin(size_t count)
+        {
+            if (count == 0)
+                return {};
+            std::vector<MemberScore> result = zrange(0, static_cast<long long>(std::min<size_t>(count, zcard())) - 1);
+            for (const auto &entry : result)
+            {
+                zrem(entry.first);
+            }
+            return result;
+        }
+
+        unsigned long long SortedSetType::zscan(unsigned long long cursor, size_t count,
+                                                std::vector<MemberScore> &out) const
+        {
+            // A compact set is returned whole, as Redis does.
+            if (std::holds_alternative<Listpack>(entries))
+            {
+                for (const auto &[member, score] : packedPairs())
+                {
+                    out.emplace_back(std::string(member), score);
+                }
+                return 0;
+            }
+
+            // Empty buckets count against a budget, as in CacheManager::scan():
+            // an index shrunk by ZREM keeps its buckets.
+            const auto &members = std::get<std::unique_ptr<Index>>(entries)->members;
+            size_t buckets = members.bucket_count();
+            size_t budget = count < SIZE_MAX / 10 ? count * 10 : SIZE_MAX;
+            size_t visited = 0;
+            for (; cursor < buckets && visited < count && budget > 0; ++cursor, --budget)
+            {
+                for (auto it = members.begin(cursor); it != members.end(cursor); ++it, ++visited)
+                {
+                    out.emplace_back(std::string(it->first), it->second->score());
+                }
+            }
+            return cursor < buckets ? cursor : 0;
+        }
+
+        bool SortedSetType::isEmpty() const
+        {
+            return zcard() == 0;
+        }
+
+    } // namespace storage
+} // namespace opus
@@ -0,0 +1,167 @@
+#ifndef OPUS_STORAGE_SORTED_SET_TYPE_HPP
+#define OPUS_STORAGE_SORTED_SET_TYPE_HPP
+
+#include "base_datastructure.hpp"
+#include "listpack.hpp"
+#include "skiplist.hpp"
+#include <cstddef>
+#include <memory>
+#include <optional>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+#include <utility>
+#include <variant>
+#include <vector>
+
+namespace opus
+{
+    namespace storage
+    {
+
+        /**
+         * @brief Sorted set of members ordered by score, then member
+         *
+         * A small sorted set is a Listpack of (member, score) pairs kept in
+         * order, the score stored as its 8 raw bytes. A larger one is a
+         * span-annotated Skiplist for O(log n) rank and range queries plus a
+         * hash index from member to skiplist node for O(1) score lookups; the
+         * index keys point at the member bytes inside the nodes, so each
+         * member is stored once.
+         */
+        class SortedSetType : public BaseDataStructure
+        {
+        public:
+            /**
+             * @brief Size thresholds for the compact encoding (the
+             *        zset-max-listpack-* options, with Redis's defaults)
+             */
+            struct Limits
+            {
+                size_t max_listpack_entries = 128;
+                size_t max_listpack_value = 64;
+            };
+
+            using MemberScore = std::pair<std::string, double>;
+
+            // ZADD options
+            static constexpr unsigned ADD_NX = 1 << 0;   // only add new members
+            static constexpr unsigned ADD_XX = 1 << 1;   // only update existing members
+            static constexpr unsigned ADD_GT = 1 << 2;   // only update to a greater score
+            static constexpr unsigned ADD_LT = 1 << 3;   // only update to a lower score
+            static constexpr unsigned ADD_INCR = 1 << 4; // the score is an increment
+
+            enum class AddResult
+            {
+                ADDED,
+                UPDATED,
+                UNCHANGED, // already at that score
+                SKIPPED    // left alone because of the options
+            };
+
+        private:
+            struct Index
+            {
+                Skiplist list;
+                std::unordered_map<std::string_view, Skiplist::Node *, std::hash<std::string_view>,
+                                   std::equal_to<std::string_view>,
+                                   SlabStlAllocator<std::pair<const std::string_view, Skiplist::Node *>>>
+                    members;
+            };
+
+            std::variant<Listpack, std::unique_ptr<Index>> entries;
+
+            static Limits limits;
+
+            // An index node: next pointer, member view, node pointer, cached hash.
+            static constexpr size_t INDEX_NODE_BYTES =
+                sizeof(void *) + sizeof(std::string_view) + sizeof(Skiplist::Node *) + sizeof(size_t);
+
+            Index &convertToSkiplist();
+
+            // Pairs of a compact set in order; views into the listpack.
+            std::vector<std::pair<std::string_view, double>> packedPairs() const;
+            void packedInsert(std::string_view member, double score);
+
+            void insert(const std::string &member, double score);
+
+        public:
+            SortedSetType();
+            ~SortedSetType();
+            SortedSetType(SortedSetType &&other) noexcept;
+
+            static constexpr ValueType TYPE = ValueType::ZSET;
+
+            /**
+             * @brief Replaces the thresholds; called once at startup, before
+             *        any worker runs
+             */
+            static void setLimits(const Limits &new_limits);
+
+            Encoding encoding() const;
+
+            /**
+             * @brief Estimated bytes held, the object included; O(1)
+             */
+            size_t memoryUsage() const;
+
+            /**
+             * @brief Moves a packed sorted set's buffer out of a sparsely used
+             *        allocator page; skiplist nodes stay, as every level
+             *        pointing at a node would need fixing up
+             * @return blocks moved
+             */
+            size_t defrag();
+
+            /**
+             * @brief ZADD of one member under the ADD_* options
+             *
+             * With ADD_INCR `score` is the increment. On return it holds the
+             * member's score. Throws std::runtime_error if an increment gives
+             * NaN.
+             */
+            AddResult zadd(const std::string &member, double &score, unsigned flags);
+
+            int zrem(std::string_view member);
+            std::optional<double> zscore(std::string_view member) const;
+
+            /**
+             * @return 0-based rank, counted from the highest score when
+             *         `reverse` is set
+             */
+            std::optional<size_t> zrank(std::string_view member, bool reverse = false) const;
+
+            int zcard() const;
+
+            /**
+             * @brief Members by rank; negative indexes count from the end
+             */
+            std::vector<MemberScore> zrange(long long start, long long stop, bool reverse = false) const;
+
+            /**
+             * @brief Members with a score in `range`, skipping `offset` and
+             *        returning at most `count` of them (all if negative)
+             */
+            std::vector<MemberScore> zrangebyscore(const ScoreRange &range, bool reverse = false,
+                                                   size_t offset = 0, long long count = -1) const;
+
+            size_t zremrangebyscore(const ScoreRange &range);
+
+            /**
+             * @brief Removes and returns up to `count` lowest-scored members
+             */
+            std::vector<MemberScore> zpopmin(size_t count);
+
+            /**
+             * @brief One ZSCAN page; see HashType::hscan(), which pages
+             *        through its fields the same way
+             */
+            unsigned long long zscan(unsigned long long cursor, size_t count, std::vector<MemberScore> &out) const;
+
+            bool isEmpty() const;
+        };
+
+    } // namespace storage
+} // namespace opus
+
+#endif // OPUS_STORAGE_SORTED_SET_TYPE_HPP
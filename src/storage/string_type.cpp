@@ -1,5 +1,11 @@
 #include "string_type.hpp"
 
+#include <cctype>
+#include <cerrno>
+#include <charconv>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
 #include <utility>
 
 namespace opus
@@ -9,23 +15,96 @@ namespace opus
 
         StringType::StringType() = default;
 
-        StringType::StringType(const std::string &val) : value(val) {}
+        StringType::StringType(std::string_view val) : value(val.data(), val.size()) {}
 
-        StringType::~StringType() = default;
+        StringType::StringType(StringType &&other) noexcept : value(std::move(other.value)) {}
 
-        std::string StringType::getType() const
+        void StringType::set(const std::string &val)
         {
-            return "string";
+            value.assign(val.data(), val.size());
         }
 
-        void StringType::set(const std::string &val)
+        std::string StringType::get() const
         {
-            value = val;
+            return std::string(value.data(), value.size());
         }
 
-        std::string StringType::get() const
+        bool StringType::defrag()
+        {
+            if (heapBytes(value.capacity()) == 0 || !SlabAllocator::shouldMove(value.data(), value.capacity() + 1))
+                return false;
+            SlabAllocator::DefragScope scope;
+            Buffer copy;
+            copy.reserve(value.capacity());
+            copy.assign(value.data(), value.size());
+            value.swap(copy);
+            return true;
+        }
+
+        bool StringType::parseInteger(std::string_view text, long long &out)
+        {
+            if (text.empty() || text.size() > MAX_INTEGER_DIGITS)
+                return false;
+
+            size_t digits = text[0] == '-' ? 1 : 0;
+            if (digits == text.size())
+                return false;
+            // "0" is the only number allowed to start with a zero ("-0" is not).
+            if (text[digits] == '0' && text.size() > 1)
+                return false;
+
+            auto [ptr, ec] = std::from_chars(text.data(), text.data() + text.size(), out);
+            return ec == std::errc() && ptr == text.data() + text.size();
+        }
+
+        size_t StringType::formatInteger(long long value, char *buf)
+        {
+            auto [ptr, ec] = std::to_chars(buf, buf + MAX_INTEGER_DIGITS, value);
+            (void)ec;
+            return static_cast<size_t>(ptr - buf);
+        }
+
+        bool StringType::parseFloat(std::string_view text, long double &out)
         {
-            return value;
+            // Anything longer is not a float worth parsing.
+            constexpr size_t MAX_FLOAT_CHARS = 5 * 1024;
+            if (text.empty() || text.size() >= MAX_FLOAT_CHARS || std::isspace(static_cast<unsigned char>(text[0])))
+                return false;
+
+            // strtold needs a terminated copy.
+            char buf[MAX_FLOAT_CHARS];
+            text.copy(buf, text.size());
+            buf[text.size()] = '\0';
+
+            char *end = nullptr;
+            errno = 0;
+            long double value = std::strtold(buf, &end);
+            if (end != buf + text.size() || std::isnan(value) ||
+                (errno == ERANGE && (value == HUGE_VALL || value == -HUGE_VALL || value == 0)))
+                return false;
+
+            out = value;
+            return true;
+        }
+
+        std::string StringType::formatFloat(long double value)
+        {
+            char buf[5 * 1024];
+            int len = std::snprintf(buf, sizeof(buf), "%.17Lf", value);
+            if (len <= 0 || static_cast<size_t>(len) >= sizeof(buf))
+                return std::string();
+
+            std::string text(buf, static_cast<size_t>(len));
+            if (text.find('.') != std::string::npos)
+            {
+                while (text.back() == '0')
+                    text.pop_back();
+                if (text.back() == '.')
+                    text.pop_back();
+            }
+            if (text == "-0")
+                text = "0";
+            return text;
         }
 
     } // namespace storage
@@ -2,7 +2,10 @@
 #define OPUS_STORAGE_STRING_TYPE_HPP
 
 #include "base_datastructure.hpp"
+#include <atomic>
+#include <cstdint>
 #include <string>
+#include <string_view>
 
 namespace opus
 {
@@ -12,17 +15,101 @@ namespace opus
         class StringType : public BaseDataStructure
         {
         private:
-            std::string value;
+            // Bytes past the inline buffer come from the slab allocator.
+            using Buffer = std::basic_string<char, std::char_traits<char>, SlabStlAllocator<char>>;
+
+            Buffer value;
+
+            // Owners of the string: the entry holding it, plus replies still
+            // waiting to write it out (see retain()).
+            mutable std::atomic<uint32_t> refs{1};
 
         public:
             StringType();
-            explicit StringType(const std::string &val);
-            ~StringType() override;
+            explicit StringType(std::string_view val);
 
-            std::string getType() const override;
+            // Takes over the bytes; only for a string nothing else shares.
+            StringType(StringType &&other) noexcept;
+
+            static constexpr ValueType TYPE = ValueType::STRING;
 
             void set(const std::string &val);
             std::string get() const;
+            std::string_view view() const { return value; }
+
+            /**
+             * @brief Adds an owner, so view() outlives the key being
+             *        overwritten or deleted
+             *
+             * Stored strings are replaced on write, never changed in place,
+             * so a shared one can be read from any thread without the
+             * keyspace's locks.
+             */
+            void retain() const { refs.fetch_add(1, std::memory_order_relaxed); }
+
+            /**
+             * @brief Drops an owner; the last one frees the string
+             */
+            static void release(const StringType *string)
+            {
+                if (string->refs.fetch_sub(1, std::memory_order_acq_rel) == 1)
+                    delete const_cast<StringType *>(string);
+            }
+
+            bool shared() const { return refs.load(std::memory_order_acquire) > 1; }
+
+            /**
+             * @brief Moves the bytes out of a sparsely used allocator page
+             * @return whether they moved
+             */
+            bool defrag();
+
+            /**
+             * @brief Heap bytes a std::string of `length` allocates beyond
+             *        itself: none while it fits the inline buffer (15 bytes
+             *        in libstdc++), else the bytes plus a terminator
+             */
+            static size_t heapBytes(size_t length) { return length < 16 ? 0 : length + 1; }
+
+            /**
+             * @brief Estimated bytes held, the object included
+             */
+            size_t memoryUsage() const
+            {
+                size_t heap = heapBytes(value.capacity());
+                return sizeof(StringType) + (heap ? SlabAllocator::usableSize(heap) : 0);
+            }
+
+            // Longest decimal form of a long long ("-9223372036854775808").
+            static constexpr size_t MAX_INTEGER_DIGITS = 20;
+
+            /**
+             * @brief Parses `text` if it is the canonical decimal form of a
+             *        64-bit integer (no sign other than '-', no leading zeros,
+             *        no spaces), i.e. exactly what formatInteger would print
+             *
+             * Only such strings are stored integer-encoded, so GET returns
+             * the bytes that were SET. This is also the form INCR accepts.
+             */
+            static bool parseInteger(std::string_view text, long long &out);
+
+            /**
+             * @brief Writes `value` in decimal into `buf` (at least
+             *        MAX_INTEGER_DIGITS bytes) and returns the length
+             */
+            static size_t formatInteger(long long value, char *buf);
+
+            /**
+             * @brief Parses a float as INCRBYFLOAT does: the whole string must
+             *        be consumed, no leading space, NaN is rejected
+             */
+            static bool parseFloat(std::string_view text, long double &out);
+
+            /**
+             * @brief Human-friendly float formatting: 17 decimals with
+             *        trailing zeros (and a trailing point) removed
+             */
+            static std::string formatFloat(long double value);
         };
 
     } // namespace storage